@@ -0,0 +1,50 @@
+#include "arena.h"
+
+#include "freertos/FreeRTOS.h"
+#include "mem.h"
+
+fp_arena* fp_arena_init(size_t capacity) {
+	fp_arena* arena = fp_mem_alloc(FP_MEM_ARENA, sizeof(fp_arena));
+	if(!arena) {
+		printf("error: fp_arena_init: failed to allocate memory for arena\n");
+		return NULL;
+	}
+
+	arena->buffer = fp_mem_alloc(FP_MEM_ARENA, capacity);
+	if(!arena->buffer) {
+		printf("error: fp_arena_init: failed to allocate %u bytes\n", (unsigned int)capacity);
+		fp_mem_free(arena);
+		return NULL;
+	}
+
+	arena->capacity = capacity;
+	arena->used = 0;
+	arena->peak = 0;
+
+	return arena;
+}
+
+bool fp_arena_free(fp_arena* arena) {
+	fp_mem_free(arena->buffer);
+	fp_mem_free(arena);
+	return true;
+}
+
+void* fp_arena_alloc(fp_arena* arena, size_t size) {
+	size_t offset = (arena->used + FP_ARENA_ALIGN - 1) & ~(size_t)(FP_ARENA_ALIGN - 1);
+	if(offset + size > arena->capacity) {
+		printf("error: fp_arena_alloc: arena full. requested %u, %u/%u used\n", (unsigned int)size, (unsigned int)arena->used, (unsigned int)arena->capacity);
+		return NULL;
+	}
+
+	arena->used = offset + size;
+	if(arena->used > arena->peak) {
+		arena->peak = arena->used;
+	}
+
+	return arena->buffer + offset;
+}
+
+void fp_arena_reset(fp_arena* arena) {
+	arena->used = 0;
+}
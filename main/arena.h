@@ -0,0 +1,31 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * fp_arena
+ * bump allocator over a single block of memory. allocations are never freed individually,
+ * the whole arena is reset or freed at once.
+ */
+
+typedef struct {
+	size_t capacity;
+	size_t used;
+	/* largest value of "used" since the arena was created */
+	size_t peak;
+	char* buffer;
+} fp_arena;
+
+fp_arena* fp_arena_init(size_t capacity);
+bool fp_arena_free(fp_arena* arena);
+
+/** returns NULL if the arena doesn't have room. memory is aligned to FP_ARENA_ALIGN */
+void* fp_arena_alloc(fp_arena* arena, size_t size);
+/** releases every allocation made from the arena */
+void fp_arena_reset(fp_arena* arena);
+
+#define FP_ARENA_ALIGN 4
+
+#endif /* ARENA_H */
@@ -0,0 +1,310 @@
+#include "budget.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "ring.h"
+#include "trace.h"
+#include "console.h"
+
+static const char* fp_budget_degrade_names[FP_VIEW_DEGRADE_COUNT] = {
+	"none",
+	"half rate",
+	"low res",
+	"skip",
+};
+
+/* fp_budget_view registrations from any task, drained by the render task */
+fp_ring* budgetRegistrations = NULL;
+atomic_uint budgetTargetUs = 0;
+
+/* only accessed by the render task */
+fp_budget_view budgetViews[FP_BUDGET_VIEW_COUNT];
+unsigned int budgetViewCount = 0;
+unsigned int framesSinceDecision = 0;
+unsigned int framesSinceRestore = 0;
+unsigned int headroomFrames = 0;
+fp_budget_stats budgetStats = { 0 };
+
+bool fp_budget_init(uint32_t budgetUs) {
+	budgetRegistrations = fp_ring_init(FP_BUDGET_VIEW_COUNT, sizeof(fp_budget_view));
+	if(!budgetRegistrations) {
+		printf("error: fp_budget_init: failed to allocate registration ring\n");
+		return false;
+	}
+
+	budgetStats.restoreFrames = FP_BUDGET_RESTORE_FRAMES;
+	framesSinceRestore = FP_BUDGET_RESTORE_FRAMES * 8;
+	atomic_store(&budgetTargetUs, budgetUs);
+	return true;
+}
+
+void fp_budget_set(uint32_t budgetUs) {
+	atomic_store(&budgetTargetUs, budgetUs);
+}
+
+bool fp_budget_register(fp_viewid view, unsigned int priority, fp_view_degrade maxDegrade) {
+	fp_view* target = fp_view_get(view);
+	if(!budgetRegistrations || !target || maxDegrade >= FP_VIEW_DEGRADE_COUNT) {
+		return false;
+	}
+
+	fp_budget_view budgetView = { view, target->serial, priority, maxDegrade, false };
+	if(!fp_ring_push(budgetRegistrations, &budgetView)) {
+		printf("error: fp_budget_register: registration ring full. limit: %d\n", FP_BUDGET_VIEW_COUNT);
+		return false;
+	}
+
+	return true;
+}
+
+static void fp_budget_set_degrade(fp_budget_view* budgetView, fp_view_degrade degrade, const char* action) {
+	fp_view* view = fp_view_get(budgetView->view);
+	view->degrade = degrade;
+	fp_view_mark_dirty(budgetView->view);
+
+	printf("budget: %s view %u (priority %u) to %s. average %u us, budget %u us\n",
+		action,
+		budgetView->view,
+		budgetView->priority,
+		fp_budget_degrade_names[degrade],
+		budgetStats.averageUs,
+		budgetStats.budgetUs
+	);
+}
+
+/** the next level in direction (1 to degrade, -1 to restore), skipping levels that don't change the view */
+static fp_view_degrade fp_budget_step(fp_budget_view* budgetView, int direction) {
+	fp_view* view = fp_view_get(budgetView->view);
+	int degrade = view->degrade + direction;
+	if(degrade == FP_VIEW_DEGRADE_LOW_RES && view->type != FP_VIEW_PROCEDURAL) {
+		degrade += direction;
+	}
+	return degrade;
+}
+
+/* the lowest priority view on screen that can be degraded further. ties go to the least degraded view */
+static fp_budget_view* fp_budget_find_degrade() {
+	fp_budget_view* found = NULL;
+	unsigned int foundDegrade = 0;
+	for(unsigned int i = 0; i < budgetViewCount; i++) {
+		if(!budgetViews[i].onScreen || fp_budget_step(&budgetViews[i], 1) > budgetViews[i].maxDegrade) {
+			continue;
+		}
+
+		unsigned int degrade = fp_view_get(budgetViews[i].view)->degrade;
+		if(!found
+			|| budgetViews[i].priority < found->priority
+			|| (budgetViews[i].priority == found->priority && degrade < foundDegrade)) {
+			found = &budgetViews[i];
+			foundDegrade = degrade;
+		}
+	}
+
+	return found;
+}
+
+/* the highest priority degraded view. ties go to the most degraded view */
+static fp_budget_view* fp_budget_find_restore() {
+	fp_budget_view* found = NULL;
+	unsigned int foundDegrade = 0;
+	for(unsigned int i = 0; i < budgetViewCount; i++) {
+		unsigned int degrade = fp_view_get(budgetViews[i].view)->degrade;
+		if(!budgetViews[i].onScreen || degrade == FP_VIEW_DEGRADE_NONE) {
+			continue;
+		}
+
+		if(!found
+			|| budgetViews[i].priority > found->priority
+			|| (budgetViews[i].priority == found->priority && degrade > foundDegrade)) {
+			found = &budgetViews[i];
+			foundDegrade = degrade;
+		}
+	}
+
+	return found;
+}
+
+static bool fp_budget_is_under(fp_viewid id, fp_viewid root) {
+	while(id != 0) {
+		if(id == root) {
+			return true;
+		}
+		id = fp_view_get(id)->parent;
+	}
+	return false;
+}
+
+/* add new registrations, drop views that were freed and restore views that left the screen */
+static void fp_budget_update_views(fp_viewid root) {
+	fp_budget_view budgetView;
+	while(fp_ring_pop(budgetRegistrations, &budgetView)) {
+		if(budgetViewCount >= FP_BUDGET_VIEW_COUNT) {
+			printf("error: fp_budget_update: too many views, can't add %u\n", budgetView.view);
+			continue;
+		}
+		budgetViews[budgetViewCount] = budgetView;
+		budgetViewCount++;
+	}
+
+	unsigned int degradedCount = 0;
+	for(unsigned int i = 0; i < budgetViewCount;) {
+		if(!fp_view_is_alive(budgetViews[i].view, budgetViews[i].serial)) {
+			budgetViewCount--;
+			budgetViews[i] = budgetViews[budgetViewCount];
+			continue;
+		}
+
+		budgetViews[i].onScreen = fp_budget_is_under(budgetViews[i].view, root);
+		if(fp_view_get(budgetViews[i].view)->degrade != FP_VIEW_DEGRADE_NONE) {
+			if(budgetViews[i].onScreen) {
+				degradedCount++;
+			}
+			else {
+				/* scenes start at full quality when they come back */
+				fp_budget_set_degrade(&budgetViews[i], FP_VIEW_DEGRADE_NONE, "restored off screen");
+			}
+		}
+		i++;
+	}
+
+	budgetStats.viewCount = budgetViewCount;
+	budgetStats.degradedCount = degradedCount;
+}
+
+void fp_budget_update(fp_viewid root, uint32_t frameUs) {
+	if(!budgetRegistrations) {
+		return;
+	}
+
+	fp_budget_update_views(root);
+
+	uint32_t budgetUs = atomic_load_explicit(&budgetTargetUs, memory_order_relaxed);
+	budgetStats.budgetUs = budgetUs;
+	budgetStats.lastUs = frameUs;
+	if(budgetStats.frames == 0) {
+		budgetStats.averageUs = frameUs;
+	}
+	else {
+		budgetStats.averageUs += ((int32_t)frameUs - (int32_t)budgetStats.averageUs) / FP_BUDGET_AVERAGE_WEIGHT;
+	}
+	budgetStats.frames++;
+
+	if(budgetUs == 0) {
+		/* disabled. undo everything at once */
+		for(unsigned int i = 0; i < budgetViewCount; i++) {
+			if(fp_view_get(budgetViews[i].view)->degrade != FP_VIEW_DEGRADE_NONE) {
+				fp_budget_set_degrade(&budgetViews[i], FP_VIEW_DEGRADE_NONE, "restored");
+				budgetStats.restores++;
+			}
+		}
+		budgetStats.degradedCount = 0;
+		budgetStats.restoreFrames = FP_BUDGET_RESTORE_FRAMES;
+		headroomFrames = 0;
+		return;
+	}
+
+	if(frameUs > budgetUs) {
+		budgetStats.overruns++;
+	}
+
+	framesSinceDecision++;
+	framesSinceRestore++;
+	if(framesSinceDecision < FP_BUDGET_COOLDOWN_FRAMES) {
+		return;
+	}
+
+	if(budgetStats.averageUs > budgetUs) {
+		headroomFrames = 0;
+		fp_budget_view* budgetView = fp_budget_find_degrade();
+		if(!budgetView) {
+			return;
+		}
+
+		if(framesSinceRestore < budgetStats.restoreFrames && budgetStats.restoreFrames < FP_BUDGET_RESTORE_FRAMES * 8) {
+			/* the last restore didn't fit. wait longer before the next one */
+			budgetStats.restoreFrames *= 2;
+		}
+
+		fp_budget_set_degrade(budgetView, fp_budget_step(budgetView, 1), "degraded");
+		fp_trace_instant("budget degrade");
+		budgetStats.degrades++;
+		framesSinceDecision = 0;
+	}
+	else if(budgetStats.averageUs < (uint64_t)budgetUs * FP_BUDGET_RESTORE_PERCENT / 100) {
+		headroomFrames++;
+		if(headroomFrames < budgetStats.restoreFrames) {
+			return;
+		}
+
+		headroomFrames = 0;
+		fp_budget_view* budgetView = fp_budget_find_restore();
+		if(!budgetView) {
+			/* everything restored and stable */
+			budgetStats.restoreFrames = FP_BUDGET_RESTORE_FRAMES;
+			return;
+		}
+
+		fp_budget_set_degrade(budgetView, fp_budget_step(budgetView, -1), "restored");
+		fp_trace_instant("budget restore");
+		budgetStats.restores++;
+		framesSinceDecision = 0;
+		framesSinceRestore = 0;
+	}
+	else {
+		headroomFrames = 0;
+	}
+}
+
+fp_budget_stats fp_budget_get_stats() {
+	return budgetStats;
+}
+
+static int fp_budget_command(int argc, char** argv) {
+	if(argc >= 2) {
+		char* end;
+		unsigned long budgetUs = strcmp(argv[1], "off") == 0 ? 0 : strtoul(argv[1], &end, 10);
+		if(budgetUs == 0 && strcmp(argv[1], "off") != 0) {
+			printf("usage: budget [<us>|off]\n");
+			return 1;
+		}
+
+		fp_budget_set(budgetUs);
+		return 0;
+	}
+
+	fp_budget_stats stats = fp_budget_get_stats();
+	if(stats.budgetUs == 0) {
+		printf("budget: off\n");
+	}
+	else {
+		printf("budget: %u us\n", stats.budgetUs);
+	}
+	printf("frame: %u us average, %u us last\n", stats.averageUs, stats.lastUs);
+	printf("frames: %u, %u over budget\n", stats.frames, stats.overruns);
+	printf("decisions: %u degrades, %u restores. restore after %u frames of headroom\n", stats.degrades, stats.restores, stats.restoreFrames);
+	printf("views: %u, %u degraded\n", stats.viewCount, stats.degradedCount);
+	/* read while the render task may be updating it. good enough for a report */
+	for(unsigned int i = 0; i < budgetViewCount; i++) {
+		fp_budget_view budgetView = budgetViews[i];
+		fp_view* view = fp_view_get(budgetView.view);
+		if(!view) {
+			continue;
+		}
+		printf("  view %u: priority %u, %s (max %s)%s\n",
+			budgetView.view,
+			budgetView.priority,
+			fp_budget_degrade_names[view->degrade],
+			fp_budget_degrade_names[budgetView.maxDegrade],
+			budgetView.onScreen ? "" : ", off screen"
+		);
+	}
+
+	return 0;
+}
+
+bool fp_budget_console_init() {
+	return fp_console_register("budget", "frame time budget and degraded views: [<us>|off]", &fp_budget_command);
+}
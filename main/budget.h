@@ -0,0 +1,77 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "view.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_budget
+ * frame time budget for the render task. views registered with a priority and the deepest fp_view_degrade they allow
+ * are degraded one level at a time, lowest priority first, while the average frame cost is over budget.
+ * when the average stays well under budget they are restored, highest priority first.
+ * every decision is printed, traced as an instant event, and counted. the "budget" console command shows the state.
+ *
+ * the decisions are made on the render task by fp_budget_update, which is also the only place view->degrade changes.
+ * registrations are queued through a ring, so views can be registered from any task (e.g. a scene build task).
+ * freed views are dropped from the budget automatically.
+ * only views under the render root (following view->parent) are considered, so views of scenes built ahead of time
+ * aren't degraded for the cost of the scene on screen. a view that leaves the screen is restored at once.
+ * levels that don't apply to a view are skipped: only procedural views have a low res mode.
+ * the measured cost excludes time spent waiting on output (see fp_render_add_output_wait).
+ */
+
+#define FP_BUDGET_VIEW_COUNT 32
+/* weight of the newest frame in the average cost is 1/FP_BUDGET_AVERAGE_WEIGHT */
+#define FP_BUDGET_AVERAGE_WEIGHT 8
+/* frames to wait after a decision before the next one, so the average can reflect it */
+#define FP_BUDGET_COOLDOWN_FRAMES 16
+/* views are restored when the average is under this share of the budget... */
+#define FP_BUDGET_RESTORE_PERCENT 60
+/* ...for this many frames in a row. doubled, up to 8 times, when a restore is followed by a degrade within the same period */
+#define FP_BUDGET_RESTORE_FRAMES 60
+
+typedef struct {
+	fp_viewid view;
+	unsigned int serial;
+	/* higher is more important */
+	unsigned int priority;
+	fp_view_degrade maxDegrade;
+	/* internal. reachable from the render root at the last update */
+	bool onScreen;
+} fp_budget_view;
+
+typedef struct {
+	/* 0 while the budget is disabled */
+	uint32_t budgetUs;
+	uint32_t averageUs;
+	uint32_t lastUs;
+	unsigned int frames;
+	/* frames that took longer than the budget */
+	unsigned int overruns;
+	unsigned int degrades;
+	unsigned int restores;
+	/* frames of headroom currently required before a restore */
+	unsigned int restoreFrames;
+	unsigned int viewCount;
+	/* views currently degraded by at least one level */
+	unsigned int degradedCount;
+} fp_budget_stats;
+
+/** @param budgetUs - render time allowed per frame. 0 to start disabled */
+bool fp_budget_init(uint32_t budgetUs);
+/** changes the budget from any task. 0 disables the budget and restores every view */
+void fp_budget_set(uint32_t budgetUs);
+/** lets the budget manager degrade the view, at most to maxDegrade */
+bool fp_budget_register(fp_viewid view, unsigned int priority, fp_view_degrade maxDegrade);
+/** render task only. records the cost of a rendered frame and degrades or restores a view under root if needed */
+void fp_budget_update(fp_viewid root, uint32_t frameUs);
+fp_budget_stats fp_budget_get_stats();
+
+/** registers the "budget" console command */
+bool fp_budget_console_init();
+
+#endif /* BUDGET_H */
@@ -0,0 +1,292 @@
+#include "capture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "mem.h"
+#include "console.h"
+
+typedef struct {
+	unsigned int width;
+	unsigned int height;
+	/* held while a frame is written, and while the file is opened or closed */
+	SemaphoreHandle_t lock;
+	FILE* file;
+	/* checked by the output stage, so an idle capture costs one load per frame */
+	atomic_bool recording;
+	int64_t lastTimestamp;
+	uint32_t lastHash;
+	bool hasLastFrame;
+	/* one frame of packed rgb, so each record is a single fwrite */
+	uint8_t* record;
+
+	/* frames copied by the output stage, waiting for the capture task. slot indices move between the two queues */
+	uint32_t* slotLeds;
+	int64_t slotTimestamps[FP_CAPTURE_QUEUE_LENGTH];
+	QueueHandle_t freeSlots;
+	QueueHandle_t pendingSlots;
+	TaskHandle_t task;
+
+	fp_capture_stats stats;
+} fp_capture;
+
+/* only one capture can be driven from the console */
+fp_output* consoleCapture = NULL;
+
+static void fp_capture_put_u16(uint8_t* out, uint16_t value) {
+	out[0] = value & 0xff;
+	out[1] = value >> 8;
+}
+
+static void fp_capture_put_u32(uint8_t* out, uint32_t value) {
+	for(unsigned int i = 0; i < 4; i++) {
+		out[i] = (value >> (i * 8)) & 0xff;
+	}
+}
+
+/** appends a record for the frame to the file. called by the capture task with the lock held */
+static bool fp_capture_write_record(fp_capture* capture, FILE* file, const uint32_t* leds, int64_t timestamp) {
+	unsigned int count = capture->width * capture->height;
+	uint8_t* pixels = capture->record + 5;
+	/* FNV-1a over the recorded pixels */
+	uint32_t hash = 2166136261u;
+	for(unsigned int i = 0; i < count; i++) {
+		/* rgb_color layout: blue in byte 0, red in byte 1, green in byte 2 */
+		uint32_t bits = leds[i];
+		pixels[i*3] = (bits >> 8) & 0xff;
+		pixels[i*3 + 1] = (bits >> 16) & 0xff;
+		pixels[i*3 + 2] = bits & 0xff;
+		hash = (hash ^ (bits & 0xffffff)) * 16777619u;
+	}
+
+	bool repeat = capture->hasLastFrame && hash == capture->lastHash;
+	uint32_t delta = capture->hasLastFrame ? (uint32_t)(timestamp - capture->lastTimestamp) : 0;
+	fp_capture_put_u32(capture->record, delta);
+	capture->record[4] = repeat ? FP_CAPTURE_REPEAT : FP_CAPTURE_FRAME;
+
+	size_t size = repeat ? 5 : 5 + count * 3;
+	if(fwrite(capture->record, 1, size, file) != size) {
+		capture->stats.errors++;
+		return false;
+	}
+
+	capture->lastTimestamp = timestamp;
+	capture->lastHash = hash;
+	capture->hasLastFrame = true;
+	capture->stats.bytes += size;
+	if(repeat) {
+		capture->stats.repeats++;
+	}
+	else {
+		capture->stats.frames++;
+	}
+	return true;
+}
+
+static void fp_capture_task(void* pvParameters) {
+	fp_capture* capture = pvParameters;
+	unsigned int count = capture->width * capture->height;
+
+	while(true) {
+		uint8_t slot;
+		xQueueReceive(capture->pendingSlots, &slot, portMAX_DELAY);
+
+		xSemaphoreTake(capture->lock, portMAX_DELAY);
+		if(capture->file) {
+			fp_capture_write_record(capture, capture->file, capture->slotLeds + slot * count, capture->slotTimestamps[slot]);
+		}
+		xSemaphoreGive(capture->lock);
+
+		xQueueSend(capture->freeSlots, &slot, 0);
+	}
+}
+
+/** output stage: copy the frame into a free slot for the capture task. never blocks */
+static bool fp_capture_write(fp_output* output, const uint32_t* leds, unsigned int length, int64_t timestamp) {
+	fp_capture* capture = output->context;
+	if(!atomic_load_explicit(&capture->recording, memory_order_relaxed)) {
+		return true;
+	}
+
+	uint8_t slot;
+	if(xQueueReceive(capture->freeSlots, &slot, 0) != pdTRUE) {
+		capture->stats.dropped++;
+		return true;
+	}
+
+	unsigned int count = capture->width * capture->height;
+	uint32_t* slotLeds = capture->slotLeds + slot * count;
+	unsigned int copied = length < count ? length : count;
+	memcpy(slotLeds, leds, copied * sizeof(uint32_t));
+	memset(slotLeds + copied, 0, (count - copied) * sizeof(uint32_t));
+	capture->slotTimestamps[slot] = timestamp;
+
+	/* there are only FP_CAPTURE_QUEUE_LENGTH slots, so this never waits */
+	xQueueSend(capture->pendingSlots, &slot, 0);
+	return true;
+}
+
+static void fp_capture_delete(fp_output* output) {
+	fp_capture* capture = output->context;
+	if(capture->lock) {
+		vSemaphoreDelete(capture->lock);
+	}
+	if(capture->freeSlots) {
+		vQueueDelete(capture->freeSlots);
+	}
+	if(capture->pendingSlots) {
+		vQueueDelete(capture->pendingSlots);
+	}
+	fp_mem_free(capture->slotLeds);
+	fp_mem_free(capture->record);
+	fp_mem_free(output);
+}
+
+fp_output* fp_capture_create(unsigned int width, unsigned int height) {
+	if(width == 0 || height == 0 || width > 0xffff || height > 0xffff) {
+		printf("error: fp_capture_create: invalid size %ux%u\n", width, height);
+		return NULL;
+	}
+
+	fp_output* output = fp_mem_calloc(FP_MEM_DEBUG, 1, sizeof(fp_output) + sizeof(fp_capture));
+	if(!output) {
+		printf("error: fp_capture_create: failed to allocate capture\n");
+		return NULL;
+	}
+
+	fp_capture* capture = (fp_capture*)(output + 1);
+	output->context = capture;
+	capture->width = width;
+	capture->height = height;
+	atomic_init(&capture->recording, false);
+
+	capture->record = fp_mem_alloc(FP_MEM_DEBUG, 5 + width * height * 3);
+	capture->slotLeds = fp_mem_alloc(FP_MEM_DEBUG, FP_CAPTURE_QUEUE_LENGTH * width * height * sizeof(uint32_t));
+	if(!capture->record || !capture->slotLeds) {
+		printf("error: fp_capture_create: failed to allocate record buffers\n");
+		fp_capture_delete(output);
+		return NULL;
+	}
+
+	capture->lock = xSemaphoreCreateMutex();
+	capture->freeSlots = xQueueCreate(FP_CAPTURE_QUEUE_LENGTH, sizeof(uint8_t));
+	capture->pendingSlots = xQueueCreate(FP_CAPTURE_QUEUE_LENGTH, sizeof(uint8_t));
+	if(!capture->lock || !capture->freeSlots || !capture->pendingSlots) {
+		printf("error: fp_capture_create: failed to create lock and queues\n");
+		fp_capture_delete(output);
+		return NULL;
+	}
+
+	for(uint8_t i = 0; i < FP_CAPTURE_QUEUE_LENGTH; i++) {
+		xQueueSend(capture->freeSlots, &i, 0);
+	}
+
+	if(xTaskCreate(fp_capture_task, "fp_capture", FP_CAPTURE_TASK_STACK_SIZE, capture, FP_CAPTURE_TASK_PRIORITY, &capture->task) != pdPASS) {
+		printf("error: fp_capture_create: failed to create capture task\n");
+		fp_capture_delete(output);
+		return NULL;
+	}
+	fp_mem_register_task(capture->task, FP_CAPTURE_TASK_STACK_SIZE);
+
+	output->name = "capture";
+	output->write = &fp_capture_write;
+	output->next = NULL;
+	return output;
+}
+
+bool fp_capture_start(fp_output* output, const char* path) {
+	fp_capture* capture = output->context;
+
+	xSemaphoreTake(capture->lock, portMAX_DELAY);
+	if(capture->file) {
+		xSemaphoreGive(capture->lock);
+		printf("error: fp_capture_start: already capturing\n");
+		return false;
+	}
+
+	FILE* file = fopen(path, "wb");
+	if(!file) {
+		xSemaphoreGive(capture->lock);
+		printf("error: fp_capture_start: failed to open %s\n", path);
+		return false;
+	}
+
+	uint8_t header[FP_CAPTURE_HEADER_SIZE] = { 0 };
+	memcpy(header, FP_CAPTURE_MAGIC, 4);
+	header[4] = FP_CAPTURE_VERSION;
+	fp_capture_put_u16(header + 6, capture->width);
+	fp_capture_put_u16(header + 8, capture->height);
+	if(fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+		fclose(file);
+		xSemaphoreGive(capture->lock);
+		printf("error: fp_capture_start: failed to write header to %s\n", path);
+		return false;
+	}
+
+	capture->hasLastFrame = false;
+	memset(&capture->stats, 0, sizeof(capture->stats));
+	capture->stats.bytes = sizeof(header);
+	capture->file = file;
+	atomic_store(&capture->recording, true);
+	xSemaphoreGive(capture->lock);
+	return true;
+}
+
+bool fp_capture_stop(fp_output* output) {
+	fp_capture* capture = output->context;
+	if(!atomic_exchange(&capture->recording, false)) {
+		return false;
+	}
+
+	/* let the capture task write what was queued before the output stage saw the flag */
+	while(uxQueueMessagesWaiting(capture->freeSlots) < FP_CAPTURE_QUEUE_LENGTH) {
+		vTaskDelay(1);
+	}
+
+	xSemaphoreTake(capture->lock, portMAX_DELAY);
+	FILE* file = capture->file;
+	capture->file = NULL;
+	xSemaphoreGive(capture->lock);
+
+	if(!file) {
+		return false;
+	}
+
+	return fclose(file) == 0;
+}
+
+fp_capture_stats fp_capture_get_stats(fp_output* output) {
+	fp_capture* capture = output->context;
+	return capture->stats;
+}
+
+static int fp_capture_command(int argc, char** argv) {
+	if(argc >= 3 && strcmp(argv[1], "start") == 0) {
+		return fp_capture_start(consoleCapture, argv[2]) ? 0 : 1;
+	}
+
+	if(argc >= 2 && strcmp(argv[1], "stop") == 0) {
+		bool result = fp_capture_stop(consoleCapture);
+		fp_capture_stats stats = fp_capture_get_stats(consoleCapture);
+		printf("capture: %u frames, %u repeats, %u bytes, %u errors, %u dropped\n", stats.frames, stats.repeats, stats.bytes, stats.errors, stats.dropped);
+		return result ? 0 : 1;
+	}
+
+	printf("usage: capture start <path>|stop\n");
+	return 1;
+}
+
+bool fp_capture_console_init(fp_output* capture) {
+	if(!capture) {
+		return false;
+	}
+
+	consoleCapture = capture;
+	return fp_console_register("capture", "record transmitted frames: start <path>|stop", &fp_capture_command);
+}
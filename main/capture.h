@@ -0,0 +1,61 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "output.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_capture
+ * output that records every frame it receives into a capture file, for replay and regression diffs on a host
+ * (see tools/capture_tool.py). chain it after the LEDs to record what was transmitted.
+ * it is idle until started, and can be started and stopped while frames are being written.
+ * the output stage only copies each frame into a queue. a capture task packs and writes it to the file,
+ * so the output task never waits on the filesystem. if the file falls behind, frames are dropped and counted.
+ * on a host the path can be on a tmpfs (e.g. /dev/shm) to share frames with a live viewer.
+ *
+ * format, little endian:
+ *   header: "FPCP", u8 version, u8 reserved, u16 width, u16 height, u16 reserved
+ *   records: { u32 microseconds since the previous record (0 for the first), u8 type, ... }
+ *     FRAME: width*height * { u8 r, u8 g, u8 b }, in LED order
+ *     REPEAT: nothing. the frame is identical to the previous one
+ */
+
+#define FP_CAPTURE_MAGIC "FPCP"
+#define FP_CAPTURE_VERSION 1
+#define FP_CAPTURE_HEADER_SIZE 12
+
+/* frames queued between the output stage and the capture task */
+#define FP_CAPTURE_QUEUE_LENGTH 4
+#define FP_CAPTURE_TASK_PRIORITY 2
+#define FP_CAPTURE_TASK_STACK_SIZE 4096
+
+typedef enum {
+	FP_CAPTURE_FRAME = 1,
+	FP_CAPTURE_REPEAT = 2,
+} fp_capture_record_type;
+
+typedef struct {
+	unsigned int frames;
+	unsigned int repeats;
+	unsigned int bytes;
+	/* frames dropped because of a write error */
+	unsigned int errors;
+	/* frames dropped because the queue was full */
+	unsigned int dropped;
+} fp_capture_stats;
+
+fp_output* fp_capture_create(unsigned int width, unsigned int height);
+/** start recording to a new file at path */
+bool fp_capture_start(fp_output* capture, const char* path);
+/** finish the file. blocks until the queued frames are written */
+bool fp_capture_stop(fp_output* capture);
+fp_capture_stats fp_capture_get_stats(fp_output* capture);
+
+/** registers the "capture" console command for this capture */
+bool fp_capture_console_init(fp_output* capture);
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,107 @@
+#include "console.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "mem.h"
+
+fp_console_command consoleCommands[FP_CONSOLE_COMMAND_COUNT];
+unsigned int consoleCommandCount = 0;
+
+static int fp_console_help(int argc, char** argv) {
+	for(unsigned int i = 0; i < consoleCommandCount; i++) {
+		printf("  %-10s %s\n", consoleCommands[i].name, consoleCommands[i].help);
+	}
+	return 0;
+}
+
+bool fp_console_init() {
+	fp_console_register("help", "list commands", &fp_console_help);
+
+	TaskHandle_t task = NULL;
+	if(xTaskCreate(fp_console_task, "fp_console", FP_CONSOLE_TASK_STACK_SIZE, NULL, FP_CONSOLE_TASK_PRIORITY, &task) != pdPASS) {
+		printf("error: fp_console_init: failed to create console task\n");
+		return false;
+	}
+	fp_mem_register_task(task, FP_CONSOLE_TASK_STACK_SIZE);
+
+	return true;
+}
+
+bool fp_console_register(const char* name, const char* help, fp_console_fn fn) {
+	if(consoleCommandCount >= FP_CONSOLE_COMMAND_COUNT) {
+		printf("error: fp_console_register: too many commands, can't add %s\n", name);
+		return false;
+	}
+
+	consoleCommands[consoleCommandCount] = (fp_console_command){ name, help, fn };
+	consoleCommandCount++;
+	return true;
+}
+
+int fp_console_run(char* line) {
+	char* argv[FP_CONSOLE_MAX_ARGS];
+	int argc = 0;
+	char* save = NULL;
+	for(char* arg = strtok_r(line, " \t\r\n", &save); arg && argc < FP_CONSOLE_MAX_ARGS; arg = strtok_r(NULL, " \t\r\n", &save)) {
+		argv[argc++] = arg;
+	}
+
+	if(argc == 0) {
+		return 0;
+	}
+
+	for(unsigned int i = 0; i < consoleCommandCount; i++) {
+		if(strcmp(consoleCommands[i].name, argv[0]) == 0) {
+			return consoleCommands[i].fn(argc, argv);
+		}
+	}
+
+	printf("unknown command: %s. try help\n", argv[0]);
+	return 1;
+}
+
+void fp_console_task(void* pvParameters) {
+	char line[FP_CONSOLE_LINE_LENGTH];
+	unsigned int length = 0;
+
+	while(true) {
+		/* the default UART stdin doesn't block, it returns EOF when there is no input */
+		int c = getchar();
+		if(c == EOF) {
+			clearerr(stdin);
+			vTaskDelay(pdMS_TO_TICKS(20));
+			continue;
+		}
+
+		if(c == '\b' || c == 127) {
+			if(length > 0) {
+				length--;
+				printf("\b \b");
+				fflush(stdout);
+			}
+			continue;
+		}
+
+		if(c == '\r' || c == '\n') {
+			if(length == 0) {
+				/* empty line, or the second half of \r\n */
+				continue;
+			}
+			printf("\n");
+			line[length] = '\0';
+			length = 0;
+			fp_console_run(line);
+			continue;
+		}
+
+		if(length < FP_CONSOLE_LINE_LENGTH - 1) {
+			line[length++] = c;
+			putchar(c);
+			fflush(stdout);
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdbool.h>
+
+/* fp: fresh pixel */
+
+/**
+ * fp_console
+ * line based command console on stdin/stdout (the UART monitor).
+ * a low priority task reads a line, splits it on whitespace, and runs the command named by the first word.
+ * "help" lists the registered commands.
+ */
+
+#define FP_CONSOLE_TASK_PRIORITY 2
+#define FP_CONSOLE_TASK_STACK_SIZE 4096
+#define FP_CONSOLE_COMMAND_COUNT 16
+#define FP_CONSOLE_LINE_LENGTH 128
+#define FP_CONSOLE_MAX_ARGS 8
+
+/** returns 0 on success */
+typedef int (*fp_console_fn) (int argc, char** argv);
+
+typedef struct {
+	const char* name;
+	/* one line, shown by "help" */
+	const char* help;
+	fp_console_fn fn;
+} fp_console_command;
+
+/** starts the console task. commands may be registered before or after */
+bool fp_console_init();
+/** name and help must outlive the console */
+bool fp_console_register(const char* name, const char* help, fp_console_fn fn);
+/** run one command line. line is modified */
+int fp_console_run(char* line);
+
+void fp_console_task(void* pvParameters);
+
+#endif /* CONSOLE_H */
@@ -0,0 +1,379 @@
+#include "display-list.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#include "render.h"
+#include "mem.h"
+#include "console.h"
+
+/* ring the console benchmark submits to */
+fp_ring* displayListCommands = NULL;
+
+static void fp_display_list_release_targets(fp_display_list* list) {
+	for(fp_display_op* op = list->first; op != NULL; op = op->next) {
+		fp_frame_release(op->id);
+	}
+}
+
+fp_display_list* fp_display_list_create(size_t arenaSize) {
+	fp_display_list* list = fp_mem_alloc(FP_MEM_RENDER, sizeof(fp_display_list));
+	if(!list) {
+		printf("error: fp_display_list_create: failed to allocate memory for list\n");
+		return NULL;
+	}
+
+	list->arena = fp_arena_init(arenaSize);
+	if(!list->arena) {
+		fp_mem_free(list);
+		return NULL;
+	}
+
+	list->first = NULL;
+	list->last = NULL;
+	list->count = 0;
+
+	return list;
+}
+
+bool fp_display_list_free(fp_display_list* list) {
+	fp_display_list_release_targets(list);
+	fp_arena_free(list->arena);
+	fp_mem_free(list);
+	return true;
+}
+
+void fp_display_list_reset(fp_display_list* list) {
+	fp_display_list_release_targets(list);
+	fp_arena_reset(list->arena);
+	list->first = NULL;
+	list->last = NULL;
+	list->count = 0;
+}
+
+static fp_display_op* fp_dl_add(fp_display_list* list, fp_display_op_type type, fp_frameid id) {
+	fp_display_op* op = fp_arena_alloc(list->arena, sizeof(fp_display_op));
+	if(!op) {
+		return NULL;
+	}
+
+	op->type = type;
+	op->id = id;
+	op->next = NULL;
+	return op;
+}
+
+/* link the op after its data has been copied, so a failed copy doesn't leave a partial op in the list.
+ * the op keeps the target alive until the list is reset or freed */
+static void fp_dl_append(fp_display_list* list, fp_display_op* op) {
+	fp_frame_retain(op->id);
+	if(list->last) {
+		list->last->next = op;
+	}
+	else {
+		list->first = op;
+	}
+	list->last = op;
+	list->count++;
+}
+
+/* copies the frame's pixels into the arena */
+static bool fp_dl_copy_frame(fp_display_list* list, fp_frame* target, const fp_frame* frame) {
+	rgb_color* pixels = fp_arena_alloc(list->arena, frame->length * sizeof(rgb_color));
+	if(!pixels) {
+		return false;
+	}
+
+	memcpy(pixels, frame->pixels, frame->length * sizeof(rgb_color));
+	target->length = frame->length;
+	target->width = frame->width;
+	target->pixels = pixels;
+	return true;
+}
+
+bool fp_dl_fill_rect(fp_display_list* list, fp_frameid id, unsigned int x, unsigned int y, unsigned int width, unsigned int height, rgb_color color) {
+	fp_display_op* op = fp_dl_add(list, FP_DL_FILL_RECT, id);
+	if(!op) {
+		return false;
+	}
+
+	op->args.FILL_RECT.x = x;
+	op->args.FILL_RECT.y = y;
+	op->args.FILL_RECT.width = width;
+	op->args.FILL_RECT.height = height;
+	op->args.FILL_RECT.color = color;
+	fp_dl_append(list, op);
+	return true;
+}
+
+bool fp_dl_set_rect(fp_display_list* list, fp_frameid id, unsigned int x, unsigned int y, const fp_frame* frame) {
+	fp_display_op* op = fp_dl_add(list, FP_DL_SET_RECT, id);
+	if(!op || !fp_dl_copy_frame(list, &op->args.SET_RECT.frame, frame)) {
+		return false;
+	}
+
+	op->args.SET_RECT.x = x;
+	op->args.SET_RECT.y = y;
+	fp_dl_append(list, op);
+	return true;
+}
+
+bool fp_dl_blend_rect(fp_display_list* list, blend_fn blendFn, fp_frameid id, uint8_t alphaTarget, unsigned int x, unsigned int y, const fp_frame* frame, uint8_t alphaSrc) {
+	fp_display_op* op = fp_dl_add(list, FP_DL_BLEND_RECT, id);
+	if(!op || !fp_dl_copy_frame(list, &op->args.BLEND_RECT.frame, frame)) {
+		return false;
+	}
+
+	op->args.BLEND_RECT.blendFn = blendFn;
+	op->args.BLEND_RECT.alphaTarget = alphaTarget;
+	op->args.BLEND_RECT.alphaSrc = alphaSrc;
+	op->args.BLEND_RECT.x = x;
+	op->args.BLEND_RECT.y = y;
+	fp_dl_append(list, op);
+	return true;
+}
+
+bool fp_dl_line(fp_display_list* list, fp_frameid id, int x0, int y0, int x1, int y1, rgb_color color) {
+	fp_display_op* op = fp_dl_add(list, FP_DL_LINE, id);
+	if(!op) {
+		return false;
+	}
+
+	op->args.LINE.x0 = x0;
+	op->args.LINE.y0 = y0;
+	op->args.LINE.x1 = x1;
+	op->args.LINE.y1 = y1;
+	op->args.LINE.color = color;
+	fp_dl_append(list, op);
+	return true;
+}
+
+bool fp_dl_text(fp_display_list* list, fp_frameid id, int x, int y, const char* text, rgb_color color) {
+	fp_display_op* op = fp_dl_add(list, FP_DL_TEXT, id);
+	if(!op) {
+		return false;
+	}
+
+	size_t length = strlen(text) + 1;
+	char* textCopy = fp_arena_alloc(list->arena, length);
+	if(!textCopy) {
+		return false;
+	}
+	memcpy(textCopy, text, length);
+
+	op->args.TEXT.x = x;
+	op->args.TEXT.y = y;
+	op->args.TEXT.color = color;
+	op->args.TEXT.text = textCopy;
+	fp_dl_append(list, op);
+	return true;
+}
+
+void fp_display_list_execute(fp_display_list* list) {
+	for(fp_display_op* op = list->first; op != NULL; op = op->next) {
+		switch(op->type) {
+			case FP_DL_FILL_RECT:
+				fp_ffill_rect(
+					op->id,
+					op->args.FILL_RECT.x,
+					op->args.FILL_RECT.y,
+					op->args.FILL_RECT.width,
+					op->args.FILL_RECT.height,
+					op->args.FILL_RECT.color
+				);
+				break;
+			case FP_DL_SET_RECT:
+				fp_fset_rect(
+					op->id,
+					op->args.SET_RECT.x,
+					op->args.SET_RECT.y,
+					&op->args.SET_RECT.frame
+				);
+				break;
+			case FP_DL_BLEND_RECT:
+				fp_fblend_rect(
+					op->args.BLEND_RECT.blendFn,
+					op->id,
+					op->args.BLEND_RECT.alphaTarget,
+					op->args.BLEND_RECT.x,
+					op->args.BLEND_RECT.y,
+					&op->args.BLEND_RECT.frame,
+					op->args.BLEND_RECT.alphaSrc
+				);
+				break;
+			case FP_DL_LINE:
+				fp_fdraw_line(
+					op->id,
+					op->args.LINE.x0,
+					op->args.LINE.y0,
+					op->args.LINE.x1,
+					op->args.LINE.y1,
+					op->args.LINE.color
+				);
+				break;
+			case FP_DL_TEXT:
+				fp_fdraw_text(
+					op->id,
+					op->args.TEXT.x,
+					op->args.TEXT.y,
+					op->args.TEXT.text,
+					op->args.TEXT.color
+				);
+				break;
+		}
+	}
+}
+
+bool fp_display_list_submit(fp_ring* commands, fp_display_list* list) {
+	fp_queue_command command = {
+		DISPLAY_LIST,
+		{ .DISPLAY_LIST = { list } }
+	};
+
+	return fp_queue_command_send(commands, &command);
+}
+
+typedef struct {
+	int64_t executeStart;
+	int64_t executeEnd;
+	SemaphoreHandle_t done;
+} fp_display_list_bench_state;
+
+/* static: a late command after a timed out run must not write to a dead stack frame */
+fp_display_list_bench_state displayListBench = { 0 };
+
+/* runs on the render task, before (value 0) and after (value 1) the list */
+static void fp_display_list_bench_mark(void* arg, int32_t value) {
+	fp_display_list_bench_state* bench = arg;
+	if(value == 0) {
+		bench->executeStart = esp_timer_get_time();
+	}
+	else {
+		bench->executeEnd = esp_timer_get_time();
+		xSemaphoreGive(bench->done);
+	}
+}
+
+/* fills, lines and text in turn, spread over a 32x32 frame */
+static bool fp_display_list_bench_record(fp_display_list* list, fp_frameid target, unsigned int ops) {
+	for(unsigned int i = 0; i < ops; i++) {
+		unsigned int x = (i * 7) % 32;
+		unsigned int y = (i * 13) % 32;
+		rgb_color color = rgb(i & 0xff, (i >> 2) & 0xff, (i >> 4) & 0xff);
+		bool recorded;
+		switch(i % 3) {
+			case 0:
+				recorded = fp_dl_fill_rect(list, target, x, y, 4, 4, color);
+				break;
+			case 1:
+				recorded = fp_dl_line(list, target, x, y, 31 - x, 31 - y, color);
+				break;
+			default:
+				recorded = fp_dl_text(list, target, x, y, "fp", color);
+				break;
+		}
+		if(!recorded) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int fp_display_list_bench(unsigned int ops, unsigned int lists) {
+	if(!displayListBench.done) {
+		displayListBench.done = xSemaphoreCreateBinary();
+		if(!displayListBench.done) {
+			printf("error: fp_display_list_bench: failed to create semaphore\n");
+			return 1;
+		}
+	}
+
+	fp_frameid target = fp_frame_create(32, 32, rgb(0, 0, 0));
+	if(target == 0) {
+		return 1;
+	}
+
+	/* text ops copy 3 bytes, rounded up by the arena */
+	size_t arenaSize = ops * (sizeof(fp_display_op) + 8);
+	int64_t recordUs = 0;
+	int64_t executeUs = 0;
+	unsigned int executed = 0;
+	for(unsigned int i = 0; i < lists; i++) {
+		fp_display_list* list = fp_display_list_create(arenaSize);
+		if(!list) {
+			break;
+		}
+
+		int64_t recordStart = esp_timer_get_time();
+		bool recorded = fp_display_list_bench_record(list, target, ops);
+		recordUs += esp_timer_get_time() - recordStart;
+		if(!recorded) {
+			printf("error: fp_display_list_bench: arena full after %u ops\n", list->count);
+			fp_display_list_free(list);
+			break;
+		}
+
+		/* commands run in order within one pass, so the marks bracket the list */
+		fp_queue_command before = { CALL, { .CALL = { &fp_display_list_bench_mark, &displayListBench, 0 } } };
+		fp_queue_command after = { CALL, { .CALL = { &fp_display_list_bench_mark, &displayListBench, 1 } } };
+		if(!fp_queue_command_send(displayListCommands, &before)) {
+			fp_display_list_free(list);
+			break;
+		}
+		if(!fp_display_list_submit(displayListCommands, list)) {
+			printf("error: fp_display_list_bench: command ring full\n");
+			fp_display_list_free(list);
+			break;
+		}
+		if(!fp_queue_command_send(displayListCommands, &after)) {
+			printf("error: fp_display_list_bench: command ring full\n");
+			break;
+		}
+
+		if(xSemaphoreTake(displayListBench.done, pdMS_TO_TICKS(1000)) != pdTRUE) {
+			printf("error: fp_display_list_bench: timed out waiting for the render task\n");
+			break;
+		}
+		executeUs += displayListBench.executeEnd - displayListBench.executeStart;
+		executed++;
+	}
+
+	if(executed > 0) {
+		printf("%u lists of %u ops: record %u ns/op, execute %u ns/op, %u us/list on the render task\n",
+			executed,
+			ops,
+			(unsigned int)(recordUs * 1000 / ((int64_t)executed * ops)),
+			(unsigned int)(executeUs * 1000 / ((int64_t)executed * ops)),
+			(unsigned int)(executeUs / executed)
+		);
+	}
+
+	/* the lists hold their own references, released by the render task */
+	fp_frame_release(target);
+	return executed > 0 ? 0 : 1;
+}
+
+static int fp_display_list_command(int argc, char** argv) {
+	if(argc < 2 || strcmp(argv[1], "bench") != 0) {
+		printf("usage: displaylist bench [<ops> [<lists>]]\n");
+		return 1;
+	}
+
+	unsigned int ops = argc >= 3 ? strtoul(argv[2], NULL, 0) : 2000;
+	unsigned int lists = argc >= 4 ? strtoul(argv[3], NULL, 0) : 10;
+	if(ops == 0 || lists == 0) {
+		printf("usage: displaylist bench [<ops> [<lists>]]\n");
+		return 1;
+	}
+
+	return fp_display_list_bench(ops, lists);
+}
+
+bool fp_display_list_console_init(fp_ring* commands) {
+	displayListCommands = commands;
+	return fp_console_register("displaylist", "display list cost: bench [<ops> [<lists>]]", &fp_display_list_command);
+}
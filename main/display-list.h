@@ -0,0 +1,107 @@
+#ifndef DISPLAY_LIST_H
+#define DISPLAY_LIST_H
+
+#include <stdbool.h>
+
+#include "color.h"
+#include "frame.h"
+#include "arena.h"
+#include "ring.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_display_list
+ * records a batch of draw operations into an arena, to be executed by the render task in a single pass.
+ * everything an operation needs (including source pixels and text) is copied into the arena when it is recorded,
+ * so the caller's buffers can be reused immediately.
+ * each recorded operation holds a reference to its target frame, released when the list is reset or freed,
+ * so the target stays valid until the render task has executed the list.
+ * submit the list with fp_display_list_submit. the render task takes ownership and frees it after executing it.
+ *
+ * the "displaylist bench" console command records and submits lists of mixed operations, and reports
+ * the cost per operation of recording them and of executing them on the render task.
+ */
+
+typedef enum {
+	FP_DL_FILL_RECT,
+	FP_DL_SET_RECT,
+	FP_DL_BLEND_RECT,
+	FP_DL_LINE,
+	FP_DL_TEXT,
+} fp_display_op_type;
+
+typedef struct fp_display_op {
+	fp_display_op_type type;
+	fp_frameid id;
+	struct fp_display_op* next;
+	union {
+		struct {
+			unsigned int x;
+			unsigned int y;
+			unsigned int width;
+			unsigned int height;
+			rgb_color color;
+		} FILL_RECT;
+		struct {
+			unsigned int x;
+			unsigned int y;
+			/* pixels point into the arena */
+			fp_frame frame;
+		} SET_RECT;
+		struct {
+			blend_fn blendFn;
+			uint8_t alphaTarget;
+			uint8_t alphaSrc;
+			unsigned int x;
+			unsigned int y;
+			fp_frame frame;
+		} BLEND_RECT;
+		struct {
+			int x0;
+			int y0;
+			int x1;
+			int y1;
+			rgb_color color;
+		} LINE;
+		struct {
+			int x;
+			int y;
+			rgb_color color;
+			/* null terminated, stored in the arena */
+			char* text;
+		} TEXT;
+	} args;
+} fp_display_op;
+
+typedef struct {
+	fp_arena* arena;
+	fp_display_op* first;
+	fp_display_op* last;
+	unsigned int count;
+} fp_display_list;
+
+/** @param arenaSize - bytes available for operations and their copied data */
+fp_display_list* fp_display_list_create(size_t arenaSize);
+/** releases the target frames and frees the list */
+bool fp_display_list_free(fp_display_list* list);
+/** drop all recorded operations and release their target frames, so the list can be reused */
+void fp_display_list_reset(fp_display_list* list);
+
+/* recording returns false if the arena is full. the operation is not recorded in that case */
+bool fp_dl_fill_rect(fp_display_list* list, fp_frameid id, unsigned int x, unsigned int y, unsigned int width, unsigned int height, rgb_color color);
+bool fp_dl_set_rect(fp_display_list* list, fp_frameid id, unsigned int x, unsigned int y, const fp_frame* frame);
+bool fp_dl_blend_rect(fp_display_list* list, blend_fn blendFn, fp_frameid id, uint8_t alphaTarget, unsigned int x, unsigned int y, const fp_frame* frame, uint8_t alphaSrc);
+bool fp_dl_line(fp_display_list* list, fp_frameid id, int x0, int y0, int x1, int y1, rgb_color color);
+bool fp_dl_text(fp_display_list* list, fp_frameid id, int x, int y, const char* text, rgb_color color);
+
+/** runs every operation in the order it was recorded */
+void fp_display_list_execute(fp_display_list* list);
+
+/** hands the list to the render task as a single command. on success the render task owns the list and frees it after execution */
+bool fp_display_list_submit(fp_ring* commands, fp_display_list* list);
+
+/** registers the "displaylist" console command, which submits its lists to commands */
+bool fp_display_list_console_init(fp_ring* commands);
+
+#endif /* DISPLAY_LIST_H */
@@ -0,0 +1,458 @@
+#include "draw.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fixed.h"
+#include "profile.h"
+
+typedef struct {
+	/* 16.16 x where the edge crosses the center of the current row */
+	int32_t x;
+	/* 16.16 change in x per row */
+	int32_t step;
+	/* rows [yStart, yEnd) */
+	int yStart;
+	int yEnd;
+} fp_draw_edge;
+
+typedef struct {
+	/* Q15 directions of the first and last angle */
+	int startX;
+	int startY;
+	int endX;
+	int endY;
+} fp_draw_wedge;
+
+static fp_frame* fp_draw_get_frame(fp_frameid id) {
+	fp_frame* frame = fp_frame_get(id);
+	if(frame == NULL || frame->pixels == NULL) {
+		return NULL;
+	}
+	return frame;
+}
+
+/** sets pixels [x0, x1] of row y, clipped to the frame. the row must be in the frame */
+static void fp_draw_span(fp_frame* frame, int x0, int x1, int y, rgb_color color) {
+	if(x0 < 0) {
+		x0 = 0;
+	}
+	if(x1 >= (int)frame->width) {
+		x1 = frame->width - 1;
+	}
+
+	rgb_color* pixel = frame->pixels + y * frame->width + x0;
+	for(int x = x0; x <= x1; x++) {
+		*pixel++ = color;
+	}
+}
+
+static void fp_draw_point(fp_frame* frame, int x, int y, rgb_color color) {
+	if(fp_frame_has_point(frame, x, y)) {
+		frame->pixels[y * frame->width + x] = color;
+	}
+}
+
+static void fp_draw_blend_point(fp_frame* frame, int x, int y, rgb_color color, uint8_t coverage) {
+	if(!fp_frame_has_point(frame, x, y) || coverage == 0) {
+		return;
+	}
+
+	rgb_color* pixel = &frame->pixels[y * frame->width + x];
+	if(coverage == 255) {
+		*pixel = color;
+		return;
+	}
+	pixel->fields.r = FP_LERP8(pixel->fields.r, color.fields.r, coverage);
+	pixel->fields.g = FP_LERP8(pixel->fields.g, color.fields.g, coverage);
+	pixel->fields.b = FP_LERP8(pixel->fields.b, color.fields.b, coverage);
+}
+
+/** floor(a / b), b > 0 */
+static int fp_draw_floor_div(int a, int b) {
+	int quotient = a / b;
+	if(a % b != 0 && a < 0) {
+		quotient--;
+	}
+	return quotient;
+}
+
+/** narrows [*lo, *hi] to the x on row y where cross((dx, dy), (x, y)) > 0, i.e. clockwise of direction (dx, dy).
+ * points on the line are decided as if moved by a tiny (e, e*e), so of two wedges sharing the line, exactly one gets them */
+static void fp_draw_clip_half_plane(int dx, int dy, int y, int* lo, int* hi) {
+	int q = dx * y;
+	if(dy > 0) {
+		/* dy * x < q */
+		int limit = fp_draw_floor_div(q - 1, dy);
+		if(limit < *hi) {
+			*hi = limit;
+		}
+	}
+	else if(dy < 0) {
+		/* -dy * x >= -q */
+		int limit = -fp_draw_floor_div(q, -dy);
+		if(limit > *lo) {
+			*lo = limit;
+		}
+	}
+	else if(q < 0 || (q == 0 && dx < 0)) {
+		*hi = *lo - 1;
+	}
+}
+
+static void fp_draw_wedge_span(fp_frame* frame, int centerX, int y, int x0, int x1, int clipLo, int clipHi, rgb_color color) {
+	if(x0 < clipLo) {
+		x0 = clipLo;
+	}
+	if(x1 > clipHi) {
+		x1 = clipHi;
+	}
+	if(x0 <= x1 && centerX + x1 >= 0 && centerX + x0 < (int)frame->width) {
+		fp_draw_span(frame, centerX + x0, centerX + x1, y, color);
+	}
+}
+
+/** fills row y (relative to the center) of the ring inside the wedge. holeHalf < 0 for no hole on this row */
+static void fp_draw_arc_row(
+	fp_frame* frame,
+	int centerX,
+	int centerY,
+	int y,
+	int half,
+	int holeHalf,
+	const fp_draw_wedge* wedge,
+	rgb_color color
+) {
+	if(centerY + y < 0 || centerY + y >= (int)fp_frame_height(frame)) {
+		return;
+	}
+
+	int clipLo = INT_MIN / 2;
+	int clipHi = INT_MAX / 2;
+	if(wedge != NULL) {
+		fp_draw_clip_half_plane(wedge->startX, wedge->startY, y, &clipLo, &clipHi);
+		/* counterclockwise of the end is clockwise of its reverse */
+		fp_draw_clip_half_plane(-wedge->endX, -wedge->endY, y, &clipLo, &clipHi);
+		if(clipLo > clipHi) {
+			return;
+		}
+	}
+
+	if(holeHalf >= 0) {
+		fp_draw_wedge_span(frame, centerX, centerY + y, -half, -holeHalf - 1, clipLo, clipHi, color);
+		fp_draw_wedge_span(frame, centerX, centerY + y, holeHalf + 1, half, clipLo, clipHi, color);
+	}
+	else {
+		fp_draw_wedge_span(frame, centerX, centerY + y, -half, half, clipLo, clipHi, color);
+	}
+}
+
+/** fills the ring between the radii, inside the wedge. a NULL wedge fills the whole ring */
+static void fp_draw_arc_rows(
+	fp_frame* frame,
+	int centerX,
+	int centerY,
+	unsigned int innerRadius,
+	unsigned int outerRadius,
+	const fp_draw_wedge* wedge,
+	rgb_color color
+) {
+	int radius = outerRadius;
+	int outerLimit = radius * radius + radius;
+	/* the hole is the filled circle of innerRadius - 1 */
+	int hole = (int)innerRadius - 1;
+	int holeLimit = hole * hole + hole;
+
+	/* walk outwards from the center row, so the half widths only shrink */
+	int half = radius;
+	int holeHalf = hole;
+	for(int y = 0; y <= radius; y++) {
+		int yy = y * y;
+		while(half * half > outerLimit - yy) {
+			half--;
+		}
+		if(holeHalf >= 0) {
+			if(yy > holeLimit) {
+				holeHalf = -1;
+			}
+			else {
+				while(holeHalf * holeHalf > holeLimit - yy) {
+					holeHalf--;
+				}
+			}
+		}
+
+		fp_draw_arc_row(frame, centerX, centerY, y, half, holeHalf, wedge, color);
+		if(y != 0) {
+			fp_draw_arc_row(frame, centerX, centerY, -y, half, holeHalf, wedge, color);
+		}
+	}
+}
+
+bool fp_fdraw_line_aa(
+	fp_frameid id,
+	int32_t x0,
+	int32_t y0,
+	int32_t x1,
+	int32_t y1,
+	rgb_color color
+) {
+	fp_frame* frame = fp_draw_get_frame(id);
+	if(frame == NULL) {
+		return false;
+	}
+	FP_PROFILE_BEGIN_OP("fp_fdraw_line_aa");
+
+	/* step along the major axis, one pixel at a time, and split each pixel between the two rows the line passes */
+	bool steep = abs(y1 - y0) > abs(x1 - x0);
+	if(steep) {
+		int32_t swap = x0; x0 = y0; y0 = swap;
+		swap = x1; x1 = y1; y1 = swap;
+	}
+	if(x0 > x1) {
+		int32_t swap = x0; x0 = x1; x1 = swap;
+		swap = y0; y0 = y1; y1 = swap;
+	}
+
+	int32_t dx = x1 - x0;
+	/* 16.16 change in minor axis per pixel */
+	int32_t gradient = dx == 0 ? 0 : (int32_t)(((int64_t)(y1 - y0) << 16) / dx);
+
+	int xStart = (x0 + 128) >> 8;
+	int xEnd = (x1 + 128) >> 8;
+	/* 16.16 minor axis position at the center of pixel xStart */
+	int32_t y = y0 * 256 + (int32_t)(((int64_t)gradient * (xStart * 256 - x0)) >> 8);
+
+	for(int x = xStart; x <= xEnd; x++) {
+		int row = y >> 16;
+		uint8_t fraction = (y >> 8) & 0xff;
+		if(steep) {
+			fp_draw_blend_point(frame, row, x, color, 255 - fraction);
+			fp_draw_blend_point(frame, row + 1, x, color, fraction);
+		}
+		else {
+			fp_draw_blend_point(frame, x, row, color, 255 - fraction);
+			fp_draw_blend_point(frame, x, row + 1, color, fraction);
+		}
+		y += gradient;
+	}
+
+	FP_PROFILE_END();
+	return true;
+}
+
+bool fp_fdraw_circle(
+	fp_frameid id,
+	int centerX,
+	int centerY,
+	unsigned int radius,
+	rgb_color color
+) {
+	fp_frame* frame = fp_draw_get_frame(id);
+	if(frame == NULL) {
+		return false;
+	}
+	FP_PROFILE_BEGIN_OP("fp_fdraw_circle");
+
+	/* midpoint: walk the first octant and mirror it */
+	int x = radius;
+	int y = 0;
+	int error = 1 - x;
+	while(x >= y) {
+		fp_draw_point(frame, centerX + x, centerY + y, color);
+		fp_draw_point(frame, centerX + y, centerY + x, color);
+		fp_draw_point(frame, centerX - y, centerY + x, color);
+		fp_draw_point(frame, centerX - x, centerY + y, color);
+		fp_draw_point(frame, centerX - x, centerY - y, color);
+		fp_draw_point(frame, centerX - y, centerY - x, color);
+		fp_draw_point(frame, centerX + y, centerY - x, color);
+		fp_draw_point(frame, centerX + x, centerY - y, color);
+
+		y++;
+		if(error < 0) {
+			error += 2 * y + 1;
+		}
+		else {
+			x--;
+			error += 2 * (y - x) + 1;
+		}
+	}
+
+	FP_PROFILE_END();
+	return true;
+}
+
+bool fp_ffill_circle(
+	fp_frameid id,
+	int centerX,
+	int centerY,
+	unsigned int radius,
+	rgb_color color
+) {
+	fp_frame* frame = fp_draw_get_frame(id);
+	if(frame == NULL) {
+		return false;
+	}
+	FP_PROFILE_BEGIN_OP("fp_ffill_circle");
+
+	fp_draw_arc_rows(frame, centerX, centerY, 0, radius, NULL, color);
+
+	FP_PROFILE_END();
+	return true;
+}
+
+bool fp_ffill_arc(
+	fp_frameid id,
+	int centerX,
+	int centerY,
+	unsigned int innerRadius,
+	unsigned int outerRadius,
+	uint16_t startAngle,
+	uint32_t sweep,
+	rgb_color color
+) {
+	fp_frame* frame = fp_draw_get_frame(id);
+	if(frame == NULL) {
+		return false;
+	}
+	if(innerRadius > outerRadius) {
+		printf("error: fp_ffill_arc: inner radius %u is larger than outer radius %u\n", innerRadius, outerRadius);
+		return false;
+	}
+	if(sweep == 0) {
+		return true;
+	}
+	FP_PROFILE_BEGIN_OP("fp_ffill_arc");
+
+	if(sweep >= FP_DRAW_TURN) {
+		fp_draw_arc_rows(frame, centerX, centerY, innerRadius, outerRadius, NULL, color);
+	}
+	else {
+		/* a wedge of half a turn or less is the intersection of two half planes, so each row is one x range.
+		 * split larger sweeps in two */
+		uint16_t angles[3] = {startAngle, startAngle, startAngle + sweep};
+		unsigned int wedges = 1;
+		if(sweep > FP_DRAW_TURN / 2) {
+			angles[1] = startAngle + sweep / 2;
+			angles[2] = startAngle + sweep;
+			wedges = 2;
+		}
+		else {
+			angles[1] = startAngle + sweep;
+		}
+
+		for(unsigned int i = 0; i < wedges; i++) {
+			fp_draw_wedge wedge = {
+				.startX = FP_COS16(angles[i]),
+				.startY = fp_sin16(angles[i]),
+				.endX = FP_COS16(angles[i + 1]),
+				.endY = fp_sin16(angles[i + 1]),
+			};
+			fp_draw_arc_rows(frame, centerX, centerY, innerRadius, outerRadius, &wedge, color);
+		}
+	}
+
+	FP_PROFILE_END();
+	return true;
+}
+
+bool fp_ffill_pie(
+	fp_frameid id,
+	int centerX,
+	int centerY,
+	unsigned int radius,
+	uint16_t startAngle,
+	uint32_t sweep,
+	rgb_color color
+) {
+	return fp_ffill_arc(id, centerX, centerY, 0, radius, startAngle, sweep, color);
+}
+
+bool fp_ffill_polygon(
+	fp_frameid id,
+	const fp_point* points,
+	unsigned int count,
+	rgb_color color
+) {
+	fp_frame* frame = fp_draw_get_frame(id);
+	if(frame == NULL) {
+		return false;
+	}
+	if(count > FP_DRAW_MAX_POLYGON_POINTS) {
+		printf("error: fp_ffill_polygon: %u points, max %d\n", count, FP_DRAW_MAX_POLYGON_POINTS);
+		return false;
+	}
+	if(count < 3) {
+		return true;
+	}
+	FP_PROFILE_BEGIN_OP("fp_ffill_polygon");
+
+	int height = fp_frame_height(frame);
+	fp_draw_edge edges[FP_DRAW_MAX_POLYGON_POINTS];
+	unsigned int edgeCount = 0;
+	int yMin = INT_MAX;
+	int yMax = INT_MIN;
+
+	for(unsigned int i = 0; i < count; i++) {
+		fp_point a = points[i];
+		fp_point b = points[(i + 1) % count];
+		if(a.y == b.y) {
+			/* horizontal edges never cross a row center */
+			continue;
+		}
+		if(a.y > b.y) {
+			fp_point swap = a; a = b; b = swap;
+		}
+
+		/* a row is crossed if its center y + 0.5 is in [a.y, b.y) */
+		fp_draw_edge* edge = &edges[edgeCount++];
+		edge->yStart = a.y < 0 ? 0 : a.y;
+		edge->yEnd = b.y;
+		edge->step = (int32_t)(((int64_t)(b.x - a.x) << 16) / (b.y - a.y));
+		edge->x = (int32_t)a.x * 65536 + (int32_t)(((int64_t)edge->step * (2 * (edge->yStart - a.y) + 1)) / 2);
+
+		if(edge->yStart < yMin) {
+			yMin = edge->yStart;
+		}
+		if(edge->yEnd > yMax) {
+			yMax = edge->yEnd;
+		}
+	}
+	if(yMax > height) {
+		yMax = height;
+	}
+
+	int32_t crossings[FP_DRAW_MAX_POLYGON_POINTS];
+	for(int y = yMin; y < yMax; y++) {
+		unsigned int crossingCount = 0;
+		for(unsigned int i = 0; i < edgeCount; i++) {
+			fp_draw_edge* edge = &edges[i];
+			if(y < edge->yStart || y >= edge->yEnd) {
+				continue;
+			}
+
+			/* insertion sort as we go, there are only a few per row */
+			int32_t x = edge->x;
+			unsigned int j = crossingCount++;
+			while(j > 0 && crossings[j - 1] > x) {
+				crossings[j] = crossings[j - 1];
+				j--;
+			}
+			crossings[j] = x;
+			edge->x += edge->step;
+		}
+
+		/* even-odd: inside between each pair of crossings. pixel x is inside if x + 0.5 is in [left, right) */
+		for(unsigned int i = 0; i + 1 < crossingCount; i += 2) {
+			int x0 = (crossings[i] + 32767) >> 16;
+			int x1 = ((crossings[i + 1] + 32767) >> 16) - 1;
+			if(x0 <= x1 && x1 >= 0 && x0 < (int)frame->width) {
+				fp_draw_span(frame, x0, x1, y, color);
+			}
+		}
+	}
+
+	FP_PROFILE_END();
+	return true;
+}
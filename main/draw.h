@@ -0,0 +1,94 @@
+#ifndef DRAW_H
+#define DRAW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "color.h"
+#include "frame.h"
+
+/* fp: fresh pixel */
+
+/**
+ * rasterization primitives that draw into frames. the 1 pixel line (fp_fdraw_line) and text live in frame.h.
+ * shapes are integer only: circles and arcs are filled one row at a time, from the circle's half width at the row
+ * (fp_isqrt32) and the x range inside the arc's angles, and polygons step each edge's x by a fixed increment per row.
+ * rows and spans are clipped to the frame once, then written straight into its pixels.
+ *
+ * pixel (x, y) is inside a circle of radius r if x*x + y*y <= r*r + r (its center is within r + 0.5).
+ * angles have 16 bits: FP_DRAW_TURN is a full turn, 0 is +x and FP_DRAW_TURN/4 is +y (down), so angles grow clockwise.
+ * arcs that share an edge never share a pixel, so a circle cut into arcs is covered exactly once.
+ */
+
+#define FP_DRAW_TURN 65536u
+/** converts whole pixels to the 24.8 fixed point coordinates of fp_fdraw_line_aa */
+#define FP_DRAW_SUBPIXEL(pixels) ((int32_t)(pixels) * 256)
+#define FP_DRAW_MAX_POLYGON_POINTS 32
+
+typedef struct {
+	int x;
+	int y;
+} fp_point;
+
+/** draws an anti-aliased line (xiaolin wu). endpoints are 24.8 fixed point pixel centers (see FP_DRAW_SUBPIXEL).
+ * each pixel is blended towards color by how much of the line covers it */
+bool fp_fdraw_line_aa(
+	fp_frameid id,
+	int32_t x0,
+	int32_t y0,
+	int32_t x1,
+	int32_t y1,
+	rgb_color color
+);
+
+/** draws the 1 pixel outline of a circle (midpoint algorithm) */
+bool fp_fdraw_circle(
+	fp_frameid id,
+	int centerX,
+	int centerY,
+	unsigned int radius,
+	rgb_color color
+);
+
+bool fp_ffill_circle(
+	fp_frameid id,
+	int centerX,
+	int centerY,
+	unsigned int radius,
+	rgb_color color
+);
+
+/** fills the part of the ring between innerRadius and outerRadius (both inclusive) from startAngle, clockwise for sweep.
+ * a sweep of FP_DRAW_TURN or more fills the whole ring */
+bool fp_ffill_arc(
+	fp_frameid id,
+	int centerX,
+	int centerY,
+	unsigned int innerRadius,
+	unsigned int outerRadius,
+	uint16_t startAngle,
+	uint32_t sweep,
+	rgb_color color
+);
+
+/** same as fp_ffill_arc with an inner radius of 0 */
+bool fp_ffill_pie(
+	fp_frameid id,
+	int centerX,
+	int centerY,
+	unsigned int radius,
+	uint16_t startAngle,
+	uint32_t sweep,
+	rgb_color color
+);
+
+/** fills a polygon of up to FP_DRAW_MAX_POLYGON_POINTS points, which may be concave or self intersecting (even-odd rule).
+ * points are pixel corners: pixel (x, y) is filled if its center (x + 0.5, y + 0.5) is inside */
+bool fp_ffill_polygon(
+	fp_frameid id,
+	const fp_point* points,
+	unsigned int count,
+	rgb_color color
+);
+
+#endif /* DRAW_H */
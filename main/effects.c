@@ -0,0 +1,424 @@
+#include "effects.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "fixed.h"
+#include "mem.h"
+#include "render.h"
+#include "console.h"
+#include "views/procedural-view.h"
+
+typedef struct {
+	fp_effect_type type;
+	unsigned int width;
+	unsigned int height;
+	fp_effect_params params;
+	uint32_t phase;
+	uint32_t seed;
+	fp_rand rand;
+	/* fire: heat of each pixel. radial gradient: palette index of each pixel's distance from the center. NULL otherwise */
+	uint8_t* cells;
+} fp_effect;
+
+static const char* fp_effect_names[FP_EFFECT_COUNT] = {
+	"plasma",
+	"fire",
+	"noise",
+	"linear gradient",
+	"radial gradient",
+	"color waves",
+};
+
+/* rgb_color fields are in b, r, g order */
+#define PALETTE_RGB(r, g, b) {{ b, r, g }}
+
+const fp_palette fp_palette_rainbow = {{
+	PALETTE_RGB(255, 0, 0), PALETTE_RGB(255, 96, 0), PALETTE_RGB(255, 192, 0), PALETTE_RGB(224, 255, 0),
+	PALETTE_RGB(128, 255, 0), PALETTE_RGB(32, 255, 0), PALETTE_RGB(0, 255, 64), PALETTE_RGB(0, 255, 160),
+	PALETTE_RGB(0, 255, 255), PALETTE_RGB(0, 160, 255), PALETTE_RGB(0, 64, 255), PALETTE_RGB(32, 0, 255),
+	PALETTE_RGB(128, 0, 255), PALETTE_RGB(224, 0, 255), PALETTE_RGB(255, 0, 192), PALETTE_RGB(255, 0, 96),
+}};
+
+const fp_palette fp_palette_heat = {{
+	PALETTE_RGB(0, 0, 0), PALETTE_RGB(32, 0, 0), PALETTE_RGB(72, 0, 0), PALETTE_RGB(112, 0, 0),
+	PALETTE_RGB(160, 0, 0), PALETTE_RGB(208, 16, 0), PALETTE_RGB(255, 32, 0), PALETTE_RGB(255, 64, 0),
+	PALETTE_RGB(255, 96, 0), PALETTE_RGB(255, 128, 0), PALETTE_RGB(255, 160, 0), PALETTE_RGB(255, 192, 0),
+	PALETTE_RGB(255, 224, 0), PALETTE_RGB(255, 255, 64), PALETTE_RGB(255, 255, 160), PALETTE_RGB(255, 255, 255),
+}};
+
+const fp_palette fp_palette_ocean = {{
+	PALETTE_RGB(0, 0, 16), PALETTE_RGB(0, 0, 48), PALETTE_RGB(0, 0, 96), PALETTE_RGB(0, 16, 128),
+	PALETTE_RGB(0, 32, 160), PALETTE_RGB(0, 64, 192), PALETTE_RGB(0, 96, 208), PALETTE_RGB(0, 128, 224),
+	PALETTE_RGB(0, 160, 224), PALETTE_RGB(0, 192, 224), PALETTE_RGB(0, 224, 224), PALETTE_RGB(32, 240, 232),
+	PALETTE_RGB(64, 255, 240), PALETTE_RGB(128, 255, 255), PALETTE_RGB(192, 255, 255), PALETTE_RGB(255, 255, 255),
+}};
+
+rgb_color fp_palette_get(const fp_palette* palette, uint8_t index) {
+	/* stop i is at index i * 17 */
+	unsigned int stop = index / 17;
+	if(stop == 15) {
+		return palette->stops[15];
+	}
+
+	unsigned int t = (index - stop * 17) * 15;
+	rgb_color a = palette->stops[stop];
+	rgb_color b = palette->stops[stop + 1];
+	rgb_color color;
+	color.bits = 0;
+	color.fields.r = FP_LERP8(a.fields.r, b.fields.r, t);
+	color.fields.g = FP_LERP8(a.fields.g, b.fields.g, t);
+	color.fields.b = FP_LERP8(a.fields.b, b.fields.b, t);
+	return color;
+}
+
+fp_effect_params fp_effect_default_params(fp_effect_type type) {
+	fp_effect_params params = {
+		&fp_palette_rainbow,
+		32,
+		2,
+		1000/30,
+		127,
+		0,
+		FP_EFFECT_CENTER,
+		FP_EFFECT_CENTER,
+		55,
+		120
+	};
+
+	switch(type) {
+		case FP_EFFECT_FIRE:
+			params.palette = &fp_palette_heat;
+			break;
+		case FP_EFFECT_NOISE:
+			params.palette = &fp_palette_ocean;
+			params.scale = 48;
+			params.speed = 8;
+			break;
+		case FP_EFFECT_LINEAR_GRADIENT:
+			params.scale = 16;
+			params.speed = 1;
+			break;
+		case FP_EFFECT_COLOR_WAVES:
+			params.scale = 24;
+			params.speed = 3;
+			break;
+		default:
+			break;
+	}
+
+	return params;
+}
+
+const char* fp_effect_get_name(fp_effect_type type) {
+	return type < FP_EFFECT_COUNT ? fp_effect_names[type] : "unknown";
+}
+
+static fp_effect* fp_effect_from_view(fp_view* view) {
+	return ((fp_procedural_view_data*)view->data)->data;
+}
+
+static bool fp_effect_plasma_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_effect* effect = fp_effect_from_view(view);
+	unsigned int scale = effect->params.scale;
+	uint8_t t = effect->phase;
+
+	uint8_t rowWave = FP_SIN8(y * scale - t);
+	for(unsigned int i = 0; i < width; i++) {
+		unsigned int px = x + i;
+		unsigned int value = FP_SIN8(px * scale + t)
+			+ rowWave
+			+ FP_SIN8(((px + y) * scale >> 1) + 2*t)
+			+ FP_SIN8(FP_SIN8((px * scale >> 1) + t) + y * scale);
+		out[i] = fp_palette_get(effect->params.palette, (value >> 2) + (t >> 1));
+	}
+
+	return true;
+}
+
+static bool fp_effect_fire_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_effect* effect = fp_effect_from_view(view);
+	const uint8_t* heat = &effect->cells[y * effect->width + x];
+	for(unsigned int i = 0; i < width; i++) {
+		out[i] = fp_palette_get(effect->params.palette, heat[i]);
+	}
+
+	return true;
+}
+
+/* random value at an integer lattice point */
+static uint8_t fp_effect_lattice(uint32_t seed, uint32_t ix, uint32_t iy) {
+	uint32_t hash = seed ^ (ix * 0x27d4eb2du) ^ (iy * 0x165667b1u);
+	hash = (hash ^ (hash >> 15)) * 0x2c1b3c6du;
+	hash ^= hash >> 12;
+	return hash >> 24;
+}
+
+/* value noise at 24.8 fixed point coordinates, eased between the lattice points */
+static uint8_t fp_effect_value_noise(uint32_t seed, uint32_t fx, uint32_t fy) {
+	uint32_t ix = fx >> 8;
+	uint32_t iy = fy >> 8;
+	uint8_t tx = FP_EASE8(fx);
+	uint8_t ty = FP_EASE8(fy);
+
+	uint8_t top = FP_LERP8(fp_effect_lattice(seed, ix, iy), fp_effect_lattice(seed, ix + 1, iy), tx);
+	uint8_t bottom = FP_LERP8(fp_effect_lattice(seed, ix, iy + 1), fp_effect_lattice(seed, ix + 1, iy + 1), tx);
+	return FP_LERP8(top, bottom, ty);
+}
+
+static bool fp_effect_noise_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_effect* effect = fp_effect_from_view(view);
+	uint32_t scale = effect->params.scale;
+	uint32_t fy = y * scale + effect->phase;
+	for(unsigned int i = 0; i < width; i++) {
+		uint32_t fx = (x + i) * scale;
+		unsigned int coarse = fp_effect_value_noise(effect->seed, fx, fy);
+		unsigned int fine = fp_effect_value_noise(effect->seed + 1, fx * 2, fy * 2);
+		/* 2/3 coarse, 1/3 fine */
+		out[i] = fp_palette_get(effect->params.palette, (coarse * 171 + fine * 85) >> 8);
+	}
+
+	return true;
+}
+
+static bool fp_effect_linear_gradient_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_effect* effect = fp_effect_from_view(view);
+	int scale = effect->params.scale;
+	int directionX = effect->params.directionX;
+	uint8_t t = effect->phase;
+
+	int rowPosition = y * effect->params.directionY;
+	for(unsigned int i = 0; i < width; i++) {
+		int position = (((int)(x + i) * directionX + rowPosition) * scale) >> 7;
+		out[i] = fp_palette_get(effect->params.palette, position + t);
+	}
+
+	return true;
+}
+
+static bool fp_effect_radial_gradient_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_effect* effect = fp_effect_from_view(view);
+	const uint8_t* distance = &effect->cells[y * effect->width + x];
+	uint8_t t = effect->phase;
+	for(unsigned int i = 0; i < width; i++) {
+		out[i] = fp_palette_get(effect->params.palette, distance[i] - t);
+	}
+
+	return true;
+}
+
+static bool fp_effect_color_waves_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_effect* effect = fp_effect_from_view(view);
+	unsigned int scale = effect->params.scale;
+	uint8_t t = effect->phase;
+
+	for(unsigned int i = 0; i < width; i++) {
+		unsigned int px = x + i;
+		uint8_t index = FP_SIN8(px * scale + t) + (y * scale >> 1);
+		uint8_t brightness = FP_SIN8(2 * px * scale + y * scale - 2*t);
+		rgb_color color = fp_palette_get(effect->params.palette, index);
+		color.fields.r = FP_SCALE8(color.fields.r, brightness);
+		color.fields.g = FP_SCALE8(color.fields.g, brightness);
+		color.fields.b = FP_SCALE8(color.fields.b, brightness);
+		out[i] = color;
+	}
+
+	return true;
+}
+
+static const fp_span_fn fp_effect_span_fns[FP_EFFECT_COUNT] = {
+	&fp_effect_plasma_span,
+	&fp_effect_fire_span,
+	&fp_effect_noise_span,
+	&fp_effect_linear_gradient_span,
+	&fp_effect_radial_gradient_span,
+	&fp_effect_color_waves_span,
+};
+
+/* one step of the fire simulation: cool every cell, move heat up each column, and light new sparks at the bottom */
+static void fp_effect_fire_step(fp_effect* effect) {
+	unsigned int width = effect->width;
+	unsigned int height = effect->height;
+	uint8_t* heat = effect->cells;
+	/* unsigned int, so large cooling on short frames saturates instead of wrapping */
+	unsigned int cooling = (effect->params.cooling * 10u) / height + 2;
+	uint8_t maxCooling = cooling > 255 ? 255 : cooling;
+	unsigned int sparkRows = height < 3 ? height : 3;
+
+	/* one random byte per cell, and 3 for the spark */
+	uint8_t noise[height + 3];
+	for(unsigned int x = 0; x < width; x++) {
+		fp_rand_fill(&effect->rand, noise, height + 3);
+
+		for(unsigned int y = 0; y < height; y++) {
+			uint8_t* cell = &heat[y * width + x];
+			*cell = FP_QSUB8(*cell, FP_SCALE8(noise[y], maxCooling));
+		}
+
+		/* top to bottom, so each cell reads the cells below it before they change */
+		for(unsigned int y = 0; y + 2 < height; y++) {
+			heat[y * width + x] = ((heat[(y + 1) * width + x] + 2 * heat[(y + 2) * width + x]) * 85) >> 8;
+		}
+
+		if(noise[height] < effect->params.sparking) {
+			unsigned int y = height - 1 - noise[height + 1] % sparkRows;
+			uint8_t* cell = &heat[y * width + x];
+			*cell = FP_QADD8(*cell, 160 + noise[height + 2] % 96);
+		}
+	}
+}
+
+static void fp_effect_step(fp_effect* effect) {
+	if(fp_rand_sync(&effect->rand)) {
+		effect->seed = fp_rand_next(&effect->rand);
+		effect->phase = 0;
+		if(effect->type == FP_EFFECT_FIRE) {
+			memset(effect->cells, 0, effect->width * effect->height);
+		}
+	}
+
+	effect->phase += effect->params.speed;
+	if(effect->type == FP_EFFECT_FIRE) {
+		fp_effect_fire_step(effect);
+	}
+}
+
+static bool fp_effect_onnext_render(fp_view* view) {
+	fp_effect* effect = fp_effect_from_view(view);
+	fp_effect_step(effect);
+	return fp_queue_render(view->id, xTaskGetTickCount() + pdMS_TO_TICKS(effect->params.periodMs));
+}
+
+static bool fp_effect_free(fp_view* view) {
+	fp_mem_free(fp_effect_from_view(view));
+	return true;
+}
+
+/* palette index of each pixel's distance from the center */
+static void fp_effect_radial_init(fp_effect* effect) {
+	unsigned int centerX = effect->params.centerX == FP_EFFECT_CENTER ? effect->width / 2 : effect->params.centerX;
+	unsigned int centerY = effect->params.centerY == FP_EFFECT_CENTER ? effect->height / 2 : effect->params.centerY;
+	for(unsigned int y = 0; y < effect->height; y++) {
+		for(unsigned int x = 0; x < effect->width; x++) {
+			/* from the middle of the pixel, in 1/16 pixels */
+			int dx = (int)(x * 16 + 8) - (int)(centerX * 16);
+			int dy = (int)(y * 16 + 8) - (int)(centerY * 16);
+			uint32_t distance = fp_isqrt32(dx * dx + dy * dy);
+			effect->cells[y * effect->width + x] = (distance * effect->params.scale) >> 6;
+		}
+	}
+}
+
+fp_viewid fp_effect_create(fp_effect_type type, unsigned int width, unsigned int height, const fp_effect_params* params) {
+	if(type >= FP_EFFECT_COUNT || width == 0 || height == 0) {
+		printf("error: fp_effect_create: invalid effect %d (%ux%u)\n", type, width, height);
+		return 0;
+	}
+
+	size_t cellsSize = (type == FP_EFFECT_FIRE || type == FP_EFFECT_RADIAL_GRADIENT) ? width * height : 0;
+	fp_effect* effect = fp_mem_calloc(FP_MEM_VIEW, 1, sizeof(fp_effect) + cellsSize);
+	if(!effect) {
+		printf("error: fp_effect_create: failed to allocate %s\n", fp_effect_names[type]);
+		return 0;
+	}
+
+	effect->type = type;
+	effect->width = width;
+	effect->height = height;
+	effect->params = params ? *params : fp_effect_default_params(type);
+	if(!effect->params.palette) {
+		effect->params.palette = &fp_palette_rainbow;
+	}
+	effect->cells = cellsSize > 0 ? (uint8_t*)(effect + 1) : NULL;
+	fp_rand_seed(&effect->rand, type);
+	effect->seed = fp_rand_next(&effect->rand);
+
+	if(type == FP_EFFECT_RADIAL_GRADIENT) {
+		fp_effect_radial_init(effect);
+	}
+
+	bool animated = effect->params.periodMs > 0;
+	fp_viewid id = fp_procedural_view_create(width, height, fp_effect_span_fns[type], animated ? &fp_effect_onnext_render : NULL, effect);
+	if(id == 0) {
+		fp_mem_free(effect);
+		return 0;
+	}
+	fp_procedural_view_set_free(id, &fp_effect_free);
+
+	if(animated) {
+		fp_queue_render(id, xTaskGetTickCount() + pdMS_TO_TICKS(effect->params.periodMs));
+	}
+
+	return id;
+}
+
+bool fp_effect_bench(fp_effect_type type, unsigned int width, unsigned int height, unsigned int frames, fp_effect_bench_result* result) {
+	fp_effect_params params = fp_effect_default_params(type);
+	/* nothing may be queued, the effect is only stepped here */
+	params.periodMs = 0;
+	fp_viewid id = fp_effect_create(type, width, height, &params);
+	rgb_color* row = fp_mem_alloc(FP_MEM_DEBUG, width * sizeof(rgb_color));
+	if(id == 0 || !row) {
+		printf("error: fp_effect_bench: failed to create %s\n", fp_effect_get_name(type));
+		fp_view_release(id);
+		fp_mem_free(row);
+		return false;
+	}
+
+	fp_effect* effect = fp_effect_from_view(fp_view_get(id));
+	int64_t updateUs = 0;
+	int64_t spanUs = 0;
+	for(unsigned int frame = 0; frame < frames; frame++) {
+		int64_t start = esp_timer_get_time();
+		fp_effect_step(effect);
+		int64_t stepped = esp_timer_get_time();
+		for(unsigned int y = 0; y < height; y++) {
+			fp_view_get_span(id, 0, y, width, row);
+		}
+		spanUs += esp_timer_get_time() - stepped;
+		updateUs += stepped - start;
+	}
+
+	uint64_t pixels = (uint64_t)width * height * frames;
+	result->nsPerPixel = pixels > 0 ? spanUs * 1000 / pixels : 0;
+	result->updateUs = frames > 0 ? updateUs / frames : 0;
+
+	fp_mem_free(row);
+	fp_view_release(id);
+	return true;
+}
+
+static int fp_effect_command(int argc, char** argv) {
+	if(argc < 2 || strcmp(argv[1], "bench") != 0) {
+		printf("usage: effects bench [<width> <height> [<frames>]]\n");
+		return 1;
+	}
+
+	unsigned int width = argc >= 4 ? strtoul(argv[2], NULL, 0) : 32;
+	unsigned int height = argc >= 4 ? strtoul(argv[3], NULL, 0) : 32;
+	unsigned int frames = argc >= 5 ? strtoul(argv[4], NULL, 0) : 30;
+	if(width == 0 || height == 0 || frames == 0) {
+		printf("usage: effects bench [<width> <height> [<frames>]]\n");
+		return 1;
+	}
+
+	printf("%ux%u, %u frames\n", width, height, frames);
+	for(unsigned int type = 0; type < FP_EFFECT_COUNT; type++) {
+		fp_effect_bench_result result;
+		if(!fp_effect_bench(type, width, height, frames, &result)) {
+			return 1;
+		}
+		printf("  %-16s %6u ns/pixel %6u us/update\n", fp_effect_get_name(type), result.nsPerPixel, result.updateUs);
+	}
+
+	return 0;
+}
+
+bool fp_effect_console_init() {
+	return fp_console_register("effects", "cost of each effect: bench [<width> <height> [<frames>]]", &fp_effect_command);
+}
@@ -0,0 +1,95 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "color.h"
+#include "view.h"
+#include "rand.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_effect
+ * generative effects as procedural views (see views/procedural-view.h). pixels are generated per span with 8 bit
+ * fixed point math and lookup tables (see fixed.h), so an effect costs no frame memory, and the per pixel path is integer only.
+ * animated effects advance their phase and queue their next render every periodMs.
+ * effects that need state (fire's heat, the radial distances) keep one byte per pixel, freed with the view.
+ * random effects draw from a stream seeded with the effect type, so they are reproducible with fp_rand_set_seed.
+ *
+ * the "effects bench" console command reports the cost of every effect in ns/pixel, to budget effects on larger panels.
+ */
+
+typedef enum {
+	/* sum of sine waves through a palette */
+	FP_EFFECT_PLASMA,
+	/* heat rising from sparks at the bottom row, cooling as it goes */
+	FP_EFFECT_FIRE,
+	/* 2 octaves of smoothed value noise, drifting upwards */
+	FP_EFFECT_NOISE,
+	/* palette along directionX, directionY, scrolling with the phase */
+	FP_EFFECT_LINEAR_GRADIENT,
+	/* palette by distance from the center, rings moving outwards */
+	FP_EFFECT_RADIAL_GRADIENT,
+	/* palette and brightness waves travelling in opposite directions */
+	FP_EFFECT_COLOR_WAVES,
+	FP_EFFECT_COUNT
+} fp_effect_type;
+
+/** 16 colors spread evenly over indices 0-255, blended in between */
+typedef struct {
+	rgb_color stops[16];
+} fp_palette;
+
+extern const fp_palette fp_palette_rainbow;
+/* black, red, yellow, white */
+extern const fp_palette fp_palette_heat;
+/* deep blue, cyan, white */
+extern const fp_palette fp_palette_ocean;
+
+rgb_color fp_palette_get(const fp_palette* palette, uint8_t index);
+
+/* centerX and centerY of the radial gradient default to the middle of the view */
+#define FP_EFFECT_CENTER UINT_MAX
+
+typedef struct {
+	const fp_palette* palette;
+	/* spatial frequency. larger values make smaller features */
+	uint8_t scale;
+	/* phase advance per update */
+	uint8_t speed;
+	/* update period. 0 for a still image */
+	unsigned int periodMs;
+	/* linear gradient direction, -127 to 127 on each axis */
+	int8_t directionX;
+	int8_t directionY;
+	/* radial gradient center, in pixels */
+	unsigned int centerX;
+	unsigned int centerY;
+	/* fire: how fast heat fades, and the chance in 256 of a new spark per column each update */
+	uint8_t cooling;
+	uint8_t sparking;
+} fp_effect_params;
+
+fp_effect_params fp_effect_default_params(fp_effect_type type);
+
+/** @param params - NULL to use the defaults for the type */
+fp_viewid fp_effect_create(fp_effect_type type, unsigned int width, unsigned int height, const fp_effect_params* params);
+const char* fp_effect_get_name(fp_effect_type type);
+
+typedef struct {
+	/* generating the pixels of one frame */
+	uint32_t nsPerPixel;
+	/* advancing the effect by one update (fire's simulation), per frame */
+	uint32_t updateUs;
+} fp_effect_bench_result;
+
+/** renders "frames" frames of an effect of the given size, on the calling task. the effect isn't shown */
+bool fp_effect_bench(fp_effect_type type, unsigned int width, unsigned int height, unsigned int frames, fp_effect_bench_result* result);
+
+/** registers the "effects" console command */
+bool fp_effect_console_init();
+
+#endif /* EFFECTS_H */
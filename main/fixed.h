@@ -0,0 +1,38 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+/* fp: fresh pixel */
+
+/**
+ * 8 bit fixed point helpers for per pixel effects, so the pixel path never touches floating point.
+ * angles are 0-255 for a full turn, and fractions are 0-255 for 0.0-1.0.
+ * the macros are table lookups or a multiply and shift. arguments may be evaluated more than once.
+ */
+
+extern const uint8_t fp_sin8_table[256];
+extern const uint8_t fp_ease8_table[256];
+
+/** 128 + 127 * sin(angle) */
+#define FP_SIN8(angle) (fp_sin8_table[(uint8_t)(angle)])
+#define FP_COS8(angle) (fp_sin8_table[(uint8_t)((angle) + 64)])
+/** smoothstep of a fraction, for easing and noise interpolation */
+#define FP_EASE8(t) (fp_ease8_table[(uint8_t)(t)])
+/** a * b, both fractions. FP_SCALE8(a, 255) == a */
+#define FP_SCALE8(a, b) ((uint8_t)(((uint16_t)(a) * ((uint16_t)(b) + 1)) >> 8))
+/** a + (b - a) * t */
+#define FP_LERP8(a, b, t) ((uint8_t)((a) + ((((int)(b) - (int)(a)) * (int)(t)) >> 8)))
+/** a + b, saturated at 255 */
+#define FP_QADD8(a, b) ((uint8_t)((unsigned int)(a) + (b) > 255 ? 255 : (a) + (b)))
+/** a - b, saturated at 0 */
+#define FP_QSUB8(a, b) ((uint8_t)((a) > (b) ? (a) - (b) : 0))
+
+/** 32767 * sin(angle), for angles with 16 bits: 0-65535 is a full turn. interpolated from a quarter wave table */
+int16_t fp_sin16(uint16_t angle);
+#define FP_COS16(angle) (fp_sin16((uint16_t)((angle) + 16384)))
+
+/** floor(sqrt(value)) */
+uint32_t fp_isqrt32(uint32_t value);
+
+#endif /* FIXED_H */
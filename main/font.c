@@ -0,0 +1,75 @@
+#include "font.h"
+
+const uint16_t fp_font_3x5[] = {
+	0x0000, /* ' ' */
+	0x2482, /* '!' */
+	0x0000, /* '"' */
+	0x0000, /* '#' */
+	0x0000, /* '$' */
+	0x0000, /* '%' */
+	0x0000, /* '&' */
+	0x0000, /* ' */
+	0x0000, /* '(' */
+	0x0000, /* ')' */
+	0x0000, /* '*' */
+	0x05d0, /* '+' */
+	0x0000, /* ',' */
+	0x01c0, /* '-' */
+	0x0002, /* '.' */
+	0x12a4, /* '/' */
+	0x7b6f, /* '0' */
+	0x2c97, /* '1' */
+	0x73e7, /* '2' */
+	0x72cf, /* '3' */
+	0x5bc9, /* '4' */
+	0x79cf, /* '5' */
+	0x79ef, /* '6' */
+	0x7292, /* '7' */
+	0x7bef, /* '8' */
+	0x7bcf, /* '9' */
+	0x0410, /* ':' */
+	0x0000, /* ';' */
+	0x0000, /* '<' */
+	0x0000, /* '=' */
+	0x0000, /* '>' */
+	0x72c2, /* '?' */
+	0x0000, /* '@' */
+	0x2bed, /* 'A' */
+	0x6bae, /* 'B' */
+	0x3923, /* 'C' */
+	0x6b6e, /* 'D' */
+	0x79a7, /* 'E' */
+	0x79a4, /* 'F' */
+	0x396b, /* 'G' */
+	0x5bed, /* 'H' */
+	0x7497, /* 'I' */
+	0x126a, /* 'J' */
+	0x5bad, /* 'K' */
+	0x4927, /* 'L' */
+	0x5fed, /* 'M' */
+	0x6b6d, /* 'N' */
+	0x2b6a, /* 'O' */
+	0x6ba4, /* 'P' */
+	0x2b73, /* 'Q' */
+	0x6bad, /* 'R' */
+	0x388e, /* 'S' */
+	0x7492, /* 'T' */
+	0x5b6f, /* 'U' */
+	0x5b6a, /* 'V' */
+	0x5bfd, /* 'W' */
+	0x5aad, /* 'X' */
+	0x5a92, /* 'Y' */
+	0x72a7, /* 'Z' */
+};
+
+uint16_t fp_font_glyph(char c) {
+	if(c >= 'a' && c <= 'z') {
+		c = c - 'a' + 'A';
+	}
+
+	if(c < FP_FONT_FIRST_CHAR || c > FP_FONT_LAST_CHAR) {
+		return 0;
+	}
+
+	return fp_font_3x5[c - FP_FONT_FIRST_CHAR];
+}
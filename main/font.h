@@ -0,0 +1,19 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <stdint.h>
+
+/* 3x5 pixel font covering ' ' through 'Z'. lowercase letters are drawn as uppercase.
+ * each glyph is 15 bits, read row by row from the top left, most significant bit first */
+
+#define FP_FONT_WIDTH 3
+#define FP_FONT_HEIGHT 5
+#define FP_FONT_FIRST_CHAR ' '
+#define FP_FONT_LAST_CHAR 'Z'
+
+extern const uint16_t fp_font_3x5[];
+
+/** returns the glyph for the character, or a blank glyph if it is not in the font */
+uint16_t fp_font_glyph(char c);
+
+#endif /* FONT_H */
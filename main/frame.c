@@ -1,6 +1,7 @@
 #include "frame.h"
 
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
@@ -8,7 +9,10 @@
 #include "freertos/task.h"
 
 #include "pool.h"
+#include "font.h"
 #include "global.h"
+#include "profile.h"
+#include "mem.h"
 
 unsigned int fp_fcalc_index(unsigned int x, unsigned int y, unsigned int width) {
 	return y*width + x%width;
@@ -21,12 +25,26 @@ bool fp_frame_has_point(fp_frame* frame, int x, int y) {
 fp_pool* framePool = NULL;
 fp_frame* zeroFrame;
 
+/** locks the set of interned frames, so a dedup lookup can't retain a frame while it is being freed */
+SemaphoreHandle_t dedupLock = NULL;
+fp_frame_dedup_stats dedupStats = {0};
+
 bool fp_frame_init(unsigned int capacity) {
 	framePool = fp_pool_init(capacity, sizeof(fp_frame), true);
+	fp_mem_register_pool("frame", framePool);
 	zeroFrame = fp_pool_get(framePool, 0);
 	zeroFrame->length = 0;
 	zeroFrame->width = 0;
 	zeroFrame->pixels = NULL;
+	zeroFrame->ownsPixels = false;
+	atomic_init(&zeroFrame->refCount, 0);
+	zeroFrame->interned = false;
+
+	dedupLock = xSemaphoreCreateMutex();
+	if(!dedupLock) {
+		printf("error: fp_frame_init: failed to create dedup lock\n");
+		return false;
+	}
 
 	return true;
 }
@@ -45,7 +63,7 @@ fp_frameid fp_frame_create(unsigned int width, unsigned int height, rgb_color co
 
 	unsigned int length = width * height;
 
-	rgb_color* pixels = malloc(length * sizeof(rgb_color));
+	rgb_color* pixels = fp_mem_alloc(FP_MEM_FRAME, length * sizeof(rgb_color));
 	if(!pixels) {
 		printf("error: fp_frame_create: failed to allocate memory for pixels\n");
 		fp_pool_delete(framePool, id);
@@ -60,6 +78,10 @@ fp_frameid fp_frame_create(unsigned int width, unsigned int height, rgb_color co
 	frame->length = length;
 	frame->width = width;
 	frame->pixels = pixels;
+	frame->ownsPixels = true;
+	atomic_init(&frame->refCount, 1);
+	frame->interned = false;
+	frame->hash = 0;
 
 #ifdef DEBUG
 		printf("frame: create %d (%d/%d): length: %d\n", id, framePool->count, framePool->capacity, length);
@@ -68,24 +90,163 @@ fp_frameid fp_frame_create(unsigned int width, unsigned int height, rgb_color co
 	return id;
 }
 
-bool fp_frame_free(fp_frameid id) {
+fp_frameid fp_frame_create_from_buffer(unsigned int width, unsigned int height, rgb_color* pixels) {
+	fp_frameid id = fp_pool_add(framePool);
 	if(id == 0) {
-		return false;
+		printf("error: fp_frame_create_from_buffer: failed to add frame\n");
+		return 0;
 	}
 
 	fp_frame* frame = fp_pool_get(framePool, id);
-	if(frame == NULL) {
-		return false;
+	frame->length = width * height;
+	frame->width = width;
+	frame->pixels = pixels;
+	frame->ownsPixels = false;
+	atomic_init(&frame->refCount, 1);
+	frame->interned = false;
+	frame->hash = 0;
+
+	return id;
+}
+
+fp_frameid fp_frame_retain(fp_frameid id) {
+	if(id == 0) {
+		return 0;
 	}
 
+	fp_frame* frame = fp_pool_get(framePool, id);
+	atomic_fetch_add_explicit(&frame->refCount, 1, memory_order_relaxed);
+	return id;
+}
+
+static bool fp_frame_delete(fp_frameid id, fp_frame* frame) {
 #ifdef DEBUG
 		printf("frame: delete %d (%d/%d)\n", id, framePool->count, framePool->capacity);
 #endif
 
-	free(frame->pixels);
+	if(frame->ownsPixels) {
+		fp_mem_free(frame->pixels);
+	}
+	frame->interned = false;
 	return fp_pool_delete(framePool, id);
 }
 
+bool fp_frame_release(fp_frameid id) {
+	if(id == 0) {
+		return false;
+	}
+
+	fp_frame* frame = fp_pool_get(framePool, id);
+	if(frame == NULL) {
+		return false;
+	}
+
+	if(frame->interned) {
+		/* dedup may be about to retain it */
+		xSemaphoreTake(dedupLock, portMAX_DELAY);
+		bool result = true;
+		if(atomic_fetch_sub_explicit(&frame->refCount, 1, memory_order_acq_rel) == 1) {
+			result = fp_frame_delete(id, frame);
+		}
+		xSemaphoreGive(dedupLock);
+		return result;
+	}
+
+	if(atomic_fetch_sub_explicit(&frame->refCount, 1, memory_order_acq_rel) != 1) {
+		return true;
+	}
+
+	return fp_frame_delete(id, frame);
+}
+
+bool fp_frame_free(fp_frameid id) {
+	return fp_frame_release(id);
+}
+
+static uint32_t fp_frame_hash(fp_frame* frame) {
+	/* FNV-1a over the dimensions and color channels. the unused byte of each pixel is ignored */
+	uint32_t hash = 2166136261u;
+	hash = (hash ^ frame->width) * 16777619u;
+	hash = (hash ^ frame->length) * 16777619u;
+	for(unsigned int i = 0; i < frame->length; i++) {
+		hash = (hash ^ frame->pixels[i].fields.r) * 16777619u;
+		hash = (hash ^ frame->pixels[i].fields.g) * 16777619u;
+		hash = (hash ^ frame->pixels[i].fields.b) * 16777619u;
+	}
+	return hash;
+}
+
+static bool fp_frame_equals(fp_frame* a, fp_frame* b) {
+	if(a->width != b->width || a->length != b->length) {
+		return false;
+	}
+
+	for(unsigned int i = 0; i < a->length; i++) {
+		if(a->pixels[i].fields.r != b->pixels[i].fields.r
+			|| a->pixels[i].fields.g != b->pixels[i].fields.g
+			|| a->pixels[i].fields.b != b->pixels[i].fields.b) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+fp_frameid fp_frame_dedup(fp_frameid id) {
+	fp_frame* frame = fp_frame_get(id);
+	if(id == 0 || frame == NULL) {
+		return 0;
+	}
+
+	if(frame->interned) {
+		return id;
+	}
+
+	uint32_t hash = fp_frame_hash(frame);
+
+	xSemaphoreTake(dedupLock, portMAX_DELAY);
+	dedupStats.framesChecked++;
+
+	/* dedup runs at load time, so a linear scan of the pool is cheap enough */
+	fp_frameid match = 0;
+	for(fp_frameid i = 1; i < framePool->capacity; i++) {
+		if(i == id || !fp_pool_has(framePool, i)) {
+			continue;
+		}
+
+		fp_frame* other = fp_pool_get(framePool, i);
+		if(other->interned && other->hash == hash && fp_frame_equals(frame, other)) {
+			match = i;
+			break;
+		}
+	}
+
+	if(match == 0) {
+		frame->hash = hash;
+		frame->interned = true;
+		xSemaphoreGive(dedupLock);
+		return id;
+	}
+
+	fp_frame* other = fp_pool_get(framePool, match);
+	atomic_fetch_add_explicit(&other->refCount, 1, memory_order_relaxed);
+	dedupStats.framesShared++;
+	if(atomic_load_explicit(&frame->refCount, memory_order_relaxed) == 1) {
+		dedupStats.bytesSaved += frame->length * sizeof(rgb_color);
+	}
+	xSemaphoreGive(dedupLock);
+
+	fp_frame_release(id);
+	return match;
+}
+
+fp_frame_dedup_stats fp_frame_get_dedup_stats() {
+	xSemaphoreTake(dedupLock, portMAX_DELAY);
+	fp_frame_dedup_stats stats = dedupStats;
+	xSemaphoreGive(dedupLock);
+	return stats;
+}
+
 fp_frame* fp_frame_get(fp_frameid id) {
 	return fp_pool_get(framePool, id);
 	/* if(id >= framePoolCount) { */
@@ -131,6 +292,7 @@ bool fp_fset_rect(
 	if(targetFrame == NULL) {
 		return false;
 	}
+	FP_PROFILE_BEGIN_OP("fp_fset_rect");
 
 	for(int row = 0; row < (int)fmin(frame->length / frame->width, fmax(0, targetFrame->length / targetFrame->width - y)); row++) {
 		memcpy(
@@ -140,6 +302,7 @@ bool fp_fset_rect(
 		);
 	}
 
+	FP_PROFILE_END();
 	return true;
 }
 
@@ -156,6 +319,7 @@ bool fp_ffill_rect(
 	if(frame == NULL) {
 		return false;
 	}
+	FP_PROFILE_BEGIN_OP("fp_ffill_rect");
 
 	for(int row = 0; row < fmin(height, fmax(0,frame->length / frame->width - y)); row++) {
 		for(int col = 0; col < fmin(width, fmax(0, frame->width - x)); col++) {
@@ -163,6 +327,7 @@ bool fp_ffill_rect(
 		}
 	}
 
+	FP_PROFILE_END();
 	return true;
 }
 
@@ -177,6 +342,7 @@ bool fp_fset_rect_transparent(
 	if(targetFrame == NULL) {
 		return false;
 	}
+	FP_PROFILE_BEGIN_OP("fp_fset_rect_transparent");
 
 	for(int row = 0; row < fmin(frame->length / frame->width, fmax(0, targetFrame->length / targetFrame->width - y)); row++) {
 		for(int col = 0; col < fmin(frame->width, fmax(0, targetFrame->width - x)); col++) {
@@ -190,6 +356,7 @@ bool fp_fset_rect_transparent(
 		}
 	}
 
+	FP_PROFILE_END();
 	return true;
 }
 
@@ -226,6 +393,7 @@ bool fp_fblend_rect(
 	if(targetFrame == NULL) {
 		return false;
 	}
+	FP_PROFILE_BEGIN_OP("fp_fblend_rect");
 
 	for(int row = 0; row < fmin(frame->length / frame->width, (targetFrame->length / targetFrame->width) - y); row++) {
 		for(int col = 0; col < fmin(frame->width, targetFrame->width - x); col++) {
@@ -239,5 +407,123 @@ bool fp_fblend_rect(
 		}
 	}
 
+	FP_PROFILE_END();
 	return true;
 }
+
+bool fp_fdraw_line(
+	fp_frameid id,
+	int x0,
+	int y0,
+	int x1,
+	int y1,
+	rgb_color color
+) {
+	fp_frame* frame = fp_frame_get(id);
+	if(frame == NULL) {
+		return false;
+	}
+	FP_PROFILE_BEGIN_OP("fp_fdraw_line");
+
+	/* bresenham */
+	int dx = abs(x1 - x0);
+	int dy = -abs(y1 - y0);
+	int stepX = x0 < x1 ? 1 : -1;
+	int stepY = y0 < y1 ? 1 : -1;
+	int error = dx + dy;
+
+	while(true) {
+		if(fp_frame_has_point(frame, x0, y0)) {
+			frame->pixels[fp_fcalc_index(x0, y0, frame->width)] = color;
+		}
+
+		if(x0 == x1 && y0 == y1) {
+			break;
+		}
+
+		int error2 = 2 * error;
+		if(error2 >= dy) {
+			error += dy;
+			x0 += stepX;
+		}
+		if(error2 <= dx) {
+			error += dx;
+			y0 += stepY;
+		}
+	}
+
+	FP_PROFILE_END();
+	return true;
+}
+
+bool fp_fdraw_text(
+	fp_frameid id,
+	int x,
+	int y,
+	const char* text,
+	rgb_color color
+) {
+	fp_frame* frame = fp_frame_get(id);
+	if(frame == NULL) {
+		return false;
+	}
+	FP_PROFILE_BEGIN_OP("fp_fdraw_text");
+
+	int cursorX = x;
+	int cursorY = y;
+	for(const char* c = text; *c != '\0'; c++) {
+		if(*c == '\n') {
+			cursorX = x;
+			cursorY += FP_FONT_HEIGHT + 1;
+			continue;
+		}
+
+		uint16_t glyph = fp_font_glyph(*c);
+		uint16_t mask = 1 << (FP_FONT_WIDTH * FP_FONT_HEIGHT - 1);
+		for(int row = 0; row < FP_FONT_HEIGHT; row++) {
+			for(int col = 0; col < FP_FONT_WIDTH; col++) {
+				if((glyph & mask) && fp_frame_has_point(frame, cursorX + col, cursorY + row)) {
+					frame->pixels[fp_fcalc_index(cursorX + col, cursorY + row, frame->width)] = color;
+				}
+				mask >>= 1;
+			}
+		}
+
+		cursorX += FP_FONT_WIDTH + 1;
+	}
+
+	FP_PROFILE_END();
+	return true;
+}
+
+void fp_span_set(rgb_color* target, const rgb_color* src, unsigned int width) {
+	memcpy(target, src, width * sizeof(rgb_color));
+}
+
+void fp_span_set_transparent(rgb_color* target, const rgb_color* src, unsigned int width) {
+	FP_PROFILE_BEGIN_OP("fp_span_set_transparent");
+	for(unsigned int i = 0; i < width; i++) {
+		if(src[i].fields.b == 0
+			&& src[i].fields.r == 0
+			&& src[i].fields.g == 0) {
+			continue;
+		}
+		target[i] = src[i];
+	}
+	FP_PROFILE_END();
+}
+
+void fp_span_blend(
+	blend_fn blendFn,
+	rgb_color* target,
+	uint8_t alphaTarget,
+	const rgb_color* src,
+	uint8_t alphaSrc,
+	unsigned int width
+) {
+	FP_PROFILE_BEGIN_OP("fp_span_blend");
+	for(unsigned int i = 0; i < width; i++) {
+		target[i] = (*blendFn)(src[i], alphaSrc, target[i], alphaTarget);
+	}
+	FP_PROFILE_END();
+}
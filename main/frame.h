@@ -2,30 +2,62 @@
 #define FRAME_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 #include "color.h"
 
 /* fp: fresh pixel */
 
-/* A frame is buffer storing color information for a 2D frame. */
+/* A frame is buffer storing color information for a 2D frame.
+ * frames are reference counted. fp_frame_create returns a frame with one reference, owned by the caller */
 typedef struct {
 	/* length of "pixels" buffer */
 	unsigned int length;
 	/* width of the 2D frame in pixels */
 	unsigned int width;
 	rgb_color* pixels;
+	/* false if pixels belong to someone else (e.g. an arena), and must not be freed with the frame */
+	bool ownsPixels;
+	atomic_uint refCount;
+	/* set by fp_frame_dedup. the pixels may be shared by several owners and must not be modified */
+	bool interned;
+	uint32_t hash;
 } fp_frame;
 
 typedef unsigned int fp_frameid;
 
+typedef struct {
+	unsigned int framesChecked;
+	/* frames replaced by an identical interned frame */
+	unsigned int framesShared;
+	/* pixel memory released by sharing */
+	size_t bytesSaved;
+} fp_frame_dedup_stats;
+
 bool fp_frame_init(unsigned int capacity);
 
 /* creates a frame with given width and height, and returns its id
  * if the frame could not be created, returns id 0, which points to the NULL frame (all fields 0) */
 fp_frameid fp_frame_create(unsigned int width, unsigned int height, rgb_color color);
-
+/* creates a frame over an existing buffer of width*height pixels. the buffer must outlive the frame */
+fp_frameid fp_frame_create_from_buffer(unsigned int width, unsigned int height, rgb_color* pixels);
+
+/** adds a reference to the frame. returns id */
+fp_frameid fp_frame_retain(fp_frameid id);
+/** drops a reference. the frame is freed when the last reference is released */
+bool fp_frame_release(fp_frameid id);
+/** same as fp_frame_release */
 bool fp_frame_free(fp_frameid frame);
 
+/** content-hash deduplication, for frames that won't be modified again (e.g. baked animations).
+ * if an interned frame has identical pixels, releases id and returns a new reference to the interned frame.
+ * otherwise interns id and returns it. in both cases the returned frame must be treated as read-only */
+fp_frameid fp_frame_dedup(fp_frameid id);
+/** totals since boot */
+fp_frame_dedup_stats fp_frame_get_dedup_stats();
+
 /* retrieve the frame. if there is no frame with the id, returns the NULL frame (all values 0)
  * only use if you cannot achieve what you need with the other commands */
 fp_frame* fp_frame_get(fp_frameid id);
@@ -101,4 +133,37 @@ bool fp_fblend_rect(
 
 );
 
+/** draws a 1 pixel line from (x0, y0) to (x1, y1), inclusive. pixels outside the frame are clipped */
+bool fp_fdraw_line(
+	fp_frameid id,
+	int x0,
+	int y0,
+	int x1,
+	int y1,
+	rgb_color color
+);
+
+/** draws text with the 3x5 font (see font.h), with 1 pixel between characters. '\n' starts a new line */
+bool fp_fdraw_text(
+	fp_frameid id,
+	int x,
+	int y,
+	const char* text,
+	rgb_color color
+);
+
+/* span operations combine a single row of "width" pixels from src into target.
+ * used to composite views that are read one span at a time (see fp_view_get_span) */
+void fp_span_set(rgb_color* target, const rgb_color* src, unsigned int width);
+/** ignores 0,0,0 colors */
+void fp_span_set_transparent(rgb_color* target, const rgb_color* src, unsigned int width);
+void fp_span_blend(
+	blend_fn blendFn,
+	rgb_color* target,
+	uint8_t alphaTarget,
+	const rgb_color* src,
+	uint8_t alphaSrc,
+	unsigned int width
+);
+
 #endif /* FRAME_H */
@@ -1,2 +1,4 @@
 #define DEBUG
+/* per-view render profiler, see profile.h */
+/* #define FP_PROFILE */
 #define FP_INDEX_ZIGZAG
@@ -10,13 +10,15 @@
 #include "esp_system.h"
 #include "esp_spi_flash.h"
 #include "esp_chip_info.h"
-#include "esp_random.h"
 
 /* #include "nvs_flash.h" */
 /* #include "nvs.h" */
 #include "esp_spiffs.h"
 
 #include "esp_err.h"
+#ifdef CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
 
 #include "driver/gpio.h"
 
@@ -26,8 +28,23 @@
 #include "ws2812_control.h"
 #include "color.h"
 #include "frame.h"
+#include "draw.h"
 #include "render.h"
+#include "display-list.h"
+#include "pipeline.h"
+#include "scene.h"
+#include "scene-file.h"
 #include "ppm.h"
+#include "console.h"
+#include "trace.h"
+#include "telemetry.h"
+#include "output.h"
+#include "capture.h"
+#include "budget.h"
+#include "rand.h"
+#include "fixed.h"
+#include "effects.h"
+#include "mem.h"
 
 #include "input.h"
 #include "input/button.h"
@@ -40,12 +57,19 @@
 #include "views/layer-view.h"
 #include "views/transition-view.h"
 #include "views/dynamic-view.h"
+#include "views/procedural-view.h"
+#include "views/particle-view.h"
+#include "profile.h"
 
 #define LED_QUEUE_LENGTH 16 
 
 #define SCREEN_WIDTH 8
 #define SCREEN_HEIGHT 8
 
+/* heap the prebuilt demos may use */
+#define DEMO_MEMORY_BUDGET (32*1024)
+#define DEMO_CROSSFADE_MS 250
+
 #define GPIO_INPUT_PIN_0 19
 #define GPIO_INPUT_PIN_1 21
 #define GPIO_INPUT_PIN_2 3
@@ -57,10 +81,12 @@ void init_gpio_test();
 
 typedef struct {
 	fp_viewid (*init_mode) (void**);
-	bool (*free_mode) (fp_view*, void**);
-	void (*onrotate_mode) (fp_view*, fp_rotary_encoder*);
-	void (*onbutton_mode) (fp_view*, fp_button*);
-	fp_viewid view;
+	bool (*free_mode) (void**);
+	/* input handlers run on the render task, with the root view of the demo's scene while it is current.
+	 * steps is positive clockwise */
+	void (*onrotate_mode) (fp_view*, int steps);
+	void (*onbutton_mode) (fp_view*);
+	/* initial scene data */
 	void* data;
 } demo_mode;
 
@@ -80,10 +106,18 @@ fp_viewid frame_view_demo_init(void** data) {
 	return frameView;
 }
 
-bool frame_view_demo_free(fp_view* view, void** data) {
+bool frame_view_demo_free(void** data) {
 	return true;
 }
 
+typedef struct {
+	TickType_t lastDrop;
+	fp_rand rand;
+} rain_state;
+
+#define RAIN_RAND_STREAM 1
+#define MAZE_RAND_STREAM 2
+
 bool dynamic_view_demo_render(fp_view* view) {
 	fp_dynamic_view_data* dynamicData = view->data;
 	fp_frame* frame = fp_frame_get(dynamicData->frame);
@@ -91,9 +125,9 @@ bool dynamic_view_demo_render(fp_view* view) {
 	for(int i = 0; i < SCREEN_WIDTH; i++) {
 		for(int j = 0; j < SCREEN_HEIGHT; j++) {
 			rgb_color color = frame->pixels[fp_fcalc_index(i, j, frame->width)];
-			color.fields.r = (int)fmax(color.fields.r-1, 0);
-			color.fields.g = (int)fmax(color.fields.g-1, 0); 
-			color.fields.b = (int)fmax(color.fields.b-1, 0);
+			color.fields.r = FP_QSUB8(color.fields.r, 1);
+			color.fields.g = FP_QSUB8(color.fields.g, 1);
+			color.fields.b = FP_QSUB8(color.fields.b, 1);
 			/*
 			if(color.fields.r == 0
 				&& color.fields.g == 0
@@ -107,12 +141,13 @@ bool dynamic_view_demo_render(fp_view* view) {
 	}
 
 	/** raindrop */
-	TickType_t* lastDrop = dynamicData->data;
+	rain_state* rain = dynamicData->data;
+	fp_rand_sync(&rain->rand);
 	TickType_t currentTick = xTaskGetTickCount();
-	if(currentTick > *lastDrop + pdMS_TO_TICKS(100)) {
-		rgb_color color = {.bits = esp_random()};
-		frame->pixels[esp_random() % frame->length] = color;
-		*lastDrop = currentTick;
+	if(currentTick > rain->lastDrop + pdMS_TO_TICKS(100)) {
+		rgb_color color = {.bits = fp_rand_next(&rain->rand)};
+		frame->pixels[fp_rand_range(&rain->rand, frame->length)] = color;
+		rain->lastDrop = currentTick;
 	}
 
 	return true;
@@ -121,10 +156,18 @@ bool dynamic_view_demo_render(fp_view* view) {
 	/* frame->pixels[0] */
 }
 
+bool dynamic_view_demo_onnext_render(fp_view* view) {
+	/* the fade runs every frame, keep a render queued */
+	return fp_queue_render(view->id, xTaskGetTickCount() + pdMS_TO_TICKS(16));
+}
+
 fp_viewid dynamic_view_demo_init(void** data) {
-	TickType_t* lastDrop = malloc(sizeof(TickType_t));
-	*lastDrop = xTaskGetTickCount();
-	fp_viewid dynamicView = fp_dynamic_view_create(SCREEN_WIDTH, SCREEN_HEIGHT, dynamic_view_demo_render, NULL, lastDrop);
+	rain_state* rain = fp_mem_alloc(FP_MEM_APP, sizeof(rain_state));
+	rain->lastDrop = xTaskGetTickCount();
+	fp_rand_seed(&rain->rand, RAIN_RAND_STREAM);
+	fp_viewid dynamicView = fp_dynamic_view_create(SCREEN_WIDTH, SCREEN_HEIGHT, dynamic_view_demo_render, dynamic_view_demo_onnext_render, rain);
+	*data = rain;
+	fp_queue_render(dynamicView, xTaskGetTickCount());
 	/* fp_frameid frameId = fp_view_get_frame(dynamicView); */
 
 	/** init with noisy pattern */
@@ -140,10 +183,8 @@ fp_viewid dynamic_view_demo_init(void** data) {
 	return dynamicView;
 }
 
-bool dynamic_view_demo_free(fp_view* view, void** data) {
-	fp_dynamic_view_data* viewData = view->data;
-	TickType_t* lastDrop = viewData->data;
-	free(lastDrop);
+bool dynamic_view_demo_free(void** data) {
+	fp_mem_free(*data);
 	return true;
 }
 
@@ -170,7 +211,7 @@ fp_viewid animation_view_demo_init(void** data) {
 	return animViewId;
 }
 
-bool animation_view_demo_free(fp_view* view, void** data) {
+bool animation_view_demo_free(void** data) {
 	return true;
 }
 
@@ -199,7 +240,7 @@ fp_viewid layer_view_demo_init(void** data) {
 	return layerViewId;
 }
 
-bool layer_view_demo_free(fp_view* view, void** data) {
+bool layer_view_demo_free(void** data) {
 	return true;
 }
 
@@ -259,47 +300,10 @@ fp_viewid layer_view_alpha_demo_init(void** data) {
 	return layerViewId;
 }
 
-bool layer_view_alpha_demo_free(fp_view* view, void** data) {
+bool layer_view_alpha_demo_free(void** data) {
 	return true;
 }
 
-void draw_arc_filled(fp_frameid id, int centerX, int centerY, int radius, float startTheta, float endTheta, rgb_color color) {
-	if(endTheta - startTheta >= M_PI) {
-		// can't deal with large angles
-		float centerAngle = (endTheta - startTheta)/2.0f + startTheta;
-		draw_arc_filled(id, centerX, centerY, radius, startTheta, centerAngle, color);
-		draw_arc_filled(id, centerX, centerY, radius, centerAngle, endTheta, color);
-		return;
-	}
-
-	/* normal vectors for each angle */
-	float startNormalX = radius * sin(startTheta + M_PI_2);
-	float startNormalY = radius * cos(startTheta + M_PI_2);
-
-	float endNormalX = radius * sin(endTheta - M_PI_2);
-	float endNormalY = radius * cos(endTheta - M_PI_2);
-
-	/* reduce the radius threshold to make the circle appear rounder for small values */
-	float radiusModifier = 0.7f;
-
-	/* just check every pixel in the enclosing rectangle and set the appropriate pixels */
-	for(int y = -radius; y <= radius; y++) {
-		for(int x = -radius; x <= radius; x++) {
-			if(x*x + y*y < radius*radius * radiusModifier) {
-				// in circle
-				if(// check if clockwise from start
-					-startNormalX*y + startNormalY*x > 0 &&
-					// check counterclockwise from end
-					-endNormalX*y + endNormalY*x < 0) {
-					/* true) { */
-
-					fp_fset(id, centerX + x, centerY + y, color);
-				}
-			}
-		}
-	}
-}
-
 fp_viewid spinning_ball_demo_init(void** data) {
 	rgb_color colors[] = {
 		rgb(255, 0, 0),
@@ -308,18 +312,20 @@ fp_viewid spinning_ball_demo_init(void** data) {
 		rgb(255, 255, 0),
 		rgb(255, 0, 255),
 	};
-	float angle = 2.0*M_PI/5.0;
+	uint16_t slice = FP_DRAW_TURN / 5;
 
 	unsigned int frameCount = 30;
 	fp_viewid animViewId = fp_anim_view_create(8, 8, frameCount, 1000/30);
 	fp_view* animView = fp_view_get(animViewId);
 	fp_anim_view_data* animData = animView->data;
 
-	float angleOffset = 2.0f*M_PI / animData->frameCount;
+	uint16_t angleOffset = FP_DRAW_TURN / animData->frameCount;
 
+	/* the first slice starts centered at the top. slices go counterclockwise, and so does the spin */
 	for(int i = 0; i < animData->frameCount; i++) {
 		for(int j = 0; j < 5; j++) {
-			draw_arc_filled(fp_view_get_frame(animData->frames[i]), 3, 3, 4, j*angle + i*angleOffset, (j+1)*angle + i*angleOffset, colors[j]);
+			uint16_t startAngle = FP_DRAW_TURN * 3 / 4 - slice / 2 - j * slice - i * angleOffset;
+			fp_ffill_pie(fp_view_get_frame(animData->frames[i]), 3, 3, 3, startAngle, slice, colors[j]);
 		}
 	}
 
@@ -332,6 +338,9 @@ fp_viewid spinning_ball_demo_init(void** data) {
 	};
 
 	fp_viewid layerViewId = fp_layer_view_create_composite(8, 8, layers, 5);
+	for(int i = 0; i < 5; i++) {
+		fp_view_release(layers[i]);
+	}
 	fp_view* layerView = fp_view_get(layerViewId);
 
 	fp_layer_view_data* layerData = layerView->data;
@@ -357,11 +366,7 @@ fp_viewid spinning_ball_demo_init(void** data) {
 	return layerViewId;
 }
 
-bool spinning_ball_demo_free(fp_view* view, void** data) {
-	fp_layer_view_data* layerData = view->data;
-	for(int i = 0; i < layerData->layerCount; i++) {
-		fp_view_free(layerData->layers[i].view);
-	}
+bool spinning_ball_demo_free(void** data) {
 	return true;
 }
 
@@ -441,7 +446,8 @@ fp_viewid animated_layer_view_demo_init(void** data) {
 			rgb(brightness, brightness, brightness)
 		);
 	}
-
+	/* the fade is symmetric, so the second half repeats the first */
+	fp_anim_view_dedup(animViewIds[4]);
 
 
 	fp_viewid layerViews[] = {
@@ -459,7 +465,16 @@ fp_viewid animated_layer_view_demo_init(void** data) {
 	fp_anim_play(animViewIds[4]);
 
 
+	/* under load the quadrants update at half rate, and the mask is dropped first */
+	for(int i = 0; i < layerCount - 1; i++) {
+		fp_budget_register(animViewIds[i], 1, FP_VIEW_DEGRADE_HALF_RATE);
+	}
+	fp_budget_register(animViewIds[4], 0, FP_VIEW_DEGRADE_SKIP);
+
 	fp_viewid layerViewId = fp_layer_view_create_composite(8, 8, layerViews, layerCount);
+	for(int i = 0; i < layerCount; i++) {
+		fp_view_release(layerViews[i]);
+	}
 
 	fp_view* layerView = fp_view_get(layerViewId);
 	fp_layer_view_data* layerData = layerView->data;
@@ -481,11 +496,7 @@ fp_viewid animated_layer_view_demo_init(void** data) {
 
 }
 
-bool animated_layer_view_demo_free(fp_view* view, void** data) {
-	fp_layer_view_data* layerData = view->data;
-	for(int i = 0; i < layerData->layerCount; i++) {
-		fp_view_free(layerData->layers[i].view);
-	}
+bool animated_layer_view_demo_free(void** data) {
 	return true;
 }
 
@@ -494,6 +505,8 @@ fp_viewid transition_view_demo_init(void** data) {
 
 	fp_transition transition = fp_create_sliding_transition(8, 8, 1000/8);
 	fp_viewid transitionViewId = fp_create_transition_view(8, 8, pageCount, transition, 2000);
+	fp_view_release(transition.viewA);
+	fp_view_release(transition.viewB);
 	fp_view* transitionView = fp_view_get(transitionViewId);
 	fp_transition_view_data* transitionData = transitionView->data;
 
@@ -516,10 +529,7 @@ fp_viewid transition_view_demo_init(void** data) {
 	return transitionViewId;
 }
 
-bool transition_view_demo_free(fp_view* view, void** data) {
-	fp_transition_view_data* transitionData = view->data;
-	fp_view_free(transitionData->transition.viewA);
-	fp_view_free(transitionData->transition.viewB);
+bool transition_view_demo_free(void** data) {
 	return true;
 }
 
@@ -559,34 +569,30 @@ fp_viewid animated_transition_view_demo_init(void** data) {
 
 	fp_transition transition = fp_create_sliding_transition(8, 8, 1000/8);
 	fp_viewid transitionViewId = fp_create_transition_view_composite(8, 8, pageViews, pageCount, transition, 2000);
+	fp_view_release(transition.viewA);
+	fp_view_release(transition.viewB);
+	for(int i = 0; i < pageCount; i++) {
+		fp_view_release(pageViews[i]);
+	}
 
 	fp_transition_loop(transitionViewId, false);
 
 	return transitionViewId;
 }
 
-bool animated_transition_view_demo_free(fp_view* view, void** data) {
-	fp_transition_view_data* transitionData = view->data;
-
-	fp_view_free(transitionData->transition.viewA);
-	fp_view_free(transitionData->transition.viewB);
-
-	for(int i = 0; i < transitionData->pageCount; i++) {
-		fp_view_free(transitionData->pages[i]);
-	}
-
+bool animated_transition_view_demo_free(void** data) {
 	return true;
 }
 
 fp_viewid ppm_image_demo_init(void** data) {
 	fp_frameid frame = fp_ppm_load_image("/spiffs/test-pat.ppm");
 	fp_viewid view = fp_frame_view_create_composite(frame);
-	fp_view_get(view)->composite = false; // when the view is free it will automatically free the frame
+	fp_frame_release(frame); // the view holds the only reference, and frees the frame with it
 
 	return view;
 }
 	
-bool ppm_image_demo_free(fp_view* view, void** data) {
+bool ppm_image_demo_free(void** data) {
 	return true;
 }
 
@@ -620,12 +626,12 @@ unsigned int maze_opposite(unsigned int direction) {
 
 unsigned int MAZE_DIRECTIONS[] = { MAZE_N, MAZE_E, MAZE_S, MAZE_W };
 
-void maze_carve_passages(fp_frame* frame, unsigned int x,unsigned int y) {
+void maze_carve_passages(fp_frame* frame, unsigned int x,unsigned int y, fp_rand* rand) {
 
 	unsigned int directions[] = { MAZE_N, MAZE_E, MAZE_S, MAZE_W };
 	// shuffle
 	for(int i = 3; i >= 0; i--) {
-		unsigned int target = esp_random() % (i+1); /* not very random */
+		unsigned int target = fp_rand_range(rand, i+1);
 
 		unsigned int temp = directions[i];
 		directions[i] = directions[target];
@@ -644,7 +650,7 @@ void maze_carve_passages(fp_frame* frame, unsigned int x,unsigned int y) {
 			frame->pixels[fp_fcalc_index(x, y, frame->width)].bits |= direction;
 			frame->pixels[nextIndex].bits |= oppositeDirection;
 
-			maze_carve_passages(frame, nextX, nextY);
+			maze_carve_passages(frame, nextX, nextY, rand);
 		}
 	}
 }
@@ -660,6 +666,7 @@ typedef struct {
 	unsigned int lastDirection;
 	unsigned int autostepPeriodMs;
 	TickType_t lastStepTick;
+	fp_rand rand;
 } maze_state;
 
 bool maze_step(maze_state* maze, unsigned int direction) {
@@ -678,7 +685,7 @@ bool maze_step(maze_state* maze, unsigned int direction) {
 		if(maze->x == maze->exitX && maze->y == maze->exitY) {
 			printf("you win!\n");
 			fp_ffill_rect(maze->maze, 0, 0, mazeFrame->width, fp_frame_height(mazeFrame), rgb(0,0,0));
-			maze_carve_passages(mazeFrame, maze->x, maze->y);
+			maze_carve_passages(mazeFrame, maze->x, maze->y, &maze->rand);
 
 			if(maze->exitX == 0) {
 				maze->exitX = mazeFrame->width - 1;
@@ -701,8 +708,29 @@ bool maze_step(maze_state* maze, unsigned int direction) {
 	return false;
 }
 
+/* carves a new maze and starts over in the corner */
+void maze_reset(maze_state* maze) {
+	fp_frame* mazeFrame = fp_frame_get(maze->maze);
+	fp_ffill_rect(maze->maze, 0, 0, mazeFrame->width, fp_frame_height(mazeFrame), rgb(0,0,0));
+	maze_carve_passages(mazeFrame, 0, 0, &maze->rand);
+
+	maze->x = 0;
+	maze->y = 0;
+	maze->lastDirection = MAZE_N;
+	maze->exitX = mazeFrame->width - 1;
+	maze->exitY = fp_frame_height(mazeFrame) - 1;
+}
+
+/* the global seed changed. start a maze that repeats with it */
+void maze_sync(maze_state* maze) {
+	if(fp_rand_sync(&maze->rand)) {
+		maze_reset(maze);
+	}
+}
+
 // take a step forward following the right wall
 void maze_step_next(maze_state* maze) {
+	maze_sync(maze);
 	// try to step to the right
 	// clockwise and counter-clockwise are inverted??
 	unsigned int direction = maze_rotate_ccw(maze->lastDirection);
@@ -716,6 +744,7 @@ void maze_step_next(maze_state* maze) {
 }
 
 void maze_step_prev(maze_state* maze) {
+	maze_sync(maze);
 	unsigned int direction = maze_rotate_cw(maze_opposite(maze->lastDirection));
 	do {
 		if(maze_step(maze, direction)) {
@@ -733,16 +762,7 @@ bool maze_render(fp_view* view) {
 	maze_state* maze = viewData->data;
 	fp_frame* mazeFrame = fp_frame_get(maze->maze);
 
-	if(maze->autostepPeriodMs > 0) {
-		TickType_t lastStepTick = maze->lastStepTick;
-		TickType_t currentTick = xTaskGetTickCount();
-
-		if(currentTick > lastStepTick + pdMS_TO_TICKS(maze->autostepPeriodMs)) {
-			maze_step_next(maze);
-			maze->lastStepTick = currentTick;
-		}
-	}
-
+	maze_sync(maze);
 
 	fp_ffill_rect(viewData->frame, 0, 0, viewFrame->width, fp_frame_height(viewFrame), rgb(0,0,0));
 
@@ -850,12 +870,27 @@ bool maze_render(fp_view* view) {
 	return true;
 }
 
+bool maze_onnext_render(fp_view* view) {
+	fp_dynamic_view_data* viewData = view->data;
+	maze_state* maze = viewData->data;
+
+	if(maze->autostepPeriodMs == 0) {
+		return true;
+	}
+
+	maze_step_next(maze);
+	maze->lastStepTick = xTaskGetTickCount();
+	return fp_queue_render(view->id, maze->lastStepTick + pdMS_TO_TICKS(maze->autostepPeriodMs));
+}
+
 fp_viewid maze_demo_init(void** data) {
 	fp_frameid maze = fp_frame_create(SCREEN_WIDTH, SCREEN_HEIGHT, rgb(0, 0, 0));
 	fp_frame* mazeFrame = fp_frame_get(maze);
-	maze_carve_passages(mazeFrame, 0, 0);
 
-	maze_state* state = malloc(sizeof(maze_state));
+	maze_state* state = fp_mem_alloc(FP_MEM_APP, sizeof(maze_state));
+	*data = state;
+	fp_rand_seed(&state->rand, MAZE_RAND_STREAM);
+	maze_carve_passages(mazeFrame, 0, 0, &state->rand);
 
 	state->x = 0;
 	state->y = 0;
@@ -866,26 +901,28 @@ fp_viewid maze_demo_init(void** data) {
 	state->exitX = SCREEN_WIDTH-1;
 	state->exitY = SCREEN_HEIGHT-1;
 
-	fp_viewid view = fp_dynamic_view_create(SCREEN_WIDTH, SCREEN_HEIGHT, &maze_render, NULL, state);
+	fp_viewid view = fp_dynamic_view_create(SCREEN_WIDTH, SCREEN_HEIGHT, &maze_render, &maze_onnext_render, state);
+	fp_queue_render(view, state->lastStepTick + pdMS_TO_TICKS(state->autostepPeriodMs));
 
 	return view;
 
 }
 	
-bool maze_demo_free(fp_view* view, void** data) {
-	fp_dynamic_view_data* viewData = view->data;
-	maze_state* maze = viewData->data;
+bool maze_demo_free(void** data) {
+	maze_state* maze = *data;
 	fp_frame_free(maze->maze);
-	free(maze);
+	fp_mem_free(maze);
 	return true;
 }
 
 fp_viewid maze_interactive_demo_init(void** data) {
 	fp_frameid maze = fp_frame_create(SCREEN_WIDTH, SCREEN_HEIGHT, rgb(0, 0, 0));
 	fp_frame* mazeFrame = fp_frame_get(maze);
-	maze_carve_passages(mazeFrame, 0, 0);
 
-	maze_state* state = malloc(sizeof(maze_state));
+	maze_state* state = fp_mem_alloc(FP_MEM_APP, sizeof(maze_state));
+	*data = state;
+	fp_rand_seed(&state->rand, MAZE_RAND_STREAM);
+	maze_carve_passages(mazeFrame, 0, 0, &state->rand);
 
 	state->x = 0;
 	state->y = 0;
@@ -902,198 +939,234 @@ fp_viewid maze_interactive_demo_init(void** data) {
 
 }
 	
-bool maze_interactive_demo_free(fp_view* view, void** data) {
-	fp_dynamic_view_data* viewData = view->data;
-	maze_state* maze = viewData->data;
+bool maze_interactive_demo_free(void** data) {
+	maze_state* maze = *data;
 	fp_frame_free(maze->maze);
-	free(maze);
+	fp_mem_free(maze);
 	return true;
 }
 
-void maze_interactive_demo_onrotate(fp_view* view, fp_rotary_encoder* re) {
+void maze_interactive_demo_onrotate(fp_view* view, int steps) {
 	fp_dynamic_view_data* viewData = view->data;
 
 	maze_state* maze = viewData->data;
 
-	if(re->lastDirectionCw) {
-		maze_step_next(maze);
-	}
-	else {
-		maze_step_prev(maze);
+	for(int i = 0; i < abs(steps); i++) {
+		if(steps > 0) {
+			maze_step_next(maze);
+		}
+		else {
+			maze_step_prev(maze);
+		}
 	}
+
+	fp_view_mark_dirty(view->id);
+}
+
+void maze_interactive_demo_onbutton(fp_view* view) {
+}
+
+fp_viewid particle_rain_demo_init(void** data) {
+	fp_viewid view = fp_particle_view_create(SCREEN_WIDTH, SCREEN_HEIGHT, 256, 1000/60);
+	fp_particle_emitter drops = {
+		0, -1 << 16, SCREEN_WIDTH << 16, 0,
+		12, 0, 0,
+		64, 4,
+		4 << 8, 8 << 8,
+		1500, 2500,
+		{ .fields = { 255, 0, 64 } },
+		false
+	};
+	fp_particle_view_add_emitter(view, &drops);
+	/* falling drops leave short streaks */
+	fp_particle_view_set_forces(view, 0, 16 << 8, 0, 160);
+	return view;
+}
+
+bool particle_rain_demo_free(void** data) {
+	return true;
+}
+
+fp_viewid fireworks_demo_init(void** data) {
+	fp_viewid view = fp_particle_view_create(SCREEN_WIDTH, SCREEN_HEIGHT, 512, 1000/60);
+	fp_particle_emitter shells = {
+		1 << 16, 1 << 16, (SCREEN_WIDTH - 2) << 16, (SCREEN_HEIGHT / 2) << 16,
+		0, 48, 900,
+		0, 128,
+		2 << 8, 10 << 8,
+		600, 1200,
+		{ .bits = 0 },
+		true
+	};
+	fp_particle_view_add_emitter(view, &shells);
+	fp_particle_view_set_forces(view, 0, 6 << 8, 64, 96);
+	return view;
 }
 
-void maze_interactive_demo_onbutton(fp_button* button) {
+bool fireworks_demo_free(void** data) {
+	return true;
+}
+
+/* scene data is the effect type */
+fp_viewid effect_demo_init(void** data) {
+	const fp_effect_type* type = *data;
+	return fp_effect_create(*type, SCREEN_WIDTH, SCREEN_HEIGHT, NULL);
+}
+
+bool effect_demo_free(void** data) {
+	/* the effect's state is freed with its view */
+	return true;
 }
 
+const fp_effect_type plasmaEffect = FP_EFFECT_PLASMA;
+const fp_effect_type fireEffect = FP_EFFECT_FIRE;
+const fp_effect_type noiseEffect = FP_EFFECT_NOISE;
+const fp_effect_type radialGradientEffect = FP_EFFECT_RADIAL_GRADIENT;
+const fp_effect_type colorWavesEffect = FP_EFFECT_COLOR_WAVES;
+
+fp_scene_file layersSceneFile = { "/spiffs/layers.fps", NULL, 0 };
+
 demo_mode demos[] = {{
 	&frame_view_demo_init,
 	&frame_view_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&dynamic_view_demo_init,
 	&dynamic_view_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&animation_view_demo_init,
 	&animation_view_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&layer_view_demo_init,
 	&layer_view_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&layer_view_alpha_demo_init,
 	&layer_view_alpha_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&spinning_ball_demo_init,
 	&spinning_ball_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&animated_layer_view_demo_init,
 	&animated_layer_view_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&transition_view_demo_init,
 	&transition_view_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&animated_transition_view_demo_init,
 	&animated_transition_view_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&ppm_image_demo_init,
 	&ppm_image_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&maze_demo_init,
 	&maze_demo_free,
 	NULL,
-	NULL,
-	0,
 	NULL
 }, {
 	&maze_interactive_demo_init,
 	&maze_interactive_demo_free,
 	&maze_interactive_demo_onrotate,
+	NULL
+}, {
+	&particle_rain_demo_init,
+	&particle_rain_demo_free,
+	NULL,
+	NULL
+}, {
+	&fireworks_demo_init,
+	&fireworks_demo_free,
 	NULL,
-	0,
 	NULL
+}, {
+	&effect_demo_init,
+	&effect_demo_free,
+	NULL,
+	NULL,
+	(void*)&plasmaEffect
+}, {
+	&effect_demo_init,
+	&effect_demo_free,
+	NULL,
+	NULL,
+	(void*)&fireEffect
+}, {
+	&effect_demo_init,
+	&effect_demo_free,
+	NULL,
+	NULL,
+	(void*)&noiseEffect
+}, {
+	&effect_demo_init,
+	&effect_demo_free,
+	NULL,
+	NULL,
+	(void*)&radialGradientEffect
+}, {
+	&effect_demo_init,
+	&effect_demo_free,
+	NULL,
+	NULL,
+	(void*)&colorWavesEffect
+}, {
+	/* compiled from scenes/layers.scene, see tools/scene_compiler.py */
+	&fp_scene_file_init,
+	&fp_scene_file_free,
+	NULL,
+	NULL,
+	&layersSceneFile
 }};
 
 const unsigned int DEMO_COUNT = sizeof(demos) / sizeof(demo_mode);
 
-demo_mode* currentDemo = NULL;
+fp_scene scenes[sizeof(demos) / sizeof(demo_mode)];
+fp_scene_manager* sceneManager = NULL;
+/* render task commands */
+fp_ring* commandQueue = NULL;
 unsigned int demoIndex = 0;
 
-bool demo_select_render(fp_view* view) {
-	fp_dynamic_view_data* dynamicData = view->data;
-	fp_frame* frame = fp_frame_get(dynamicData->frame);
-
-	if(dynamicData->data == false && currentDemo != NULL && currentDemo->view != 0) {
-		fp_fset_rect(dynamicData->frame, 0, 0, fp_frame_get(fp_view_get_frame(currentDemo->view)));
-		return true;
+/** shown while a demo is still building */
+bool demo_static_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	/* draw static. one step of the render task's stream makes 4 pixels */
+	fp_rand* rand = fp_rand_task();
+	if(!rand) {
+		return false;
 	}
 
-	/* draw static */
-	for(int i = 0; i < SCREEN_WIDTH; i++) {
-		for(int j = 0; j < SCREEN_HEIGHT; j++) {
-			/* uint8_t value = fp_fcalc_index(i, j, frame->width) * 255 / frame->length; */
-			// r skews toward center. we take the inverse to get a distribution with more extreme values
-			/* float r = (((uint8_t)esp_random()/255.0)+((uint8_t)esp_random()/255.0)+((uint8_t)esp_random()/255.0))/3.0; */
-			/* uint8_t value = gamma8[(uint8_t)((1.0-r)*255)];// % 100; */
-			uint8_t value = gamma8[(uint8_t)esp_random()];// % 100;
-			/* uint8_t value = gamma8[(esp_random()%4)*(255/4)]; */
-			frame->pixels[fp_fcalc_index(i, j, frame->width)] = rgb(value, value, value);
-		}
+	uint8_t noise[width];
+	fp_rand_fill(rand, noise, width);
+	for(unsigned int i = 0; i < width; i++) {
+		/* uint8_t value = fp_fcalc_index(i, j, frame->width) * 255 / frame->length; */
+		// r skews toward center. we take the inverse to get a distribution with more extreme values
+		/* float r = (((uint8_t)esp_random()/255.0)+((uint8_t)esp_random()/255.0)+((uint8_t)esp_random()/255.0))/3.0; */
+		/* uint8_t value = gamma8[(uint8_t)((1.0-r)*255)];// % 100; */
+		uint8_t value = gamma8[noise[i]];// % 100;
+		/* uint8_t value = gamma8[(esp_random()%4)*(255/4)]; */
+		out[i] = rgb(value, value, value);
 	}
 	return true;
 }
 
-bool demo_select_onnext_render(fp_view* view) {
-	fp_dynamic_view_data* dynamicData = view->data;
-	dynamicData->data = false; /* don't show static */
-
-	return true;
-}
-
-SemaphoreHandle_t ledRenderLock = NULL;
-
-fp_viewid play_demo(fp_viewid selectViewId, demo_mode* demo) {
-	fp_view* selectView = fp_view_get(selectViewId);
-	fp_dynamic_view_data* dynamicData = selectView->data;
-	dynamicData->data = (void*)true;
-
-
-	TickType_t startTick = xTaskGetTickCount();
-
-	if(currentDemo != NULL) {
-		xSemaphoreTake(ledRenderLock, portMAX_DELAY);
-
-		/* reset any pending renders initialized by the previous demo */
-		fp_queue_reset();
-
-		demo_mode* lastDemo = currentDemo;
-		/* clear current demo to prevent trying to render from it while it's freeing */
-		currentDemo = NULL;
-
-		xSemaphoreGive(ledRenderLock);
-		/* the last render should be finished, so we can free memory now that the current demo is cleared */
-
-		lastDemo->free_mode(fp_view_get(lastDemo->view), &lastDemo->data);
-		if(lastDemo->view != 0) {
-			if(fp_view_free(lastDemo->view)) {
-				lastDemo->view = 0;
-			}
-		}
-	}
-
-	fp_viewid view = demo->init_mode(&demo->data);
-	fp_view* demoView = fp_view_get(view);
-
-	demoView->parent = selectViewId;
-
-	currentDemo = demo;
-	currentDemo->view = view;
-
-
-
-	TickType_t loadedTick = xTaskGetTickCount();
-	fp_queue_render(selectViewId, fmax(startTick + pdMS_TO_TICKS(300), loadedTick));
-
-	return view;
-}
+/* held by the pipeline output stage while transmitting */
+SemaphoreHandle_t ledOutputLock = NULL;
 
 static xQueueHandle demoQueue = NULL;
 
@@ -1119,28 +1192,65 @@ void select_demo(fp_rotary_encoder* re) {
 		index = abs(re->position) % DEMO_COUNT;
 	}
 
-	/* queue the demo set on the main task, since free/init may take awhile */
+	/* queue the switch on the main task, the input task shouldn't wait on the scene manager's lock */
 	if(xQueueSend(demoQueue, &index, 0) != pdPASS) {
 			printf("failed to queue next demo\n");
 	}
 }
 
+/* runs on the render task. the scene may have been switched since the input event, so check it's still current */
+static void demo_rotate_command(void* arg, int32_t steps) {
+	unsigned int index;
+	fp_viewid view = fp_scene_manager_get_render_view(sceneManager, &index);
+	if(view != 0 && &demos[index] == arg) {
+		demos[index].onrotate_mode(fp_view_get(view), steps);
+	}
+}
+
+static void demo_button_command(void* arg, int32_t value) {
+	unsigned int index;
+	fp_viewid view = fp_scene_manager_get_render_view(sceneManager, &index);
+	if(view != 0 && &demos[index] == arg) {
+		demos[index].onbutton_mode(fp_view_get(view));
+	}
+}
+
+static void demo_send_input(fp_command_fn fn, demo_mode* demo, int32_t value) {
+	fp_queue_command command = { CALL, { .CALL = { fn, demo, value } } };
+	if(!fp_queue_command_send(commandQueue, &command)) {
+		printf("failed to queue input for demo\n");
+		return;
+	}
+	fp_render_urgent(fp_input_get_event_timestamp());
+}
+
 void onrotate_left(fp_rotary_encoder* re) {
-	if(currentDemo != NULL && currentDemo->onrotate_mode != NULL) {
-		currentDemo->onrotate_mode(fp_view_get(currentDemo->view), re);
+	unsigned int index;
+	if(!fp_scene_manager_read_current(sceneManager, &index)) {
+		return;
+	}
+
+	if(demos[index].onrotate_mode != NULL) {
+		int steps = re->lastDirectionCw ? abs(re->delta) : -abs(re->delta);
+		demo_send_input(&demo_rotate_command, &demos[index], steps);
 	}
 }
 
 void onbutton_left(fp_button* button) {
-	if(currentDemo != NULL && currentDemo->onbutton_mode != NULL) {
-		currentDemo->onbutton_mode(fp_view_get(currentDemo->view), button);
+	unsigned int index;
+	if(!fp_scene_manager_read_current(sceneManager, &index)) {
+		return;
+	}
+
+	if(demos[index].onbutton_mode != NULL) {
+		demo_send_input(&demo_button_command, &demos[index], 0);
 	}
 }
 
 void change_brightness(fp_button* button) {
 	printf("button state %d\n", button->state);
 
-	if(button->state == 1) {
+	if(button->event != FP_INPUT_RELEASE) {
 		 /* only trigger on release */
 		return;
 	}
@@ -1159,13 +1269,12 @@ void change_brightness(fp_button* button) {
 	if(brightness <= 0.05f) {
 		brightness = 1.0f;
 	}
-	xSemaphoreTake(ledRenderLock, portMAX_DELAY);
+	/* a single aligned store, the render task sees either the old or the new value */
 	screenData->brightness = brightness;
-	xSemaphoreGive(ledRenderLock);
+	fp_view_mark_dirty(screenViewId);
+	fp_render_urgent(fp_input_get_event_timestamp());
 }
 
-static xQueueHandle gpio_evt_queue = NULL;
-
 void app_main()
 {
 	/*BaseType_t taskResult = */
@@ -1198,61 +1307,126 @@ void app_main()
 		ESP_ERROR_CHECK(err);
 	}
 
-	QueueHandle_t ledQueue = xQueueCreate(LED_QUEUE_LENGTH, sizeof(fp_queue_command));
+	fp_ring* ledQueue = fp_ring_init(LED_QUEUE_LENGTH, sizeof(fp_queue_command));
 	if(!ledQueue) {
 		printf("Failed to allocate queue for led render task\n");
 	}
-
-	ledRenderLock = xSemaphoreCreateBinary();
-
-	if(!ledRenderLock) {
-		printf("Failed to create semaphore ledRenderLock\n");
-	}
-	xSemaphoreGive(ledRenderLock);
+	commandQueue = ledQueue;
 
 	/* init_gpio_test(); */
 
+	/* before anything that records events */
+	fp_trace_init(FP_TRACE_DEFAULT_CAPACITY);
+	/* before any scene seeds a stream */
+	fp_rand_init();
+
 	fp_frame_init(512);
 	fp_view_init(512);
+	fp_render_init();
+	/* 60 fps, leaving a fifth of each frame for the rest of core 0 */
+	fp_budget_init(1000000/60 * 4/5);
+	/* containers don't keep intermediate frames, the screen streams the view tree one row at a time */
+	fp_view_set_compositor_mode(FP_COMPOSITOR_SCANLINE);
 
 	ws2812_control_init();
 
+#ifdef CONFIG_PM_ENABLE
+	/* only prepared: CONFIG_PM_ENABLE is off in sdkconfig, so none of this is built.
+	 * once enabled, the idle task can lower the clock while the render task sleeps between deadlines.
+	 * light sleep stays off, since the encoders and buttons use edge interrupts, which can't wake the chip */
+	esp_pm_config_esp32_t pmConfig = {
+		.max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+		.min_freq_mhz = 40,
+		.light_sleep_enable = false
+	};
+	ESP_ERROR_CHECK(esp_pm_configure(&pmConfig));
+#endif
+
 	fp_view_register_type(FP_VIEW_FRAME, fp_frame_view_register_data);
 	fp_view_register_type(FP_VIEW_WS2812, fp_ws2812_view_register_data);
 	fp_view_register_type(FP_VIEW_ANIM, fp_anim_view_register_data);
 	fp_view_register_type(FP_VIEW_LAYER, fp_layer_view_register_data);
 	fp_view_register_type(FP_VIEW_TRANSITION, fp_transition_view_register_data);
 	fp_view_register_type(FP_VIEW_DYNAMIC, fp_dynamic_view_register_data);
+	fp_view_register_type(FP_VIEW_PROCEDURAL, fp_procedural_view_register_data);
+	fp_view_register_type(FP_VIEW_PARTICLE, fp_particle_view_register_data);
 
 	fp_viewid screenViewId = fp_create_ws2812_view(SCREEN_WIDTH, SCREEN_HEIGHT, FP_INDEX_ZIGZAG);
-	fp_viewid mainViewId = fp_dynamic_view_create(SCREEN_WIDTH, SCREEN_HEIGHT, &demo_select_render, demo_select_onnext_render, (void*)true);
-
-	play_demo(mainViewId, &demos[0]);
+	/* keep the neighbouring demos built, so turning the selector one step switches within a frame */
+	for(unsigned int i = 0; i < DEMO_COUNT; i++) {
+		scenes[i].init = demos[i].init_mode;
+		scenes[i].free = demos[i].free_mode;
+		scenes[i].data = demos[i].data;
+	}
+	sceneManager = fp_scene_manager_create(SCREEN_WIDTH, SCREEN_HEIGHT, scenes, DEMO_COUNT, 1, DEMO_MEMORY_BUDGET, &demo_static_render_span);
+	fp_viewid mainViewId = fp_scene_manager_get_view(sceneManager);
 
 	fp_ws2812_view_set_child(screenViewId, mainViewId);
 
+	/* compose on core 0, encode and transmit on core 1.
+	 * the output stage holds ledOutputLock while transmitting, so shutdown can wait for it */
+	ledOutputLock = xSemaphoreCreateMutex();
+	if(!ledOutputLock) {
+		printf("Failed to create semaphore ledOutputLock\n");
+	}
+
+	/* every transmitted frame also goes to the capture, which records it once started from the console */
+	fp_output* ledOutput = fp_output_ws2812();
+	fp_output* capture = fp_capture_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+	if(capture) {
+		fp_output_chain(ledOutput, capture);
+		fp_capture_console_init(capture);
+	}
+
+	fp_pipeline* pipeline = fp_pipeline_create(SCREEN_WIDTH * SCREEN_HEIGHT, ledOutput, ledOutputLock);
+	if(pipeline) {
+		fp_pipeline_set_on_complete(pipeline, &fp_render_record_latency);
+		fp_ws2812_view_set_pipeline(screenViewId, pipeline);
+	}
+	else {
+		fp_ws2812_view_set_output(screenViewId, ledOutput);
+	}
+	fp_telemetry_register_output(screenViewId, pipeline);
+
 	gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
 
-	gpio_evt_queue = xQueueCreate(10, sizeof(fp_gpio_pin_config));
-	xTaskCreate(fp_input_task, "fp_input_task", 4096, gpio_evt_queue, 10, NULL);
+	fp_input_init(32);
 
 	demoQueue = xQueueCreate(10, sizeof(demoIndex));
+	fp_telemetry_register_ring("commands", ledQueue);
+	fp_telemetry_register_queue("demo", demoQueue);
 
-	fp_rotary_encoder* re = fp_rotary_encoder_init(19, 21, &select_demo, gpio_evt_queue, (void*)(size_t)mainViewId);
-	fp_button* button = fp_button_init(3, &change_brightness, gpio_evt_queue, (void*)(size_t)screenViewId);
+	fp_rotary_encoder* re = fp_rotary_encoder_init(19, 21, &select_demo, (void*)(size_t)mainViewId);
+	fp_button* button = fp_button_init(3, &change_brightness, (void*)(size_t)screenViewId);
 
-	fp_rotary_encoder* reLeft = fp_rotary_encoder_init(16, 17, &onrotate_left, gpio_evt_queue, NULL);
+	fp_rotary_encoder* reLeft = fp_rotary_encoder_init(16, 17, &onrotate_left, NULL);
 
-	fp_button* buttonLeft = fp_button_init(4, &onbutton_left, gpio_evt_queue, NULL);
+	fp_button* buttonLeft = fp_button_init(4, &onbutton_left, NULL);
 
-	/* fp_rotary_encoder* re = fp_rotary_encoder_init(19, 21, &fp_rotary_encoder_on_position_change_printdbg, gpio_evt_queue); */
+	/* fp_rotary_encoder* re = fp_rotary_encoder_init(19, 21, &fp_rotary_encoder_on_position_change_printdbg, NULL); */
 
 	/* bootloader_random_enable(); */
 
-	fp_task_render_params renderParams = { 1000/60, screenViewId, ledQueue, ledRenderLock };
+	fp_task_render_params renderParams = { 1000/60, screenViewId, ledQueue, FP_WS2812_DEFAULT_KEEP_ALIVE_MS };
 
 	vTaskPrioritySet(NULL, 1);
-	xTaskCreate(fp_task_render, "Render LED Task", 2048*4, &renderParams, 5, NULL);
+	TaskHandle_t renderTask = NULL;
+	xTaskCreatePinnedToCore(fp_task_render, "Render LED Task", FP_RENDER_TASK_STACK_SIZE, &renderParams, 5, &renderTask, 0);
+	fp_mem_register_task(renderTask, FP_RENDER_TASK_STACK_SIZE);
+	fp_mem_register_task(xTaskGetCurrentTaskHandle(), CONFIG_ESP_MAIN_TASK_STACK_SIZE);
+
+	fp_profile_console_init();
+	fp_trace_console_init();
+	fp_mem_console_init();
+	fp_telemetry_console_init();
+	fp_budget_console_init();
+	fp_rand_console_init();
+	fp_ring_console_init();
+	fp_rotary_encoder_console_init();
+	fp_effect_console_init();
+	fp_particle_console_init();
+	fp_display_list_console_init(ledQueue);
+	fp_console_init();
 
 	unsigned int selecteDemoIndex;
 	while(xQueueReceive(demoQueue, &selecteDemoIndex, portMAX_DELAY) == pdPASS) {
@@ -1263,8 +1437,9 @@ void app_main()
 
 		demoIndex = selecteDemoIndex;
 		printf("demo %d\n", demoIndex);
-		demo_mode* demo = &demos[demoIndex];
-		play_demo(mainViewId, demo);
+		fp_trace_begin("scene switch");
+		fp_scene_manager_switch(sceneManager, demoIndex, DEMO_CROSSFADE_MS);
+		fp_trace_end("scene switch");
 	}
 
 	fp_rotary_encoder_free(re);
@@ -1273,7 +1448,11 @@ void app_main()
 	fp_rotary_encoder_free(reLeft);
 	fp_button_free(buttonLeft);
 
-	xSemaphoreTake(ledRenderLock, portMAX_DELAY);
+	/* restarting mid-render can cause bright flashes */
+	fp_render_stop();
+	if(ledOutputLock) {
+		xSemaphoreTake(ledOutputLock, portMAX_DELAY);
+	}
     printf("Restarting now.\n");
     fflush(stdout);
     esp_restart();
@@ -1285,7 +1464,7 @@ void app_main()
 			FILL_RECT,
 			{ .FILL_RECT = { frame1, 0, i, 8, 1, hsv_to_rgb(hsv(i*255/8, 255, 10))}}
 		};
-		if(xQueueSend(ledQueue, &command, 0) != pdPASS) {
+		if(!fp_queue_command_send(ledQueue, &command)) {
 			printf("failed to send command to led queue\n");
 		}
 	}
@@ -1297,7 +1476,7 @@ void app_main()
 		{.RENDER_VIEW = { layerViewId }}
 	};
 
-	if(xQueueSend(ledQueue, &renderCommand, 0) != pdPASS) {
+	if(!fp_queue_command_send(ledQueue, &renderCommand)) {
 		printf("failed to send render command to led queue\n");
 	}
 	*/
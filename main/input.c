@@ -1,33 +1,157 @@
 #include "input.h"
 
-/* #include <stdio.h> */
+#include <stdio.h>
 
-void fp_input_task(void* options) {
-	QueueHandle_t taskQueue = options;
+#include "esp_timer.h"
 
-	fp_gpio_pin_config pin;
-	for(;;) {
-		if(xQueueReceive(taskQueue, &pin, portMAX_DELAY)) {
-			/* printf("pin %d\n", pin.pin); */
-			pin.oninput(pin.data);
+#include "trace.h"
+#include "mem.h"
+#include "telemetry.h"
+
+fp_ring* inputEvents = NULL;
+TaskHandle_t inputTask = NULL;
+
+/* only accessed by the input task */
+static fp_input_timer* timers = NULL;
+static int64_t currentEventTimestamp = 0;
+
+bool fp_input_init(unsigned int capacity) {
+	inputEvents = fp_ring_init(capacity, sizeof(fp_input_event));
+	if(!inputEvents) {
+		printf("error: fp_input_init: failed to allocate input event ring\n");
+		return false;
+	}
+
+	if(xTaskCreate(fp_input_task, "fp_input_task", FP_INPUT_TASK_STACK_SIZE, NULL, FP_INPUT_TASK_PRIORITY, &inputTask) != pdPASS) {
+		printf("error: fp_input_init: failed to create input task\n");
+		return false;
+	}
+	fp_mem_register_task(inputTask, FP_INPUT_TASK_STACK_SIZE);
+	fp_telemetry_register_ring("input events", inputEvents);
+
+	return true;
+}
+
+static void fp_input_run_timers(int64_t now) {
+	/* timers may rearm themselves, so unlink each one before running it */
+	fp_input_timer** timer = &timers;
+	while(*timer) {
+		fp_input_timer* current = *timer;
+		if(current->deadline > now) {
+			timer = &current->next;
+			continue;
 		}
+
+		*timer = current->next;
+		current->armed = false;
+		current->next = NULL;
+		current->ontimer(current, now);
 	}
 }
 
-void fp_input_debounce_task(void* options) {
-	QueueHandle_t taskQueue = options;
+static TickType_t fp_input_next_timeout(int64_t now) {
+	if(!timers) {
+		return portMAX_DELAY;
+	}
 
-	/* fp_gpio_pin_config pin; */
+	int64_t deadline = timers->deadline;
+	for(fp_input_timer* timer = timers->next; timer; timer = timer->next) {
+		if(timer->deadline < deadline) {
+			deadline = timer->deadline;
+		}
+	}
+
+	if(deadline <= now) {
+		return 0;
+	}
+
+	/* round up, so the timer has always expired when the task wakes */
+	return ((deadline - now) / 1000 + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS + 1;
+}
+
+void fp_input_task(void* options) {
+	fp_input_event event;
 	for(;;) {
-		/* if(xQueueReceive(taskQueue, &pin, portMAX_DELAY)) { */
-			/* printf("pin %d\n", pin.pin); */
-			/* pin.oninput(pin.data); */
-		/* } */
+		TickType_t timeout = fp_input_next_timeout(esp_timer_get_time());
+		if(timeout > 0 && fp_ring_count(inputEvents) == 0) {
+			ulTaskNotifyTake(pdTRUE, timeout);
+		}
+
+		while(fp_ring_pop(inputEvents, &event)) {
+			currentEventTimestamp = event.timestamp;
+			fp_trace_begin("input event");
+			event.oninput(&event);
+			fp_trace_end("input event");
+			currentEventTimestamp = 0;
+		}
+
+		fp_input_run_timers(esp_timer_get_time());
 	}
 }
 
 void IRAM_ATTR fp_input_isr_handler(void* arg) {
 	fp_input_isr_config* config = arg;
-	xQueueSendFromISR(config->taskQueue, &config->pin_config, NULL);
+	fp_input_event event = config->event;
+	event.type = FP_INPUT_EDGE;
+	event.timestamp = esp_timer_get_time();
+	fp_trace_instant_from_isr("input isr");
+
+	fp_input_push_from_isr(&event);
+}
+
+bool IRAM_ATTR fp_input_push_from_isr(const fp_input_event* event) {
+	if(!fp_ring_push(inputEvents, event)) {
+		return false;
+	}
+
+	BaseType_t higherPriorityTaskWoken = pdFALSE;
+	vTaskNotifyGiveFromISR(inputTask, &higherPriorityTaskWoken);
+	if(higherPriorityTaskWoken) {
+		/* switch straight to the input task instead of waiting for the next tick */
+		portYIELD_FROM_ISR();
+	}
+
+	return true;
+}
+
+bool fp_input_push(const fp_input_event* event) {
+	if(!fp_ring_push(inputEvents, event)) {
+		printf("error: fp_input_push: input event ring full\n");
+		return false;
+	}
+
+	if(xTaskGetCurrentTaskHandle() != inputTask) {
+		xTaskNotifyGive(inputTask);
+	}
+
+	return true;
+}
+
+void fp_input_timer_start(fp_input_timer* timer, int64_t deadline) {
+	timer->deadline = deadline;
+	if(!timer->armed) {
+		timer->armed = true;
+		timer->next = timers;
+		timers = timer;
+	}
+}
+
+void fp_input_timer_stop(fp_input_timer* timer) {
+	if(!timer->armed) {
+		return;
+	}
+
+	for(fp_input_timer** current = &timers; *current; current = &(*current)->next) {
+		if(*current == timer) {
+			*current = timer->next;
+			break;
+		}
+	}
+
+	timer->armed = false;
+	timer->next = NULL;
 }
 
+int64_t fp_input_get_event_timestamp() {
+	return currentEventTimestamp;
+}
@@ -2,23 +2,75 @@
 #define INPUT_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
+#include "freertos/task.h"
 
-typedef struct {
+#include "ring.h"
+
+/**
+ * all input devices share one timestamped event ring.
+ * ISRs stamp raw edges and push them into the ring, and the input task dispatches each event to its device's oninput.
+ * devices that need to wait (debouncing, long press) schedule an fp_input_timer.
+ * timers are kept on a single list serviced by the input task, which blocks until the next event or timer deadline,
+ * so there are no polling tasks.
+ */
+
+#define FP_INPUT_TASK_PRIORITY 10
+#define FP_INPUT_TASK_STACK_SIZE 4096
+
+typedef enum {
+	/* raw pin change, seen by the ISR */
+	FP_INPUT_EDGE,
+	FP_INPUT_PRESS,
+	FP_INPUT_RELEASE,
+	FP_INPUT_LONG_PRESS,
+	FP_INPUT_REPEAT,
+	FP_INPUT_ROTATE,
+} fp_input_event_type;
+
+typedef struct fp_input_event {
+	fp_input_event_type type;
 	unsigned int pin;
-	void (*oninput) (void*);
+	void (*oninput) (const struct fp_input_event*);
 	void* data;
-} fp_gpio_pin_config;
+	/* esp_timer_get_time() when the event happened. for debounced events, the time of the first edge */
+	int64_t timestamp;
+} fp_input_event;
 
+/** passed as the GPIO ISR argument. the ISR pushes a copy of event, with type FP_INPUT_EDGE and a timestamp */
 typedef struct {
-	QueueHandle_t taskQueue;
-	fp_gpio_pin_config pin_config;
+	fp_input_event event;
 } fp_input_isr_config;
 
+typedef struct fp_input_timer {
+	/* esp_timer_get_time() at which ontimer runs */
+	int64_t deadline;
+	void (*ontimer) (struct fp_input_timer*, int64_t now);
+	void* data;
+
+	bool armed;
+	struct fp_input_timer* next;
+} fp_input_timer;
+
+/** allocates the event ring and starts the input task.
+ * @param capacity - maximum number of undispatched events. must be a power of two */
+bool fp_input_init(unsigned int capacity);
 
 void fp_input_task(void* options);
 void IRAM_ATTR fp_input_isr_handler(void* arg);
 
+/** push an event from an ISR. wakes the input task */
+bool IRAM_ATTR fp_input_push_from_isr(const fp_input_event* event);
+/** push an event from a task */
+bool fp_input_push(const fp_input_event* event);
+
+/** input task only. (re)arm timer to run at deadline */
+void fp_input_timer_start(fp_input_timer* timer, int64_t deadline);
+/** input task only */
+void fp_input_timer_stop(fp_input_timer* timer);
+
+/** timestamp of the event currently being dispatched on the input task. 0 outside of a callback */
+int64_t fp_input_get_event_timestamp();
 
 #endif /* INPUT_H */
@@ -1,32 +1,93 @@
 #include "button.h"
 
+#include <stdio.h>
+
 #include "freertos/FreeRTOS.h"
 #include "driver/gpio.h"
 #include "freertos/task.h"
+#include "../mem.h"
+
+static void fp_button_send(fp_button* button, fp_input_event_type type, int64_t timestamp) {
+	fp_input_event event = button->pin.event;
+	event.type = type;
+	event.timestamp = timestamp;
+	fp_input_push(&event);
+}
+
+/* pin has been stable for debounceMs */
+static void fp_button_ondebounce(fp_input_timer* timer, int64_t now) {
+	fp_button* button = timer->data;
+	button->settling = false;
+
+	bool state = !gpio_get_level(button->pin.event.pin);
+	if(state == button->state) {
+		/* bounce or a glitch shorter than debounceMs */
+		return;
+	}
+
+	button->state = state;
+	button->held = false;
+	if(state) {
+		fp_button_send(button, FP_INPUT_PRESS, button->firstEdgeTimestamp);
+		if(button->longPressMs > 0) {
+			fp_input_timer_start(&button->holdTimer, button->firstEdgeTimestamp + button->longPressMs * 1000LL);
+		}
+	}
+	else {
+		fp_input_timer_stop(&button->holdTimer);
+		fp_button_send(button, FP_INPUT_RELEASE, button->firstEdgeTimestamp);
+	}
+}
 
-unsigned int debounceTime = 20; // millsections
+static void fp_button_onhold(fp_input_timer* timer, int64_t now) {
+	fp_button* button = timer->data;
+	if(!button->state) {
+		return;
+	}
+
+	/* the first expiry is the long press, every one after it a repeat */
+	fp_button_send(button, button->held ? FP_INPUT_REPEAT : FP_INPUT_LONG_PRESS, now);
+	button->held = true;
+
+	if(button->repeatMs > 0) {
+		fp_input_timer_start(timer, timer->deadline + button->repeatMs * 1000LL);
+	}
+}
 
 fp_button* fp_button_init(
 	unsigned int pin,
 	void (*onInput) (fp_button*),
-	xQueueHandle taskQueue,
 	void* data
 ) {
-	fp_button* button = malloc(sizeof(fp_button));
+	fp_button* button = fp_mem_alloc(FP_MEM_INPUT, sizeof(fp_button));
 	if(button == NULL) {
-		// ERROR
+		printf("error: fp_button_init: failed to allocate memory for button\n");
+		return NULL;
 	}
 
-	button->pin.taskQueue = taskQueue;
-	button->pin.pin_config.pin = pin;
-	button->pin.pin_config.oninput = &fp_button_oninput;
-	button->pin.pin_config.data = button;
+	button->pin.event.type = FP_INPUT_EDGE;
+	button->pin.event.pin = pin;
+	button->pin.event.oninput = &fp_button_oninput;
+	button->pin.event.data = button;
+	button->pin.event.timestamp = 0;
 
 	button->onInput = onInput;
 
 	button->state = 0;
+	button->event = FP_INPUT_RELEASE;
 	button->data = data;
 
+	button->debounceMs = FP_BUTTON_DEFAULT_DEBOUNCE_MS;
+	button->longPressMs = FP_BUTTON_DEFAULT_LONG_PRESS_MS;
+	button->repeatMs = FP_BUTTON_DEFAULT_REPEAT_MS;
+
+	button->firstEdgeTimestamp = 0;
+	button->settling = false;
+	button->held = false;
+	button->freeing = false;
+	button->debounceTimer = (fp_input_timer){ 0, &fp_button_ondebounce, button, false, NULL };
+	button->holdTimer = (fp_input_timer){ 0, &fp_button_onhold, button, false, NULL };
+
 	gpio_config_t io_conf;
 	io_conf.intr_type = GPIO_INTR_ANYEDGE;
 	io_conf.pin_bit_mask = (1ULL<<pin);
@@ -41,25 +102,59 @@ fp_button* fp_button_init(
 	return button;
 }
 
+/* timers run after the input task has emptied the ring, so no queued event references the button anymore */
+static void fp_button_onfreed(fp_input_timer* timer, int64_t now) {
+	fp_mem_free(timer->data);
+}
+
+/* input task. nothing can queue events for the button after this: the interrupt is gone and its timers are stopped */
+static void fp_button_onfree(const fp_input_event* event) {
+	fp_button* button = event->data;
+	button->freeing = true;
+	fp_input_timer_stop(&button->debounceTimer);
+	fp_input_timer_stop(&button->holdTimer);
+
+	button->debounceTimer.ontimer = &fp_button_onfreed;
+	fp_input_timer_start(&button->debounceTimer, 0);
+}
+
 bool fp_button_free(fp_button* button) {
-	gpio_isr_handler_remove(button->pin.pin_config.pin);
-	free(button);
+	gpio_isr_handler_remove(button->pin.event.pin);
+
+	fp_input_event event = button->pin.event;
+	event.oninput = &fp_button_onfree;
+	if(!fp_input_push(&event)) {
+		printf("error: fp_button_free: failed to queue free for button on pin %u\n", button->pin.event.pin);
+		gpio_isr_handler_add(button->pin.event.pin, &fp_input_isr_handler, &button->pin);
+		return false;
+	}
 
 	return true;
 }
 
-void fp_button_oninput(void* data) {
-	fp_button* button = data;
+void fp_button_set_timing(fp_button* button, unsigned int debounceMs, unsigned int longPressMs, unsigned int repeatMs) {
+	button->debounceMs = debounceMs;
+	button->longPressMs = longPressMs;
+	button->repeatMs = repeatMs;
+}
 
-	
-	// TODO: add to fp_input the ability to queue an input event at a certain time, so we can retrigger oninput after the debounceTime
-	/* TickType_t currentTick = xTaskGetTickCount(); */
-	/* if(currentTick - button->lastInputTick < pdMS_TO_TICKS(debounceTime)) { */
-	/* } */
+void fp_button_oninput(const fp_input_event* event) {
+	fp_button* button = event->data;
+	if(button->freeing) {
+		return;
+	}
+
+	if(event->type == FP_INPUT_EDGE) {
+		if(!button->settling) {
+			button->settling = true;
+			button->firstEdgeTimestamp = event->timestamp;
+		}
 
-	int state = !gpio_get_level(button->pin.pin_config.pin);
-	if(state != button->state) {
-		button->state = state;
-		button->onInput(button);
+		/* every edge pushes the settle deadline back */
+		fp_input_timer_start(&button->debounceTimer, event->timestamp + button->debounceMs * 1000LL);
+		return;
 	}
+
+	button->event = event->type;
+	button->onInput(button);
 }
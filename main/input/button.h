@@ -2,29 +2,58 @@
 #define BUTTON_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 
 #include "../input.h"
 
+#define FP_BUTTON_DEFAULT_DEBOUNCE_MS 20
+#define FP_BUTTON_DEFAULT_LONG_PRESS_MS 600
+#define FP_BUTTON_DEFAULT_REPEAT_MS 200
+
+/** buttons are active low with the internal pull-up.
+ * every edge restarts the debounce timer, and the pin is only read once it has been stable for debounceMs.
+ * onInput is called with event set to FP_INPUT_PRESS or FP_INPUT_RELEASE when the debounced state changes,
+ * FP_INPUT_LONG_PRESS once the button has been held for longPressMs,
+ * then FP_INPUT_REPEAT every repeatMs until released. */
 typedef struct fp_button {
 	fp_input_isr_config pin;
 	void (*onInput) (struct fp_button*);
 	void* data;
 
+	/** debounced state. 1 while pressed */
 	bool state;
-	TickType_t lastInputTick; // used to debounce
+	/** the event onInput is being called for */
+	fp_input_event_type event;
+
+	unsigned int debounceMs;
+	/* 0 to disable long press and repeat */
+	unsigned int longPressMs;
+	/* 0 to disable repeat */
+	unsigned int repeatMs;
+
+	/* time of the first edge since the state was last confirmed */
+	int64_t firstEdgeTimestamp;
+	bool settling;
+	/* true after the long press was sent */
+	bool held;
+	/* set on the input task by fp_button_free. events still queued for the button are dropped */
+	bool freeing;
+	fp_input_timer debounceTimer;
+	fp_input_timer holdTimer;
 } fp_button;
 
 
 fp_button* fp_button_init(
 	unsigned int pin,
 	void (*onInput) (fp_button*),
-	xQueueHandle taskQueue,
 	void* data
 );
 
+/** stops the button's interrupt and frees it on the input task, once every event queued for it has been dropped.
+ * safe to call from any task. the button must not be used after this returns true */
 bool fp_button_free(fp_button* button);
-void fp_button_oninput(void* data);
+void fp_button_set_timing(fp_button* button, unsigned int debounceMs, unsigned int longPressMs, unsigned int repeatMs);
+void fp_button_oninput(const fp_input_event* event);
 
 #endif /* BUTTON_H */
@@ -1,38 +1,50 @@
 #include "rotary-encoder.h"
 
+#include <stdio.h>
+#include <string.h>
+
 #include "freertos/FreeRTOS.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
+
+#include "../trace.h"
+#include "../mem.h"
+#include "../console.h"
 
 fp_rotary_encoder* fp_rotary_encoder_init(
 	unsigned int pinA,
 	unsigned int pinB,
 	void (*onPositionChange) (fp_rotary_encoder*),
-	xQueueHandle taskQueue,
 	void* data
 ) {
-	fp_rotary_encoder* re = malloc(sizeof(fp_rotary_encoder));
+	fp_rotary_encoder* re = fp_mem_alloc(FP_MEM_INPUT, sizeof(fp_rotary_encoder));
 	if(re == NULL) {
-		// ERROR
+		printf("error: fp_rotary_encoder_init: failed to allocate memory for rotary encoder\n");
+		return NULL;
 	}
 
-	re->pinA.taskQueue = taskQueue;
-	re->pinA.pin_config.pin = pinA;
-	re->pinA.pin_config.oninput = &fp_rotary_encoder_oninput;
-	re->pinA.pin_config.data = re;
+	re->pinA = pinA;
+	re->pinB = pinB;
 
-	re->pinB.taskQueue = taskQueue;
-	re->pinB.pin_config.pin = pinB;
-	re->pinB.pin_config.oninput = &fp_rotary_encoder_oninput;
-	re->pinB.pin_config.data = re;
+	re->event.type = FP_INPUT_ROTATE;
+	re->event.pin = pinA;
+	re->event.oninput = &fp_rotary_encoder_oninput;
+	re->event.data = re;
+	re->event.timestamp = 0;
 
 	re->onPositionChange = onPositionChange;
 
 	re->position = 0;
-	re->state = 0;
-	re->lastInputA = 0;
-	re->lastInputB = 0;
+	re->delta = 0;
 	re->lastDirectionCw = false;
 
+	re->decoderState = FP_RE_START;
+	re->pendingDelta = 0;
+	re->eventPending = false;
+	portMUX_INITIALIZE(&re->lock);
+	re->freeing = false;
+	re->freeTimer = (fp_input_timer){ 0, NULL, re, false, NULL };
+
 	re->data = data;
 
 	gpio_config_t io_conf;
@@ -44,81 +56,126 @@ fp_rotary_encoder* fp_rotary_encoder_init(
 
 	gpio_config(&io_conf);
 
-	gpio_isr_handler_add(pinA, &fp_input_isr_handler, &re->pinA);
-	gpio_isr_handler_add(pinB, &fp_input_isr_handler, &re->pinB);
+	gpio_isr_handler_add(pinA, &fp_rotary_encoder_isr_handler, re);
+	gpio_isr_handler_add(pinB, &fp_rotary_encoder_isr_handler, re);
 
 	return re;
 }
 
+/* timers run after the input task has emptied the ring, so no queued event references the encoder anymore */
+static void fp_rotary_encoder_onfreed(fp_input_timer* timer, int64_t now) {
+	fp_mem_free(timer->data);
+}
+
+/* input task. the interrupts are gone, so nothing can queue events for the encoder after this */
+static void fp_rotary_encoder_onfree(const fp_input_event* event) {
+	fp_rotary_encoder* re = event->data;
+	re->freeing = true;
+	re->freeTimer.ontimer = &fp_rotary_encoder_onfreed;
+	fp_input_timer_start(&re->freeTimer, 0);
+}
+
 bool fp_rotary_encoder_free(fp_rotary_encoder* re) {
-	gpio_isr_handler_remove(re->pinA.pin_config.pin);
-	gpio_isr_handler_remove(re->pinB.pin_config.pin);
-	free(re);
+	gpio_isr_handler_remove(re->pinA);
+	gpio_isr_handler_remove(re->pinB);
+
+	fp_input_event event = re->event;
+	event.oninput = &fp_rotary_encoder_onfree;
+	if(!fp_input_push(&event)) {
+		printf("error: fp_rotary_encoder_free: failed to queue free for encoder on pins %u, %u\n", re->pinA, re->pinB);
+		gpio_isr_handler_add(re->pinA, &fp_rotary_encoder_isr_handler, re);
+		gpio_isr_handler_add(re->pinB, &fp_rotary_encoder_isr_handler, re);
+		return false;
+	}
 
 	return true;
 }
 
-bool fp_rotary_encoder_update_state(fp_rotary_encoder* re, int a, int b, int aPrev, int bPrev) {
-	/* state truth table
-	 * a b o
-	 * 0 0 0
-	 * 0 1 1
-	 * 1 0 3
-	 * 1 1 2
-	 */
-	int state = 2*a + b - a*b + a*!b;
-	int statePrev = 2*aPrev + bPrev - aPrev*bPrev + aPrev*!bPrev;
-
-	int stateDiff = state - statePrev;
-
-	if(stateDiff == -3) {
-		stateDiff = 1;
+/* next state, indexed by [state][(b << 1) | a] */
+static const uint8_t FP_RE_TRANSITIONS[7][4] = {
+	/* FP_RE_START */
+	{ FP_RE_START, FP_RE_CW_BEGIN, FP_RE_CCW_BEGIN, FP_RE_START },
+	/* FP_RE_CW_FINAL */
+	{ FP_RE_CW_NEXT, FP_RE_START, FP_RE_CW_FINAL, FP_RE_START | FP_RE_DIR_CW },
+	/* FP_RE_CW_BEGIN */
+	{ FP_RE_CW_NEXT, FP_RE_CW_BEGIN, FP_RE_START, FP_RE_START },
+	/* FP_RE_CW_NEXT */
+	{ FP_RE_CW_NEXT, FP_RE_CW_BEGIN, FP_RE_CW_FINAL, FP_RE_START },
+	/* FP_RE_CCW_BEGIN */
+	{ FP_RE_CCW_NEXT, FP_RE_START, FP_RE_CCW_BEGIN, FP_RE_START },
+	/* FP_RE_CCW_FINAL */
+	{ FP_RE_CCW_NEXT, FP_RE_CCW_FINAL, FP_RE_START, FP_RE_START | FP_RE_DIR_CCW },
+	/* FP_RE_CCW_NEXT */
+	{ FP_RE_CCW_NEXT, FP_RE_CCW_FINAL, FP_RE_CCW_BEGIN, FP_RE_START },
+};
+
+int IRAM_ATTR fp_rotary_encoder_decode(uint8_t* state, int a, int b) {
+	uint8_t next = FP_RE_TRANSITIONS[*state & 0x0f][(b << 1) | a];
+	*state = next & 0x0f;
+
+	if(next & FP_RE_DIR_CW) {
+		return 1;
 	}
-	else if(stateDiff == 3) {
-		stateDiff = -1;
+	else if(next & FP_RE_DIR_CCW) {
+		return -1;
 	}
 
-	if(stateDiff == 0) {
-		return false;
-	}
+	return 0;
+}
 
-	/* if 2, continue in same direction as before, or default CW */
-	if(stateDiff == 2 || stateDiff == -2) {
-		stateDiff = 2*(re->state >= 0? 1: -1);
-	}
+void IRAM_ATTR fp_rotary_encoder_isr_handler(void* arg) {
+	fp_rotary_encoder* re = arg;
+	int a = gpio_get_level(re->pinA);
+	int b = gpio_get_level(re->pinB);
 
-	re->state += stateDiff;
+	int step = fp_rotary_encoder_decode(&re->decoderState, a, b);
+	if(step == 0) {
+		return;
+	}
 
-	/* printf("%d %d [%d %d] (%d %d) (%d %d)\n", re_state, stateDiff, statePrev, state, aPrev, bPrev, a, b); */
+	portENTER_CRITICAL_ISR(&re->lock);
+	re->pendingDelta += step;
+	bool postEvent = !re->eventPending;
+	re->eventPending = true;
+	portEXIT_CRITICAL_ISR(&re->lock);
 
-	if(re->state > 3) {
-		re->state -= 4;
-		re->position++;
-		re->lastDirectionCw = true;
-		return true;
+	if(!postEvent) {
+		/* the input task hasn't consumed the last event yet, it will pick up this detent too */
+		return;
 	}
-	else if(re->state < -3) {
-		re->state += 4;
-		re->position--;
-		re->lastDirectionCw = false;
-		return true;
+
+	fp_input_event event = re->event;
+	event.timestamp = esp_timer_get_time();
+	fp_trace_instant_from_isr("encoder isr");
+
+	if(!fp_input_push_from_isr(&event)) {
+		/* ring full. allow the next detent to try again */
+		portENTER_CRITICAL_ISR(&re->lock);
+		re->eventPending = false;
+		portEXIT_CRITICAL_ISR(&re->lock);
 	}
-	
-	return false;
 }
 
-void fp_rotary_encoder_oninput(void* data) {
-	fp_rotary_encoder* re = data;
-	int inputA = !gpio_get_level(re->pinA.pin_config.pin);
-	int inputB = !gpio_get_level(re->pinB.pin_config.pin);
+void fp_rotary_encoder_oninput(const fp_input_event* event) {
+	fp_rotary_encoder* re = event->data;
+	if(re->freeing) {
+		return;
+	}
+
+	portENTER_CRITICAL(&re->lock);
+	int delta = re->pendingDelta;
+	re->pendingDelta = 0;
+	re->eventPending = false;
+	portEXIT_CRITICAL(&re->lock);
 
-	if(fp_rotary_encoder_update_state(re, inputA, inputB, re->lastInputA, re->lastInputB)) {
-		re->onPositionChange(re);
+	if(delta == 0) {
+		return;
 	}
 
-	// update rotary encoder
-	re->lastInputA = inputA;
-	re->lastInputB = inputB;
+	re->delta = delta;
+	re->position += delta;
+	re->lastDirectionCw = delta > 0;
+	re->onPositionChange(re);
 }
 
 void fp_rotary_encoder_on_position_change_printdbg(fp_rotary_encoder* re) {
@@ -135,3 +192,76 @@ void fp_rotary_encoder_on_position_change_printdbg(fp_rotary_encoder* re) {
 	}
 	printf("\n");
 }
+
+/* decoder replay tests. pins are written "ab" per edge, starting from rest (11) */
+typedef struct {
+	const char* name;
+	const char* edges;
+	int detents;
+} fp_rotary_encoder_test;
+
+static const fp_rotary_encoder_test FP_RE_TESTS[] = {
+	{ "cw detent", "10 00 01 11", 1 },
+	{ "ccw detent", "01 00 10 11", -1 },
+	{ "cw with bounce on every edge", "10 11 10 00 10 00 01 00 01 11", 1 },
+	{ "ccw with bounce on every edge", "01 11 01 00 01 00 10 00 10 11", -1 },
+	{ "bounce at rest after a detent", "10 00 01 11 01 11 10 11", 1 },
+	{ "repeated samples", "10 10 00 00 01 01 11 11", 1 },
+	{ "half turn and back", "10 00 10 11", 0 },
+	{ "skipped first state", "00 01 11", 0 },
+	{ "skipped middle state", "10 01 11", 0 },
+	{ "skipped last state", "10 00 11", 0 },
+	{ "reversal at the last state", "10 00 01 00 10 11", 0 },
+	{ "two cw, one ccw", "10 00 01 11 10 00 01 11 01 00 10 11", 1 },
+};
+
+static int fp_rotary_encoder_replay(const char* edges, uint8_t* state) {
+	int detents = 0;
+	for(const char* edge = edges; edge[0] && edge[1]; edge += edge[2] ? 3 : 2) {
+		detents += fp_rotary_encoder_decode(state, edge[0] == '1', edge[1] == '1');
+	}
+
+	return detents;
+}
+
+static int fp_rotary_encoder_self_test() {
+	unsigned int failed = 0;
+	unsigned int count = sizeof(FP_RE_TESTS) / sizeof(FP_RE_TESTS[0]);
+	for(unsigned int i = 0; i < count; i++) {
+		uint8_t state = FP_RE_START;
+		int detents = fp_rotary_encoder_replay(FP_RE_TESTS[i].edges, &state);
+		if(detents != FP_RE_TESTS[i].detents || state != FP_RE_START) {
+			printf("FAIL %s: %d detents (expected %d), state %u\n", FP_RE_TESTS[i].name, detents, FP_RE_TESTS[i].detents, state);
+			failed++;
+		}
+	}
+
+	/* every transition: the state stays valid, returning to rest always resets, and only the return to rest counts */
+	for(uint8_t from = FP_RE_START; from <= FP_RE_CCW_NEXT; from++) {
+		for(int pins = 0; pins < 4; pins++) {
+			uint8_t state = from;
+			int step = fp_rotary_encoder_decode(&state, pins & 1, pins >> 1);
+			bool rest = pins == 3;
+			if(state > FP_RE_CCW_NEXT || (rest && state != FP_RE_START) || (!rest && step != 0)) {
+				printf("FAIL transition from %u on %d%d: state %u, step %d\n", from, pins & 1, pins >> 1, state, step);
+				failed++;
+			}
+		}
+	}
+
+	printf("%s: %u replays, %u failed\n", failed == 0 ? "pass" : "FAIL", count, failed);
+	return failed == 0 ? 0 : 1;
+}
+
+static int fp_rotary_encoder_command(int argc, char** argv) {
+	if(argc < 2 || strcmp(argv[1], "test") != 0) {
+		printf("usage: encoder test\n");
+		return 1;
+	}
+
+	return fp_rotary_encoder_self_test();
+}
+
+bool fp_rotary_encoder_console_init() {
+	return fp_console_register("encoder", "rotary encoder decoder: test replays recorded pin sequences", &fp_rotary_encoder_command);
+}
@@ -2,33 +2,53 @@
 #define ROTARY_ENCODER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 
 #include "../input.h"
 
 
-/** detect a full step when the encoder has passed through all 4 states
- * and returned to the OFF state, completing a cycle.
- * negative values represent negative rotation */
-/* #define RE_STATE_OFF 0 */
-/* #define RE_STATE_CW_START 1 */
-/* #define RE_STATE_ON 2 */
-/* #define RE_STATE_CW_END 3 */
+/** quadrature decoding runs inside the GPIO ISR.
+ * both pins are sampled on every edge and fed through a Gray-code state machine
+ * that only counts a detent after the encoder passes through all 4 states and returns to rest,
+ * so contact bounce and invalid transitions never move the position.
+ * detents are accumulated in the ISR, and a single event is posted to the input task
+ * until it consumes them, no matter how many edges arrive in between. */
+
+/* decoder states. the rest state is both pins high (pull-ups) */
+#define FP_RE_START 0x0
+#define FP_RE_CW_FINAL 0x1
+#define FP_RE_CW_BEGIN 0x2
+#define FP_RE_CW_NEXT 0x3
+#define FP_RE_CCW_BEGIN 0x4
+#define FP_RE_CCW_FINAL 0x5
+#define FP_RE_CCW_NEXT 0x6
+/* set on the next state when a detent completes */
+#define FP_RE_DIR_CW 0x10
+#define FP_RE_DIR_CCW 0x20
 
 typedef struct fp_rotary_encoder {
-	fp_input_isr_config pinA;
-	fp_input_isr_config pinB;
+	unsigned int pinA;
+	unsigned int pinB;
+	/* template for the FP_INPUT_ROTATE events posted by the ISR */
+	fp_input_event event;
 	void (*onPositionChange) (struct fp_rotary_encoder*);
 
 	/** number of ticks forward/backward from starting position */
 	int position;
-	/** sub-position of rotary encoder; used to detect a position change */
-	int state;
+	/** detents moved since the last onPositionChange. events are coalesced, so this may be more than 1 */
+	int delta;
 	bool lastDirectionCw;
 
-	int lastInputA;
-	int lastInputB;
+	/* ISR state. pendingDelta and eventPending are shared with the input task under lock */
+	uint8_t decoderState;
+	int pendingDelta;
+	bool eventPending;
+	portMUX_TYPE lock;
+	/* set on the input task by fp_rotary_encoder_free. events still queued for the encoder are dropped */
+	bool freeing;
+	/* frees the encoder once the input task has emptied the ring */
+	fp_input_timer freeTimer;
 
 	void* data;
 } fp_rotary_encoder;
@@ -38,15 +58,23 @@ fp_rotary_encoder* fp_rotary_encoder_init(
 	unsigned int pinA,
 	unsigned int pinB,
 	void (*onPositionChange) (fp_rotary_encoder*),
-	xQueueHandle taskQueue,
 	void* data
 );
 
+/** stops the encoder's interrupts and frees it on the input task, once every event queued for it has been dropped.
+ * safe to call from any task. the encoder must not be used after this returns true */
 bool fp_rotary_encoder_free(fp_rotary_encoder* re);
 
-bool fp_rotary_encoder_update_state(fp_rotary_encoder* re, int a, int b, int aPrev, int bPrev);
+/** advance the decoder with the current pin levels.
+ * @param state - decoder state, starts at FP_RE_START
+ * @return 1 for a clockwise detent, -1 for counter-clockwise, 0 otherwise */
+int IRAM_ATTR fp_rotary_encoder_decode(uint8_t* state, int a, int b);
 
-void fp_rotary_encoder_oninput(void* data);
+void IRAM_ATTR fp_rotary_encoder_isr_handler(void* arg);
+void fp_rotary_encoder_oninput(const fp_input_event* event);
 void fp_rotary_encoder_on_position_change_printdbg(fp_rotary_encoder* re);
 
+/** registers the "encoder" console command, which replays recorded pin sequences through the decoder */
+bool fp_rotary_encoder_console_init();
+
 #endif /* ROTARY_ENCODER_H */
@@ -0,0 +1,242 @@
+#include "mem.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "console.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#endif
+
+/* 8 bytes, so memory after the header keeps malloc's alignment on the ESP32 */
+typedef struct {
+	uint32_t size;
+	uint8_t tag;
+	/* -1 if not counted against a scene */
+	int8_t scene;
+	uint16_t reserved;
+} fp_mem_header;
+
+typedef struct {
+	atomic_size_t current;
+	atomic_size_t peak;
+	atomic_uint count;
+} fp_mem_counter;
+
+typedef struct {
+	const char* name;
+	fp_pool* pool;
+} fp_mem_pool_entry;
+
+typedef struct {
+	TaskHandle_t task;
+	unsigned int stackSize;
+} fp_mem_task_entry;
+
+static const char* fp_mem_tag_names[FP_MEM_TAG_COUNT] = {
+	"frame",
+	"view",
+	"pool",
+	"arena",
+	"asset",
+	"render",
+	"output",
+	"scene",
+	"input",
+	"debug",
+	"app",
+};
+
+fp_mem_counter memTags[FP_MEM_TAG_COUNT];
+fp_mem_counter memScenes[FP_MEM_SCENE_COUNT];
+
+/* only used for allocations made by memSceneOwner */
+int memScene = -1;
+TaskHandle_t memSceneOwner = NULL;
+
+fp_mem_pool_entry memPools[FP_MEM_POOL_COUNT];
+unsigned int memPoolCount = 0;
+fp_mem_task_entry memTasks[FP_MEM_TASK_COUNT];
+unsigned int memTaskCount = 0;
+
+static void fp_mem_counter_add(fp_mem_counter* counter, size_t size) {
+	size_t current = atomic_fetch_add_explicit(&counter->current, size, memory_order_relaxed) + size;
+	size_t peak = atomic_load_explicit(&counter->peak, memory_order_relaxed);
+	while(current > peak && !atomic_compare_exchange_weak_explicit(&counter->peak, &peak, current, memory_order_relaxed, memory_order_relaxed)) {
+	}
+	atomic_fetch_add_explicit(&counter->count, 1, memory_order_relaxed);
+}
+
+static void fp_mem_counter_sub(fp_mem_counter* counter, size_t size) {
+	atomic_fetch_sub_explicit(&counter->current, size, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&counter->count, 1, memory_order_relaxed);
+}
+
+static fp_mem_usage fp_mem_counter_get(fp_mem_counter* counter) {
+	return (fp_mem_usage){
+		atomic_load_explicit(&counter->current, memory_order_relaxed),
+		atomic_load_explicit(&counter->peak, memory_order_relaxed),
+		atomic_load_explicit(&counter->count, memory_order_relaxed),
+	};
+}
+
+static void* fp_mem_track(fp_mem_header* header, fp_mem_tag tag, size_t size) {
+	if(!header) {
+		return NULL;
+	}
+
+	int scene = memSceneOwner == xTaskGetCurrentTaskHandle() ? memScene : -1;
+	header->size = size;
+	header->tag = tag;
+	header->scene = scene;
+	header->reserved = 0;
+
+	fp_mem_counter_add(&memTags[tag], size);
+	if(scene >= 0) {
+		fp_mem_counter_add(&memScenes[scene], size);
+	}
+
+	return header + 1;
+}
+
+void* fp_mem_alloc(fp_mem_tag tag, size_t size) {
+	return fp_mem_track(malloc(sizeof(fp_mem_header) + size), tag, size);
+}
+
+void* fp_mem_calloc(fp_mem_tag tag, size_t count, size_t size) {
+	if(size != 0 && count > (SIZE_MAX - sizeof(fp_mem_header)) / size) {
+		return NULL;
+	}
+
+	return fp_mem_track(calloc(1, sizeof(fp_mem_header) + count * size), tag, count * size);
+}
+
+void fp_mem_free(void* ptr) {
+	if(!ptr) {
+		return;
+	}
+
+	fp_mem_header* header = (fp_mem_header*)ptr - 1;
+	fp_mem_counter_sub(&memTags[header->tag], header->size);
+	if(header->scene >= 0) {
+		fp_mem_counter_sub(&memScenes[header->scene], header->size);
+	}
+
+	free(header);
+}
+
+void fp_mem_add_static(fp_mem_tag tag, size_t size) {
+	fp_mem_counter_add(&memTags[tag], size);
+}
+
+void fp_mem_set_scene(int scene) {
+	if(scene >= FP_MEM_SCENE_COUNT) {
+		/* not counted */
+		scene = -1;
+	}
+
+	memScene = scene;
+	memSceneOwner = scene >= 0 ? xTaskGetCurrentTaskHandle() : NULL;
+}
+
+fp_mem_usage fp_mem_get_usage(fp_mem_tag tag) {
+	return fp_mem_counter_get(&memTags[tag]);
+}
+
+fp_mem_usage fp_mem_get_scene_usage(unsigned int scene) {
+	if(scene >= FP_MEM_SCENE_COUNT) {
+		return (fp_mem_usage){ 0 };
+	}
+
+	return fp_mem_counter_get(&memScenes[scene]);
+}
+
+fp_mem_heap_stats fp_mem_get_heap_stats() {
+	fp_mem_heap_stats stats = { 0 };
+#ifdef ESP_PLATFORM
+	stats.freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+	stats.minimumFreeBytes = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+	stats.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+	if(stats.freeBytes > 0) {
+		stats.fragmentation = 100 - stats.largestFreeBlock * 100 / stats.freeBytes;
+	}
+#endif
+	return stats;
+}
+
+bool fp_mem_register_pool(const char* name, fp_pool* pool) {
+	if(memPoolCount >= FP_MEM_POOL_COUNT) {
+		printf("error: fp_mem_register_pool: too many pools, can't add %s\n", name);
+		return false;
+	}
+
+	memPools[memPoolCount] = (fp_mem_pool_entry){ name, pool };
+	memPoolCount++;
+	return true;
+}
+
+bool fp_mem_register_task(TaskHandle_t task, unsigned int stackSize) {
+	if(task == NULL) {
+		return false;
+	}
+
+	if(memTaskCount >= FP_MEM_TASK_COUNT) {
+		printf("error: fp_mem_register_task: too many tasks, can't add %s\n", pcTaskGetName(task));
+		return false;
+	}
+
+	memTasks[memTaskCount] = (fp_mem_task_entry){ task, stackSize };
+	memTaskCount++;
+	return true;
+}
+
+void fp_mem_dump(FILE* out) {
+	size_t total = 0;
+	fprintf(out, "%-8s %10s %10s %8s\n", "tag", "current", "peak", "allocs");
+	for(unsigned int tag = 0; tag < FP_MEM_TAG_COUNT; tag++) {
+		fp_mem_usage usage = fp_mem_get_usage(tag);
+		fprintf(out, "%-8s %10zu %10zu %8u\n", fp_mem_tag_names[tag], usage.current, usage.peak, usage.count);
+		total += usage.current;
+	}
+	fprintf(out, "%-8s %10zu\n", "total", total);
+
+	fprintf(out, "\n%-8s %10s %10s %8s\n", "scene", "current", "peak", "allocs");
+	for(unsigned int scene = 0; scene < FP_MEM_SCENE_COUNT; scene++) {
+		fp_mem_usage usage = fp_mem_get_scene_usage(scene);
+		if(usage.peak == 0) {
+			continue;
+		}
+		fprintf(out, "%-8u %10zu %10zu %8u\n", scene, usage.current, usage.peak, usage.count);
+	}
+
+	fprintf(out, "\n%-8s %10s %10s\n", "pool", "used", "slot size");
+	for(unsigned int i = 0; i < memPoolCount; i++) {
+		fp_pool* pool = memPools[i].pool;
+		char used[24];
+		snprintf(used, sizeof(used), "%u/%u", pool->count, pool->capacity);
+		fprintf(out, "%-8s %10s %10u\n", memPools[i].name, used, pool->elementSize);
+	}
+
+	fprintf(out, "\n%-20s %10s %10s\n", "task", "stack", "min free");
+	for(unsigned int i = 0; i < memTaskCount; i++) {
+		fprintf(out, "%-20s %10u %10u\n",
+			pcTaskGetName(memTasks[i].task),
+			memTasks[i].stackSize,
+			(unsigned int)uxTaskGetStackHighWaterMark(memTasks[i].task));
+	}
+
+	fp_mem_heap_stats heap = fp_mem_get_heap_stats();
+	fprintf(out, "\nheap: %zu free, %zu minimum free, %zu largest block, %u%% fragmented\n",
+		heap.freeBytes, heap.minimumFreeBytes, heap.largestFreeBlock, heap.fragmentation);
+}
+
+static int fp_mem_command(int argc, char** argv) {
+	fp_mem_dump(stdout);
+	return 0;
+}
+
+bool fp_mem_console_init() {
+	return fp_console_register("mem", "memory by subsystem, scene, pool and task stack", &fp_mem_command);
+}
@@ -0,0 +1,83 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "pool.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_mem
+ * tagged allocation accounting. allocations made through fp_mem_alloc carry a small header with their size, tag and scene,
+ * so current and peak bytes can be reported for each subsystem and each scene, and fp_mem_free doesn't need to be told the tag.
+ * memory from fp_mem_alloc must be freed with fp_mem_free.
+ *
+ * allocations made by the task that called fp_mem_set_scene are also counted against that scene, until it is cleared.
+ * a scene that still holds memory after it was evicted is leaking.
+ * pools and task stacks are registered to report their occupancy alongside the heap.
+ */
+
+#define FP_MEM_SCENE_COUNT 16
+#define FP_MEM_POOL_COUNT 4
+#define FP_MEM_TASK_COUNT 12
+
+typedef enum {
+	FP_MEM_FRAME, /* frame pixels */
+	FP_MEM_VIEW, /* view data too large to store inline, child lists outside of an arena */
+	FP_MEM_POOL, /* pool storage */
+	FP_MEM_ARENA, /* arenas, including their unused capacity */
+	FP_MEM_ASSET, /* ppm and scene file buffers */
+	FP_MEM_RENDER, /* rings, display lists */
+	FP_MEM_OUTPUT, /* pipeline and RMT buffers */
+	FP_MEM_SCENE, /* scene manager */
+	FP_MEM_INPUT, /* buttons and rotary encoders */
+	FP_MEM_DEBUG, /* trace */
+	FP_MEM_APP, /* demo state */
+	FP_MEM_TAG_COUNT
+} fp_mem_tag;
+
+typedef struct {
+	size_t current;
+	size_t peak;
+	/* live allocations */
+	unsigned int count;
+} fp_mem_usage;
+
+typedef struct {
+	size_t freeBytes;
+	size_t minimumFreeBytes;
+	size_t largestFreeBlock;
+	/* percentage of free memory that isn't in the largest block */
+	unsigned int fragmentation;
+} fp_mem_heap_stats;
+
+void* fp_mem_alloc(fp_mem_tag tag, size_t size);
+/** zeroed */
+void* fp_mem_calloc(fp_mem_tag tag, size_t count, size_t size);
+void fp_mem_free(void* ptr);
+/** count a statically allocated buffer against tag */
+void fp_mem_add_static(fp_mem_tag tag, size_t size);
+
+/** count allocations made by the calling task against scene, or stop if scene is negative */
+void fp_mem_set_scene(int scene);
+
+fp_mem_usage fp_mem_get_usage(fp_mem_tag tag);
+fp_mem_usage fp_mem_get_scene_usage(unsigned int scene);
+fp_mem_heap_stats fp_mem_get_heap_stats();
+
+/** name must outlive the pool */
+bool fp_mem_register_pool(const char* name, fp_pool* pool);
+bool fp_mem_register_task(TaskHandle_t task, unsigned int stackSize);
+
+void fp_mem_dump(FILE* out);
+/** registers the "mem" console command */
+bool fp_mem_console_init();
+
+#endif /* MEM_H */
@@ -0,0 +1,37 @@
+#include "output.h"
+
+#include <stddef.h>
+
+#include "esp_timer.h"
+
+#include "ws2812_control.h"
+
+bool fp_output_write(fp_output* output, const uint32_t* leds, unsigned int length) {
+	int64_t timestamp = esp_timer_get_time();
+	bool result = true;
+	for(; output; output = output->next) {
+		if(!output->write(output, leds, length, timestamp)) {
+			result = false;
+		}
+	}
+
+	return result;
+}
+
+void fp_output_chain(fp_output* output, fp_output* sink) {
+	while(output->next) {
+		output = output->next;
+	}
+	output->next = sink;
+}
+
+static bool fp_output_ws2812_write(fp_output* output, const uint32_t* leds, unsigned int length, int64_t timestamp) {
+	ws2812_write_pixels(leds, length);
+	return true;
+}
+
+fp_output ws2812Output = { "ws2812", &fp_output_ws2812_write, NULL, NULL };
+
+fp_output* fp_output_ws2812() {
+	return &ws2812Output;
+}
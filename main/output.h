@@ -0,0 +1,37 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* fp: fresh pixel */
+
+/**
+ * fp_output
+ * sink for finished frames of LED values, in the layout of ws2812_control.h (one uint32_t per LED, in LED order).
+ * outputs can be chained, every output in the chain receives every frame with the same timestamp.
+ * the ws2812 view and the pipeline write to an output, so the LEDs can be replaced or joined by other sinks,
+ * e.g. a capture file (see capture.h).
+ */
+
+typedef struct fp_output fp_output;
+
+/** @param timestamp - esp_timer_get_time() when the frame was handed to the chain */
+typedef bool (*fp_output_write_fn) (fp_output* output, const uint32_t* leds, unsigned int length, int64_t timestamp);
+
+struct fp_output {
+	const char* name;
+	fp_output_write_fn write;
+	void* context;
+	fp_output* next;
+};
+
+/** writes the frame to every output in the chain. returns false if any of them failed */
+bool fp_output_write(fp_output* output, const uint32_t* leds, unsigned int length);
+/** appends sink to the end of the chain. call before frames are written to the chain */
+void fp_output_chain(fp_output* output, fp_output* sink);
+
+/** the RMT driven WS2812 LEDs. ws2812_control_init must have been called */
+fp_output* fp_output_ws2812();
+
+#endif /* OUTPUT_H */
@@ -0,0 +1,122 @@
+#include "pipeline.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "trace.h"
+#include "telemetry.h"
+#include "mem.h"
+
+void fp_pipeline_output_task(void* pvParameters) {
+	fp_pipeline* pipeline = pvParameters;
+
+	while(true) {
+		unsigned int readCount = atomic_load_explicit(&pipeline->readCount, memory_order_relaxed);
+		if(readCount == atomic_load_explicit(&pipeline->writeCount, memory_order_acquire)) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+
+		const uint32_t* leds = pipeline->buffers[readCount % FP_PIPELINE_BUFFER_COUNT];
+		if(pipeline->outputLock) {
+			xSemaphoreTake(pipeline->outputLock, portMAX_DELAY);
+		}
+		fp_trace_begin("output");
+		int64_t outputStart = esp_timer_get_time();
+		fp_output_write(pipeline->output, leds, pipeline->length);
+		fp_telemetry_record(FP_TELEMETRY_OUTPUT, esp_timer_get_time() - outputStart);
+		fp_trace_end("output");
+		if(pipeline->outputLock) {
+			xSemaphoreGive(pipeline->outputLock);
+		}
+		pipeline->stats.framesOutput++;
+
+		int64_t inputTimestamp = pipeline->inputTimestamps[readCount % FP_PIPELINE_BUFFER_COUNT];
+		if(inputTimestamp != 0 && pipeline->onComplete) {
+			pipeline->onComplete(inputTimestamp);
+		}
+
+		atomic_store_explicit(&pipeline->readCount, readCount + 1, memory_order_release);
+		xSemaphoreGive(pipeline->bufferReleased);
+	}
+}
+
+static void fp_pipeline_delete(fp_pipeline* pipeline) {
+	for(int i = 0; i < FP_PIPELINE_BUFFER_COUNT; i++) {
+		fp_mem_free(pipeline->buffers[i]);
+	}
+	if(pipeline->bufferReleased) {
+		vSemaphoreDelete(pipeline->bufferReleased);
+	}
+	fp_mem_free(pipeline);
+}
+
+fp_pipeline* fp_pipeline_create(unsigned int length, fp_output* output, SemaphoreHandle_t outputLock) {
+	fp_pipeline* pipeline = fp_mem_alloc(FP_MEM_OUTPUT, sizeof(fp_pipeline));
+	if(!pipeline) {
+		printf("error: fp_pipeline_create: failed to allocate memory for pipeline\n");
+		return NULL;
+	}
+
+	memset(pipeline, 0, sizeof(fp_pipeline));
+
+	for(int i = 0; i < FP_PIPELINE_BUFFER_COUNT; i++) {
+		pipeline->buffers[i] = fp_mem_calloc(FP_MEM_OUTPUT, length, sizeof(uint32_t));
+		if(!pipeline->buffers[i]) {
+			printf("error: fp_pipeline_create: failed to allocate memory for buffers\n");
+			fp_pipeline_delete(pipeline);
+			return NULL;
+		}
+	}
+
+	pipeline->length = length;
+	atomic_init(&pipeline->writeCount, 0);
+	atomic_init(&pipeline->readCount, 0);
+	pipeline->output = output;
+	pipeline->outputLock = outputLock;
+
+	pipeline->bufferReleased = xSemaphoreCreateBinary();
+	if(!pipeline->bufferReleased) {
+		printf("error: fp_pipeline_create: failed to create semaphore\n");
+		fp_pipeline_delete(pipeline);
+		return NULL;
+	}
+
+	if(xTaskCreatePinnedToCore(fp_pipeline_output_task, "fp_pipeline_output", FP_PIPELINE_OUTPUT_STACK_SIZE, pipeline, 5, &pipeline->outputTask, FP_PIPELINE_OUTPUT_CORE) != pdPASS) {
+		printf("error: fp_pipeline_create: failed to create output task\n");
+		fp_pipeline_delete(pipeline);
+		return NULL;
+	}
+	fp_mem_register_task(pipeline->outputTask, FP_PIPELINE_OUTPUT_STACK_SIZE);
+
+	return pipeline;
+}
+
+uint32_t* fp_pipeline_acquire(fp_pipeline* pipeline) {
+	unsigned int writeCount = atomic_load_explicit(&pipeline->writeCount, memory_order_relaxed);
+	while(writeCount - atomic_load_explicit(&pipeline->readCount, memory_order_acquire) >= FP_PIPELINE_BUFFER_COUNT) {
+		pipeline->stats.producerStalls++;
+		fp_trace_instant("pipeline stall");
+		xSemaphoreTake(pipeline->bufferReleased, portMAX_DELAY);
+	}
+
+	return pipeline->buffers[writeCount % FP_PIPELINE_BUFFER_COUNT];
+}
+
+void fp_pipeline_publish(fp_pipeline* pipeline, int64_t inputTimestamp) {
+	unsigned int writeCount = atomic_load_explicit(&pipeline->writeCount, memory_order_relaxed);
+	pipeline->inputTimestamps[writeCount % FP_PIPELINE_BUFFER_COUNT] = inputTimestamp;
+	atomic_store_explicit(&pipeline->writeCount, writeCount + 1, memory_order_release);
+	pipeline->stats.framesComposed++;
+
+	xTaskNotifyGive(pipeline->outputTask);
+}
+
+void fp_pipeline_set_on_complete(fp_pipeline* pipeline, fp_pipeline_complete_fn onComplete) {
+	pipeline->onComplete = onComplete;
+}
+
+fp_pipeline_stats fp_pipeline_get_stats(fp_pipeline* pipeline) {
+	return pipeline->stats;
+}
@@ -0,0 +1,78 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "output.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_pipeline
+ * splits the output of a frame into two stages running on different cores.
+ * the compose stage (render task, core 0) evaluates the view tree into a buffer of final LED values,
+ * and the output stage (output task, core 1) writes it to an fp_output, e.g. encodes and transmits it to the LEDs.
+ * buffers are passed between the stages through a lock-free single-producer/single-consumer ring,
+ * so the next frame is composed while the previous one is transmitted.
+ * composition stays on the render task: views lazily re-render dirty children while their spans are read,
+ * so the tree can't be read from two tasks at once.
+ */
+
+#define FP_PIPELINE_BUFFER_COUNT 2
+
+#define FP_PIPELINE_OUTPUT_CORE 1
+#define FP_PIPELINE_OUTPUT_STACK_SIZE 2048
+
+/** called by the output stage after a tagged buffer is transmitted */
+typedef void (*fp_pipeline_complete_fn) (int64_t inputTimestamp);
+
+typedef struct {
+	unsigned int framesComposed;
+	unsigned int framesOutput;
+	/* number of times the compose stage waited for the output stage to free a buffer */
+	unsigned int producerStalls;
+} fp_pipeline_stats;
+
+typedef struct {
+	unsigned int length;
+	uint32_t* buffers[FP_PIPELINE_BUFFER_COUNT];
+	/* input event timestamp that triggered each buffer's frame, 0 if none */
+	int64_t inputTimestamps[FP_PIPELINE_BUFFER_COUNT];
+	/* total buffers published by the producer / released by the consumer. only the owner writes each counter */
+	atomic_uint writeCount;
+	atomic_uint readCount;
+
+	fp_output* output;
+	fp_pipeline_complete_fn onComplete;
+	/* held while transmitting, so shutdown can wait for the transmission to finish */
+	SemaphoreHandle_t outputLock;
+
+	/* given by the output stage whenever it releases a buffer */
+	SemaphoreHandle_t bufferReleased;
+	TaskHandle_t outputTask;
+
+	fp_pipeline_stats stats;
+} fp_pipeline;
+
+/** creates the pipeline and starts its output task on FP_PIPELINE_OUTPUT_CORE. returns NULL on failure
+ * @param length - number of LEDs in each buffer
+ * @param outputLock - optional. taken while the output chain runs */
+fp_pipeline* fp_pipeline_create(unsigned int length, fp_output* output, SemaphoreHandle_t outputLock);
+
+/** producer: returns the next free buffer, blocking until the output stage releases one */
+uint32_t* fp_pipeline_acquire(fp_pipeline* pipeline);
+/** producer: hand the buffer returned by fp_pipeline_acquire to the output stage
+ * @param inputTimestamp - passed to the onComplete callback once the buffer is transmitted. 0 for none */
+void fp_pipeline_publish(fp_pipeline* pipeline, int64_t inputTimestamp);
+/** set a callback run by the output stage after each buffer published with an input timestamp is transmitted */
+void fp_pipeline_set_on_complete(fp_pipeline* pipeline, fp_pipeline_complete_fn onComplete);
+
+fp_pipeline_stats fp_pipeline_get_stats(fp_pipeline* pipeline);
+
+#endif /* PIPELINE_H */
@@ -1,25 +1,29 @@
 #include "pool.h"
 
-/**
- * do I have to worry about alignment?
- * */
+#include "mem.h"
+
+/* the header and each element are padded to FP_POOL_ALIGN, so elements can hold aligned data inline */
+#define FP_POOL_ALIGN 4
+#define FP_POOL_ALIGN_UP(size) (((size) + FP_POOL_ALIGN - 1) & ~(FP_POOL_ALIGN - 1))
+#define FP_POOL_HEADER_SIZE FP_POOL_ALIGN_UP(sizeof(fp_pool_element))
 
 fp_pool_element* fp_pool_get_element(fp_pool* pool, fp_pool_id id) {
-	return (fp_pool_element*)((char*)pool->elements + (sizeof(fp_pool_element) + pool->elementSize)*id);
+	return (fp_pool_element*)((char*)pool->elements + (FP_POOL_HEADER_SIZE + pool->elementSize)*id);
 }
 
 fp_pool* fp_pool_init(unsigned int capacity, unsigned int elementSize, bool useSempahore) {
-	fp_pool* pool = malloc(sizeof(fp_pool));
+	fp_pool* pool = fp_mem_alloc(FP_MEM_POOL, sizeof(fp_pool));
 	if(!pool) {
 		printf("error: fp_pool_init: failed to allocate memory for pool\n");
 		return NULL;
 	}
 
-	pool->elements = calloc(capacity, sizeof(fp_pool_element) + elementSize);
+	elementSize = FP_POOL_ALIGN_UP(elementSize);
+	pool->elements = fp_mem_calloc(FP_MEM_POOL, capacity, FP_POOL_HEADER_SIZE + elementSize);
 
 	if(!pool->elements) {
 		printf("error: fp_pool_init: failed to allocate memory for %ud elements (size %ud)\n", capacity, elementSize);
-		free(pool);
+		fp_mem_free(pool);
 		return NULL;
 	}
 
@@ -47,19 +51,20 @@ fp_pool* fp_pool_init(unsigned int capacity, unsigned int elementSize, bool useS
 }
 
 bool fp_pool_free(fp_pool* pool) {
-	free(pool->elements);
-	free(pool);
+	fp_mem_free(pool->elements);
+	fp_mem_free(pool);
 	return true;
 }
 
 void* fp_pool_get(fp_pool* pool, fp_pool_id id) {
-	fp_pool_element* element = fp_pool_get_element(pool, id);
-	if(id > pool->capacity || !element->exists) {
+	if(id >= pool->capacity || !fp_pool_get_element(pool, id)->exists) {
 		printf("error: fp_pool_get: invalid id: %d\n", id);
 		return NULL;
 	}
 
-	return element+1; /* return memory right after the element */
+	fp_pool_element* element = fp_pool_get_element(pool, id);
+
+	return (char*)element + FP_POOL_HEADER_SIZE; /* return memory right after the element header */
 }
 
 fp_pool_id fp_pool_add(fp_pool* pool) {
@@ -105,8 +110,17 @@ fp_pool_id fp_pool_add(fp_pool* pool) {
 	return id;
 }
 
+bool fp_pool_has(fp_pool* pool, fp_pool_id id) {
+	/* ids run from 1 to capacity - 1. 0 is the zero-element, not a live one */
+	if(id == 0 || id >= pool->capacity) {
+		return false;
+	}
+
+	return fp_pool_get_element(pool, id)->exists;
+}
+
 bool fp_pool_delete(fp_pool* pool, fp_pool_id id) {
-	if(id == 0 || id > pool->capacity) {
+	if(id == 0 || id >= pool->capacity) {
 		return false;
 	}
 
@@ -38,5 +38,7 @@ void* fp_pool_get(fp_pool* pool, fp_pool_id id);
  */
 fp_pool_id fp_pool_add(fp_pool* pool);
 bool fp_pool_delete(fp_pool* pool, fp_pool_id id);
+/** true if the element exists. unlike fp_pool_get, missing elements are not an error. false for id 0 */
+bool fp_pool_has(fp_pool* pool, fp_pool_id id);
 
 #endif /* POOL_H */
@@ -2,6 +2,7 @@
 #include "color.h"
 
 #include "freertos/FreeRTOS.h"
+#include "mem.h"
 #include <string.h>
 #include <errno.h>
 
@@ -80,13 +81,13 @@ fp_frameid fp_ppm_load_image(char* filepath) {
 	size_t fileSize = ftell(file);
 	fseek(file, 0, SEEK_SET);
 
-	char* fileBuffer = malloc(fileSize + 1);
+	char* fileBuffer = fp_mem_alloc(FP_MEM_ASSET, fileSize + 1);
 	fread(fileBuffer, 1, fileSize, file);
 	fclose(file);
 
 	fp_frameid frameid = fp_ppm_create_frame(fileBuffer, fileSize);
 
-	free(fileBuffer);
+	fp_mem_free(fileBuffer);
 
 	return frameid;
 }
@@ -0,0 +1,393 @@
+#include "global.h"
+#include "profile.h"
+
+#include <string.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include "view.h"
+#include "render.h"
+#include "console.h"
+
+#ifdef FP_PROFILE
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+/* assumes the CPU runs at its default frequency. with dynamic frequency scaling times are only approximate */
+#define FP_PROFILE_CYCLES_PER_US CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+
+static inline uint32_t fp_profile_now() {
+	return esp_cpu_get_ccount();
+}
+#else
+#include <time.h>
+/* host builds count nanoseconds */
+#define FP_PROFILE_CYCLES_PER_US 1000
+
+static inline uint32_t fp_profile_now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000000000ull + now.tv_nsec);
+}
+#endif
+
+typedef struct {
+	/* -1 if the node couldn't be recorded */
+	int node;
+	uint32_t start;
+} fp_profile_frame;
+
+fp_profile_node profileNodes[FP_PROFILE_NODE_COUNT];
+unsigned int profileNodeCount = 0;
+int profileFirstRoot = -1;
+/* begin calls that found the tree or stack full */
+unsigned int profileDropped = 0;
+
+/* only touched by profileTask */
+fp_profile_frame profileStack[FP_PROFILE_STACK_DEPTH];
+unsigned int profileDepth = 0;
+/* begin calls past FP_PROFILE_STACK_DEPTH, matched by end calls that have nothing to pop */
+unsigned int profileOverflow = 0;
+bool profileRunning = false;
+TaskHandle_t profileTask = NULL;
+
+/* requests, applied by fp_profile_sync */
+atomic_bool profileRunRequested = false;
+atomic_bool profileResetRequested = false;
+
+void fp_profile_start() {
+	atomic_store(&profileRunRequested, true);
+	fp_render_wake();
+}
+
+void fp_profile_stop() {
+	atomic_store(&profileRunRequested, false);
+	fp_render_wake();
+}
+
+void fp_profile_reset() {
+	atomic_store(&profileResetRequested, true);
+	fp_render_wake();
+}
+
+bool fp_profile_is_running() {
+	return atomic_load(&profileRunRequested);
+}
+
+void fp_profile_sync() {
+	if(atomic_exchange(&profileResetRequested, false)) {
+		profileNodeCount = 0;
+		profileFirstRoot = -1;
+		profileDropped = 0;
+	}
+
+	profileDepth = 0;
+	profileOverflow = 0;
+	profileTask = xTaskGetCurrentTaskHandle();
+	profileRunning = atomic_load(&profileRunRequested);
+}
+
+static bool fp_profile_node_matches(const fp_profile_node* node, fp_profile_kind kind, unsigned int viewType, unsigned int viewId, const char* name) {
+	if(node->kind != kind) {
+		return false;
+	}
+
+	if(kind == FP_PROFILE_OP) {
+		return node->name == name || strcmp(node->name, name) == 0;
+	}
+
+	return node->viewType == viewType && node->viewId == viewId;
+}
+
+void fp_profile_begin(fp_profile_kind kind, unsigned int viewType, unsigned int viewId, const char* name) {
+	if(!profileRunning || xTaskGetCurrentTaskHandle() != profileTask) {
+		return;
+	}
+
+	if(profileDepth >= FP_PROFILE_STACK_DEPTH) {
+		profileOverflow++;
+		profileDropped++;
+		return;
+	}
+
+	int node = -1;
+	if(profileDepth == 0 || profileStack[profileDepth - 1].node >= 0) {
+		int parent = profileDepth > 0 ? profileStack[profileDepth - 1].node : -1;
+		int* first = parent >= 0 ? &profileNodes[parent].firstChild : &profileFirstRoot;
+
+		node = *first;
+		while(node >= 0 && !fp_profile_node_matches(&profileNodes[node], kind, viewType, viewId, name)) {
+			node = profileNodes[node].nextSibling;
+		}
+
+		if(node < 0 && profileNodeCount < FP_PROFILE_NODE_COUNT) {
+			node = profileNodeCount;
+			profileNodes[node] = (fp_profile_node){
+				parent, -1, *first,
+				kind, viewType, viewId, name,
+				0, 0, 0
+			};
+			/* publish after the node is filled in, dumps may walk the tree at any time */
+			profileNodeCount++;
+			*first = node;
+		}
+	}
+
+	if(node < 0) {
+		profileDropped++;
+	}
+
+	profileStack[profileDepth] = (fp_profile_frame){ node, fp_profile_now() };
+	profileDepth++;
+}
+
+void fp_profile_end() {
+	if(!profileRunning || xTaskGetCurrentTaskHandle() != profileTask) {
+		return;
+	}
+
+	if(profileOverflow > 0) {
+		profileOverflow--;
+		return;
+	}
+
+	if(profileDepth == 0) {
+		return;
+	}
+
+	profileDepth--;
+	fp_profile_frame frame = profileStack[profileDepth];
+	uint32_t elapsed = fp_profile_now() - frame.start;
+
+	if(frame.node >= 0) {
+		profileNodes[frame.node].calls++;
+		profileNodes[frame.node].inclusiveCycles += elapsed;
+	}
+
+	if(profileDepth > 0 && profileStack[profileDepth - 1].node >= 0) {
+		profileNodes[profileStack[profileDepth - 1].node].childCycles += elapsed;
+	}
+}
+
+static const char* fp_profile_view_type_names[FP_VIEW_TYPE_COUNT] = {
+	"frame",
+	"ws2812",
+	"anim",
+	"layer",
+	"transition",
+	"dynamic",
+	"procedural",
+	"particle",
+};
+
+static void fp_profile_node_name(const fp_profile_node* node, bool byType, char* out, size_t size) {
+	if(node->kind == FP_PROFILE_OP) {
+		snprintf(out, size, "%s", node->name);
+		return;
+	}
+
+	const char* typeName = node->viewType < FP_VIEW_TYPE_COUNT ? fp_profile_view_type_names[node->viewType] : "unknown";
+	const char* suffix = node->kind == FP_PROFILE_SPAN ? ":span" : "";
+	if(byType) {
+		snprintf(out, size, "%s%s", typeName, suffix);
+	}
+	else {
+		snprintf(out, size, "%s#%u%s", typeName, node->viewId, suffix);
+	}
+}
+
+static uint64_t fp_profile_exclusive(const fp_profile_node* node) {
+	return node->inclusiveCycles > node->childCycles ? node->inclusiveCycles - node->childCycles : 0;
+}
+
+static void fp_profile_dump_tree_node(FILE* out, int node, unsigned int depth) {
+	for(; node >= 0; node = profileNodes[node].nextSibling) {
+		const fp_profile_node* n = &profileNodes[node];
+		char name[48];
+		fp_profile_node_name(n, false, name, sizeof(name));
+		fprintf(out, "%8u %10llu %10llu  %*s%s\n",
+			n->calls,
+			(unsigned long long)(n->inclusiveCycles / FP_PROFILE_CYCLES_PER_US),
+			(unsigned long long)(fp_profile_exclusive(n) / FP_PROFILE_CYCLES_PER_US),
+			depth * 2, "", name);
+		fp_profile_dump_tree_node(out, n->firstChild, depth + 1);
+	}
+}
+
+void fp_profile_dump_tree(FILE* out) {
+	fprintf(out, "%8s %10s %10s  %s\n", "calls", "incl us", "excl us", "node");
+	fp_profile_dump_tree_node(out, profileFirstRoot, 0);
+	fprintf(out, "%u/%u nodes, %u dropped\n", profileNodeCount, FP_PROFILE_NODE_COUNT, profileDropped);
+}
+
+void fp_profile_dump_types(FILE* out) {
+	typedef struct {
+		char name[32];
+		unsigned int calls;
+		uint64_t inclusiveCycles;
+		uint64_t exclusiveCycles;
+	} fp_profile_total;
+
+	fp_profile_total totals[32];
+	unsigned int totalCount = 0;
+
+	unsigned int nodeCount = profileNodeCount;
+	for(unsigned int i = 0; i < nodeCount; i++) {
+		const fp_profile_node* node = &profileNodes[i];
+		char name[32];
+		fp_profile_node_name(node, true, name, sizeof(name));
+
+		unsigned int t = 0;
+		while(t < totalCount && strcmp(totals[t].name, name) != 0) {
+			t++;
+		}
+		if(t == totalCount) {
+			if(totalCount == sizeof(totals) / sizeof(totals[0])) {
+				continue;
+			}
+			memset(&totals[t], 0, sizeof(totals[t]));
+			strcpy(totals[t].name, name);
+			totalCount++;
+		}
+
+		totals[t].calls += node->calls;
+		totals[t].exclusiveCycles += fp_profile_exclusive(node);
+
+		/* nested views of the same type are already included in the outer one */
+		bool nested = false;
+		for(int parent = node->parent; parent >= 0 && !nested; parent = profileNodes[parent].parent) {
+			char parentName[32];
+			fp_profile_node_name(&profileNodes[parent], true, parentName, sizeof(parentName));
+			nested = strcmp(parentName, name) == 0;
+		}
+		if(!nested) {
+			totals[t].inclusiveCycles += node->inclusiveCycles;
+		}
+	}
+
+	fprintf(out, "%8s %10s %10s  %s\n", "calls", "incl us", "excl us", "type");
+	for(unsigned int t = 0; t < totalCount; t++) {
+		fprintf(out, "%8u %10llu %10llu  %s\n",
+			totals[t].calls,
+			(unsigned long long)(totals[t].inclusiveCycles / FP_PROFILE_CYCLES_PER_US),
+			(unsigned long long)(totals[t].exclusiveCycles / FP_PROFILE_CYCLES_PER_US),
+			totals[t].name);
+	}
+}
+
+static void fp_profile_dump_folded_node(FILE* out, int node, bool byType, char* path, size_t pathLength, size_t pathSize) {
+	for(; node >= 0; node = profileNodes[node].nextSibling) {
+		const fp_profile_node* n = &profileNodes[node];
+		size_t length = pathLength;
+		if(length > 0 && length < pathSize - 1) {
+			path[length++] = ';';
+		}
+		fp_profile_node_name(n, byType, path + length, pathSize - length);
+		length += strlen(path + length);
+
+		uint64_t exclusiveNs = fp_profile_exclusive(n) * 1000 / FP_PROFILE_CYCLES_PER_US;
+		if(exclusiveNs > 0) {
+			fprintf(out, "%s %llu\n", path, (unsigned long long)exclusiveNs);
+		}
+
+		fp_profile_dump_folded_node(out, n->firstChild, byType, path, length, pathSize);
+		path[pathLength] = '\0';
+	}
+}
+
+void fp_profile_dump_folded(FILE* out, bool byType) {
+	char path[256] = "";
+	fp_profile_dump_folded_node(out, profileFirstRoot, byType, path, 0, sizeof(path));
+}
+
+#else
+
+void fp_profile_start() {
+	printf("profile: built without FP_PROFILE (see global.h)\n");
+}
+
+void fp_profile_stop() {
+}
+
+void fp_profile_reset() {
+}
+
+bool fp_profile_is_running() {
+	return false;
+}
+
+void fp_profile_begin(fp_profile_kind kind, unsigned int viewType, unsigned int viewId, const char* name) {
+}
+
+void fp_profile_end() {
+}
+
+void fp_profile_sync() {
+}
+
+void fp_profile_dump_tree(FILE* out) {
+	fprintf(out, "profile: built without FP_PROFILE (see global.h)\n");
+}
+
+void fp_profile_dump_types(FILE* out) {
+	fp_profile_dump_tree(out);
+}
+
+void fp_profile_dump_folded(FILE* out, bool byType) {
+	fp_profile_dump_tree(out);
+}
+
+#endif /* FP_PROFILE */
+
+static int fp_profile_command(int argc, char** argv) {
+	if(argc < 2) {
+		printf("usage: profile start|stop|reset|tree|types|folded [type] [path]\n");
+		return 1;
+	}
+
+	if(strcmp(argv[1], "start") == 0) {
+		fp_profile_start();
+	}
+	else if(strcmp(argv[1], "stop") == 0) {
+		fp_profile_stop();
+	}
+	else if(strcmp(argv[1], "reset") == 0) {
+		fp_profile_reset();
+	}
+	else if(strcmp(argv[1], "tree") == 0) {
+		fp_profile_dump_tree(stdout);
+	}
+	else if(strcmp(argv[1], "types") == 0) {
+		fp_profile_dump_types(stdout);
+	}
+	else if(strcmp(argv[1], "folded") == 0) {
+		bool byType = argc > 2 && strcmp(argv[2], "type") == 0;
+		const char* path = argc > (byType ? 3 : 2) ? argv[byType ? 3 : 2] : NULL;
+		if(!path) {
+			fp_profile_dump_folded(stdout, byType);
+			return 0;
+		}
+
+		FILE* file = fopen(path, "w");
+		if(!file) {
+			printf("error: profile: failed to open %s\n", path);
+			return 1;
+		}
+		fp_profile_dump_folded(file, byType);
+		fclose(file);
+		printf("profile: wrote %s\n", path);
+	}
+	else {
+		printf("profile: unknown subcommand %s\n", argv[1]);
+		return 1;
+	}
+
+	return 0;
+}
+
+bool fp_profile_console_init() {
+	return fp_console_register("profile", "render profiler: start|stop|reset|tree|types|folded [type] [path]", &fp_profile_command);
+}
@@ -0,0 +1,82 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* fp: fresh pixel */
+
+/**
+ * fp_profile
+ * render profiler. when built with FP_PROFILE (see global.h), view renders, span reads and frame operations on the render task
+ * are timed with the cycle counter and aggregated into a call tree. each node is a (view, kind) or named operation,
+ * under the node that was running when it started, with its call count, inclusive time, and exclusive time (inclusive minus children).
+ *
+ * start/stop/reset are applied by the render task between passes (fp_profile_sync), so begin/end pairs are never split.
+ * without FP_PROFILE the instrumentation macros compile to nothing. instrumented files include global.h before this header;
+ * it isn't included here because global.h also defines FP_INDEX_ZIGZAG, which clashes with fp_index_mode.
+ */
+
+#define FP_PROFILE_NODE_COUNT 128
+#define FP_PROFILE_STACK_DEPTH 16
+
+typedef enum {
+	FP_PROFILE_RENDER, /* fp_view_render */
+	FP_PROFILE_SPAN, /* render_span, called through fp_view_get_span */
+	FP_PROFILE_OP, /* named operation, e.g. a frame op */
+} fp_profile_kind;
+
+typedef struct {
+	/* -1 for top level nodes */
+	int parent;
+	int firstChild;
+	int nextSibling;
+
+	fp_profile_kind kind;
+	unsigned int viewType;
+	unsigned int viewId;
+	/* FP_PROFILE_OP */
+	const char* name;
+
+	unsigned int calls;
+	uint64_t inclusiveCycles;
+	uint64_t childCycles;
+} fp_profile_node;
+
+#ifdef FP_PROFILE
+#define FP_PROFILE_BEGIN_VIEW(kind, viewType, viewId) fp_profile_begin((kind), (viewType), (viewId), NULL)
+#define FP_PROFILE_BEGIN_OP(name) fp_profile_begin(FP_PROFILE_OP, 0, 0, (name))
+#define FP_PROFILE_END() fp_profile_end()
+#define FP_PROFILE_SYNC() fp_profile_sync()
+#else
+#define FP_PROFILE_BEGIN_VIEW(kind, viewType, viewId) do {} while(0)
+#define FP_PROFILE_BEGIN_OP(name) do {} while(0)
+#define FP_PROFILE_END() do {} while(0)
+#define FP_PROFILE_SYNC() do {} while(0)
+#endif
+
+/** request the profiler to start or stop recording. takes effect at the render task's next pass */
+void fp_profile_start();
+void fp_profile_stop();
+/** clear the call tree at the next pass */
+void fp_profile_reset();
+bool fp_profile_is_running();
+
+void fp_profile_begin(fp_profile_kind kind, unsigned int viewType, unsigned int viewId, const char* name);
+void fp_profile_end();
+/** applies pending requests. called by the render task between passes */
+void fp_profile_sync();
+
+/** indented call tree with calls, inclusive and exclusive microseconds */
+void fp_profile_dump_tree(FILE* out);
+/** totals for each view type and operation */
+void fp_profile_dump_types(FILE* out);
+/** folded stacks ("a;b;c <exclusive ns>" per line) for flamegraph.pl or speedscope.
+ * @param byType - name frames by view type instead of type and id, merging views of the same type */
+void fp_profile_dump_folded(FILE* out, bool byType);
+
+/** registers the "profile" console command */
+bool fp_profile_console_init();
+
+#endif /* PROFILE_H */
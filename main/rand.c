@@ -0,0 +1,230 @@
+#include "rand.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "mem.h"
+#include "console.h"
+
+typedef struct fp_rand_task_stream {
+	/* NULL while the slot is free. claimed once by the task that owns the stream */
+	_Atomic(TaskHandle_t) task;
+	fp_rand rand;
+	/* next overflow stream */
+	struct fp_rand_task_stream* next;
+} fp_rand_task_stream;
+
+atomic_ullong randSeed = 0;
+/* incremented by fp_rand_set_seed. task streams reseed when they see a new generation */
+atomic_uint randGeneration = 0;
+
+fp_rand_task_stream randTaskStreams[FP_RAND_TASK_COUNT];
+/* allocated for tasks that didn't get a slot. pushed once, never removed */
+_Atomic(fp_rand_task_stream*) randOverflowStreams = NULL;
+
+void fp_rand_init() {
+	fp_rand_set_seed(((uint64_t)esp_random() << 32) | esp_random());
+}
+
+void fp_rand_set_seed(uint64_t seed) {
+	atomic_store(&randSeed, seed);
+	atomic_fetch_add(&randGeneration, 1);
+}
+
+uint64_t fp_rand_get_seed() {
+	return atomic_load(&randSeed);
+}
+
+uint32_t fp_rand_next(fp_rand* rand) {
+	/* PCG-XSH-RR */
+	uint64_t state = rand->state;
+	rand->state = state * 6364136223846793005ULL + rand->increment;
+	uint32_t xorshifted = ((state >> 18) ^ state) >> 27;
+	uint32_t rotation = state >> 59;
+	return (xorshifted >> rotation) | (xorshifted << ((-rotation) & 31));
+}
+
+static void fp_rand_seed_stream(fp_rand* rand, uint64_t seed, uint64_t stream) {
+	rand->state = 0;
+	rand->increment = (stream << 1) | 1;
+	fp_rand_next(rand);
+	rand->state += seed;
+	fp_rand_next(rand);
+	rand->stream = stream;
+}
+
+void fp_rand_seed_explicit(fp_rand* rand, uint64_t seed, uint64_t stream) {
+	fp_rand_seed_stream(rand, seed, stream);
+	rand->generation = 0;
+	rand->followsSeed = false;
+}
+
+void fp_rand_seed(fp_rand* rand, uint64_t stream) {
+	/* the generation before the seed. if the seed changes in between, the next sync reseeds again */
+	rand->generation = atomic_load(&randGeneration);
+	fp_rand_seed_stream(rand, atomic_load(&randSeed), stream);
+	rand->followsSeed = true;
+}
+
+bool fp_rand_sync(fp_rand* rand) {
+	if(!rand->followsSeed || rand->generation == atomic_load_explicit(&randGeneration, memory_order_relaxed)) {
+		return false;
+	}
+
+	fp_rand_seed(rand, rand->stream);
+	return true;
+}
+
+static uint64_t fp_rand_task_stream_id(TaskHandle_t task) {
+	/* the task name, so the stream is the same on every run */
+	uint64_t hash = 14695981039346656037ULL;
+	for(const char* name = pcTaskGetName(task); *name; name++) {
+		hash = (hash ^ (uint8_t)*name) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+fp_rand* fp_rand_task() {
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	fp_rand_task_stream* stream = NULL;
+	for(unsigned int i = 0; i < FP_RAND_TASK_COUNT; i++) {
+		TaskHandle_t owner = atomic_load_explicit(&randTaskStreams[i].task, memory_order_relaxed);
+		if(owner == task) {
+			stream = &randTaskStreams[i];
+			break;
+		}
+
+		TaskHandle_t expected = NULL;
+		if(owner == NULL && atomic_compare_exchange_strong(&randTaskStreams[i].task, &expected, task)) {
+			stream = &randTaskStreams[i];
+			fp_rand_seed(&stream->rand, fp_rand_task_stream_id(task));
+			return &stream->rand;
+		}
+	}
+
+	if(!stream) {
+		for(stream = atomic_load(&randOverflowStreams); stream; stream = stream->next) {
+			if(atomic_load_explicit(&stream->task, memory_order_relaxed) == task) {
+				break;
+			}
+		}
+	}
+
+	if(!stream) {
+		/* every slot is taken. each task still gets its own stream, so no stream is shared between tasks */
+		stream = fp_mem_alloc(FP_MEM_RENDER, sizeof(fp_rand_task_stream));
+		if(!stream) {
+			printf("error: fp_rand_task: failed to allocate stream for %s\n", pcTaskGetName(task));
+			return NULL;
+		}
+
+		atomic_init(&stream->task, task);
+		fp_rand_seed(&stream->rand, fp_rand_task_stream_id(task));
+		stream->next = atomic_load(&randOverflowStreams);
+		while(!atomic_compare_exchange_weak(&randOverflowStreams, &stream->next, stream));
+		return &stream->rand;
+	}
+
+	fp_rand_sync(&stream->rand);
+	return &stream->rand;
+}
+
+uint32_t fp_rand_range(fp_rand* rand, uint32_t bound) {
+	/* multiply-shift. the bias is negligible for the small bounds effects use */
+	return ((uint64_t)fp_rand_next(rand) * bound) >> 32;
+}
+
+void fp_rand_fill(fp_rand* rand, void* buffer, size_t size) {
+	uint8_t* out = buffer;
+	for(; size >= 4; size -= 4, out += 4) {
+		uint32_t value = fp_rand_next(rand);
+		memcpy(out, &value, 4);
+	}
+
+	if(size > 0) {
+		uint32_t value = fp_rand_next(rand);
+		memcpy(out, &value, size);
+	}
+}
+
+void fp_rand_fill_span(fp_rand* rand, rgb_color* out, unsigned int width) {
+	for(unsigned int i = 0; i < width; i++) {
+		out[i].bits = fp_rand_next(rand) & 0xffffff;
+	}
+}
+
+bool fp_rand_fill_frame(fp_rand* rand, fp_frameid id) {
+	fp_frame* frame = fp_frame_get(id);
+	if(!frame) {
+		return false;
+	}
+
+	fp_rand_fill_span(rand, frame->pixels, frame->length);
+	return true;
+}
+
+/* time n values from the hardware RNG, a stream, and a batch fill */
+static void fp_rand_bench(unsigned int count) {
+	uint32_t* buffer = fp_mem_alloc(FP_MEM_DEBUG, count * sizeof(uint32_t));
+	if(!buffer) {
+		printf("error: fp_rand_bench: failed to allocate buffer\n");
+		return;
+	}
+
+	fp_rand* rand = fp_rand_task();
+	if(!rand) {
+		fp_mem_free(buffer);
+		return;
+	}
+	volatile uint32_t sink = 0;
+
+	int64_t start = esp_timer_get_time();
+	for(unsigned int i = 0; i < count; i++) {
+		sink += esp_random();
+	}
+	int64_t hardwareUs = esp_timer_get_time() - start;
+
+	start = esp_timer_get_time();
+	for(unsigned int i = 0; i < count; i++) {
+		sink += fp_rand_next(rand);
+	}
+	int64_t nextUs = esp_timer_get_time() - start;
+
+	start = esp_timer_get_time();
+	fp_rand_fill(rand, buffer, count * sizeof(uint32_t));
+	int64_t fillUs = esp_timer_get_time() - start;
+
+	printf("%u values: esp_random %lld us, fp_rand_next %lld us, fp_rand_fill %lld us\n", count, (long long)hardwareUs, (long long)nextUs, (long long)fillUs);
+	fp_mem_free(buffer);
+}
+
+static int fp_rand_command(int argc, char** argv) {
+	if(argc >= 3 && strcmp(argv[1], "seed") == 0) {
+		fp_rand_set_seed(strtoull(argv[2], NULL, 0));
+		return 0;
+	}
+
+	if(argc >= 2 && strcmp(argv[1], "bench") == 0) {
+		fp_rand_bench(argc >= 3 ? strtoul(argv[2], NULL, 0) : 4096);
+		return 0;
+	}
+
+	if(argc >= 2) {
+		printf("usage: rand [seed <n>|bench [<count>]]\n");
+		return 1;
+	}
+
+	printf("seed: %llu\n", (unsigned long long)fp_rand_get_seed());
+	return 0;
+}
+
+bool fp_rand_console_init() {
+	return fp_console_register("rand", "random streams: seed <n> makes the run reproducible, bench [<count>]", &fp_rand_command);
+}
@@ -0,0 +1,72 @@
+#ifndef RAND_H
+#define RAND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "color.h"
+#include "frame.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_rand
+ * fast seedable pseudorandom streams (PCG32) for effects, in place of the hardware RNG (esp_random),
+ * which is slow to read per pixel and can't be reproduced.
+ * a stream is owned by one task or view. streams with the same seed and different stream ids are independent.
+ *
+ * every stream is seeded from the global seed, which is taken from the hardware RNG at init.
+ * fp_rand_set_seed makes the run reproducible: streams that follow the global seed restart from it
+ * the next time their owner calls fp_rand_sync, and produce the same values on every run
+ * (e.g. to record a golden capture, see capture.h).
+ * not for cryptographic use.
+ */
+
+#define FP_RAND_TASK_COUNT 16
+
+typedef struct {
+	uint64_t state;
+	/* selects the stream. always odd */
+	uint64_t increment;
+	/* stream id, to reseed from a new global seed */
+	uint64_t stream;
+	/* global seed generation the stream was seeded with */
+	unsigned int generation;
+	/* false for explicitly seeded streams */
+	bool followsSeed;
+} fp_rand;
+
+/** seeds the global seed from the hardware RNG */
+void fp_rand_init();
+/** replaces the global seed. streams that follow it reseed on their next fp_rand_sync */
+void fp_rand_set_seed(uint64_t seed);
+uint64_t fp_rand_get_seed();
+
+/** seed a stream from the global seed. use a fixed stream id (e.g. a constant per effect) so reproducible runs match */
+void fp_rand_seed(fp_rand* rand, uint64_t stream);
+/** reseeds the stream if the global seed changed since it was seeded. call it from the stream's owner before drawing a batch
+ * @return true if the stream was reseeded, so state derived from it can be rebuilt */
+bool fp_rand_sync(fp_rand* rand);
+/** seed a stream from an explicit seed, independent of the global seed */
+void fp_rand_seed_explicit(fp_rand* rand, uint64_t seed, uint64_t stream);
+
+/** the calling task's stream, seeded on first use from the global seed and the task name, and synced on every call.
+ * tasks with the same name draw the same values. they should seed their own streams.
+ * returns NULL if a stream can't be allocated for the task */
+fp_rand* fp_rand_task();
+
+uint32_t fp_rand_next(fp_rand* rand);
+/** uniform in [0, bound). bound must not be 0 */
+uint32_t fp_rand_range(fp_rand* rand, uint32_t bound);
+
+/** batch APIs. one step of the generator fills 4 bytes or one pixel */
+void fp_rand_fill(fp_rand* rand, void* buffer, size_t size);
+/** random colors, with the unused byte of rgb_color cleared */
+void fp_rand_fill_span(fp_rand* rand, rgb_color* out, unsigned int width);
+bool fp_rand_fill_frame(fp_rand* rand, fp_frameid id);
+
+/** registers the "rand" console command */
+bool fp_rand_console_init();
+
+#endif /* RAND_H */
@@ -1,35 +1,131 @@
 #include "render.h"
 
 #include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
 
 #include "view.h"
+#include "display-list.h"
+#include "trace.h"
+#include "telemetry.h"
+#include "budget.h"
 /* TODO: this is a bad include, rework this */
 #include "views/ws2812-view.h"
+/* after the views, global.h defines FP_INDEX_ZIGZAG */
+#include "global.h"
+#include "profile.h"
 
-/* circular buffer */
+/* render requests from any task are pushed into this ring, and drained once per frame by the render task */
+fp_ring* renderRequests = NULL;
+/* incremented by fp_queue_reset. requests queued with an older generation are dropped */
+atomic_uint renderGeneration = 0;
+
+/* circular buffer, only accessed by the render task */
 unsigned int pendingViewRenderCount = 0;
 unsigned int pendingViewRenderIndex = 0;
 fp_pending_view_render pendingViewRenderPool[FP_PENDING_VIEW_RENDER_COUNT];
 
+TaskHandle_t renderTask = NULL;
+fp_render_stats renderStats = { 0 };
+
+/* earliest input timestamp of the pending urgent render, 0 if none. -1 marks an urgent render without a timestamp */
+atomic_llong urgentInputTimestamp = 0;
+/* only accessed by the render task */
+int64_t frameInputTimestamp = 0;
+/* time the current pass waited on output, see fp_render_add_output_wait. only accessed by the render task */
+int64_t frameOutputWaitUs = 0;
+
+/* recorded from the output tasks and read from the console. 64 bit fields can't be updated atomically, so both take latencyLock */
+fp_input_latency_stats latencyStats = { 0 };
+portMUX_TYPE latencyLock = portMUX_INITIALIZER_UNLOCKED;
+
+/* incremented when the render task enters and leaves a pass. odd while a pass is in progress */
+atomic_uint renderEpoch = 0;
+/* fp_render_deferred. run by the render task between passes */
+fp_ring* deferredFrees = NULL;
+atomic_bool stopRequested = false;
+atomic_bool stopped = false;
+
+static void fp_render_count_wakeup(TickType_t currentTick) {
+	renderStats.wakeups++;
+	renderStats.windowWakeups++;
+	if(currentTick - renderStats.windowStartTick >= pdMS_TO_TICKS(1000)) {
+		unsigned int windowMs = (currentTick - renderStats.windowStartTick) * portTICK_PERIOD_MS;
+		renderStats.wakeupsPerSecond = renderStats.windowWakeups * 1000 / windowMs;
+		renderStats.rendersPerSecond = renderStats.windowRenders * 1000 / windowMs;
+		renderStats.windowWakeups = 0;
+		renderStats.windowRenders = 0;
+		renderStats.windowStartTick = currentTick;
+	}
+}
+
+bool fp_render_init() {
+	renderRequests = fp_ring_init(FP_PENDING_VIEW_RENDER_COUNT, sizeof(fp_pending_view_render));
+	deferredFrees = fp_ring_init(FP_RENDER_DEFERRED_COUNT, sizeof(fp_render_deferred));
+	fp_telemetry_register_ring("render requests", renderRequests);
+	fp_telemetry_register_ring("deferred frees", deferredFrees);
+	return renderRequests != NULL && deferredFrees != NULL;
+}
+
 void fp_queue_reset() {
-	pendingViewRenderCount = 0;
-	pendingViewRenderIndex = 0;
+	atomic_fetch_add_explicit(&renderGeneration, 1, memory_order_relaxed);
 }
 
 bool fp_queue_render(fp_viewid view, TickType_t tick) {
-	if(pendingViewRenderCount >= FP_PENDING_VIEW_RENDER_COUNT) {
+	fp_view* target = fp_view_get(view);
+	if(!target) {
+		return false;
+	}
+
+	if(target->degrade >= FP_VIEW_DEGRADE_HALF_RATE) {
+		/* stretch the delay the view asked for, so self-scheduled updates run at half rate */
+		TickType_t currentTick = xTaskGetTickCount();
+		if((int32_t)(tick - currentTick) > 0) {
+			tick += tick - currentTick;
+		}
+	}
+
+	fp_pending_view_render render = {
+		view,
+		tick,
+		atomic_load_explicit(&renderGeneration, memory_order_relaxed),
+		target->serial
+	};
+
+	if(!fp_ring_push(renderRequests, &render)) {
 		printf("error: fp_queue_render: pending render pool full. limit: %d\n", FP_PENDING_VIEW_RENDER_COUNT);
 		return false;
 	}
 
+	/* the new render may be earlier than the deadline the render task is sleeping until */
+	fp_render_wake();
+	return true;
+}
+
+/* requeue a render on the render task's pending buffer */
+static bool fp_requeue_render(fp_pending_view_render render) {
+	if(pendingViewRenderCount >= FP_PENDING_VIEW_RENDER_COUNT) {
+		printf("error: fp_requeue_render: pending render pool full. limit: %d\n", FP_PENDING_VIEW_RENDER_COUNT);
+		return false;
+	}
+
 	unsigned int nextRender = (pendingViewRenderIndex + pendingViewRenderCount) % FP_PENDING_VIEW_RENDER_COUNT;
 	pendingViewRenderCount++;
-	pendingViewRenderPool[nextRender].view = view;
-	pendingViewRenderPool[nextRender].tick = tick;
+	pendingViewRenderPool[nextRender] = render;
 
 	return true;
 }
 
+/* move new requests from the ring to the pending buffer, dropping any made stale by fp_queue_reset */
+static void fp_drain_render_requests() {
+	unsigned int generation = atomic_load_explicit(&renderGeneration, memory_order_relaxed);
+	fp_pending_view_render render;
+	while(pendingViewRenderCount < FP_PENDING_VIEW_RENDER_COUNT && fp_ring_pop(renderRequests, &render)) {
+		if(render.generation == generation) {
+			fp_requeue_render(render);
+		}
+	}
+}
+
 fp_pending_view_render fp_dequeue_render() {
 
 	fp_pending_view_render render = pendingViewRenderPool[pendingViewRenderIndex];
@@ -45,6 +141,15 @@ fp_pending_view_render fp_dequeue_render() {
 	return render;
 }
 
+bool fp_queue_command_send(fp_ring* commands, const fp_queue_command* command) {
+	if(!fp_ring_push(commands, command)) {
+		return false;
+	}
+
+	fp_render_wake();
+	return true;
+}
+
 void fp_task_render(void *pvParameters) {
 	const fp_task_render_params* params = (const fp_task_render_params*) pvParameters;
 	/* ws2812_control_init(); */
@@ -55,12 +160,36 @@ void fp_task_render(void *pvParameters) {
 	/* fp_ffill_rect(frame1, 0, 0, 4, 4, rgb(0, 0, brightness)); */
 
 
+	renderTask = xTaskGetCurrentTaskHandle();
+
 	TickType_t lastWakeTime = xTaskGetTickCount();
+	TickType_t lastRenderTick = lastWakeTime;
+	renderStats.windowStartTick = lastWakeTime;
 	while(true) {
+		if(atomic_load(&stopRequested)) {
+			/* quiescent, the epoch is even. never render again */
+			atomic_store(&stopped, true);
+			vTaskSuspend(NULL);
+		}
+
+		/* quiescent: nothing from the last pass is referenced anymore, and every pending render still holds a serial.
+		 * anything retired before this point can be freed */
+		fp_render_deferred deferred;
+		while(fp_ring_pop(deferredFrees, &deferred)) {
+			deferred.fn(deferred.arg);
+		}
+		FP_PROFILE_SYNC();
+
+		/* odd epoch: the render task may hold references to views until the next boundary */
+		atomic_fetch_add(&renderEpoch, 1);
+		int64_t passStart = esp_timer_get_time();
+		frameOutputWaitUs = 0;
+		FP_PROFILE_BEGIN_OP("render pass");
+		fp_trace_begin("render pass");
 
 		/* process commands */
 		fp_queue_command command;
-		while(xQueueReceive(params->commands, &command, 0) == pdPASS) {
+		while(fp_ring_pop(params->commands, &command)) {
 			switch(command.cmd) {
 				case FILL_RECT:
 					fp_ffill_rect(
@@ -81,45 +210,222 @@ void fp_task_render(void *pvParameters) {
 					);
 					break;
 				case RENDER:
-					xSemaphoreTake(params->shutdownLock, portMAX_DELAY);
 					fp_render_leds_ws2812(command.fargs.RENDER.id);
-					xSemaphoreGive(params->shutdownLock);
 					break;
 				case RENDER_VIEW:
-					xSemaphoreTake(params->shutdownLock, portMAX_DELAY);
 					fp_view_render(command.fargs.RENDER_VIEW.id);
-					xSemaphoreGive(params->shutdownLock);
+					break;
+				case DISPLAY_LIST:
+					fp_display_list_execute(command.fargs.DISPLAY_LIST.list);
+					fp_display_list_free(command.fargs.DISPLAY_LIST.list);
+					break;
+				case CALL:
+					command.fargs.CALL.fn(command.fargs.CALL.arg, command.fargs.CALL.value);
 					break;
 			}
 		}
 
+		/* take urgent requests made so far. any made after this wake the task again */
+		frameInputTimestamp = atomic_exchange_explicit(&urgentInputTimestamp, 0, memory_order_acq_rel);
+
 		TickType_t currentTick = xTaskGetTickCount();
 		/* composite the image */
 		/* TODO */
 		/* process each pending render by dequeuing. requeue if the render is still pending */
 		/* TODO: just us a vector for this? */
+		FP_PROFILE_BEGIN_OP("pending renders");
+		fp_drain_render_requests();
+		unsigned int generation = atomic_load_explicit(&renderGeneration, memory_order_relaxed);
 		int originalPendingViewRenderCount = pendingViewRenderCount;
 		for(int i = 0; i < originalPendingViewRenderCount; i++) {
 			fp_pending_view_render pendingRender = fp_dequeue_render();
+			if(pendingRender.generation != generation
+				|| !fp_view_is_alive(pendingRender.view, pendingRender.serial)) {
+				/* reset or freed while this render was pending */
+				continue;
+			}
+
 			if(pendingRender.tick <= currentTick) {
 				fp_view_onnext_render(pendingRender.view);
 				fp_view_mark_dirty(pendingRender.view); 
 			}
 			else {
-				// requeue
-				unsigned int nextRender = (pendingViewRenderIndex + pendingViewRenderCount) % FP_PENDING_VIEW_RENDER_COUNT;
-				pendingViewRenderCount++;
-				pendingViewRenderPool[nextRender].view = pendingRender.view;
-				pendingViewRenderPool[nextRender].tick = pendingRender.tick;
+				fp_requeue_render(pendingRender);
 			}
 		}
+		FP_PROFILE_END();
 
 		fp_view* rootView = fp_view_get(params->rootView);
+		if(params->keepAliveMs > 0 && currentTick - lastRenderTick >= pdMS_TO_TICKS(params->keepAliveMs)) {
+			rootView->dirty = true;
+		}
+
+		if(frameInputTimestamp != 0) {
+			rootView->dirty = true;
+		}
+
 		if(rootView->dirty) {
-			xSemaphoreTake(params->shutdownLock, portMAX_DELAY);
+			int64_t renderStart = esp_timer_get_time();
 			fp_view_render(params->rootView);
-			xSemaphoreGive(params->shutdownLock);
+			int64_t renderEnd = esp_timer_get_time();
+			fp_telemetry_record(FP_TELEMETRY_RENDER, renderEnd - renderStart);
+			/* the whole pass counts against the budget, including commands and onnext_render callbacks,
+			 * but not time spent waiting on the output stage */
+			fp_budget_update(params->rootView, renderEnd - passStart - frameOutputWaitUs);
+			lastRenderTick = currentTick;
+			renderStats.renders++;
+			renderStats.windowRenders++;
+		}
+		renderStats.pendingRenders = pendingViewRenderCount;
+		frameInputTimestamp = 0;
+		fp_trace_end("render pass");
+		FP_PROFILE_END();
+
+		/* epoch boundary. nothing read during this pass is referenced after this point */
+		atomic_fetch_add(&renderEpoch, 1);
+
+		/* sleep until the earliest of: the next pending render, a wake notification, or the keep alive deadline */
+		currentTick = xTaskGetTickCount();
+		TickType_t wakeTick = currentTick + portMAX_DELAY / 2;
+		if(params->keepAliveMs > 0) {
+			wakeTick = lastRenderTick + pdMS_TO_TICKS(params->keepAliveMs);
+		}
+		if(rootView->dirty) {
+			/* dirtied by onnext_render or the render itself */
+			wakeTick = currentTick;
+		}
+		for(unsigned int i = 0; i < pendingViewRenderCount; i++) {
+			TickType_t tick = pendingViewRenderPool[(pendingViewRenderIndex + i) % FP_PENDING_VIEW_RENDER_COUNT].tick;
+			if((int32_t)(tick - wakeTick) < 0) {
+				wakeTick = tick;
+			}
+		}
+
+		/* never render more often than refresh_period_ms */
+		TickType_t earliestTick = lastWakeTime + pdMS_TO_TICKS(params->refresh_period_ms);
+		if((int32_t)(wakeTick - earliestTick) < 0) {
+			wakeTick = earliestTick;
+		}
+
+		if(atomic_load_explicit(&urgentInputTimestamp, memory_order_relaxed) != 0) {
+			wakeTick = currentTick;
+		}
+
+		if((int32_t)(wakeTick - currentTick) > 0) {
+			ulTaskNotifyTake(pdTRUE, wakeTick - currentTick);
+		}
+
+		/* a notification can arrive before the refresh period is over. only urgent renders skip the cap */
+		currentTick = xTaskGetTickCount();
+		while((int32_t)(earliestTick - currentTick) > 0
+			&& atomic_load_explicit(&urgentInputTimestamp, memory_order_relaxed) == 0) {
+			/* other wakes are handled once the cap has passed */
+			ulTaskNotifyTake(pdTRUE, earliestTick - currentTick);
+			currentTick = xTaskGetTickCount();
+		}
+
+		lastWakeTime = xTaskGetTickCount();
+		if((int32_t)(lastWakeTime - wakeTick) > (int32_t)pdMS_TO_TICKS(params->refresh_period_ms)) {
+			/* woke more than a frame after the deadline */
+			fp_trace_instant("frame late");
+		}
+		fp_render_count_wakeup(lastWakeTime);
+	}
+}
+
+void fp_render_wake() {
+	TaskHandle_t task = renderTask;
+	if(task == NULL || task == xTaskGetCurrentTaskHandle()) {
+		/* the render task checks for work before it sleeps */
+		return;
+	}
+
+	xTaskNotifyGive(task);
+}
+
+void IRAM_ATTR fp_render_wake_from_isr(BaseType_t* higherPriorityTaskWoken) {
+	if(renderTask != NULL) {
+		vTaskNotifyGiveFromISR(renderTask, higherPriorityTaskWoken);
+	}
+}
+
+bool fp_render_defer(fp_deferred_fn fn, void* arg) {
+	fp_render_deferred deferred = { fn, arg };
+	if(!fp_ring_push(deferredFrees, &deferred)) {
+		printf("error: fp_render_defer: deferred free ring full. limit: %d\n", FP_RENDER_DEFERRED_COUNT);
+		return false;
+	}
+
+	fp_render_wake();
+	return true;
+}
+
+unsigned int fp_render_get_epoch() {
+	return atomic_load(&renderEpoch);
+}
+
+void fp_render_stop() {
+	atomic_store(&stopRequested, true);
+	if(renderTask == NULL) {
+		return;
+	}
+
+	fp_render_wake();
+	while(!atomic_load(&stopped)) {
+		vTaskDelay(1);
+	}
+}
+
+fp_render_stats fp_render_get_stats() {
+	return renderStats;
+}
+
+void fp_render_urgent(int64_t inputTimestamp) {
+	if(inputTimestamp == 0) {
+		inputTimestamp = -1;
+	}
+
+	/* keep the earliest timestamp of all coalesced events */
+	long long current = atomic_load_explicit(&urgentInputTimestamp, memory_order_relaxed);
+	while(current == 0 || current == -1 || (inputTimestamp != -1 && inputTimestamp < current)) {
+		if(atomic_compare_exchange_weak_explicit(&urgentInputTimestamp, &current, inputTimestamp, memory_order_release, memory_order_relaxed)) {
+			break;
 		}
-		vTaskDelayUntil(&lastWakeTime, pdMS_TO_TICKS(params->refresh_period_ms));
 	}
+
+	fp_render_wake();
+}
+
+int64_t fp_render_get_frame_input_timestamp() {
+	return frameInputTimestamp > 0 ? frameInputTimestamp : 0;
+}
+
+void fp_render_add_output_wait(int64_t us) {
+	frameOutputWaitUs += us;
+}
+
+void fp_render_record_latency(int64_t inputTimestamp) {
+	if(inputTimestamp <= 0) {
+		return;
+	}
+
+	int64_t latency = esp_timer_get_time() - inputTimestamp;
+	portENTER_CRITICAL(&latencyLock);
+	latencyStats.lastUs = latency;
+	latencyStats.totalUs += latency;
+	if(latencyStats.count == 0 || latency < latencyStats.minUs) {
+		latencyStats.minUs = latency;
+	}
+	if(latency > latencyStats.maxUs) {
+		latencyStats.maxUs = latency;
+	}
+	latencyStats.count++;
+	portEXIT_CRITICAL(&latencyLock);
+}
+
+fp_input_latency_stats fp_render_get_latency_stats() {
+	portENTER_CRITICAL(&latencyLock);
+	fp_input_latency_stats stats = latencyStats;
+	portEXIT_CRITICAL(&latencyLock);
+	return stats;
 }
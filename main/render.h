@@ -8,10 +8,13 @@
 
 #include "color.h"
 #include "frame.h"
+#include "ring.h"
 
 /* fp: fresh pixel */
 
 #define FP_PENDING_VIEW_RENDER_COUNT 64
+#define FP_RENDER_DEFERRED_COUNT 32
+#define FP_RENDER_TASK_STACK_SIZE (2048*4)
 
 bool fp_render(fp_frameid id);
 
@@ -19,16 +22,21 @@ typedef enum {
 	SET_RECT,
 	FILL_RECT,
 	RENDER,
-	RENDER_VIEW
+	RENDER_VIEW,
+	DISPLAY_LIST,
+	CALL
 } fp_command;
 
 typedef unsigned int fp_viewid;
 
+typedef void (*fp_command_fn) (void* arg, int32_t value);
+
 typedef union {
 	struct {
 		fp_frameid id;
 		unsigned int x;
 		unsigned int y;
+		/* must stay valid until the command is processed. prefer a display list, which copies the pixels */
 		fp_frame* frame;
 	} SET_RECT;
 	struct {
@@ -45,6 +53,16 @@ typedef union {
 	struct {
 		fp_viewid id;
 	} RENDER_VIEW;
+	struct {
+		/* struct fp_display_list. the render task frees it after execution */
+		void* list;
+	} DISPLAY_LIST;
+	struct {
+		/* runs fn(arg, value) on the render task, e.g. to change state it reads from an input callback */
+		fp_command_fn fn;
+		void* arg;
+		int32_t value;
+	} CALL;
 } fp_fargs;
 
 typedef struct {
@@ -55,23 +73,102 @@ typedef struct {
 typedef struct {
 	fp_viewid view;
 	TickType_t tick; /* the view will be as soon as possible after this tick */
+	unsigned int generation; /* value of the render generation when queued. stale requests are dropped after fp_queue_reset */
+	unsigned int serial; /* serial of the view when queued. the render is dropped if the view was freed */
 } fp_pending_view_render;
 
 
-/** freeRTOS task that constantly renders at given framerate */
+/** freeRTOS task that renders the root view whenever it is dirty, at most once every refresh_period_ms.
+ * between frames the task blocks until the next pending render, a wake notification (new command, queued render, dirty view)
+ * or the keep alive deadline, so static scenes cost no CPU.
+ *
+ * the render path takes no locks. other tasks change what it renders by publishing with an atomic store
+ * (e.g. the scene manager's root), and free anything the old state referenced with fp_render_defer.
+ * every pass of the render task is an epoch: it holds no references to views or frames between passes */
 typedef struct {
 	int refresh_period_ms;
 	fp_viewid rootView;
-	QueueHandle_t commands;
-	/* prevents shutting down the chip while rendering, which can cause bright flashes */
-	SemaphoreHandle_t shutdownLock;
+	/* ring of fp_queue_command. any task can push, drained once per frame by the render task */
+	fp_ring* commands;
+	/* the root is re-rendered at least this often, even when nothing changed. 0 to disable */
+	unsigned int keepAliveMs;
 } fp_task_render_params;
 
+typedef struct {
+	unsigned int wakeups;
+	unsigned int renders;
+	/* wakeups and root renders over the last full second */
+	unsigned int wakeupsPerSecond;
+	unsigned int rendersPerSecond;
+	/* renders waiting for their tick at the end of the last pass */
+	unsigned int pendingRenders;
+
+	unsigned int windowWakeups;
+	unsigned int windowRenders;
+	TickType_t windowStartTick;
+} fp_render_stats;
+
+typedef void (*fp_deferred_fn) (void* arg);
+
+typedef struct {
+	fp_deferred_fn fn;
+	void* arg;
+} fp_render_deferred;
+
+/** time from the input ISR to the end of the LED transmission that shows its result */
+typedef struct {
+	unsigned int count;
+	int64_t lastUs;
+	int64_t minUs;
+	int64_t maxUs;
+	int64_t totalUs;
+} fp_input_latency_stats;
+
+/** allocates the render request ring. call before queueing any renders */
+bool fp_render_init();
+
+/** drop all pending renders. safe to call from any task */
 void fp_queue_reset();
 
+/** request onnext_render on a view at or after tick. lock-free, safe to call from any task */
 bool fp_queue_render(fp_viewid view, TickType_t tick);
+/** render task only. dequeues from the renders already drained from the request ring */
 fp_pending_view_render fp_dequeue_render();
 
+/** copies the command into the render task's command ring. lock-free, safe to call from any task */
+bool fp_queue_command_send(fp_ring* commands, const fp_queue_command* command);
+
 void fp_task_render(void *pvParameters);
 
+/** wakes the render task so it picks up new work before its next deadline. no-op when called from the render task */
+void fp_render_wake();
+void IRAM_ATTR fp_render_wake_from_isr(BaseType_t* higherPriorityTaskWoken);
+
+fp_render_stats fp_render_get_stats();
+
+/** run fn(arg) on the render task at its next epoch boundary, when it no longer references anything that was
+ * unpublished before this call. use to free view trees, frames and published state replaced with an atomic swap.
+ * safe to call from any task */
+bool fp_render_defer(fp_deferred_fn fn, void* arg);
+unsigned int fp_render_get_epoch();
+/** blocks until the render task is between passes, and stops it for good. use before restarting the chip,
+ * since cutting a render short can leave the LEDs flashing */
+void fp_render_stop();
+
+/** urgent render: wake the render task and render the root immediately, ignoring the refresh_period_ms frame cap.
+ * call from an input callback after marking the changed views dirty.
+ * events that arrive before the render starts are coalesced; latency is measured from the earliest one.
+ * @param inputTimestamp - esp_timer_get_time() of the input event, usually fp_input_get_event_timestamp(). 0 to skip latency tracking */
+void fp_render_urgent(int64_t inputTimestamp);
+
+/** input timestamp of the urgent render the render task is currently performing, or 0.
+ * output views pass it along to fp_render_record_latency once the frame is transmitted */
+int64_t fp_render_get_frame_input_timestamp();
+/** render task only. time the current pass spent waiting on output (a pipeline buffer, a synchronous transmit),
+ * which is left out of the cost charged to the frame budget, since degrading views can't shorten it */
+void fp_render_add_output_wait(int64_t us);
+/** record that a frame triggered by the input at inputTimestamp finished transmitting. safe to call from any task, not from an ISR */
+void fp_render_record_latency(int64_t inputTimestamp);
+fp_input_latency_stats fp_render_get_latency_stats();
+
 #endif /* RENDER_H */
@@ -0,0 +1,299 @@
+#include "ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#include "mem.h"
+#include "console.h"
+
+static void* fp_ring_get_element(fp_ring* ring, unsigned int position) {
+	return (char*)ring->elements + (position & ring->mask) * ring->elementSize;
+}
+
+fp_ring* fp_ring_init(unsigned int capacity, unsigned int elementSize) {
+	if(capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		printf("error: fp_ring_init: capacity must be a power of two: %u\n", capacity);
+		return NULL;
+	}
+
+	fp_ring* ring = fp_mem_alloc(FP_MEM_RENDER, sizeof(fp_ring));
+	if(!ring) {
+		printf("error: fp_ring_init: failed to allocate memory for ring\n");
+		return NULL;
+	}
+
+	ring->sequences = fp_mem_alloc(FP_MEM_RENDER, capacity * sizeof(atomic_uint));
+	ring->elements = fp_mem_alloc(FP_MEM_RENDER, capacity * elementSize);
+	if(!ring->sequences || !ring->elements) {
+		printf("error: fp_ring_init: failed to allocate memory for %u elements (size %u)\n", capacity, elementSize);
+		fp_mem_free(ring->sequences);
+		fp_mem_free(ring->elements);
+		fp_mem_free(ring);
+		return NULL;
+	}
+
+	ring->capacity = capacity;
+	ring->mask = capacity - 1;
+	ring->elementSize = elementSize;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+
+	for(unsigned int i = 0; i < capacity; i++) {
+		atomic_init(&ring->sequences[i], i);
+	}
+
+	return ring;
+}
+
+bool fp_ring_free(fp_ring* ring) {
+	fp_mem_free(ring->sequences);
+	fp_mem_free(ring->elements);
+	fp_mem_free(ring);
+	return true;
+}
+
+void* IRAM_ATTR fp_ring_claim(fp_ring* ring, unsigned int* position) {
+	unsigned int pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	while(true) {
+		unsigned int sequence = atomic_load_explicit(&ring->sequences[pos & ring->mask], memory_order_acquire);
+		int diff = (int)(sequence - pos);
+		if(diff == 0) {
+			/* slot is free for this lap, try to claim it. on failure pos is reloaded */
+			if(atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				*position = pos;
+				return fp_ring_get_element(ring, pos);
+			}
+		}
+		else if(diff < 0) {
+			/* the consumer hasn't released this slot yet */
+			return NULL;
+		}
+		else {
+			/* another producer claimed it first */
+			pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+		}
+	}
+}
+
+void IRAM_ATTR fp_ring_commit(fp_ring* ring, unsigned int position) {
+	atomic_store_explicit(&ring->sequences[position & ring->mask], position + 1, memory_order_release);
+}
+
+bool IRAM_ATTR fp_ring_push(fp_ring* ring, const void* element) {
+	unsigned int position;
+	void* slot = fp_ring_claim(ring, &position);
+	if(!slot) {
+		return false;
+	}
+
+	memcpy(slot, element, ring->elementSize);
+	fp_ring_commit(ring, position);
+	return true;
+}
+
+bool fp_ring_pop(fp_ring* ring, void* element) {
+	unsigned int pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	unsigned int sequence = atomic_load_explicit(&ring->sequences[pos & ring->mask], memory_order_acquire);
+	if((int)(sequence - (pos + 1)) < 0) {
+		/* empty, or the producer hasn't committed yet */
+		return false;
+	}
+
+	memcpy(element, fp_ring_get_element(ring, pos), ring->elementSize);
+
+	/* release the slot for the next lap */
+	atomic_store_explicit(&ring->sequences[pos & ring->mask], pos + ring->capacity, memory_order_release);
+	atomic_store_explicit(&ring->tail, pos + 1, memory_order_relaxed);
+	return true;
+}
+
+unsigned int fp_ring_count(fp_ring* ring) {
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	return head - tail;
+}
+
+/* stress test. producers on both cores push numbered items while the console task pops them,
+ * and every item must arrive exactly once and in order per producer */
+
+#define FP_RING_TEST_CAPACITY 16
+#define FP_RING_TEST_MAX_PRODUCERS 8
+#define FP_RING_TEST_STACK_SIZE 2048
+/* fail if nothing arrives for this long */
+#define FP_RING_TEST_TIMEOUT_US 2000000
+
+typedef struct {
+	unsigned int producer;
+	unsigned int sequence;
+} fp_ring_test_item;
+
+typedef struct {
+	fp_ring* ring;
+	unsigned int producer;
+	unsigned int items;
+	unsigned int fullCount;
+	SemaphoreHandle_t done;
+} fp_ring_test_producer;
+
+/* set by the consumer when it's done, so producers stuck on a full ring exit. one test runs at a time */
+atomic_bool ringTestAbort = false;
+
+static void fp_ring_test_producer_task(void* pvParameters) {
+	fp_ring_test_producer* producer = pvParameters;
+	for(unsigned int i = 0; i < producer->items && !atomic_load(&ringTestAbort); i++) {
+		fp_ring_test_item item = { producer->producer, i };
+		while(true) {
+			bool pushed;
+			/* odd producers construct in place, so both paths race */
+			if(producer->producer & 1) {
+				unsigned int position;
+				fp_ring_test_item* slot = fp_ring_claim(producer->ring, &position);
+				if(slot) {
+					*slot = item;
+					fp_ring_commit(producer->ring, position);
+				}
+				pushed = slot != NULL;
+			}
+			else {
+				pushed = fp_ring_push(producer->ring, &item);
+			}
+
+			if(pushed) {
+				break;
+			}
+
+			producer->fullCount++;
+			if(atomic_load(&ringTestAbort)) {
+				break;
+			}
+			taskYIELD();
+		}
+	}
+
+	xSemaphoreGive(producer->done);
+	vTaskDelete(NULL);
+}
+
+static int fp_ring_test(unsigned int producerCount, unsigned int items) {
+	fp_ring* ring = fp_ring_init(FP_RING_TEST_CAPACITY, sizeof(fp_ring_test_item));
+	fp_ring_test_producer* producers = fp_mem_calloc(FP_MEM_DEBUG, producerCount, sizeof(fp_ring_test_producer));
+	unsigned int* expected = fp_mem_calloc(FP_MEM_DEBUG, producerCount, sizeof(unsigned int));
+	SemaphoreHandle_t done = xSemaphoreCreateCounting(producerCount, 0);
+	if(!ring || !producers || !expected || !done) {
+		printf("error: fp_ring_test: failed to allocate test state\n");
+		if(ring) {
+			fp_ring_free(ring);
+		}
+		fp_mem_free(producers);
+		fp_mem_free(expected);
+		if(done) {
+			vSemaphoreDelete(done);
+		}
+		return 1;
+	}
+
+	atomic_store(&ringTestAbort, false);
+
+	unsigned int started = 0;
+	for(; started < producerCount; started++) {
+		fp_ring_test_producer* producer = &producers[started];
+		producer->ring = ring;
+		producer->producer = started;
+		producer->items = items;
+		producer->done = done;
+		if(xTaskCreatePinnedToCore(fp_ring_test_producer_task, "fp_ring_test", FP_RING_TEST_STACK_SIZE, producer, FP_CONSOLE_TASK_PRIORITY, NULL, started % 2) != pdPASS) {
+			printf("error: fp_ring_test: failed to create producer %u\n", started);
+			break;
+		}
+	}
+
+	unsigned int total = started * items;
+	unsigned int received = 0;
+	unsigned int duplicates = 0;
+	unsigned int skipped = 0;
+	unsigned int invalid = 0;
+	int64_t start = esp_timer_get_time();
+	int64_t lastReceived = start;
+	while(received < total) {
+		fp_ring_test_item item;
+		if(!fp_ring_pop(ring, &item)) {
+			if(esp_timer_get_time() - lastReceived > FP_RING_TEST_TIMEOUT_US) {
+				printf("error: fp_ring_test: timed out after %u of %u items\n", received, total);
+				break;
+			}
+			taskYIELD();
+			continue;
+		}
+
+		received++;
+		lastReceived = esp_timer_get_time();
+		if(item.producer >= started) {
+			invalid++;
+		}
+		else if(item.sequence < expected[item.producer]) {
+			duplicates++;
+		}
+		else {
+			/* anything above the expected sequence means items were lost or reordered */
+			skipped += item.sequence - expected[item.producer];
+			expected[item.producer] = item.sequence + 1;
+		}
+	}
+	int64_t elapsedUs = esp_timer_get_time() - start;
+
+	/* the producers own their state until they finish. stop any still pushing into a ring nobody drains */
+	atomic_store(&ringTestAbort, true);
+	unsigned int finished = 0;
+	while(finished < started && xSemaphoreTake(done, pdMS_TO_TICKS(FP_RING_TEST_TIMEOUT_US / 1000)) == pdTRUE) {
+		finished++;
+	}
+	if(finished < started) {
+		/* a producer is wedged. leak its state rather than free memory it may still use */
+		printf("FAIL: %u of %u producers didn't stop\n", started - finished, started);
+		return 1;
+	}
+
+	unsigned int missing = 0;
+	unsigned int fullCount = 0;
+	for(unsigned int i = 0; i < started; i++) {
+		missing += items - expected[i];
+		fullCount += producers[i].fullCount;
+	}
+	unsigned int leftover = fp_ring_count(ring);
+
+	bool passed = started == producerCount && received == total && duplicates == 0 && skipped == 0 && invalid == 0 && missing == 0 && leftover == 0;
+	printf("%s: %u producers, %u items in %lld us. duplicates %u, skipped %u, invalid %u, missing %u, left in ring %u, producer retries %u\n",
+		passed ? "pass" : "FAIL", started, received, (long long)elapsedUs, duplicates, skipped, invalid, missing, leftover, fullCount);
+
+	vSemaphoreDelete(done);
+	fp_mem_free(expected);
+	fp_mem_free(producers);
+	fp_ring_free(ring);
+	return passed ? 0 : 1;
+}
+
+static int fp_ring_command(int argc, char** argv) {
+	if(argc < 2 || strcmp(argv[1], "test") != 0) {
+		printf("usage: ring test [<producers> [<items>]]\n");
+		return 1;
+	}
+
+	unsigned int producers = argc >= 3 ? strtoul(argv[2], NULL, 0) : 4;
+	unsigned int items = argc >= 4 ? strtoul(argv[3], NULL, 0) : 10000;
+	if(producers == 0 || producers > FP_RING_TEST_MAX_PRODUCERS || items == 0) {
+		printf("usage: ring test [<producers> [<items>]]. at most %u producers\n", FP_RING_TEST_MAX_PRODUCERS);
+		return 1;
+	}
+
+	return fp_ring_test(producers, items);
+}
+
+bool fp_ring_console_init() {
+	return fp_console_register("ring", "command ring stress test: test [<producers> [<items>]]", &fp_ring_command);
+}
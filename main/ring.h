@@ -0,0 +1,48 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**
+ * fp_ring
+ * bounded lock-free multi-producer/single-consumer ring of fixed-size elements.
+ * any number of tasks (and ISRs) can push concurrently without a mutex. only one task may pop.
+ * each slot carries a sequence number, so a producer that has claimed a slot but not yet
+ * committed it never exposes a partially written element to the consumer.
+ * capacity must be a power of two.
+ */
+
+typedef struct {
+	unsigned int capacity;
+	unsigned int mask;
+	unsigned int elementSize;
+
+	/* next position claimed by a producer */
+	atomic_uint head;
+	/* next position read by the consumer. only the consumer writes this */
+	atomic_uint tail;
+
+	atomic_uint* sequences;
+	void* elements;
+} fp_ring;
+
+fp_ring* fp_ring_init(unsigned int capacity, unsigned int elementSize);
+bool fp_ring_free(fp_ring* ring);
+
+/** claim a slot to construct an element in place. returns NULL if the ring is full.
+ * the element is invisible to the consumer until fp_ring_commit is called with the returned position */
+void* fp_ring_claim(fp_ring* ring, unsigned int* position);
+void fp_ring_commit(fp_ring* ring, unsigned int position);
+
+/** copies the element into the ring. returns false if the ring is full */
+bool fp_ring_push(fp_ring* ring, const void* element);
+/** consumer only. copies the oldest element into "element". returns false if the ring is empty */
+bool fp_ring_pop(fp_ring* ring, void* element);
+/** approximate number of elements waiting */
+unsigned int fp_ring_count(fp_ring* ring);
+
+/** registers the "ring" console command, which stress tests a ring with concurrent producers on both cores */
+bool fp_ring_console_init();
+
+#endif /* RING_H */
@@ -0,0 +1,375 @@
+#include "scene-file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "esp_timer.h"
+
+#include "frame.h"
+#include "views/frame-view.h"
+#include "views/anim-view.h"
+#include "views/layer-view.h"
+#include "mem.h"
+
+#define FP_SCENE_FILE_ALIGN(size) (((size) + FP_ARENA_ALIGN - 1) & ~(size_t)(FP_ARENA_ALIGN - 1))
+/* u16 node, u8 blendMode, u16 offsetX, u16 offsetY, u8 alpha */
+#define FP_SCENE_FILE_LAYER_SIZE 8
+
+typedef struct {
+	const uint8_t* bytes;
+	size_t length;
+	size_t offset;
+	/* set when a read runs past the end of the data. reads then return 0 */
+	bool overrun;
+} fp_scene_file_reader;
+
+static const uint8_t* fp_scene_file_read_bytes(fp_scene_file_reader* reader, size_t size) {
+	if(reader->overrun || size > reader->length - reader->offset) {
+		reader->overrun = true;
+		return NULL;
+	}
+
+	const uint8_t* bytes = reader->bytes + reader->offset;
+	reader->offset += size;
+	return bytes;
+}
+
+static uint8_t fp_scene_file_read_u8(fp_scene_file_reader* reader) {
+	const uint8_t* bytes = fp_scene_file_read_bytes(reader, 1);
+	return bytes ? bytes[0] : 0;
+}
+
+static uint16_t fp_scene_file_read_u16(fp_scene_file_reader* reader) {
+	const uint8_t* bytes = fp_scene_file_read_bytes(reader, 2);
+	return bytes ? bytes[0] | (bytes[1] << 8) : 0;
+}
+
+/** pixel count of a frame, or 0 if the dimensions are empty or over FP_SCENE_FILE_MAX_FRAME_PIXELS.
+ * computed in 64 bits, so u16 dimensions can't wrap the byte sizes derived from it */
+static size_t fp_scene_file_frame_pixels(unsigned int width, unsigned int height) {
+	uint64_t pixels = (uint64_t)width * height;
+	if(pixels == 0 || pixels > FP_SCENE_FILE_MAX_FRAME_PIXELS) {
+		return 0;
+	}
+
+	return pixels;
+}
+
+typedef struct {
+	unsigned int frameCount;
+	unsigned int nodeCount;
+	/* offset of the first frame and node */
+	size_t framesOffset;
+	size_t nodesOffset;
+	/* bytes the scene needs from its arena */
+	size_t arenaSize;
+	/* largest child count of any node */
+	unsigned int maxChildren;
+} fp_scene_file_layout;
+
+/** validate the whole file and size the arena, before anything is created */
+static bool fp_scene_file_measure(fp_scene_file_reader* reader, fp_scene_file_layout* layout) {
+	const uint8_t* magic = fp_scene_file_read_bytes(reader, 4);
+	if(!magic || memcmp(magic, FP_SCENE_FILE_MAGIC, 4) != 0) {
+		printf("error: fp_scene_file_parse: not a scene file\n");
+		return false;
+	}
+
+	uint8_t version = fp_scene_file_read_u8(reader);
+	if(version != FP_SCENE_FILE_VERSION) {
+		printf("error: fp_scene_file_parse: unsupported version %d\n", version);
+		return false;
+	}
+	fp_scene_file_read_u8(reader);
+
+	layout->frameCount = fp_scene_file_read_u16(reader);
+	layout->nodeCount = fp_scene_file_read_u16(reader);
+	fp_scene_file_read_u16(reader);
+	layout->arenaSize = 0;
+	layout->maxChildren = 0;
+
+	if(reader->overrun || layout->nodeCount == 0) {
+		printf("error: fp_scene_file_parse: invalid header\n");
+		return false;
+	}
+
+	layout->framesOffset = reader->offset;
+	for(unsigned int i = 0; i < layout->frameCount; i++) {
+		unsigned int width = fp_scene_file_read_u16(reader);
+		unsigned int height = fp_scene_file_read_u16(reader);
+		size_t pixels = fp_scene_file_frame_pixels(width, height);
+		if(pixels == 0 || !fp_scene_file_read_bytes(reader, pixels * 3)) {
+			printf("error: fp_scene_file_parse: invalid frame %d (%ux%u)\n", i, width, height);
+			return false;
+		}
+
+		layout->arenaSize += FP_SCENE_FILE_ALIGN(pixels * sizeof(rgb_color));
+	}
+
+	layout->nodesOffset = reader->offset;
+	for(unsigned int i = 0; i < layout->nodeCount; i++) {
+		uint8_t type = fp_scene_file_read_u8(reader);
+		unsigned int childCount = 0;
+		switch(type) {
+			case FP_SCENE_NODE_FRAME:
+				if(fp_scene_file_read_u16(reader) >= layout->frameCount) {
+					printf("error: fp_scene_file_parse: node %d: invalid frame\n", i);
+					return false;
+				}
+				break;
+			case FP_SCENE_NODE_ANIM:
+				fp_scene_file_read_u16(reader);
+				fp_scene_file_read_u8(reader);
+				childCount = fp_scene_file_read_u16(reader);
+				for(unsigned int j = 0; j < childCount; j++) {
+					if(fp_scene_file_read_u16(reader) >= i) {
+						printf("error: fp_scene_file_parse: node %d: child %d must be an earlier node\n", i, j);
+						return false;
+					}
+				}
+				layout->arenaSize += FP_SCENE_FILE_ALIGN(childCount * sizeof(fp_viewid));
+				break;
+			case FP_SCENE_NODE_LAYER:
+				fp_scene_file_read_u16(reader);
+				fp_scene_file_read_u16(reader);
+				childCount = fp_scene_file_read_u16(reader);
+				for(unsigned int j = 0; j < childCount; j++) {
+					const uint8_t* layer = fp_scene_file_read_bytes(reader, FP_SCENE_FILE_LAYER_SIZE);
+					if(layer && (layer[0] | (layer[1] << 8)) >= i) {
+						printf("error: fp_scene_file_parse: node %d: layer %d must be an earlier node\n", i, j);
+						return false;
+					}
+					if(layer && layer[2] > FP_BLEND_ALPHA) {
+						printf("error: fp_scene_file_parse: node %d: layer %d: invalid blend mode %d\n", i, j, layer[2]);
+						return false;
+					}
+				}
+				layout->arenaSize += FP_SCENE_FILE_ALIGN(childCount * sizeof(fp_layer));
+				break;
+			default:
+				printf("error: fp_scene_file_parse: node %d: unknown type %d\n", i, type);
+				return false;
+		}
+
+		if(childCount == 0 && type != FP_SCENE_NODE_FRAME) {
+			printf("error: fp_scene_file_parse: node %d has no children\n", i);
+			return false;
+		}
+
+		if(childCount > layout->maxChildren) {
+			layout->maxChildren = childCount;
+		}
+	}
+
+	if(reader->overrun) {
+		printf("error: fp_scene_file_parse: unexpected end of file\n");
+		return false;
+	}
+
+	return true;
+}
+
+static fp_viewid fp_scene_file_create_node(
+	fp_scene_file_reader* reader,
+	const fp_frameid* frames,
+	const fp_viewid* nodes,
+	fp_viewid* children
+) {
+	uint8_t type = fp_scene_file_read_u8(reader);
+	switch(type) {
+		case FP_SCENE_NODE_FRAME:
+			return fp_frame_view_create_composite(frames[fp_scene_file_read_u16(reader)]);
+		case FP_SCENE_NODE_ANIM: {
+			unsigned int frameratePeriodMs = fp_scene_file_read_u16(reader);
+			uint8_t playback = fp_scene_file_read_u8(reader);
+			unsigned int childCount = fp_scene_file_read_u16(reader);
+			for(unsigned int i = 0; i < childCount; i++) {
+				children[i] = nodes[fp_scene_file_read_u16(reader)];
+			}
+
+			fp_viewid id = fp_anim_view_create_composite(children, childCount, frameratePeriodMs);
+			if(id != 0 && playback == FP_SCENE_ANIM_PLAY) {
+				fp_anim_play(id);
+			}
+			else if(id != 0 && playback == FP_SCENE_ANIM_PLAY_ONCE) {
+				fp_anim_play_once(id);
+			}
+			return id;
+		}
+		case FP_SCENE_NODE_LAYER: {
+			unsigned int width = fp_scene_file_read_u16(reader);
+			unsigned int height = fp_scene_file_read_u16(reader);
+			unsigned int childCount = fp_scene_file_read_u16(reader);
+			size_t layersOffset = reader->offset;
+			for(unsigned int i = 0; i < childCount; i++) {
+				const uint8_t* layer = fp_scene_file_read_bytes(reader, FP_SCENE_FILE_LAYER_SIZE);
+				children[i] = nodes[layer[0] | (layer[1] << 8)];
+			}
+
+			fp_viewid id = fp_layer_view_create_composite(width, height, children, childCount);
+			if(id == 0) {
+				return 0;
+			}
+
+			fp_layer_view_data* layerData = fp_view_get(id)->data;
+			for(unsigned int i = 0; i < childCount; i++) {
+				const uint8_t* layer = reader->bytes + layersOffset + i * FP_SCENE_FILE_LAYER_SIZE;
+				layerData->layers[i].blendMode = layer[2];
+				layerData->layers[i].offsetX = layer[3] | (layer[4] << 8);
+				layerData->layers[i].offsetY = layer[5] | (layer[6] << 8);
+				layerData->layers[i].alpha = layer[7];
+			}
+			return id;
+		}
+	}
+
+	return 0;
+}
+
+fp_viewid fp_scene_file_parse(const uint8_t* bytes, size_t length, fp_arena** arena) {
+	fp_scene_file_reader reader = { bytes, length, 0, false };
+	fp_scene_file_layout layout;
+	if(!fp_scene_file_measure(&reader, &layout)) {
+		return 0;
+	}
+
+	/* ids are only needed while loading */
+	size_t tableSize = (layout.frameCount + layout.nodeCount + layout.maxChildren) * sizeof(unsigned int);
+	unsigned int* table = fp_mem_alloc(FP_MEM_ASSET, tableSize);
+	if(!table) {
+		printf("error: fp_scene_file_parse: failed to allocate memory for id table\n");
+		return 0;
+	}
+	fp_frameid* frames = table;
+	fp_viewid* nodes = table + layout.frameCount;
+	fp_viewid* children = nodes + layout.nodeCount;
+	memset(table, 0, tableSize);
+
+	*arena = fp_arena_init(layout.arenaSize > 0 ? layout.arenaSize : FP_ARENA_ALIGN);
+	if(!*arena) {
+		printf("error: fp_scene_file_parse: failed to allocate %u byte arena\n", (unsigned int)layout.arenaSize);
+		fp_mem_free(table);
+		return 0;
+	}
+
+	fp_arena* previousArena = fp_view_get_arena();
+	fp_view_set_arena(*arena);
+
+	bool success = true;
+	reader.offset = layout.framesOffset;
+	for(unsigned int i = 0; i < layout.frameCount && success; i++) {
+		unsigned int width = fp_scene_file_read_u16(&reader);
+		unsigned int height = fp_scene_file_read_u16(&reader);
+		/* checked by fp_scene_file_measure */
+		size_t pixelCount = fp_scene_file_frame_pixels(width, height);
+		const uint8_t* channels = fp_scene_file_read_bytes(&reader, pixelCount * 3);
+
+		rgb_color* pixels = fp_arena_alloc(*arena, pixelCount * sizeof(rgb_color));
+		if(!channels || !pixels) {
+			success = false;
+			break;
+		}
+		for(size_t p = 0; p < pixelCount; p++) {
+			pixels[p] = rgb(channels[p*3], channels[p*3 + 1], channels[p*3 + 2]);
+		}
+
+		frames[i] = fp_frame_create_from_buffer(width, height, pixels);
+		success = frames[i] != 0;
+	}
+
+	reader.offset = layout.nodesOffset;
+	for(unsigned int i = 0; i < layout.nodeCount && success; i++) {
+		nodes[i] = fp_scene_file_create_node(&reader, frames, nodes, children);
+		success = nodes[i] != 0;
+	}
+
+	fp_view_set_arena(previousArena);
+
+	/* containers hold references to their children now. keep only the root */
+	fp_viewid root = success ? nodes[layout.nodeCount - 1] : 0;
+	for(unsigned int i = 0; i < layout.nodeCount; i++) {
+		if(nodes[i] != root) {
+			fp_view_release(nodes[i]);
+		}
+	}
+	for(unsigned int i = 0; i < layout.frameCount; i++) {
+		fp_frame_release(frames[i]);
+	}
+
+	fp_mem_free(table);
+
+	if(!success) {
+		printf("error: fp_scene_file_parse: failed to create scene\n");
+		fp_arena_free(*arena);
+		*arena = NULL;
+		return 0;
+	}
+
+	return root;
+}
+
+fp_viewid fp_scene_file_load(const char* path, fp_arena** arena) {
+	FILE* file = fopen(path, "rb");
+	if(!file) {
+		printf("error: fp_scene_file_load: error opening %s (%s)\n", path, strerror(errno));
+		return 0;
+	}
+
+	long fileEnd = -1;
+	if(fseek(file, 0, SEEK_END) == 0) {
+		fileEnd = ftell(file);
+	}
+	if(fileEnd <= 0 || fseek(file, 0, SEEK_SET) != 0) {
+		printf("error: fp_scene_file_load: failed to read the size of %s (%s)\n", path, fileEnd == 0 ? "empty file" : strerror(errno));
+		fclose(file);
+		return 0;
+	}
+	size_t fileSize = fileEnd;
+
+	uint8_t* bytes = fp_mem_alloc(FP_MEM_ASSET, fileSize);
+	if(!bytes) {
+		printf("error: fp_scene_file_load: failed to allocate %u bytes for %s\n", (unsigned int)fileSize, path);
+		fclose(file);
+		return 0;
+	}
+
+	size_t readSize = fread(bytes, 1, fileSize, file);
+	fclose(file);
+	if(readSize != fileSize) {
+		printf("error: fp_scene_file_load: read %u of %u bytes from %s\n", (unsigned int)readSize, (unsigned int)fileSize, path);
+		fp_mem_free(bytes);
+		return 0;
+	}
+
+	fp_viewid root = fp_scene_file_parse(bytes, readSize, arena);
+	fp_mem_free(bytes);
+
+	return root;
+}
+
+fp_viewid fp_scene_file_init(void** data) {
+	fp_scene_file* sceneFile = *data;
+
+	int64_t start = esp_timer_get_time();
+	fp_viewid root = fp_scene_file_load(sceneFile->path, &sceneFile->arena);
+	sceneFile->loadUs = esp_timer_get_time() - start;
+
+	if(root != 0) {
+		printf("scene-file: loaded %s in %lld us (%u byte arena)\n",
+			sceneFile->path, (long long)sceneFile->loadUs, (unsigned int)sceneFile->arena->capacity);
+	}
+
+	return root;
+}
+
+bool fp_scene_file_free(void** data) {
+	fp_scene_file* sceneFile = *data;
+	if(sceneFile->arena) {
+		fp_arena_free(sceneFile->arena);
+		sceneFile->arena = NULL;
+	}
+
+	return true;
+}
@@ -0,0 +1,66 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "view.h"
+#include "arena.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_scene_file
+ * loads a view graph from a compiled scene file (see tools/scene_compiler.py for the text format).
+ * all of the scene's pixels and child lists are allocated from one arena, sized from the file before anything is created,
+ * so loading doesn't malloc per node. views and frames still take slots in their pools.
+ *
+ * binary format, little endian:
+ *   header: "FPSC", u8 version, u8 reserved, u16 frameCount, u16 nodeCount, u16 reserved
+ *   frames: frameCount * { u16 width, u16 height, width*height * { u8 r, u8 g, u8 b } }
+ *   nodes: nodeCount * { u8 type, ... }. nodes only reference earlier nodes, the last node is the root
+ *     FRAME: u16 frame
+ *     ANIM: u16 frameratePeriodMs, u8 playback, u16 count, count * u16 node
+ *     LAYER: u16 width, u16 height, u16 count, count * { u16 node, u8 blendMode, u16 offsetX, u16 offsetY, u8 alpha }
+ */
+
+#define FP_SCENE_FILE_MAGIC "FPSC"
+#define FP_SCENE_FILE_VERSION 1
+#define FP_SCENE_FILE_HEADER_SIZE 12
+/* largest frame a scene file may hold. bigger frames are rejected before any size is computed from them */
+#define FP_SCENE_FILE_MAX_FRAME_PIXELS (256 * 256)
+
+typedef enum {
+	FP_SCENE_NODE_FRAME = 1,
+	FP_SCENE_NODE_ANIM = 2,
+	FP_SCENE_NODE_LAYER = 3,
+} fp_scene_node_type;
+
+typedef enum {
+	FP_SCENE_ANIM_STOP = 0,
+	FP_SCENE_ANIM_PLAY = 1, /* loop */
+	FP_SCENE_ANIM_PLAY_ONCE = 2,
+} fp_scene_anim_playback;
+
+/** scene manager data for a scene loaded from a file. use fp_scene_file_init and fp_scene_file_free as the scene's init and free */
+typedef struct {
+	const char* path;
+	/* set while the scene is loaded */
+	fp_arena* arena;
+	/* duration of the last load, including reading the file */
+	int64_t loadUs;
+} fp_scene_file;
+
+/** instantiate the scene stored in bytes. returns the root view, and the arena holding the scene in *arena.
+ * free the arena after the root view has been released */
+fp_viewid fp_scene_file_parse(const uint8_t* bytes, size_t length, fp_arena** arena);
+/** read the file at path and instantiate it */
+fp_viewid fp_scene_file_load(const char* path, fp_arena** arena);
+
+/** fp_scene_init_fn. *data must point to a fp_scene_file */
+fp_viewid fp_scene_file_init(void** data);
+/** fp_scene_free_fn */
+bool fp_scene_file_free(void** data);
+
+#endif /* SCENE_FILE_H */
@@ -0,0 +1,521 @@
+#include "scene.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "render.h"
+#include "mem.h"
+
+static bool fp_scene_manager_in_window(fp_scene_manager* manager, unsigned int current, unsigned int index) {
+	unsigned int forward = (index + manager->sceneCount - current) % manager->sceneCount;
+	unsigned int backward = (current + manager->sceneCount - index) % manager->sceneCount;
+	return forward <= manager->lookahead || backward <= manager->lookahead;
+}
+
+static void fp_scene_manager_set_parent(fp_viewid id, fp_viewid parent) {
+	if(id == 0) {
+		return;
+	}
+
+	fp_view* view = fp_view_get(id);
+	if(view) {
+		view->parent = parent;
+	}
+}
+
+/** caller holds manager->lock. returns the previous root, which may only be freed with fp_scene_manager_retire */
+static fp_scene_root* fp_scene_manager_publish(fp_scene_manager* manager, const fp_scene_root* root) {
+	fp_scene_root* next = fp_mem_alloc(FP_MEM_SCENE, sizeof(fp_scene_root));
+	if(!next) {
+		printf("error: fp_scene_manager_publish: failed to allocate memory for root\n");
+		return NULL;
+	}
+
+	*next = *root;
+	atomic_store(&manager->current, next->index);
+	return atomic_exchange(&manager->root, next);
+}
+
+static void fp_scene_manager_free_root(void* root) {
+	fp_mem_free(root);
+}
+
+/** free the old root once the render task can no longer be reading it */
+static void fp_scene_manager_retire(fp_scene_root* root) {
+	if(!root) {
+		return;
+	}
+
+	fp_render_defer(&fp_scene_manager_free_root, root);
+}
+
+typedef struct {
+	fp_scene_free_fn free;
+	fp_viewid view;
+	void* data;
+	fp_arena* arena;
+} fp_scene_retired;
+
+/* runs on the render task between passes */
+static void fp_scene_manager_free_retired(void* arg) {
+	fp_scene_retired* retired = arg;
+	fp_view_free(retired->view);
+	retired->free(&retired->data);
+	if(retired->arena) {
+		fp_arena_free(retired->arena);
+	}
+	fp_mem_free(retired);
+}
+
+/** copy a span of view into out, padding with black outside of the view */
+static void fp_scene_manager_read_span(fp_viewid view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	unsigned int viewWidth;
+	unsigned int viewHeight;
+	unsigned int copyWidth = 0;
+	if(fp_view_get_size(view, &viewWidth, &viewHeight) && y < viewHeight && x < viewWidth) {
+		copyWidth = width < viewWidth - x ? width : viewWidth - x;
+		const rgb_color* span = fp_view_get_span(view, x, y, copyWidth, out);
+		if(!span) {
+			copyWidth = 0;
+		}
+		else if(span != out) {
+			fp_span_set(out, span, copyWidth);
+		}
+	}
+
+	for(unsigned int i = copyWidth; i < width; i++) {
+		out[i] = rgb(0, 0, 0);
+	}
+}
+
+static bool fp_scene_manager_fading(const fp_scene_root* root, TickType_t currentTick) {
+	return root->fadeFromView != 0 && currentTick - root->fadeStartTick < pdMS_TO_TICKS(root->crossfadeMs);
+}
+
+static bool fp_scene_manager_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_procedural_view_data* proceduralData = view->data;
+	fp_scene_manager* manager = proceduralData->data;
+
+	/* stays valid until the render task's next epoch boundary */
+	const fp_scene_root* root = atomic_load(&manager->root);
+	if(root->view == 0) {
+		if(manager->placeholder) {
+			return manager->placeholder(view, x, y, width, out);
+		}
+
+		for(unsigned int i = 0; i < width; i++) {
+			out[i] = rgb(0, 0, 0);
+		}
+		return true;
+	}
+
+	fp_scene_manager_read_span(root->view, x, y, width, out);
+
+	TickType_t currentTick = xTaskGetTickCount();
+	if(!fp_scene_manager_fading(root, currentTick)) {
+		return true;
+	}
+
+	/* crossfade: alpha is the weight of the new scene */
+	unsigned int alpha = (currentTick - root->fadeStartTick) * 255 / pdMS_TO_TICKS(root->crossfadeMs);
+
+	fp_scene_manager_read_span(root->fadeFromView, x, y, width, manager->fadeBuffer);
+	for(unsigned int i = 0; i < width; i++) {
+		rgb_color from = manager->fadeBuffer[i];
+		out[i].fields.r = (out[i].fields.r * alpha + from.fields.r * (255 - alpha)) / 255;
+		out[i].fields.g = (out[i].fields.g * alpha + from.fields.g * (255 - alpha)) / 255;
+		out[i].fields.b = (out[i].fields.b * alpha + from.fields.b * (255 - alpha)) / 255;
+	}
+
+	return true;
+}
+
+static bool fp_scene_manager_onnext_render(fp_view* view) {
+	fp_procedural_view_data* proceduralData = view->data;
+	fp_scene_manager* manager = proceduralData->data;
+
+	TickType_t currentTick = xTaskGetTickCount();
+	const fp_scene_root* root = atomic_load(&manager->root);
+	if(root->fadeFromView != 0 && !fp_scene_manager_fading(root, currentTick)) {
+		/* the builder publishes a root without the finished fade */
+		xTaskNotifyGive(manager->buildTask);
+	}
+
+	if(fp_scene_manager_fading(root, currentTick) || (root->view == 0 && manager->placeholder)) {
+		/* the fade and the placeholder change every frame */
+		return fp_queue_render(view->id, currentTick + 1);
+	}
+
+	return true;
+}
+
+/** drop a finished fade from the published root, and detach the old scene so its animations stop dirtying the root */
+static void fp_scene_manager_finish_fade(fp_scene_manager* manager) {
+	xSemaphoreTake(manager->lock, portMAX_DELAY);
+	fp_scene_root root = *atomic_load(&manager->root);
+	if(root.fadeFromView == 0 || fp_scene_manager_fading(&root, xTaskGetTickCount())) {
+		xSemaphoreGive(manager->lock);
+		return;
+	}
+
+	fp_viewid fadeFromView = root.fadeFromView;
+	root.fadeFromView = 0;
+	root.fadeFrom = -1;
+	fp_scene_root* old = fp_scene_manager_publish(manager, &root);
+	fp_scene_manager_set_parent(fadeFromView, 0);
+	xSemaphoreGive(manager->lock);
+
+	fp_scene_manager_retire(old);
+}
+
+static bool fp_scene_manager_build(fp_scene_manager* manager, unsigned int index) {
+	fp_scene* scene = &manager->scenes[index];
+	atomic_store_explicit(&scene->state, FP_SCENE_BUILDING, memory_order_release);
+
+	size_t dedupBefore = fp_frame_get_dedup_stats().bytesSaved;
+	size_t memoryBefore = fp_mem_get_scene_usage(index).current;
+	int64_t buildStart = esp_timer_get_time();
+	/* everything this task allocates while building is counted against the scene */
+	fp_mem_set_scene(index);
+	/* without an arena, child lists are allocated from the heap */
+	scene->arena = fp_arena_init(FP_SCENE_ARENA_SIZE);
+	fp_view_set_arena(scene->arena);
+	fp_viewid view = scene->init(&scene->data);
+	fp_view_set_arena(NULL);
+	fp_mem_set_scene(-1);
+	scene->buildUs = esp_timer_get_time() - buildStart;
+	size_t memoryAfter = fp_mem_get_scene_usage(index).current;
+
+	if(view == 0) {
+		printf("error: fp_scene_manager_build: failed to build scene %d\n", index);
+		if(scene->arena) {
+			fp_arena_free(scene->arena);
+			scene->arena = NULL;
+		}
+		atomic_store_explicit(&scene->state, FP_SCENE_COLD, memory_order_release);
+		return false;
+	}
+
+	/* memory from an earlier build that hasn't been freed yet isn't counted again */
+	scene->memoryUsed = memoryAfter > memoryBefore ? memoryAfter - memoryBefore : 0;
+	scene->dedupSaved = fp_frame_get_dedup_stats().bytesSaved - dedupBefore;
+	scene->view = view;
+	printf("scene: built %d in %lld us: %zu bytes, dedup saved %zu bytes\n",
+		index, (long long)scene->buildUs, scene->memoryUsed, scene->dedupSaved);
+	manager->memoryUsed += scene->memoryUsed;
+	manager->stats.buildCount++;
+
+	xSemaphoreTake(manager->lock, portMAX_DELAY);
+	atomic_store_explicit(&scene->state, FP_SCENE_READY, memory_order_release);
+
+	fp_scene_root* old = NULL;
+	fp_scene_root root = *atomic_load(&manager->root);
+	if(root.index == index && root.view == 0) {
+		/* the current scene finished building, replace the placeholder */
+		fp_scene_manager_set_parent(view, manager->rootView);
+		root.view = view;
+		old = fp_scene_manager_publish(manager, &root);
+	}
+	xSemaphoreGive(manager->lock);
+
+	if(old) {
+		fp_view_mark_dirty(manager->rootView);
+		fp_scene_manager_retire(old);
+	}
+
+	return true;
+}
+
+static bool fp_scene_manager_evict(fp_scene_manager* manager, unsigned int index) {
+	fp_scene* scene = &manager->scenes[index];
+
+	/* allocated up front, so a failure leaves the scene READY and still owning its tree */
+	fp_scene_retired* retired = fp_mem_alloc(FP_MEM_SCENE, sizeof(fp_scene_retired));
+	if(!retired) {
+		printf("error: fp_scene_manager_evict: failed to allocate memory for retired scene\n");
+		return false;
+	}
+
+	xSemaphoreTake(manager->lock, portMAX_DELAY);
+	const fp_scene_root* root = atomic_load(&manager->root);
+	if(index == root->index
+		|| (int)index == root->fadeFrom
+		|| atomic_load_explicit(&scene->state, memory_order_relaxed) != FP_SCENE_READY) {
+		xSemaphoreGive(manager->lock);
+		fp_mem_free(retired);
+		return false;
+	}
+
+	/* a root retired before this call, or a pending render, may still be in use by the render task.
+	 * pending renders of the freed views are dropped afterwards, since their serials no longer match */
+	*retired = (fp_scene_retired){ scene->free, scene->view, scene->data, scene->arena };
+	if(!fp_render_defer(&fp_scene_manager_free_retired, retired)) {
+		xSemaphoreGive(manager->lock);
+		fp_mem_free(retired);
+		return false;
+	}
+
+	/* no root published from now on can reference the scene */
+	atomic_store_explicit(&scene->state, FP_SCENE_COLD, memory_order_release);
+	xSemaphoreGive(manager->lock);
+
+	scene->view = 0;
+	scene->arena = NULL;
+	manager->memoryUsed -= scene->memoryUsed < manager->memoryUsed ? scene->memoryUsed : manager->memoryUsed;
+	manager->stats.evictCount++;
+
+	return true;
+}
+
+/** evict least recently used scenes outside of the lookahead window until "needed" bytes fit in the budget */
+static bool fp_scene_manager_make_room(fp_scene_manager* manager, unsigned int current, size_t needed) {
+	while(manager->memoryUsed + needed > manager->memoryBudget) {
+		int lru = -1;
+		for(unsigned int i = 0; i < manager->sceneCount; i++) {
+			fp_scene* scene = &manager->scenes[i];
+			if(atomic_load_explicit(&scene->state, memory_order_relaxed) != FP_SCENE_READY
+				|| fp_scene_manager_in_window(manager, current, i)) {
+				continue;
+			}
+
+			if(lru < 0 || (int32_t)(scene->lastUsedTick - manager->scenes[lru].lastUsedTick) < 0) {
+				lru = i;
+			}
+		}
+
+		if(lru < 0 || !fp_scene_manager_evict(manager, lru)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void fp_scene_manager_update(fp_scene_manager* manager) {
+	fp_scene_manager_finish_fade(manager);
+
+	unsigned int current = atomic_load(&manager->current);
+
+	/* the current scene is always built, even over budget */
+	if(atomic_load_explicit(&manager->scenes[current].state, memory_order_relaxed) == FP_SCENE_COLD) {
+		fp_scene_manager_make_room(manager, current, manager->scenes[current].memoryUsed);
+		fp_scene_manager_build(manager, current);
+	}
+
+	/* nearest neighbours first, alternating forward and backward */
+	for(unsigned int distance = 1; distance <= manager->lookahead; distance++) {
+		unsigned int neighbours[2] = {
+			(current + distance) % manager->sceneCount,
+			(current + manager->sceneCount - distance % manager->sceneCount) % manager->sceneCount
+		};
+
+		for(int i = 0; i < 2; i++) {
+			if(atomic_load(&manager->current) != current) {
+				/* switched while building. the builder has been notified and starts over */
+				return;
+			}
+
+			fp_scene* scene = &manager->scenes[neighbours[i]];
+			if(atomic_load_explicit(&scene->state, memory_order_relaxed) != FP_SCENE_COLD) {
+				continue;
+			}
+
+			if(!fp_scene_manager_make_room(manager, current, scene->memoryUsed)) {
+				return;
+			}
+
+			fp_scene_manager_build(manager, neighbours[i]);
+		}
+	}
+
+	/* memory use of a first build isn't known in advance */
+	fp_scene_manager_make_room(manager, current, 0);
+}
+
+/* frees a manager whose creation failed. nothing else has seen it yet */
+static void fp_scene_manager_delete(fp_scene_manager* manager, fp_scene_root* root) {
+	atomic_store(&manager->root, NULL);
+	fp_mem_free(root);
+	fp_mem_free(manager->fadeBuffer);
+	if(manager->lock) {
+		vSemaphoreDelete(manager->lock);
+	}
+	fp_mem_free(manager);
+}
+
+static void fp_scene_manager_build_task(void* pvParameters) {
+	fp_scene_manager* manager = pvParameters;
+	for(;;) {
+		fp_scene_manager_update(manager);
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	}
+}
+
+fp_scene_manager* fp_scene_manager_create(
+	unsigned int width,
+	unsigned int height,
+	fp_scene* scenes,
+	unsigned int sceneCount,
+	unsigned int lookahead,
+	size_t memoryBudget,
+	fp_span_fn placeholder
+) {
+	if(sceneCount == 0) {
+		printf("error: fp_scene_manager_create: no scenes\n");
+		return NULL;
+	}
+
+	fp_scene_manager* manager = fp_mem_alloc(FP_MEM_SCENE, sizeof(fp_scene_manager));
+	if(!manager) {
+		printf("error: fp_scene_manager_create: failed to allocate memory for manager\n");
+		return NULL;
+	}
+
+	memset(manager, 0, sizeof(fp_scene_manager));
+
+	fp_scene_root* root = fp_mem_alloc(FP_MEM_SCENE, sizeof(fp_scene_root));
+	manager->fadeBuffer = fp_mem_alloc(FP_MEM_SCENE, width * sizeof(rgb_color));
+	manager->lock = xSemaphoreCreateMutex();
+	if(!root || !manager->fadeBuffer || !manager->lock) {
+		printf("error: fp_scene_manager_create: failed to allocate root, fade buffer or lock\n");
+		fp_scene_manager_delete(manager, root);
+		return NULL;
+	}
+
+	for(unsigned int i = 0; i < sceneCount; i++) {
+		scenes[i].view = 0;
+		scenes[i].arena = NULL;
+		atomic_init(&scenes[i].state, FP_SCENE_COLD);
+		scenes[i].memoryUsed = 0;
+		scenes[i].dedupSaved = 0;
+		scenes[i].buildUs = 0;
+		scenes[i].lastUsedTick = 0;
+	}
+
+	manager->scenes = scenes;
+	manager->sceneCount = sceneCount;
+	manager->lookahead = lookahead;
+	manager->memoryBudget = memoryBudget;
+	manager->width = width;
+	manager->height = height;
+	manager->placeholder = placeholder;
+
+	*root = (fp_scene_root){ 0, 0, 0, -1, 0, 0 };
+	atomic_init(&manager->root, root);
+	atomic_init(&manager->current, 0);
+
+	manager->rootView = fp_procedural_view_create(width, height, &fp_scene_manager_render_span, &fp_scene_manager_onnext_render, manager);
+	if(manager->rootView == 0) {
+		printf("error: fp_scene_manager_create: failed to create root view\n");
+		fp_scene_manager_delete(manager, root);
+		return NULL;
+	}
+
+	fp_queue_render(manager->rootView, xTaskGetTickCount());
+
+	if(xTaskCreate(fp_scene_manager_build_task, "fp_scene_build", FP_SCENE_BUILD_TASK_STACK_SIZE, manager, FP_SCENE_BUILD_TASK_PRIORITY, &manager->buildTask) != pdPASS) {
+		printf("error: fp_scene_manager_create: failed to create build task\n");
+	}
+	else {
+		fp_mem_register_task(manager->buildTask, FP_SCENE_BUILD_TASK_STACK_SIZE);
+	}
+
+	return manager;
+}
+
+fp_viewid fp_scene_manager_get_view(fp_scene_manager* manager) {
+	return manager->rootView;
+}
+
+bool fp_scene_manager_switch(fp_scene_manager* manager, unsigned int index, unsigned int crossfadeMs) {
+	if(index >= manager->sceneCount) {
+		printf("error: fp_scene_manager_switch: invalid scene %d\n", index);
+		return false;
+	}
+
+	TickType_t currentTick = xTaskGetTickCount();
+
+	xSemaphoreTake(manager->lock, portMAX_DELAY);
+	const fp_scene_root* previous = atomic_load(&manager->root);
+	if(index == previous->index) {
+		xSemaphoreGive(manager->lock);
+		return true;
+	}
+
+	fp_scene* scene = &manager->scenes[index];
+	bool ready = atomic_load_explicit(&scene->state, memory_order_relaxed) == FP_SCENE_READY;
+
+	fp_scene_root root = { index, ready ? scene->view : 0, 0, -1, currentTick, crossfadeMs };
+	if(ready && previous->view != 0 && crossfadeMs > 0) {
+		root.fadeFromView = previous->view;
+		root.fadeFrom = previous->index;
+	}
+
+	if(ready) {
+		fp_scene_manager_set_parent(scene->view, manager->rootView);
+		manager->stats.instantSwitches++;
+	}
+	else {
+		manager->stats.coldSwitches++;
+	}
+
+	manager->scenes[previous->index].lastUsedTick = currentTick;
+	scene->lastUsedTick = currentTick;
+
+	fp_scene_root* old = fp_scene_manager_publish(manager, &root);
+	if(old) {
+		/* a scene that was still fading out is cut */
+		if(old->fadeFromView != 0) {
+			fp_scene_manager_set_parent(old->fadeFromView, 0);
+		}
+		if(old->view != 0 && root.fadeFromView != old->view) {
+			fp_scene_manager_set_parent(old->view, 0);
+		}
+	}
+	xSemaphoreGive(manager->lock);
+
+	/* build the new neighbourhood in the background */
+	xTaskNotifyGive(manager->buildTask);
+
+	fp_view_mark_dirty(manager->rootView);
+	fp_queue_render(manager->rootView, currentTick);
+
+	fp_scene_manager_retire(old);
+	return true;
+}
+
+unsigned int fp_scene_manager_get_current(fp_scene_manager* manager) {
+	return atomic_load(&manager->current);
+}
+
+fp_viewid fp_scene_manager_get_current_view(fp_scene_manager* manager) {
+	fp_scene* scene = &manager->scenes[fp_scene_manager_get_current(manager)];
+	if(atomic_load_explicit(&scene->state, memory_order_acquire) != FP_SCENE_READY) {
+		return 0;
+	}
+
+	return scene->view;
+}
+
+bool fp_scene_manager_read_current(fp_scene_manager* manager, unsigned int* index) {
+	xSemaphoreTake(manager->lock, portMAX_DELAY);
+	/* roots are only replaced under the lock */
+	const fp_scene_root* root = atomic_load(&manager->root);
+	*index = root->index;
+	bool built = root->view != 0;
+	xSemaphoreGive(manager->lock);
+
+	return built;
+}
+
+fp_viewid fp_scene_manager_get_render_view(fp_scene_manager* manager, unsigned int* index) {
+	const fp_scene_root* root = atomic_load_explicit(&manager->root, memory_order_acquire);
+	*index = root->index;
+	return root->view;
+}
+
+fp_scene_manager_stats fp_scene_manager_get_stats(fp_scene_manager* manager) {
+	return manager->stats;
+}
@@ -0,0 +1,144 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "view.h"
+#include "views/procedural-view.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_scene_manager
+ * plays a playlist of scenes (view trees built by an init function).
+ * a low priority builder task keeps the current scene and its neighbours (up to "lookahead" in each direction) built
+ * ahead of time, so switching to a neighbour only changes which tree the root view reads from.
+ * scenes outside of the lookahead window are freed least recently used first, once the memory budget is exceeded.
+ * the manager's root is a frameless procedural view. it passes the current scene through,
+ * crossfades from the previous scene after a switch, and shows the placeholder while the current scene is still building.
+ *
+ * the render task reads the scene graph through a single fp_scene_root pointer, without locks.
+ * every change (switch, build finished, fade finished) publishes a new fp_scene_root with an atomic swap,
+ * the old root, and any scene no longer referenced, are freed by the render task at its next epoch boundary (fp_render_defer).
+ */
+
+#define FP_SCENE_BUILD_TASK_PRIORITY 1
+#define FP_SCENE_BUILD_TASK_STACK_SIZE 4096
+/* child lists of the views created by a scene's init are allocated from one arena per scene (fp_view_set_arena),
+ * and freed together when the scene is evicted. lists that don't fit fall back to the heap */
+#define FP_SCENE_ARENA_SIZE 512
+
+typedef fp_viewid (*fp_scene_init_fn) (void** data);
+/** called after the scene's root view has been released, so it may free memory the views referenced */
+typedef bool (*fp_scene_free_fn) (void** data);
+
+typedef enum {
+	FP_SCENE_COLD,
+	FP_SCENE_BUILDING,
+	FP_SCENE_READY
+} fp_scene_state;
+
+typedef struct {
+	fp_scene_init_fn init;
+	fp_scene_free_fn free;
+	/* custom data for init and free. init may replace it, e.g. with state allocated for the build */
+	void* data;
+
+	fp_viewid view;
+	fp_arena* arena;
+	atomic_int state;
+	/* heap allocated by the last build (see fp_mem_set_scene). used to decide whether the scene fits in the budget */
+	size_t memoryUsed;
+	/* pixel memory the last build saved by sharing identical frames (fp_frame_dedup) */
+	size_t dedupSaved;
+	/* duration of the last build */
+	int64_t buildUs;
+	TickType_t lastUsedTick;
+} fp_scene;
+
+/** immutable once published */
+typedef struct {
+	unsigned int index;
+	/* root of the current scene. 0 while it's building */
+	fp_viewid view;
+	/* scene being faded out, 0 for none */
+	fp_viewid fadeFromView;
+	int fadeFrom;
+	TickType_t fadeStartTick;
+	unsigned int crossfadeMs;
+} fp_scene_root;
+
+typedef struct {
+	unsigned int buildCount;
+	unsigned int evictCount;
+	/* switches to a scene that was already built */
+	unsigned int instantSwitches;
+	/* switches that had to wait for the builder */
+	unsigned int coldSwitches;
+} fp_scene_manager_stats;
+
+typedef struct {
+	fp_scene* scenes;
+	unsigned int sceneCount;
+	unsigned int lookahead;
+	size_t memoryBudget;
+	size_t memoryUsed;
+
+	unsigned int width;
+	unsigned int height;
+	fp_viewid rootView;
+	fp_span_fn placeholder;
+	/* serializes publishing and eviction. never taken by the render task */
+	SemaphoreHandle_t lock;
+	TaskHandle_t buildTask;
+
+	_Atomic(fp_scene_root*) root;
+	/* index of the published root, for tasks other than the render task, which must not dereference root */
+	atomic_uint current;
+	/* holds the span of the scene being faded out. only used by the render task */
+	rgb_color* fadeBuffer;
+
+	fp_scene_manager_stats stats;
+} fp_scene_manager;
+
+/** @param scenes - playlist. the manager keeps the pointer, and fills in view, state, memoryUsed and lastUsedTick
+ * @param lookahead - number of scenes before and after the current one to keep built
+ * @param memoryBudget - heap bytes the built scenes may use. the current scene is always built
+ * @param placeholder - optional. generates the root's pixels while the current scene is building */
+fp_scene_manager* fp_scene_manager_create(
+	unsigned int width,
+	unsigned int height,
+	fp_scene* scenes,
+	unsigned int sceneCount,
+	unsigned int lookahead,
+	size_t memoryBudget,
+	fp_span_fn placeholder
+);
+
+fp_viewid fp_scene_manager_get_view(fp_scene_manager* manager);
+
+/** make scene "index" current. instant if the scene is already built.
+ * @param crossfadeMs - fade from the previous scene over this duration. 0 to cut */
+bool fp_scene_manager_switch(fp_scene_manager* manager, unsigned int index, unsigned int crossfadeMs);
+
+unsigned int fp_scene_manager_get_current(fp_scene_manager* manager);
+/** root view of the current scene, or 0 if it isn't built yet.
+ * not retained: another task may free it during a switch, along with the scene's arena. only the render task may use it,
+ * through fp_scene_manager_get_render_view */
+fp_viewid fp_scene_manager_get_current_view(fp_scene_manager* manager);
+/** the current scene's index, and whether its view was built, read together under the manager's lock.
+ * no view is returned: an evicted scene's tree lives in its arena, so other tasks hand work on the view to the render task */
+bool fp_scene_manager_read_current(fp_scene_manager* manager, unsigned int* index);
+/** render task only. the index and root view of the scene in the published root, 0 if it's building.
+ * the scene and its data stay alive until the end of the render pass */
+fp_viewid fp_scene_manager_get_render_view(fp_scene_manager* manager, unsigned int* index);
+
+fp_scene_manager_stats fp_scene_manager_get_stats(fp_scene_manager* manager);
+
+#endif /* SCENE_H */
@@ -0,0 +1,276 @@
+#include "telemetry.h"
+
+#include <string.h>
+
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "esp_timer.h"
+
+#include "render.h"
+#include "mem.h"
+#include "console.h"
+#include "views/ws2812-view.h"
+
+typedef struct {
+	const char* name;
+	/* one of ring or queue */
+	fp_ring* ring;
+	QueueHandle_t queue;
+} fp_telemetry_queue;
+
+static const char* fp_telemetry_histogram_names[FP_TELEMETRY_HISTOGRAM_COUNT] = {
+	"render",
+	"output",
+};
+
+fp_histogram telemetryHistograms[FP_TELEMETRY_HISTOGRAM_COUNT];
+fp_telemetry_queue telemetryQueues[FP_TELEMETRY_QUEUE_COUNT];
+unsigned int telemetryQueueCount = 0;
+fp_viewid telemetryScreen = 0;
+fp_pipeline* telemetryPipeline = NULL;
+
+void fp_telemetry_record(fp_telemetry_histogram histogram, uint32_t us) {
+	fp_histogram* h = &telemetryHistograms[histogram];
+	unsigned int bucket = us < 2 ? 0 : 31 - __builtin_clz(us);
+	if(bucket >= FP_TELEMETRY_HISTOGRAM_BUCKETS) {
+		bucket = FP_TELEMETRY_HISTOGRAM_BUCKETS - 1;
+	}
+
+	h->buckets[bucket]++;
+	h->count++;
+	h->totalUs += us;
+	if(us > h->maxUs) {
+		h->maxUs = us;
+	}
+}
+
+fp_histogram fp_telemetry_get_histogram(fp_telemetry_histogram histogram) {
+	return telemetryHistograms[histogram];
+}
+
+void fp_telemetry_reset() {
+	memset(telemetryHistograms, 0, sizeof(telemetryHistograms));
+}
+
+static bool fp_telemetry_register(const char* name, fp_ring* ring, QueueHandle_t queue) {
+	if(!ring && !queue) {
+		return false;
+	}
+
+	if(telemetryQueueCount >= FP_TELEMETRY_QUEUE_COUNT) {
+		printf("error: fp_telemetry_register: too many queues, can't add %s\n", name);
+		return false;
+	}
+
+	telemetryQueues[telemetryQueueCount] = (fp_telemetry_queue){ name, ring, queue };
+	telemetryQueueCount++;
+	return true;
+}
+
+bool fp_telemetry_register_ring(const char* name, fp_ring* ring) {
+	return fp_telemetry_register(name, ring, NULL);
+}
+
+bool fp_telemetry_register_queue(const char* name, QueueHandle_t queue) {
+	return fp_telemetry_register(name, NULL, queue);
+}
+
+void fp_telemetry_register_output(fp_viewid screen, fp_pipeline* pipeline) {
+	telemetryScreen = screen;
+	telemetryPipeline = pipeline;
+}
+
+static void fp_telemetry_queue_depth(const fp_telemetry_queue* queue, unsigned int* count, unsigned int* capacity) {
+	if(queue->ring) {
+		*count = fp_ring_count(queue->ring);
+		*capacity = queue->ring->capacity;
+	}
+	else {
+		*count = uxQueueMessagesWaiting(queue->queue);
+		*capacity = *count + uxQueueSpacesAvailable(queue->queue);
+	}
+}
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define FP_TELEMETRY_TASK_STATS
+
+typedef struct {
+	TaskHandle_t task;
+	uint32_t runTime;
+} fp_telemetry_task_sample;
+
+/* run time counters at the previous report. only used by fp_telemetry_dump */
+fp_telemetry_task_sample telemetryTaskSamples[FP_TELEMETRY_TASK_COUNT];
+unsigned int telemetryTaskSampleCount = 0;
+uint32_t telemetryLastTotalRunTime = 0;
+
+static void fp_telemetry_dump_tasks(FILE* out, bool json) {
+	TaskStatus_t* tasks = fp_mem_alloc(FP_MEM_DEBUG, FP_TELEMETRY_TASK_COUNT * sizeof(TaskStatus_t));
+	if(!tasks) {
+		printf("error: fp_telemetry_dump_tasks: failed to allocate task status\n");
+		return;
+	}
+
+	uint32_t totalRunTime = 0;
+	unsigned int taskCount = uxTaskGetSystemState(tasks, FP_TELEMETRY_TASK_COUNT, &totalRunTime);
+	/* run time counts per core, so the total capacity over the window is the elapsed time on every core */
+	uint64_t windowRunTime = (uint64_t)(totalRunTime - telemetryLastTotalRunTime) * portNUM_PROCESSORS;
+
+	for(unsigned int i = 0; i < taskCount; i++) {
+		uint32_t lastRunTime = 0;
+		for(unsigned int j = 0; j < telemetryTaskSampleCount; j++) {
+			if(telemetryTaskSamples[j].task == tasks[i].xHandle) {
+				lastRunTime = telemetryTaskSamples[j].runTime;
+				break;
+			}
+		}
+
+		/* tenths of a percent */
+		unsigned int cpu = windowRunTime > 0 ? (uint64_t)(tasks[i].ulRunTimeCounter - lastRunTime) * 1000 / windowRunTime : 0;
+		if(json) {
+			fprintf(out, "%s{\"name\":\"%s\",\"cpu\":%u.%u,\"priority\":%u,\"stackFree\":%u}",
+				i == 0 ? "" : ",",
+				tasks[i].pcTaskName, cpu / 10, cpu % 10, (unsigned int)tasks[i].uxCurrentPriority, (unsigned int)tasks[i].usStackHighWaterMark);
+		}
+		else {
+			fprintf(out, "%-20s %5u.%u%% %8u %10u\n",
+				tasks[i].pcTaskName, cpu / 10, cpu % 10, (unsigned int)tasks[i].uxCurrentPriority, (unsigned int)tasks[i].usStackHighWaterMark);
+		}
+	}
+
+	telemetryTaskSampleCount = 0;
+	for(unsigned int i = 0; i < taskCount; i++) {
+		telemetryTaskSamples[telemetryTaskSampleCount] = (fp_telemetry_task_sample){ tasks[i].xHandle, tasks[i].ulRunTimeCounter };
+		telemetryTaskSampleCount++;
+	}
+	telemetryLastTotalRunTime = totalRunTime;
+
+	fp_mem_free(tasks);
+}
+#endif
+
+static void fp_telemetry_dump_text(FILE* out) {
+	fp_render_stats render = fp_render_get_stats();
+	fprintf(out, "uptime %lld ms, %u fps, %u wakeups/s, %u renders, %u pending renders\n",
+		(long long)(esp_timer_get_time() / 1000), render.rendersPerSecond, render.wakeupsPerSecond, render.renders, render.pendingRenders);
+
+	fp_input_latency_stats latency = fp_render_get_latency_stats();
+	if(latency.count > 0) {
+		fprintf(out, "input latency: %u events, %lld min, %lld avg, %lld max us\n",
+			latency.count, (long long)latency.minUs, (long long)(latency.totalUs / latency.count), (long long)latency.maxUs);
+	}
+
+	if(telemetryScreen != 0) {
+		fp_ws2812_stats output = fp_ws2812_view_get_stats(telemetryScreen);
+		fprintf(out, "output: %u frames sent, %u identical frames skipped\n", output.framesSent, output.framesSkipped);
+	}
+	if(telemetryPipeline) {
+		fp_pipeline_stats pipeline = fp_pipeline_get_stats(telemetryPipeline);
+		fprintf(out, "pipeline: %u composed, %u output, %u producer stalls\n", pipeline.framesComposed, pipeline.framesOutput, pipeline.producerStalls);
+	}
+
+	for(unsigned int i = 0; i < FP_TELEMETRY_HISTOGRAM_COUNT; i++) {
+		fp_histogram h = telemetryHistograms[i];
+		fprintf(out, "\n%s: %u samples, %llu avg, %u max us\n",
+			fp_telemetry_histogram_names[i], h.count, (unsigned long long)(h.count > 0 ? h.totalUs / h.count : 0), (unsigned int)h.maxUs);
+		for(unsigned int b = 0; b < FP_TELEMETRY_HISTOGRAM_BUCKETS; b++) {
+			if(h.buckets[b] > 0) {
+				fprintf(out, "  >= %6u us %8u\n", b == 0 ? 0 : 1u << b, h.buckets[b]);
+			}
+		}
+	}
+
+	fprintf(out, "\n%-20s %10s\n", "queue", "depth");
+	for(unsigned int i = 0; i < telemetryQueueCount; i++) {
+		unsigned int count, capacity;
+		fp_telemetry_queue_depth(&telemetryQueues[i], &count, &capacity);
+		char depth[24];
+		snprintf(depth, sizeof(depth), "%u/%u", count, capacity);
+		fprintf(out, "%-20s %10s\n", telemetryQueues[i].name, depth);
+	}
+
+#ifdef FP_TELEMETRY_TASK_STATS
+	fprintf(out, "\n%-20s %7s %8s %10s\n", "task", "cpu", "priority", "stack free");
+	fp_telemetry_dump_tasks(out, false);
+#else
+	fprintf(out, "\ntask stats need CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS\n");
+#endif
+
+	fp_mem_heap_stats heap = fp_mem_get_heap_stats();
+	fprintf(out, "\nheap: %zu free, %zu minimum free, %zu largest block\n", heap.freeBytes, heap.minimumFreeBytes, heap.largestFreeBlock);
+}
+
+static void fp_telemetry_dump_json(FILE* out) {
+	fp_render_stats render = fp_render_get_stats();
+	fp_input_latency_stats latency = fp_render_get_latency_stats();
+	fprintf(out, "{\"uptimeMs\":%lld,\"fps\":%u,\"wakeupsPerSecond\":%u,\"renders\":%u,\"pendingRenders\":%u",
+		(long long)(esp_timer_get_time() / 1000), render.rendersPerSecond, render.wakeupsPerSecond, render.renders, render.pendingRenders);
+	fprintf(out, ",\"latency\":{\"count\":%u,\"minUs\":%lld,\"maxUs\":%lld,\"totalUs\":%lld}",
+		latency.count, (long long)latency.minUs, (long long)latency.maxUs, (long long)latency.totalUs);
+	if(telemetryScreen != 0) {
+		fp_ws2812_stats output = fp_ws2812_view_get_stats(telemetryScreen);
+		fprintf(out, ",\"output\":{\"framesSent\":%u,\"framesSkipped\":%u}", output.framesSent, output.framesSkipped);
+	}
+	if(telemetryPipeline) {
+		fp_pipeline_stats pipeline = fp_pipeline_get_stats(telemetryPipeline);
+		fprintf(out, ",\"pipeline\":{\"framesComposed\":%u,\"framesOutput\":%u,\"producerStalls\":%u}",
+			pipeline.framesComposed, pipeline.framesOutput, pipeline.producerStalls);
+	}
+
+	fprintf(out, ",\"histograms\":{");
+	for(unsigned int i = 0; i < FP_TELEMETRY_HISTOGRAM_COUNT; i++) {
+		fp_histogram h = telemetryHistograms[i];
+		fprintf(out, "%s\"%s\":{\"count\":%u,\"totalUs\":%llu,\"maxUs\":%u,\"buckets\":[",
+			i == 0 ? "" : ",", fp_telemetry_histogram_names[i], h.count, (unsigned long long)h.totalUs, (unsigned int)h.maxUs);
+		for(unsigned int b = 0; b < FP_TELEMETRY_HISTOGRAM_BUCKETS; b++) {
+			fprintf(out, "%s%u", b == 0 ? "" : ",", h.buckets[b]);
+		}
+		fprintf(out, "]}");
+	}
+
+	fprintf(out, "},\"queues\":{");
+	for(unsigned int i = 0; i < telemetryQueueCount; i++) {
+		unsigned int count, capacity;
+		fp_telemetry_queue_depth(&telemetryQueues[i], &count, &capacity);
+		fprintf(out, "%s\"%s\":{\"count\":%u,\"capacity\":%u}", i == 0 ? "" : ",", telemetryQueues[i].name, count, capacity);
+	}
+
+	fprintf(out, "},\"tasks\":[");
+#ifdef FP_TELEMETRY_TASK_STATS
+	fp_telemetry_dump_tasks(out, true);
+#endif
+
+	fp_mem_heap_stats heap = fp_mem_get_heap_stats();
+	fprintf(out, "],\"heap\":{\"free\":%zu,\"minimumFree\":%zu,\"largestBlock\":%zu}}\n", heap.freeBytes, heap.minimumFreeBytes, heap.largestFreeBlock);
+}
+
+void fp_telemetry_dump(FILE* out, bool json) {
+	if(json) {
+		fp_telemetry_dump_json(out);
+	}
+	else {
+		fp_telemetry_dump_text(out);
+	}
+}
+
+static int fp_telemetry_command(int argc, char** argv) {
+	if(argc < 2) {
+		fp_telemetry_dump(stdout, false);
+	}
+	else if(strcmp(argv[1], "json") == 0) {
+		fp_telemetry_dump(stdout, true);
+	}
+	else if(strcmp(argv[1], "reset") == 0) {
+		fp_telemetry_reset();
+	}
+	else {
+		printf("usage: stats [json|reset]\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+bool fp_telemetry_console_init() {
+	return fp_console_register("stats", "fps, render/output times, queues, task cpu and stacks: [json|reset]", &fp_telemetry_command);
+}
@@ -0,0 +1,62 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "ring.h"
+#include "view.h"
+#include "pipeline.h"
+
+/* fp: fresh pixel */
+
+/**
+ * fp_telemetry
+ * runtime counters cheap enough to leave enabled: render and output time histograms, queue depths, frames sent and skipped,
+ * and, with CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, CPU share and stack high-water marks of every task.
+ * the "stats" console command prints them as text, or as one JSON object per line for scripts.
+ * CPU share is measured over the time since the previous report.
+ */
+
+#define FP_TELEMETRY_HISTOGRAM_BUCKETS 16
+#define FP_TELEMETRY_QUEUE_COUNT 8
+#define FP_TELEMETRY_TASK_COUNT 24
+
+typedef enum {
+	/* root view render on the render task */
+	FP_TELEMETRY_RENDER,
+	/* encoding and transmitting a frame on the pipeline output task */
+	FP_TELEMETRY_OUTPUT,
+	FP_TELEMETRY_HISTOGRAM_COUNT
+} fp_telemetry_histogram;
+
+/** log2 histogram of durations. bucket i counts durations in [2^i, 2^(i+1)) us, bucket 0 includes 0 and the last bucket everything longer.
+ * each histogram is recorded by a single task, so it isn't locked */
+typedef struct {
+	unsigned int buckets[FP_TELEMETRY_HISTOGRAM_BUCKETS];
+	unsigned int count;
+	uint32_t maxUs;
+	uint64_t totalUs;
+} fp_histogram;
+
+void fp_telemetry_record(fp_telemetry_histogram histogram, uint32_t us);
+fp_histogram fp_telemetry_get_histogram(fp_telemetry_histogram histogram);
+/** clears the histograms */
+void fp_telemetry_reset();
+
+/** report the depth of a ring or queue. name must outlive the registration */
+bool fp_telemetry_register_ring(const char* name, fp_ring* ring);
+bool fp_telemetry_register_queue(const char* name, QueueHandle_t queue);
+/** report frames sent and skipped by the ws2812 view "screen", and the counters of its pipeline. pipeline may be NULL */
+void fp_telemetry_register_output(fp_viewid screen, fp_pipeline* pipeline);
+
+/** @param json - one JSON object on a single line instead of text */
+void fp_telemetry_dump(FILE* out, bool json);
+/** registers the "stats" console command */
+bool fp_telemetry_console_init();
+
+#endif /* TELEMETRY_H */
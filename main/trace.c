@@ -0,0 +1,269 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "console.h"
+#include "mem.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+
+static inline int64_t IRAM_ATTR fp_trace_now() {
+	return esp_timer_get_time();
+}
+
+static inline uint8_t IRAM_ATTR fp_trace_core() {
+	return xPortGetCoreID();
+}
+#else
+#include <time.h>
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+/* host builds use the monotonic clock, in the same units */
+static inline int64_t fp_trace_now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000ll + now.tv_nsec / 1000;
+}
+
+static inline uint8_t fp_trace_core() {
+	return 0;
+}
+#endif
+
+#define FP_TRACE_TRACK_COUNT 16
+
+fp_trace_event* traceEvents = NULL;
+unsigned int traceMask = 0;
+/* next position claimed by a producer. positions only grow, the slot is position & traceMask */
+atomic_uint traceHead = 0;
+/* positions before this were cleared */
+atomic_uint traceStart = 0;
+atomic_bool traceRunning = false;
+
+bool fp_trace_init(unsigned int capacity) {
+	if(capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		printf("error: fp_trace_init: capacity must be a power of two, got %u\n", capacity);
+		return false;
+	}
+
+	traceEvents = fp_mem_calloc(FP_MEM_DEBUG, capacity, sizeof(fp_trace_event));
+	if(!traceEvents) {
+		printf("error: fp_trace_init: failed to allocate %u events\n", capacity);
+		return false;
+	}
+
+	for(unsigned int i = 0; i < capacity; i++) {
+		atomic_init(&traceEvents[i].sequence, 0);
+	}
+	traceMask = capacity - 1;
+	return true;
+}
+
+void fp_trace_start() {
+	if(!traceEvents) {
+		printf("error: fp_trace_start: fp_trace_init has not been called\n");
+		return;
+	}
+	atomic_store(&traceRunning, true);
+}
+
+void fp_trace_stop() {
+	atomic_store(&traceRunning, false);
+}
+
+void fp_trace_clear() {
+	atomic_store(&traceStart, atomic_load(&traceHead));
+}
+
+bool fp_trace_is_running() {
+	return atomic_load_explicit(&traceRunning, memory_order_relaxed);
+}
+
+static void IRAM_ATTR fp_trace_record(fp_trace_phase phase, const char* name, void* task) {
+	if(!atomic_load_explicit(&traceRunning, memory_order_relaxed)) {
+		return;
+	}
+
+	unsigned int position = atomic_fetch_add_explicit(&traceHead, 1, memory_order_relaxed);
+	fp_trace_event* event = &traceEvents[position & traceMask];
+
+	/* invalidate the slot before overwriting it, so a concurrent dump can't mix the old and new event */
+	atomic_store_explicit(&event->sequence, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	event->phase = phase;
+	event->core = fp_trace_core();
+	event->name = name;
+	event->task = task;
+	event->timestamp = fp_trace_now();
+
+	atomic_store_explicit(&event->sequence, position + 1, memory_order_release);
+}
+
+void fp_trace_begin(const char* name) {
+	fp_trace_record(FP_TRACE_BEGIN, name, xTaskGetCurrentTaskHandle());
+}
+
+void fp_trace_end(const char* name) {
+	fp_trace_record(FP_TRACE_END, name, xTaskGetCurrentTaskHandle());
+}
+
+void fp_trace_instant(const char* name) {
+	fp_trace_record(FP_TRACE_INSTANT, name, xTaskGetCurrentTaskHandle());
+}
+
+void IRAM_ATTR fp_trace_instant_from_isr(const char* name) {
+	fp_trace_record(FP_TRACE_INSTANT, name, NULL);
+}
+
+/** copies the event at position. returns false if it was never written, or was overwritten during the copy */
+static bool fp_trace_read(unsigned int position, fp_trace_event* out) {
+	fp_trace_event* event = &traceEvents[position & traceMask];
+	unsigned int sequence = atomic_load_explicit(&event->sequence, memory_order_acquire);
+	if(sequence != position + 1) {
+		return false;
+	}
+
+	out->phase = event->phase;
+	out->core = event->core;
+	out->name = event->name;
+	out->task = event->task;
+	out->timestamp = event->timestamp;
+
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&event->sequence, memory_order_relaxed) == sequence;
+}
+
+typedef struct {
+	void* task;
+	/* open begin events. ends whose begin was overwritten are dropped */
+	unsigned int depth;
+} fp_trace_track;
+
+void fp_trace_dump_json(FILE* out) {
+	if(!traceEvents) {
+		fprintf(out, "{\"traceEvents\":[]}\n");
+		return;
+	}
+
+	unsigned int head = atomic_load(&traceHead);
+	unsigned int start = atomic_load(&traceStart);
+	if(head - start > traceMask + 1) {
+		start = head - (traceMask + 1);
+	}
+
+	/* track 0 is for ISRs */
+	fp_trace_track tracks[FP_TRACE_TRACK_COUNT] = { { NULL, 0 } };
+	unsigned int trackCount = 1;
+	unsigned int skipped = 0;
+	bool first = true;
+
+	fprintf(out, "{\"traceEvents\":[\n");
+	for(unsigned int position = start; position != head; position++) {
+		fp_trace_event event;
+		if(!fp_trace_read(position, &event)) {
+			skipped++;
+			continue;
+		}
+
+		unsigned int track = 0;
+		if(event.task) {
+			track = 1;
+			while(track < trackCount && tracks[track].task != event.task) {
+				track++;
+			}
+			if(track == trackCount) {
+				if(trackCount == FP_TRACE_TRACK_COUNT) {
+					skipped++;
+					continue;
+				}
+				tracks[track].task = event.task;
+				tracks[track].depth = 0;
+				trackCount++;
+			}
+		}
+
+		if(event.phase == FP_TRACE_BEGIN) {
+			tracks[track].depth++;
+		}
+		else if(event.phase == FP_TRACE_END) {
+			if(tracks[track].depth == 0) {
+				continue;
+			}
+			tracks[track].depth--;
+		}
+
+		fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":0,\"tid\":%u,\"args\":{\"core\":%u}%s}",
+			first ? "" : ",\n",
+			event.name,
+			event.phase,
+			(long long)event.timestamp,
+			track,
+			event.core,
+			/* thread scoped instant */
+			event.phase == FP_TRACE_INSTANT ? ",\"s\":\"t\"" : "");
+		first = false;
+	}
+
+	/* track names. assumes the traced tasks are still alive, which holds for the tasks this app creates */
+	for(unsigned int track = 0; track < trackCount; track++) {
+		const char* name = track == 0 ? "isr" : pcTaskGetName(tracks[track].task);
+		fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n",
+			track,
+			name);
+		first = false;
+	}
+
+	fprintf(out, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"skipped\":%u}}\n", skipped);
+}
+
+static int fp_trace_command(int argc, char** argv) {
+	if(argc < 2) {
+		printf("usage: trace start|stop|clear|dump [path]\n");
+		return 1;
+	}
+
+	if(strcmp(argv[1], "start") == 0) {
+		fp_trace_start();
+	}
+	else if(strcmp(argv[1], "stop") == 0) {
+		fp_trace_stop();
+	}
+	else if(strcmp(argv[1], "clear") == 0) {
+		fp_trace_clear();
+	}
+	else if(strcmp(argv[1], "dump") == 0) {
+		if(argc < 3) {
+			fp_trace_dump_json(stdout);
+			return 0;
+		}
+
+		FILE* file = fopen(argv[2], "w");
+		if(!file) {
+			printf("error: trace: failed to open %s\n", argv[2]);
+			return 1;
+		}
+		fp_trace_dump_json(file);
+		fclose(file);
+		printf("trace: wrote %s\n", argv[2]);
+	}
+	else {
+		printf("trace: unknown subcommand %s\n", argv[1]);
+		return 1;
+	}
+
+	return 0;
+}
+
+bool fp_trace_console_init() {
+	return fp_console_register("trace", "event timeline: start|stop|clear|dump [path]", &fp_trace_command);
+}
@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+/* fp: fresh pixel */
+
+/**
+ * fp_trace
+ * timeline of timestamped begin/end/instant events from tasks and ISRs, kept in a fixed-size ring that overwrites the oldest events.
+ * recording is lock-free: a producer claims a slot with one atomic add and publishes it with a sequence number,
+ * so it is safe from any task or ISR, and costs one atomic load while tracing is stopped.
+ * the ring is dumped as Chrome trace_event JSON, which chrome://tracing and ui.perfetto.dev can open.
+ *
+ * names must be string literals (or otherwise outlive the trace). begin and end events on the same task must nest.
+ */
+
+#define FP_TRACE_DEFAULT_CAPACITY 512
+
+typedef enum {
+	FP_TRACE_BEGIN = 'B',
+	FP_TRACE_END = 'E',
+	FP_TRACE_INSTANT = 'i',
+} fp_trace_phase;
+
+typedef struct {
+	/* position + 1 once the event is written, 0 while a producer is writing it */
+	atomic_uint sequence;
+	uint8_t phase;
+	uint8_t core;
+	const char* name;
+	/* the recording task, NULL for events recorded from an ISR */
+	void* task;
+	/* microseconds, esp_timer_get_time */
+	int64_t timestamp;
+} fp_trace_event;
+
+/** allocates the ring. capacity must be a power of two */
+bool fp_trace_init(unsigned int capacity);
+
+void fp_trace_start();
+void fp_trace_stop();
+/** discards recorded events */
+void fp_trace_clear();
+bool fp_trace_is_running();
+
+void fp_trace_begin(const char* name);
+void fp_trace_end(const char* name);
+void fp_trace_instant(const char* name);
+/** instant event from an ISR. shown on the "isr" track */
+void fp_trace_instant_from_isr(const char* name);
+
+/** writes the recorded events as Chrome trace_event JSON. best stopped first, events overwritten while dumping are skipped */
+void fp_trace_dump_json(FILE* out);
+
+/** registers the "trace" console command */
+bool fp_trace_console_init();
+
+#endif /* TRACE_H */
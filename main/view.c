@@ -1,9 +1,16 @@
 #include "view.h"
 
+#include <string.h>
+#include <stdatomic.h>
+
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "pool.h"
+#include "render.h"
 #include "global.h"
+#include "profile.h"
+#include "mem.h"
 
 fp_view_register_data registered_views[FP_VIEW_TYPE_COUNT];
 
@@ -26,6 +33,7 @@ fp_view* zeroView;
 
 bool fp_view_init(unsigned int capacity) {
 	viewPool = fp_pool_init(capacity, sizeof(fp_view), true);
+	fp_mem_register_pool("view", viewPool);
 	zeroView = fp_pool_get(viewPool, 0);
 
 	zeroView->type = FP_VIEW_FRAME;
@@ -34,14 +42,41 @@ bool fp_view_init(unsigned int capacity) {
 	zeroView->dirty = false;
 	zeroView->composite = false;
 	zeroView->data = NULL;
+	zeroView->serial = 0;
+	atomic_init(&zeroView->refCount, 0);
 
 	return true;
 }
 
+/* views are created from the render, build and main tasks */
+atomic_uint nextViewSerial = 1;
+
+/* only used for views created by arenaOwner */
+fp_arena* viewArena = NULL;
+TaskHandle_t arenaOwner = NULL;
+
+fp_compositor_mode compositorMode = FP_COMPOSITOR_BUFFERED;
+
+void fp_view_set_compositor_mode(fp_compositor_mode mode) {
+	compositorMode = mode;
+}
+
+fp_compositor_mode fp_view_get_compositor_mode() {
+	return compositorMode;
+}
+
 fp_view* fp_view_get(fp_viewid id) {
 	return fp_pool_get(viewPool, id);
 }
 
+bool fp_view_is_alive(fp_viewid id, unsigned int serial) {
+	if(!fp_pool_has(viewPool, id)) {
+		return false;
+	}
+
+	return ((fp_view*)fp_pool_get(viewPool, id))->serial == serial;
+}
+
 fp_viewid fp_view_create(fp_view_type type, bool composite, fp_view_data* data) {
 	fp_viewid id = fp_pool_add(viewPool);
 	if(id == 0) {
@@ -57,6 +92,11 @@ fp_viewid fp_view_create(fp_view_type type, bool composite, fp_view_data* data)
 	view->dirty = true;
 	view->composite = composite;
 	view->data = data;
+	view->serial = atomic_fetch_add(&nextViewSerial, 1);
+	atomic_init(&view->refCount, 1);
+	view->heapData = false;
+	view->arenaChildren = false;
+	view->degrade = FP_VIEW_DEGRADE_NONE;
 
 #ifdef DEBUG
 		printf("view: create %d (%d/%d): type: %d\n", id, viewPool->count, viewPool->capacity, type);
@@ -65,7 +105,77 @@ fp_viewid fp_view_create(fp_view_type type, bool composite, fp_view_data* data)
 	return id;
 }
 
+fp_viewid fp_view_create_inline(fp_view_type type, bool composite, size_t dataSize) {
+	void* heapData = NULL;
+	if(dataSize > FP_VIEW_INLINE_DATA_SIZE) {
+		heapData = fp_mem_calloc(FP_MEM_VIEW, 1, dataSize);
+		if(!heapData) {
+			printf("error: fp_view_create_inline: failed to allocate memory for data\n");
+			return 0;
+		}
+	}
+
+	fp_viewid id = fp_view_create(type, composite, heapData);
+	if(id == 0) {
+		fp_mem_free(heapData);
+		return 0;
+	}
+
+	fp_view* view = fp_view_get(id);
+	if(heapData) {
+		view->heapData = true;
+	}
+	else {
+		memset(view->inlineData, 0, sizeof(view->inlineData));
+		view->data = view->inlineData;
+	}
+
+	return id;
+}
+
+void fp_view_set_arena(fp_arena* arena) {
+	viewArena = arena;
+	arenaOwner = arena ? xTaskGetCurrentTaskHandle() : NULL;
+}
+
+fp_arena* fp_view_get_arena() {
+	return arenaOwner == xTaskGetCurrentTaskHandle() ? viewArena : NULL;
+}
+
+void* fp_view_alloc_children(fp_view* view, size_t size) {
+	if(viewArena && arenaOwner == xTaskGetCurrentTaskHandle()) {
+		void* children = fp_arena_alloc(viewArena, size);
+		if(children) {
+			view->arenaChildren = true;
+			return children;
+		}
+	}
+
+	view->arenaChildren = false;
+	return fp_mem_alloc(FP_MEM_VIEW, size);
+}
+
+void fp_view_free_children(fp_view* view, void* children) {
+	if(!view->arenaChildren) {
+		fp_mem_free(children);
+	}
+}
+
+fp_viewid fp_view_retain(fp_viewid id) {
+	if(id == 0) {
+		return 0;
+	}
+
+	fp_view* view = fp_view_get(id);
+	atomic_fetch_add_explicit(&view->refCount, 1, memory_order_relaxed);
+	return id;
+}
+
 bool fp_view_free(fp_viewid id) {
+	return fp_view_release(id);
+}
+
+bool fp_view_release(fp_viewid id) {
 	if(id == 0) {
 		return false;
 	}
@@ -74,11 +184,20 @@ bool fp_view_free(fp_viewid id) {
 	if(view == NULL) {
 		return false;
 	}
+
+	if(atomic_fetch_sub_explicit(&view->refCount, 1, memory_order_acq_rel) != 1) {
+		return true;
+	}
+
 	bool result = registered_views[view->type].free_view(view);
 	if(!result) {
 		return result;
 	}
 
+	if(view->heapData) {
+		fp_mem_free(view->data);
+	}
+
 #ifdef DEBUG
 	printf("view: delete %d (%d/%d): type: %d\n", id, viewPool->count, viewPool->capacity, view->type);
 #endif
@@ -104,10 +223,12 @@ fp_frameid fp_view_get_frame(fp_viewid id) {
 
 void fp_view_mark_dirty(fp_viewid id) {
 	fp_view* view = fp_view_get(id);
-	view->dirty = true;
-	if(view->parent) {
-		fp_view_mark_dirty(view->parent);
+	while(view) {
+		view->dirty = true;
+		view = view->parent ? fp_view_get(view->parent) : NULL;
 	}
+
+	fp_render_wake();
 }
 
 bool fp_view_render(fp_viewid id) {
@@ -120,11 +241,12 @@ bool fp_view_render(fp_viewid id) {
 		return false;
 	}
 
-	return registered_views[view->type].render_view(view);
-
+	/* cleared first, so a render function can mark its view dirty again */
 	view->dirty = false;
-
-	return true;
+	FP_PROFILE_BEGIN_VIEW(FP_PROFILE_RENDER, view->type, id);
+	bool result = registered_views[view->type].render_view(view);
+	FP_PROFILE_END();
+	return result;
 }
 
 bool fp_view_onnext_render(fp_viewid id) {
@@ -140,3 +262,68 @@ bool fp_view_onnext_render(fp_viewid id) {
 	return registered_views[view->type].onnext_render(view);
 
 }
+
+bool fp_view_get_size(fp_viewid id, unsigned int* width, unsigned int* height) {
+	fp_view* view = fp_pool_get(viewPool, id);
+	if(!view || view->type >= FP_VIEW_TYPE_COUNT) {
+		*width = 0;
+		*height = 0;
+		return false;
+	}
+
+	if(registered_views[view->type].get_view_size) {
+		return registered_views[view->type].get_view_size(view, width, height);
+	}
+
+	fp_frame* frame = fp_frame_get(registered_views[view->type].get_view_frame(view));
+	if(!frame || frame->width == 0) {
+		*width = 0;
+		*height = 0;
+		return false;
+	}
+
+	*width = frame->width;
+	*height = fp_frame_height(frame);
+	return true;
+}
+
+bool fp_view_is_frameless(fp_viewid id) {
+	fp_view* view = fp_pool_get(viewPool, id);
+	if(!view || view->type >= FP_VIEW_TYPE_COUNT) {
+		return false;
+	}
+
+	return registered_views[view->type].render_span != NULL
+		&& registered_views[view->type].get_view_frame(view) == 0;
+}
+
+const rgb_color* fp_view_get_span(fp_viewid id, unsigned int x, unsigned int y, unsigned int width, rgb_color* buffer) {
+	fp_view* view = fp_pool_get(viewPool, id);
+	if(!view || view->type >= FP_VIEW_TYPE_COUNT) {
+		return NULL;
+	}
+
+	fp_frameid frameid = fp_view_get_frame(id);
+	if(frameid == 0) {
+		if(!registered_views[view->type].render_span) {
+			return NULL;
+		}
+
+		FP_PROFILE_BEGIN_VIEW(FP_PROFILE_SPAN, view->type, id);
+		bool result = registered_views[view->type].render_span(view, x, y, width, buffer);
+		FP_PROFILE_END();
+		return result ? buffer : NULL;
+	}
+
+	fp_frame* frame = fp_frame_get(frameid);
+	if(!frame || frame->width == 0 || x + width > frame->width) {
+		return NULL;
+	}
+
+	unsigned int index = fp_fcalc_index(x, y, frame->width);
+	if(index + width > frame->length) {
+		return NULL;
+	}
+
+	return &frame->pixels[index];
+}
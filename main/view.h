@@ -2,8 +2,11 @@
 #define VIEW_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
 
 #include "frame.h"
+#include "arena.h"
 
 /* fp: fresh pixel */
 
@@ -16,31 +19,95 @@ typedef enum {
 	FP_VIEW_LAYER,
 	FP_VIEW_TRANSITION,
 	FP_VIEW_DYNAMIC,
+	FP_VIEW_PROCEDURAL, /* frameless. pixels are generated on demand for each requested span */
+	FP_VIEW_PARTICLE,
 	FP_VIEW_TYPE_COUNT
 } fp_view_type;
 
 typedef void fp_view_data;
 
+/* type data up to this size is stored inline in the view's pool slot. larger types fall back to the heap */
+#define FP_VIEW_INLINE_DATA_SIZE 48
+
+/** cheaper ways to produce a view, set by the budget manager (see budget.h) when frames run over budget.
+ * levels are cumulative, and each view type applies the ones it supports */
+typedef enum {
+	FP_VIEW_DEGRADE_NONE,
+	FP_VIEW_DEGRADE_HALF_RATE, /* renders the view queues for itself are delayed twice as long */
+	FP_VIEW_DEGRADE_LOW_RES, /* procedural views generate every other column and duplicate it */
+	FP_VIEW_DEGRADE_SKIP, /* layer views leave the view, and its subtree, out of the composite */
+	FP_VIEW_DEGRADE_COUNT
+} fp_view_degrade;
+
+/** controls how container views (layer, transition, ws2812) produce their output.
+ * the mode is read when a view is created */
+typedef enum {
+	FP_COMPOSITOR_BUFFERED, /* each container renders into its own full-size output frame */
+	FP_COMPOSITOR_SCANLINE, /* containers don't store an output frame. the tree is evaluated one row span at a time
+							   by the root, so memory is bounded by the span size instead of tree depth * panel size */
+} fp_compositor_mode;
+
 typedef struct {
 	fp_view_type type;
 	fp_viewid id;
 	fp_viewid parent;
 	bool dirty; /* render should be called on this before fp_frame_get */
-	bool composite; /* on free_view all child views and frames are freed */
+	bool composite; /* child views and frames were provided by the caller. they are retained, and released on free */
+	/* references to this view. the creator holds the first one. container views hold one for each child */
+	atomic_uint refCount;
 	fp_view_data* data;
+	unsigned int serial; /* unique for every view created. ids are recycled, serials aren't */
+	bool heapData; /* data didn't fit inline and was allocated by fp_view_create_inline. freed with the view */
+	bool arenaChildren; /* the child list was allocated from an arena, and is freed with the arena */
+	uint8_t degrade; /* fp_view_degrade. only changed by the render task */
+	uint32_t inlineData[FP_VIEW_INLINE_DATA_SIZE / sizeof(uint32_t)];
 } fp_view;
 
 bool fp_view_init(unsigned int capacity);
 
+void fp_view_set_compositor_mode(fp_compositor_mode mode);
+fp_compositor_mode fp_view_get_compositor_mode();
+
 fp_viewid fp_view_create(fp_view_type type, bool composite, fp_view_data* data); /* used internally */
+/** creates a view with dataSize bytes of zeroed type data in view->data, stored inline when it fits. used internally */
+fp_viewid fp_view_create_inline(fp_view_type type, bool composite, size_t dataSize);
+
+/** views created by this task allocate their child lists from arena, so a whole scene's lists are contiguous
+ * and freed at once with the arena. the arena must outlive the views. NULL to allocate from the heap */
+void fp_view_set_arena(fp_arena* arena);
+/** the arena set by this task, or NULL */
+fp_arena* fp_view_get_arena();
+/** allocate a child list for a view being created. used internally */
+void* fp_view_alloc_children(fp_view* view, size_t size);
+void fp_view_free_children(fp_view* view, void* children);
+
+/** adds a reference to the view, e.g. to share it between several containers. returns id.
+ * a view only has one parent, so dirty propagation follows the container that most recently attached it */
+fp_viewid fp_view_retain(fp_viewid id);
+/** drops a reference. the view is freed when the last reference is released, which releases its children */
+bool fp_view_release(fp_viewid id);
+/** same as fp_view_release */
 bool fp_view_free(fp_viewid id);
 
 fp_view* fp_view_get(fp_viewid id);
+/** true if view "id" still exists and was created with "serial". use to detect references to freed and recycled views */
+bool fp_view_is_alive(fp_viewid id, unsigned int serial);
 fp_frameid fp_view_get_frame(fp_viewid id);
 void fp_view_mark_dirty(fp_viewid id);
 bool fp_view_render(fp_viewid id);
 bool fp_view_onnext_render(fp_viewid id);
 
+/** dimensions of the view. frame-backed views report the size of their frame */
+bool fp_view_get_size(fp_viewid id, unsigned int* width, unsigned int* height);
+/** true if the view does not store a frame, and must be read with fp_view_get_span */
+bool fp_view_is_frameless(fp_viewid id);
+/** retrieve "width" pixels of row "y", starting at column "x". the span must lie inside the view.
+ * frame-backed views return a pointer directly into their frame (no copy).
+ * frameless views generate the pixels into "buffer", which must hold at least "width" pixels, and return it.
+ * returns NULL if the span could not be produced.
+ * can trigger re-render on dirty views */
+const rgb_color* fp_view_get_span(fp_viewid id, unsigned int x, unsigned int y, unsigned int width, rgb_color* buffer);
+
 /* fp_view_type fp_view_register_type(render_func, get_view_frame_func, pending_view_update_func) */
 
 typedef struct {
@@ -48,6 +115,10 @@ typedef struct {
 	bool (*render_view) (fp_view*);
 	bool (*onnext_render) (fp_view*); /* rename... */
 	bool (*free_view) (fp_view*); /* clean up any memory the view has allocated itself. */
+	/* optional. generate "width" pixels of row "y" starting at column "x" into "out" */
+	bool (*render_span) (fp_view*, unsigned int x, unsigned int y, unsigned int width, rgb_color* out);
+	/* optional. required for views that don't store a frame */
+	bool (*get_view_size) (fp_view*, unsigned int* width, unsigned int* height);
 } fp_view_register_data;
 
 /* TODO: do this differently */
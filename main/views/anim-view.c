@@ -12,19 +12,21 @@ fp_viewid fp_anim_view_create(
 	unsigned int frameCount,
 	unsigned int frameratePeriodMs
 ) {
-	fp_viewid* frames = malloc(frameCount * sizeof(fp_viewid));
-	if(!frames) {
-		printf("error: fp_anim_view_create: failed to allocate memory for frames\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_ANIM, false, sizeof(fp_anim_view_data));
+	if(id == 0) {
+		printf("error: fp_anim_view_create: failed to create view\n");
 		return 0;
 	}
 
-	fp_anim_view_data* animData = malloc(sizeof(fp_anim_view_data));
-	if(!animData) {
-		printf("error: fp_anim_view_create: failed to allocate memory for animData\n");
-		free(frames);
+	fp_view* view = fp_view_get(id);
+	fp_viewid* frames = fp_view_alloc_children(view, frameCount * sizeof(fp_viewid));
+	if(!frames) {
+		printf("error: fp_anim_view_create: failed to allocate memory for frames\n");
+		fp_view_free(id);
 		return 0;
 	}
 
+	fp_anim_view_data* animData = view->data;
 	animData->frameCount = frameCount;
 	animData->frames = frames;
 	animData->frameIndex = 0;
@@ -32,8 +34,6 @@ fp_viewid fp_anim_view_create(
 	animData->isPlaying = false;
 	animData->loop = false;
 
-	fp_viewid id = fp_view_create(FP_VIEW_ANIM, false, animData);
-
 	/* init frames */
 	for(int i = 0; i < frameCount; i++) {
 		frames[i] = fp_frame_view_create(width, height, rgb(0,0,0));
@@ -49,19 +49,21 @@ fp_viewid fp_anim_view_create_composite(
 	unsigned int frameratePeriodMs
 ) {
 	/** copy the values from the array */
-	fp_viewid* newFrames = malloc(frameCount * sizeof(fp_viewid));
-	if(!newFrames) {
-		printf("error: fp_anim_view_create: failed to allocate memory for frames\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_ANIM, true, sizeof(fp_anim_view_data));
+	if(id == 0) {
+		printf("error: fp_anim_view_create: failed to create view\n");
 		return 0;
 	}
 
-	fp_anim_view_data* animData = malloc(sizeof(fp_anim_view_data));
-	if(!animData) {
-		printf("error: fp_anim_view_create: failed to allocate memory for animData\n");
-		free(newFrames);
+	fp_view* view = fp_view_get(id);
+	fp_viewid* newFrames = fp_view_alloc_children(view, frameCount * sizeof(fp_viewid));
+	if(!newFrames) {
+		printf("error: fp_anim_view_create: failed to allocate memory for frames\n");
+		fp_view_free(id);
 		return 0;
 	}
 
+	fp_anim_view_data* animData = view->data;
 	animData->frameCount = frameCount;
 	animData->frames = newFrames;
 	animData->frameIndex = 0;
@@ -69,11 +71,9 @@ fp_viewid fp_anim_view_create_composite(
 	animData->isPlaying = false;
 	animData->loop = false;
 
-	fp_viewid id = fp_view_create(FP_VIEW_ANIM, true, animData);
-
 	/* copy frame viewids */
 	for(int i = 0; i < frameCount; i++) {
-		newFrames[i] = frames[i];
+		newFrames[i] = fp_view_retain(frames[i]);
 		fp_view_get(newFrames[i])->parent = id;
 	}
 
@@ -85,6 +85,25 @@ fp_frameid fp_anim_view_get_frame(fp_view* view) {
 	return fp_view_get_frame(animData->frames[animData->frameIndex]);
 }
 
+/* only used when the current frame is frameless */
+bool fp_anim_view_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_anim_view_data* animData = view->data;
+	const rgb_color* span = fp_view_get_span(animData->frames[animData->frameIndex], x, y, width, out);
+	if(!span) {
+		return false;
+	}
+
+	if(span != out) {
+		fp_span_set(out, span, width);
+	}
+	return true;
+}
+
+bool fp_anim_view_get_size(fp_view* view, unsigned int* width, unsigned int* height) {
+	fp_anim_view_data* animData = view->data;
+	return fp_view_get_size(animData->frames[animData->frameIndex], width, height);
+}
+
 bool fp_anim_view_render(fp_view* view) {
 	return true;
 }
@@ -137,16 +156,25 @@ bool fp_anim_pause(fp_viewid animView) {
 	return true;
 }
 
-bool fp_anim_view_free(fp_view* view) {
+bool fp_anim_view_dedup(fp_viewid animView) {
+	fp_view* view = fp_view_get(animView);
 	fp_anim_view_data* animData = view->data;
-	if(!view->composite) {
-		for(int i = 0; i < animData->frameCount; i++) {
-			fp_view_free(animData->frames[i]);
+	for(int i = 0; i < animData->frameCount; i++) {
+		if(fp_view_get(animData->frames[i])->type == FP_VIEW_FRAME) {
+			fp_frame_view_dedup(animData->frames[i]);
 		}
 	}
 
-	free(animData->frames);
-	free(animData);
+	return true;
+}
+
+bool fp_anim_view_free(fp_view* view) {
+	fp_anim_view_data* animData = view->data;
+	for(int i = 0; i < animData->frameCount; i++) {
+		fp_view_release(animData->frames[i]);
+	}
+
+	fp_view_free_children(view, animData->frames);
 
 	return true;
 }
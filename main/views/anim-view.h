@@ -20,6 +20,7 @@ fp_viewid fp_anim_view_create(
 	unsigned int frameCount,
 	unsigned int frameratePeriodMs
 );
+/** retains each frame view. the caller may release its own references afterwards */
 fp_viewid fp_anim_view_create_composite(
 	fp_viewid* frames,
 	unsigned int frameCount,
@@ -31,18 +32,24 @@ bool fp_anim_play_once(fp_viewid animView);
 /** resumes the animation at current frame and loop continuously */
 bool fp_anim_play(fp_viewid animView);
 bool fp_anim_pause(fp_viewid animView);
+/** dedup the frames of every frame view in the animation, once they are baked (see fp_frame_dedup) */
+bool fp_anim_view_dedup(fp_viewid animView);
 
 
 fp_frameid fp_anim_view_get_frame(fp_view* view);
 bool fp_anim_view_render(fp_view* view);
 bool fp_anim_view_onnext_render(fp_view* view);
 bool fp_anim_view_free(fp_view* view);
+bool fp_anim_view_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out);
+bool fp_anim_view_get_size(fp_view* view, unsigned int* width, unsigned int* height);
 
 static const fp_view_register_data fp_anim_view_register_data = {
 	&fp_anim_view_get_frame,
 	&fp_anim_view_render,
 	&fp_anim_view_onnext_render,
-	&fp_anim_view_free
+	&fp_anim_view_free,
+	&fp_anim_view_render_span,
+	&fp_anim_view_get_size
 };
 
 #endif /* ANIM_VIEW_H */
@@ -9,18 +9,19 @@ fp_viewid fp_dynamic_view_create(
 	bool (*onnextRenderFunc) (fp_view*),
 	void* data
 ) {
-	fp_dynamic_view_data* dynamicData = malloc(sizeof(fp_dynamic_view_data));
-	if(!dynamicData) {
-		printf("error: fp_frame_view_create: failed to allocate memory for dynamicData\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_DYNAMIC, false, sizeof(fp_dynamic_view_data));
+	if(id == 0) {
+		printf("error: fp_dynamic_view_create: failed to create view\n");
 		return 0;
 	}
 
+	fp_dynamic_view_data* dynamicData = fp_view_get(id)->data;
 	dynamicData->frame = fp_frame_create(width, height, rgb(0, 0, 0));
 	dynamicData->renderFunc = renderFunc;
 	dynamicData->onnextRenderFunc = onnextRenderFunc;
 	dynamicData->data = data;
 
-	return fp_view_create(FP_VIEW_DYNAMIC, false, dynamicData);
+	return id;
 }
 
 fp_frameid fp_dynamic_view_get_frame(fp_view* view) {
@@ -48,7 +49,6 @@ bool fp_dynamic_view_free(fp_view* view) {
 	fp_dynamic_view_data* dynamicData = view->data;
 
 	fp_frame_free(dynamicData->frame);
-	free(dynamicData);
 
 	return true;
 }
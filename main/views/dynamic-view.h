@@ -7,7 +7,8 @@
 
 /* fp: fresh pixel */
 /* dynamic view is recomputed on each fp_view_render by invoking a custom callback function
- * TODO: shouldn't store a frame, to minimize memory usage
+ * the frame is kept between renders, so the callback can build on its previous output.
+ * generators that don't need their previous output should use a procedural view instead, which doesn't store a frame
  * */
 
 typedef struct {
@@ -3,25 +3,39 @@
 #include "freertos/FreeRTOS.h"
 
 fp_viewid fp_frame_view_create(unsigned int width, unsigned int height, rgb_color color) {
-	fp_frame_view_data* frameData = malloc(sizeof(fp_frame_view_data));
-	if(!frameData) {
-		printf("error: fp_frame_view_create: failed to allocate memory for frameData\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_FRAME, false, sizeof(fp_frame_view_data));
+	if(id == 0) {
+		printf("error: fp_frame_view_create: failed to create view\n");
 		return 0;
 	}
 
+	fp_frame_view_data* frameData = fp_view_get(id)->data;
 	frameData->frame = fp_frame_create(width, height, color);
-	return fp_view_create(FP_VIEW_FRAME, false, frameData);
+	return id;
 }
 
 fp_viewid fp_frame_view_create_composite(fp_frameid frameid) {
-	fp_frame_view_data* frameData = malloc(sizeof(fp_frame_view_data));
-	if(!frameData) {
-		printf("error: fp_frame_view_create_composite: failed to allocate memory for frameData\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_FRAME, true, sizeof(fp_frame_view_data));
+	if(id == 0) {
+		printf("error: fp_frame_view_create_composite: failed to create view\n");
 		return 0;
 	}
 
-	frameData->frame = frameid;
-	return fp_view_create(FP_VIEW_FRAME, true, frameData);
+	fp_frame_view_data* frameData = fp_view_get(id)->data;
+	frameData->frame = fp_frame_retain(frameid);
+	return id;
+}
+
+bool fp_frame_view_dedup(fp_viewid id) {
+	fp_view* view = fp_view_get(id);
+	if(view == NULL || view->type != FP_VIEW_FRAME) {
+		printf("error: fp_frame_view_dedup: %d is not a frame view\n", id);
+		return false;
+	}
+
+	fp_frame_view_data* frameData = view->data;
+	frameData->frame = fp_frame_dedup(frameData->frame);
+	return true;
 }
 
 fp_frameid fp_frame_view_get_frame(fp_view* view) {
@@ -38,11 +52,7 @@ bool fp_frame_view_onnext_render(fp_view* view) {
 
 bool fp_frame_view_free(fp_view* view) {
 	fp_frame_view_data* frameData = view->data;
-	if(!view->composite) {
-		fp_frame_free(frameData->frame);
-	}
-
-	free(frameData);
+	fp_frame_release(frameData->frame);
 
 	return true;
 }
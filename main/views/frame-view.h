@@ -13,7 +13,11 @@ typedef struct {
 } fp_frame_view_data;
 
 fp_viewid fp_frame_view_create(unsigned int width, unsigned int height, rgb_color color);
+/** retains frameid. the caller may release its own reference afterwards */
 fp_viewid fp_frame_view_create_composite(fp_frameid frameid);
+/** replace the view's frame with a shared copy if an identical frame was interned (see fp_frame_dedup).
+ * the frame must not be modified afterwards */
+bool fp_frame_view_dedup(fp_viewid id);
 
 fp_frameid fp_frame_view_get_frame(fp_view* view);
 bool fp_frame_view_render(fp_view* view);
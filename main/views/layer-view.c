@@ -17,24 +17,29 @@ fp_viewid fp_layer_view_create(
 	unsigned int layerHeight,
 	unsigned int layerCount
 ) {
-	fp_layer* layers = malloc(layerCount * sizeof(fp_layer));
-	if(!layers) {
-		printf("error: fp_layer_view_create: failed to allocate memory for layers\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_LAYER, false, sizeof(fp_layer_view_data));
+	if(id == 0) {
+		printf("error: fp_layer_view_create: failed to create view\n");
 		return 0;
 	}
 
-	fp_layer_view_data* layerData = malloc(sizeof(fp_layer_view_data));
-	if(!layerData) {
-		printf("error: fp_layer_view_create: failed to allocate memory for layerData\n");
-		free(layers);
+	fp_view* view = fp_view_get(id);
+	fp_layer* layers = fp_view_alloc_children(view, layerCount * sizeof(fp_layer));
+	if(!layers) {
+		printf("error: fp_layer_view_create: failed to allocate memory for layers\n");
+		fp_view_free(id);
 		return 0;
 	}
 
+	fp_layer_view_data* layerData = view->data;
+	layerData->width = width;
+	layerData->height = height;
 	layerData->layerCount = layerCount;
 	layerData->layers = layers;
-	layerData->frame = fp_frame_create(width, height, rgb(0,0,0));
-
-	fp_viewid id = fp_view_create(FP_VIEW_LAYER, false, layerData);
+	layerData->frame = 0;
+	if(fp_view_get_compositor_mode() == FP_COMPOSITOR_BUFFERED) {
+		layerData->frame = fp_frame_create(width, height, rgb(0,0,0));
+	}
 
 	/* init layers */
 	for(int i = 0; i < layerCount; i++) {
@@ -61,28 +66,33 @@ fp_viewid fp_layer_view_create_composite(
 	fp_viewid* layers,
 	unsigned int layerCount
 ) {
-	fp_layer* newLayers = malloc(layerCount * sizeof(fp_layer));
-	if(!newLayers) {
-		printf("error: fp_layer_view_create: failed to allocate memory for layers\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_LAYER, true, sizeof(fp_layer_view_data));
+	if(id == 0) {
+		printf("error: fp_layer_view_create: failed to create view\n");
 		return 0;
 	}
 
-	fp_layer_view_data* layerData = malloc(sizeof(fp_layer_view_data));
-	if(!layerData) {
-		printf("error: fp_layer_view_create: failed to allocate memory for layerData\n");
-		free(newLayers);
+	fp_view* view = fp_view_get(id);
+	fp_layer* newLayers = fp_view_alloc_children(view, layerCount * sizeof(fp_layer));
+	if(!newLayers) {
+		printf("error: fp_layer_view_create: failed to allocate memory for layers\n");
+		fp_view_free(id);
 		return 0;
 	}
 
+	fp_layer_view_data* layerData = view->data;
+	layerData->width = width;
+	layerData->height = height;
 	layerData->layerCount = layerCount;
 	layerData->layers = newLayers;
-	layerData->frame = fp_frame_create(width, height, rgb(0,0,0));
-
-	fp_viewid id = fp_view_create(FP_VIEW_LAYER, true, layerData);
+	layerData->frame = 0;
+	if(fp_view_get_compositor_mode() == FP_COMPOSITOR_BUFFERED) {
+		layerData->frame = fp_frame_create(width, height, rgb(0,0,0));
+	}
 
 	/* copy layers */
 	for(int i = 0; i < layerCount; i++) {
-		fp_viewid layerView = layers[i];
+		fp_viewid layerView = fp_view_retain(layers[i]);
 		fp_layer layer = {
 			layerView,
 			FP_BLEND_REPLACE,
@@ -104,85 +114,110 @@ fp_frameid fp_layer_view_get_frame(fp_view* view) {
 
 bool fp_layer_view_render(fp_view* view) {
 	fp_layer_view_data* layerData = view->data;
-	// clear
+	if(layerData->frame == 0) {
+		/* scanline mode, layers are composited in render_span when the parent reads them */
+		return true;
+	}
+
 	fp_frame* layerFrame = fp_frame_get(layerData->frame);
-	fp_ffill_rect(
-			layerData->frame,
-			0, 0,
-			layerFrame->width, layerFrame->length / layerFrame->width,
-			rgb(0, 0, 0)
-			);
+	for(unsigned int row = 0; row < layerData->height; row++) {
+		fp_layer_view_render_span(
+			view,
+			0, row,
+			layerData->width,
+			&layerFrame->pixels[fp_fcalc_index(0, row, layerFrame->width)]
+		);
+	}
+
+	return true;
+}
+
+bool fp_layer_view_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_layer_view_data* layerData = view->data;
+
+	// clear
+	for(unsigned int i = 0; i < width; i++) {
+		out[i] = rgb(0, 0, 0);
+	}
 
 	// draw higher indexed layers last
 	for(int i = 0; i < layerData->layerCount; i++) {
-		switch(layerData->layers[i].blendMode) {
+		fp_layer* layer = &layerData->layers[i];
+		unsigned int layerWidth;
+		unsigned int layerHeight;
+		if(y < layer->offsetY
+			|| fp_view_get(layer->view)->degrade >= FP_VIEW_DEGRADE_SKIP
+			|| !fp_view_get_size(layer->view, &layerWidth, &layerHeight)
+			|| y - layer->offsetY >= layerHeight) {
+			continue;
+		}
+
+		/* intersect [x, x+width) with the layer, clipped to the layer view */
+		unsigned int start = x > layer->offsetX ? x : layer->offsetX;
+		unsigned int end = x + width;
+		if(end > layer->offsetX + layerWidth) {
+			end = layer->offsetX + layerWidth;
+		}
+		if(end > layerData->width) {
+			end = layerData->width;
+		}
+		if(start >= end) {
+			continue;
+		}
+
+		unsigned int spanWidth = end - start;
+
+		/* frame-backed layers are read in place, frameless layers are generated into spanBuffer */
+		rgb_color spanBuffer[spanWidth];
+		const rgb_color* span = fp_view_get_span(layer->view, start - layer->offsetX, y - layer->offsetY, spanWidth, spanBuffer);
+		if(!span) {
+			continue;
+		}
+
+		rgb_color* target = &out[start - x];
+		switch(layer->blendMode) {
 			case FP_BLEND_OVERWRITE:
-				fp_fset_rect(
-						layerData->frame,
-						layerData->layers[i].offsetX,
-						layerData->layers[i].offsetY,
-						fp_frame_get(fp_view_get_frame(layerData->layers[i].view))
-						);
+				fp_span_set(target, span, spanWidth);
 				break;
 			case FP_BLEND_REPLACE:
-				fp_fset_rect_transparent(
-						layerData->frame,
-						layerData->layers[i].offsetX,
-						layerData->layers[i].offsetY,
-						fp_frame_get(fp_view_get_frame(layerData->layers[i].view))
-						);
+				fp_span_set_transparent(target, span, spanWidth);
 				break;
 			case FP_BLEND_ADD:
-				fp_fadd_rect(
-						layerData->frame,
-						layerData->layers[i].offsetX,
-						layerData->layers[i].offsetY,
-						fp_frame_get(fp_view_get_frame(layerData->layers[i].view))
-						);
+				fp_span_blend(&rgb_addb, target, 255, span, 255, spanWidth);
 				break;
 			case FP_BLEND_MULTIPLY:
-				fp_fmultiply_rect(
-						layerData->frame,
-						layerData->layers[i].offsetX,
-						layerData->layers[i].offsetY,
-						fp_frame_get(fp_view_get_frame(layerData->layers[i].view))
-						);
+				fp_span_blend(&rgb_multiplyb, target, 255, span, 255, spanWidth);
 				break;
 			case FP_BLEND_ALPHA:
-				{
-					uint8_t srcAlpha = layerData->layers[i].alpha;
-					fp_fblend_rect(
-							&rgb_alpha,
-							layerData->frame,
-							255,
-							layerData->layers[i].offsetX,
-							layerData->layers[i].offsetY,
-							fp_frame_get(fp_view_get_frame(layerData->layers[i].view)),
-							srcAlpha
-							);
-					break;
-				}
+				fp_span_blend(&rgb_alpha, target, 255, span, layer->alpha, spanWidth);
+				break;
 		}
 	}
 
 	return true;
 }
 
+bool fp_layer_view_get_size(fp_view* view, unsigned int* width, unsigned int* height) {
+	fp_layer_view_data* layerData = view->data;
+	*width = layerData->width;
+	*height = layerData->height;
+	return true;
+}
+
 bool fp_layer_view_onnext_render(fp_view* view) {
 	return true;
 }
 
 bool fp_layer_view_free(fp_view* view) {
 	fp_layer_view_data* layerData = view->data;
-	if(!view->composite) {
-		for(int i = 0; i < layerData->layerCount; i++) {
-			fp_view_free(layerData->layers[i].view);
-		}
+	for(int i = 0; i < layerData->layerCount; i++) {
+		fp_view_release(layerData->layers[i].view);
 	}
 
-	fp_frame_free(layerData->frame);
-	free(layerData->layers);
-	free(layerData);
+	if(layerData->frame != 0) {
+		fp_frame_free(layerData->frame);
+	}
+	fp_view_free_children(view, layerData->layers);
 
 	return true;
 }
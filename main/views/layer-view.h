@@ -23,9 +23,11 @@ typedef struct {
 } fp_layer;
 
 typedef struct {
+	unsigned int width;
+	unsigned int height;
 	unsigned int layerCount;
 	fp_layer* layers;
-	/** stores the result of render */
+	/** stores the result of render. 0 when created in FP_COMPOSITOR_SCANLINE mode */
 	fp_frameid frame;
 
 } fp_layer_view_data;
@@ -38,6 +40,7 @@ fp_viewid fp_layer_view_create(
 	unsigned int layerCount
 );
 
+/** retains each layer view. the caller may release its own references afterwards */
 fp_viewid fp_layer_view_create_composite(
 	unsigned int width,
 	unsigned int height,
@@ -49,12 +52,16 @@ fp_frameid fp_layer_view_get_frame(fp_view* view);
 bool fp_layer_view_render(fp_view* view);
 bool fp_layer_view_onnext_render(fp_view* view);
 bool fp_layer_view_free(fp_view* view);
+bool fp_layer_view_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out);
+bool fp_layer_view_get_size(fp_view* view, unsigned int* width, unsigned int* height);
 
 static const fp_view_register_data fp_layer_view_register_data = {
 	&fp_layer_view_get_frame,
 	&fp_layer_view_render,
 	&fp_layer_view_onnext_render,
-	&fp_layer_view_free
+	&fp_layer_view_free,
+	&fp_layer_view_render_span,
+	&fp_layer_view_get_size
 };
 
 #endif /* LAYER_VIEW_H */
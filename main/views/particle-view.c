@@ -0,0 +1,434 @@
+#include "particle-view.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "../fixed.h"
+#include "../mem.h"
+#include "../render.h"
+#include "../console.h"
+
+fp_viewid fp_particle_view_create(unsigned int width, unsigned int height, unsigned int capacity, unsigned int periodMs) {
+	fp_viewid id = fp_view_create_inline(FP_VIEW_PARTICLE, false, sizeof(fp_particle_view_data));
+	if(id == 0) {
+		printf("error: fp_particle_view_create: failed to create view\n");
+		return 0;
+	}
+
+	fp_view* view = fp_view_get(id);
+	fp_particle_view_data* particleData = view->data;
+
+	/* 32 bit fields first, so every field is aligned */
+	size_t particleSize = 2 * sizeof(int32_t) + sizeof(rgb_color) + 4 * sizeof(uint16_t);
+	uint8_t* fields = fp_mem_alloc(FP_MEM_VIEW, capacity * particleSize);
+	particleData->frame = fp_frame_create(width, height, rgb(0, 0, 0));
+	if(!fields || particleData->frame == 0) {
+		printf("error: fp_particle_view_create: failed to allocate %u particles\n", capacity);
+		fp_mem_free(fields);
+		particleData->x = NULL;
+		fp_view_free(id);
+		return 0;
+	}
+
+	particleData->x = (int32_t*)fields;
+	particleData->y = particleData->x + capacity;
+	particleData->color = (rgb_color*)(particleData->y + capacity);
+	particleData->vx = (int16_t*)(particleData->color + capacity);
+	particleData->vy = particleData->vx + capacity;
+	particleData->life = (uint16_t*)(particleData->vy + capacity);
+	particleData->lifeSpan = particleData->life + capacity;
+
+	particleData->width = width;
+	particleData->height = height;
+	particleData->capacity = capacity;
+	particleData->count = 0;
+	particleData->emitterCount = 0;
+	particleData->gravityX = 0;
+	particleData->gravityY = 0;
+	particleData->drag = 0;
+	particleData->trail = 0;
+	particleData->periodMs = periodMs;
+	particleData->lastUpdateTime = 0;
+	particleData->elapsedRemainderUs = 0;
+	/* the same views created in the same order get the same streams */
+	fp_rand_seed(&particleData->rand, view->serial);
+
+	if(periodMs > 0) {
+		fp_queue_render(id, xTaskGetTickCount() + pdMS_TO_TICKS(periodMs));
+	}
+
+	return id;
+}
+
+int fp_particle_view_add_emitter(fp_viewid id, const fp_particle_emitter* emitter) {
+	fp_view* view = fp_view_get(id);
+	if(!view || view->type != FP_VIEW_PARTICLE) {
+		return -1;
+	}
+
+	fp_particle_view_data* particleData = view->data;
+	if(particleData->emitterCount >= FP_PARTICLE_EMITTER_COUNT) {
+		printf("error: fp_particle_view_add_emitter: too many emitters. limit: %d\n", FP_PARTICLE_EMITTER_COUNT);
+		return -1;
+	}
+
+	fp_particle_emitter* newEmitter = &particleData->emitters[particleData->emitterCount];
+	*newEmitter = *emitter;
+	newEmitter->emitDebt = 0;
+	newEmitter->burstElapsedMs = 0;
+	return particleData->emitterCount++;
+}
+
+bool fp_particle_view_set_forces(fp_viewid id, int16_t gravityX, int16_t gravityY, uint8_t drag, uint8_t trail) {
+	fp_view* view = fp_view_get(id);
+	if(!view || view->type != FP_VIEW_PARTICLE) {
+		return false;
+	}
+
+	fp_particle_view_data* particleData = view->data;
+	particleData->gravityX = gravityX;
+	particleData->gravityY = gravityY;
+	particleData->drag = drag;
+	particleData->trail = trail;
+	return true;
+}
+
+static rgb_color fp_particle_random_hue(fp_rand* rand) {
+	return hsv_to_rgb(hsv(fp_rand_next(rand), 255, 255));
+}
+
+static bool fp_particle_emit(fp_particle_view_data* particleData, const fp_particle_emitter* emitter, int32_t x, int32_t y, rgb_color color) {
+	if(particleData->count >= particleData->capacity) {
+		particleData->stats.dropped++;
+		return false;
+	}
+
+	fp_rand* rand = &particleData->rand;
+	unsigned int i = particleData->count;
+	particleData->count++;
+	particleData->stats.emitted++;
+
+	uint8_t angle = emitter->angle + (int)fp_rand_range(rand, 2 * emitter->spread + 1) - emitter->spread;
+	int speed = emitter->speedMin;
+	if(emitter->speedMax > emitter->speedMin) {
+		speed += fp_rand_range(rand, emitter->speedMax - emitter->speedMin + 1);
+	}
+	uint16_t life = emitter->lifeMinMs;
+	if(emitter->lifeMaxMs > emitter->lifeMinMs) {
+		life += fp_rand_range(rand, emitter->lifeMaxMs - emitter->lifeMinMs + 1);
+	}
+
+	particleData->x[i] = x;
+	particleData->y[i] = y;
+	particleData->vx[i] = (speed * ((int)FP_COS8(angle) - 128)) >> 7;
+	particleData->vy[i] = (speed * ((int)FP_SIN8(angle) - 128)) >> 7;
+	particleData->life[i] = life;
+	particleData->lifeSpan[i] = life > 0 ? life : 1;
+	particleData->color[i] = color;
+	return true;
+}
+
+/* a random point in the emitter's area */
+static void fp_particle_emitter_point(fp_rand* rand, const fp_particle_emitter* emitter, int32_t* x, int32_t* y) {
+	*x = emitter->x + (emitter->width > 0 ? (int32_t)fp_rand_range(rand, emitter->width) : 0);
+	*y = emitter->y + (emitter->height > 0 ? (int32_t)fp_rand_range(rand, emitter->height) : 0);
+}
+
+static unsigned int fp_particle_burst(fp_particle_view_data* particleData, const fp_particle_emitter* emitter, unsigned int count) {
+	int32_t x;
+	int32_t y;
+	fp_particle_emitter_point(&particleData->rand, emitter, &x, &y);
+	rgb_color color = emitter->randomHue ? fp_particle_random_hue(&particleData->rand) : emitter->color;
+
+	unsigned int emitted = 0;
+	while(emitted < count && fp_particle_emit(particleData, emitter, x, y, color)) {
+		emitted++;
+	}
+	return emitted;
+}
+
+unsigned int fp_particle_view_burst(fp_viewid id, unsigned int emitter, unsigned int count) {
+	fp_view* view = fp_view_get(id);
+	if(!view || view->type != FP_VIEW_PARTICLE) {
+		return 0;
+	}
+
+	fp_particle_view_data* particleData = view->data;
+	if(emitter >= particleData->emitterCount) {
+		return 0;
+	}
+
+	return fp_particle_burst(particleData, &particleData->emitters[emitter], count);
+}
+
+fp_particle_stats fp_particle_view_get_stats(fp_viewid id) {
+	fp_view* view = fp_view_get(id);
+	if(!view || view->type != FP_VIEW_PARTICLE) {
+		fp_particle_stats stats = { 0 };
+		return stats;
+	}
+
+	return ((fp_particle_view_data*)view->data)->stats;
+}
+
+static int16_t fp_particle_clamp16(int32_t value) {
+	return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : value;
+}
+
+void fp_particle_view_update(fp_view* view, uint32_t elapsedUs) {
+	fp_particle_view_data* particleData = view->data;
+	if(elapsedUs > FP_PARTICLE_MAX_STEP_US) {
+		elapsedUs = FP_PARTICLE_MAX_STEP_US;
+	}
+
+	/* 0.16 seconds. 4295 / 65536 ~= 65536 / 1000000 */
+	int32_t dt = (elapsedUs * 4295) >> 16;
+	/* life is in milliseconds. keep the remainder so short frames still age particles */
+	uint32_t elapsedTotalUs = elapsedUs + particleData->elapsedRemainderUs;
+	uint32_t elapsedMs = elapsedTotalUs / 1000;
+	particleData->elapsedRemainderUs = elapsedTotalUs - elapsedMs * 1000;
+
+	/* 8.8 velocity change and 0.8 damping for this step, shared by every particle */
+	int32_t dvx = (particleData->gravityX * dt) >> 16;
+	int32_t dvy = (particleData->gravityY * dt) >> 16;
+	int32_t damping = (particleData->drag * dt) >> 16;
+
+	int32_t minX = -(int32_t)particleData->width << 16;
+	int32_t maxX = 2 * (int32_t)particleData->width << 16;
+	int32_t minY = -(int32_t)particleData->height << 16;
+	int32_t maxY = 2 * (int32_t)particleData->height << 16;
+
+	int32_t* x = particleData->x;
+	int32_t* y = particleData->y;
+	int16_t* vx = particleData->vx;
+	int16_t* vy = particleData->vy;
+	uint16_t* life = particleData->life;
+	unsigned int count = particleData->count;
+	for(unsigned int i = 0; i < count;) {
+		if(life[i] <= elapsedMs || x[i] < minX || x[i] >= maxX || y[i] < minY || y[i] >= maxY) {
+			/* expired. move the last particle into this slot */
+			count--;
+			x[i] = x[count];
+			y[i] = y[count];
+			vx[i] = vx[count];
+			vy[i] = vy[count];
+			life[i] = life[count];
+			particleData->lifeSpan[i] = particleData->lifeSpan[count];
+			particleData->color[i] = particleData->color[count];
+			particleData->stats.expired++;
+			continue;
+		}
+
+		int32_t velocityX = vx[i] + dvx;
+		int32_t velocityY = vy[i] + dvy;
+		velocityX -= (velocityX * damping) >> 8;
+		velocityY -= (velocityY * damping) >> 8;
+		vx[i] = fp_particle_clamp16(velocityX);
+		vy[i] = fp_particle_clamp16(velocityY);
+
+		/* 8.8 * 0.16 = 8.24, shifted to 16.16 */
+		x[i] += (vx[i] * dt) >> 8;
+		y[i] += (vy[i] * dt) >> 8;
+		life[i] -= elapsedMs;
+		i++;
+	}
+	particleData->count = count;
+
+	for(unsigned int e = 0; e < particleData->emitterCount; e++) {
+		fp_particle_emitter* emitter = &particleData->emitters[e];
+		if(emitter->rate > 0) {
+			/* 16.16 particles */
+			emitter->emitDebt += emitter->rate * dt;
+			unsigned int emitCount = emitter->emitDebt >> 16;
+			emitter->emitDebt &= 0xffff;
+			for(unsigned int i = 0; i < emitCount; i++) {
+				int32_t px;
+				int32_t py;
+				fp_particle_emitter_point(&particleData->rand, emitter, &px, &py);
+				rgb_color color = emitter->randomHue ? fp_particle_random_hue(&particleData->rand) : emitter->color;
+				fp_particle_emit(particleData, emitter, px, py, color);
+			}
+		}
+
+		if(emitter->burstCount > 0 && emitter->burstPeriodMs > 0) {
+			emitter->burstElapsedMs += elapsedMs;
+			while(emitter->burstElapsedMs >= emitter->burstPeriodMs) {
+				emitter->burstElapsedMs -= emitter->burstPeriodMs;
+				fp_particle_burst(particleData, emitter, emitter->burstCount);
+			}
+		}
+	}
+
+	particleData->stats.updates++;
+}
+
+static void fp_particle_splat_pixel(fp_frame* frame, unsigned int height, int x, int y, rgb_color color, unsigned int weight) {
+	if(x < 0 || y < 0 || x >= frame->width || y >= height || weight == 0) {
+		return;
+	}
+
+	rgb_color* pixel = &frame->pixels[y * frame->width + x];
+	pixel->fields.r = FP_QADD8(pixel->fields.r, (color.fields.r * weight) >> 8);
+	pixel->fields.g = FP_QADD8(pixel->fields.g, (color.fields.g * weight) >> 8);
+	pixel->fields.b = FP_QADD8(pixel->fields.b, (color.fields.b * weight) >> 8);
+}
+
+void fp_particle_view_splat(fp_view* view) {
+	fp_particle_view_data* particleData = view->data;
+	fp_frame* frame = fp_frame_get(particleData->frame);
+
+	if(particleData->trail == 0) {
+		memset(frame->pixels, 0, frame->length * sizeof(rgb_color));
+	}
+	else {
+		for(unsigned int i = 0; i < frame->length; i++) {
+			rgb_color* pixel = &frame->pixels[i];
+			pixel->fields.r = FP_SCALE8(pixel->fields.r, particleData->trail);
+			pixel->fields.g = FP_SCALE8(pixel->fields.g, particleData->trail);
+			pixel->fields.b = FP_SCALE8(pixel->fields.b, particleData->trail);
+		}
+	}
+
+	unsigned int height = particleData->height;
+	for(unsigned int i = 0; i < particleData->count; i++) {
+		/* fade out over the particle's life */
+		unsigned int brightness = ((uint32_t)particleData->life[i] << 8) / particleData->lifeSpan[i];
+		rgb_color color = particleData->color[i];
+		color.fields.r = (color.fields.r * brightness) >> 8;
+		color.fields.g = (color.fields.g * brightness) >> 8;
+		color.fields.b = (color.fields.b * brightness) >> 8;
+
+		/* relative to pixel centers, split into the pixel above left and the 8 bit fraction towards the next one */
+		int32_t sx = particleData->x[i] - 0x8000;
+		int32_t sy = particleData->y[i] - 0x8000;
+		int px = sx >> 16;
+		int py = sy >> 16;
+		unsigned int fx = (sx >> 8) & 0xff;
+		unsigned int fy = (sy >> 8) & 0xff;
+
+		fp_particle_splat_pixel(frame, height, px, py, color, ((256 - fx) * (256 - fy)) >> 8);
+		fp_particle_splat_pixel(frame, height, px + 1, py, color, (fx * (256 - fy)) >> 8);
+		fp_particle_splat_pixel(frame, height, px, py + 1, color, ((256 - fx) * fy) >> 8);
+		fp_particle_splat_pixel(frame, height, px + 1, py + 1, color, (fx * fy) >> 8);
+	}
+}
+
+fp_frameid fp_particle_view_get_frame(fp_view* view) {
+	return ((fp_particle_view_data*)view->data)->frame;
+}
+
+bool fp_particle_view_render(fp_view* view) {
+	fp_particle_view_data* particleData = view->data;
+
+	/* one batched step for everything since the last render */
+	int64_t now = esp_timer_get_time();
+	uint32_t elapsedUs = 0;
+	if(particleData->lastUpdateTime != 0) {
+		int64_t elapsed = now - particleData->lastUpdateTime;
+		elapsedUs = elapsed > FP_PARTICLE_MAX_STEP_US ? FP_PARTICLE_MAX_STEP_US : elapsed;
+	}
+	particleData->lastUpdateTime = now;
+
+	fp_rand_sync(&particleData->rand);
+	fp_particle_view_update(view, elapsedUs);
+	int64_t updated = esp_timer_get_time();
+	fp_particle_view_splat(view);
+
+	particleData->stats.lastUpdateUs = updated - now;
+	particleData->stats.lastSplatUs = esp_timer_get_time() - updated;
+	return true;
+}
+
+bool fp_particle_view_onnext_render(fp_view* view) {
+	fp_particle_view_data* particleData = view->data;
+	if(particleData->periodMs == 0) {
+		return true;
+	}
+
+	return fp_queue_render(view->id, xTaskGetTickCount() + pdMS_TO_TICKS(particleData->periodMs));
+}
+
+bool fp_particle_view_free(fp_view* view) {
+	fp_particle_view_data* particleData = view->data;
+
+	fp_frame_free(particleData->frame);
+	fp_mem_free(particleData->x);
+
+	return true;
+}
+
+/* steady state cost of "count" particles spread over a 32x32 panel, stepped at 60 fps */
+static int fp_particle_bench(unsigned int count, unsigned int frames) {
+	fp_viewid id = fp_particle_view_create(32, 32, count, 0);
+	if(id == 0) {
+		return 1;
+	}
+
+	fp_particle_emitter emitter = {
+		0, 0, 32 << 16, 32 << 16,
+		0, 0, 0,
+		0, 128,
+		4 << 8, 16 << 8,
+		60000, 60000,
+		{ .bits = 0 },
+		true
+	};
+	fp_particle_view_add_emitter(id, &emitter);
+	fp_particle_view_set_forces(id, 0, 8 << 8, 16, 0);
+
+	fp_view* view = fp_view_get(id);
+	fp_particle_view_data* particleData = view->data;
+	/* one burst per particle, so they are spread over the panel */
+	for(unsigned int i = 0; i < count; i++) {
+		fp_particle_view_burst(id, 0, 1);
+	}
+
+	int64_t updateUs = 0;
+	int64_t splatUs = 0;
+	unsigned int particles = 0;
+	for(unsigned int frame = 0; frame < frames; frame++) {
+		particles += particleData->count;
+		int64_t start = esp_timer_get_time();
+		fp_particle_view_update(view, 1000000/60);
+		int64_t updated = esp_timer_get_time();
+		fp_particle_view_splat(view);
+		splatUs += esp_timer_get_time() - updated;
+		updateUs += updated - start;
+	}
+
+	printf("%u particles, %u frames: update %u ns/particle, splat %u ns/particle, %u us/frame\n",
+		count,
+		frames,
+		particles > 0 ? (unsigned int)(updateUs * 1000 / particles) : 0,
+		particles > 0 ? (unsigned int)(splatUs * 1000 / particles) : 0,
+		(unsigned int)((updateUs + splatUs) / frames)
+	);
+
+	fp_view_release(id);
+	return 0;
+}
+
+static int fp_particle_command(int argc, char** argv) {
+	if(argc < 2 || strcmp(argv[1], "bench") != 0) {
+		printf("usage: particles bench [<count> [<frames>]]\n");
+		return 1;
+	}
+
+	unsigned int count = argc >= 3 ? strtoul(argv[2], NULL, 0) : 2000;
+	unsigned int frames = argc >= 4 ? strtoul(argv[3], NULL, 0) : 60;
+	if(count == 0 || frames == 0) {
+		printf("usage: particles bench [<count> [<frames>]]\n");
+		return 1;
+	}
+
+	return fp_particle_bench(count, frames);
+}
+
+bool fp_particle_console_init() {
+	return fp_console_register("particles", "particle cost: bench [<count> [<frames>]]", &fp_particle_command);
+}
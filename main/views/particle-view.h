@@ -0,0 +1,132 @@
+#ifndef PARTICLE_VIEW_H
+#define PARTICLE_VIEW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../view.h"
+#include "../rand.h"
+
+/* fp: fresh pixel */
+/* particle view simulates up to "capacity" particles and splats them additively into its frame.
+ * particles are stored as a structure of arrays in fixed point, so one update pass streams through each field:
+ *   position: 16.16 pixels. velocity: 8.8 pixels per second. life: milliseconds.
+ * emitters spawn particles continuously and/or in bursts. forces (gravity, drag) apply to every particle.
+ *
+ * each render advances the simulation by the time since the previous render, measured with esp_timer,
+ * then redraws the frame: each particle adds its color to the 4 pixels around it, weighted by distance (bilinear),
+ * and fades out over its life.
+ * while it's shown the view renders itself every periodMs.
+ * emitters and forces must be changed on the render task, or before the view is shown.
+ * */
+
+#define FP_PARTICLE_EMITTER_COUNT 4
+/* the simulation never advances more than this per render, so a stall doesn't teleport particles */
+#define FP_PARTICLE_MAX_STEP_US 100000
+
+typedef struct {
+	/* particles start at a random point in [x, x + width) x [y, y + height). 16.16 pixels */
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+	/* particles per second, emitted continuously. 0 for none */
+	uint16_t rate;
+	/* particles emitted at once every burstPeriodMs, at one random point of the area. 0 for no bursts */
+	uint16_t burstCount;
+	uint16_t burstPeriodMs;
+	/* direction of travel. 0-255 is a full turn, 0 is +x and 64 is +y (down) */
+	uint8_t angle;
+	/* directions are random in [angle - spread, angle + spread]. 128 for every direction */
+	uint8_t spread;
+	/* 8.8 pixels per second */
+	int16_t speedMin;
+	int16_t speedMax;
+	uint16_t lifeMinMs;
+	uint16_t lifeMaxMs;
+	rgb_color color;
+	/* ignore color and pick a random hue for each particle, or each burst */
+	bool randomHue;
+
+	/* internal. fractional particles owed, 16.16 */
+	uint32_t emitDebt;
+	/* internal */
+	uint32_t burstElapsedMs;
+} fp_particle_emitter;
+
+typedef struct {
+	unsigned int updates;
+	unsigned int emitted;
+	/* particles that died or left the area */
+	unsigned int expired;
+	/* particles that weren't emitted because the view was full */
+	unsigned int dropped;
+	uint32_t lastUpdateUs;
+	uint32_t lastSplatUs;
+} fp_particle_stats;
+
+typedef struct {
+	fp_frameid frame;
+	unsigned int width;
+	unsigned int height;
+	unsigned int capacity;
+	unsigned int count;
+
+	/* one allocation, split into the fields */
+	int32_t* x;
+	int32_t* y;
+	int16_t* vx;
+	int16_t* vy;
+	uint16_t* life;
+	uint16_t* lifeSpan;
+	rgb_color* color;
+
+	fp_particle_emitter emitters[FP_PARTICLE_EMITTER_COUNT];
+	unsigned int emitterCount;
+
+	/* 8.8 pixels per second^2 */
+	int16_t gravityX;
+	int16_t gravityY;
+	/* share of velocity lost per second, 0-255 */
+	uint8_t drag;
+	/* share of the previous frame kept under the new one, 0-255. 0 clears the frame every render */
+	uint8_t trail;
+
+	unsigned int periodMs;
+	int64_t lastUpdateTime;
+	/* time not yet taken off particle lives, under a millisecond */
+	uint32_t elapsedRemainderUs;
+	fp_rand rand;
+	fp_particle_stats stats;
+} fp_particle_view_data;
+
+fp_viewid fp_particle_view_create(unsigned int width, unsigned int height, unsigned int capacity, unsigned int periodMs);
+
+/** returns the emitter's index, or -1 if the view has FP_PARTICLE_EMITTER_COUNT emitters */
+int fp_particle_view_add_emitter(fp_viewid id, const fp_particle_emitter* emitter);
+bool fp_particle_view_set_forces(fp_viewid id, int16_t gravityX, int16_t gravityY, uint8_t drag, uint8_t trail);
+/** emit "count" particles from an emitter at once. returns the number emitted */
+unsigned int fp_particle_view_burst(fp_viewid id, unsigned int emitter, unsigned int count);
+fp_particle_stats fp_particle_view_get_stats(fp_viewid id);
+
+/** advance the simulation by elapsedUs: emit, apply forces, integrate and expire particles. used internally */
+void fp_particle_view_update(fp_view* view, uint32_t elapsedUs);
+/** redraw the frame from the particles. used internally */
+void fp_particle_view_splat(fp_view* view);
+
+fp_frameid fp_particle_view_get_frame(fp_view* view);
+bool fp_particle_view_render(fp_view* view);
+bool fp_particle_view_onnext_render(fp_view* view);
+bool fp_particle_view_free(fp_view* view);
+
+/** registers the "particles" console command, which benchmarks the update and splat on the calling task */
+bool fp_particle_console_init();
+
+static const fp_view_register_data fp_particle_view_register_data = {
+	&fp_particle_view_get_frame,
+	&fp_particle_view_render,
+	&fp_particle_view_onnext_render,
+	&fp_particle_view_free
+};
+
+#endif /* PARTICLE_VIEW_H */
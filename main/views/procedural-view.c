@@ -0,0 +1,95 @@
+#include "procedural-view.h"
+
+#include "freertos/FreeRTOS.h"
+
+fp_viewid fp_procedural_view_create(
+	unsigned int width,
+	unsigned int height,
+	fp_span_fn spanFunc,
+	bool (*onnextRenderFunc) (fp_view*),
+	void* data
+) {
+	fp_viewid id = fp_view_create_inline(FP_VIEW_PROCEDURAL, false, sizeof(fp_procedural_view_data));
+	if(id == 0) {
+		printf("error: fp_procedural_view_create: failed to create view\n");
+		return 0;
+	}
+
+	fp_procedural_view_data* proceduralData = fp_view_get(id)->data;
+	proceduralData->width = width;
+	proceduralData->height = height;
+	proceduralData->spanFunc = spanFunc;
+	proceduralData->onnextRenderFunc = onnextRenderFunc;
+	proceduralData->freeFunc = NULL;
+	proceduralData->data = data;
+
+	return id;
+}
+
+bool fp_procedural_view_set_free(fp_viewid id, bool (*freeFunc) (fp_view*)) {
+	fp_view* view = fp_view_get(id);
+	if(!view || view->type != FP_VIEW_PROCEDURAL) {
+		return false;
+	}
+
+	((fp_procedural_view_data*)view->data)->freeFunc = freeFunc;
+	return true;
+}
+
+fp_frameid fp_procedural_view_get_frame(fp_view* view) {
+	return 0;
+}
+
+bool fp_procedural_view_render(fp_view* view) {
+	/* nothing to do, pixels are generated in render_span */
+	return true;
+}
+
+bool fp_procedural_view_onnext_render(fp_view* view) {
+	fp_procedural_view_data* proceduralData = view->data;
+	if(proceduralData->onnextRenderFunc == NULL) {
+		return false;
+	}
+	return proceduralData->onnextRenderFunc(view);
+}
+
+bool fp_procedural_view_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_procedural_view_data* proceduralData = view->data;
+	if(proceduralData->spanFunc == NULL
+		|| y >= proceduralData->height
+		|| x + width > proceduralData->width) {
+		return false;
+	}
+
+	if(view->degrade < FP_VIEW_DEGRADE_LOW_RES) {
+		return proceduralData->spanFunc(view, x, y, width, out);
+	}
+
+	/* low res: generate the even columns and copy each one into the odd column after it */
+	for(unsigned int i = 0; i < width; i++) {
+		unsigned int column = x + i;
+		if(column % 2 == 1 && i > 0) {
+			out[i] = out[i - 1];
+		}
+		else if(!proceduralData->spanFunc(view, column & ~1u, y, 1, &out[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool fp_procedural_view_get_size(fp_view* view, unsigned int* width, unsigned int* height) {
+	fp_procedural_view_data* proceduralData = view->data;
+	*width = proceduralData->width;
+	*height = proceduralData->height;
+	return true;
+}
+
+bool fp_procedural_view_free(fp_view* view) {
+	fp_procedural_view_data* proceduralData = view->data;
+	if(proceduralData->freeFunc == NULL) {
+		return true;
+	}
+	return proceduralData->freeFunc(view);
+}
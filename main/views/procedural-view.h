@@ -0,0 +1,57 @@
+#ifndef PROCEDURAL_VIEW_H
+#define PROCEDURAL_VIEW_H
+
+#include <stdbool.h>
+
+#include "../view.h"
+
+/* fp: fresh pixel */
+/* procedural view doesn't store a frame. pixels are generated on demand, one span at a time,
+ * by a custom callback function whenever a parent view reads it with fp_view_get_span.
+ * use for generators (noise, gradients, etc.) that don't depend on their previous output.
+ * fp_view_get_frame returns the NULL frame for procedural views.
+ * at FP_VIEW_DEGRADE_LOW_RES spanFunc is called for one even column at a time, and each result is also used for the next column.
+ * */
+
+/** generate "width" pixels of row "y", starting at column "x", into "out" */
+typedef bool (*fp_span_fn) (fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out);
+
+typedef struct {
+	unsigned int width;
+	unsigned int height;
+	fp_span_fn spanFunc;
+	bool (*onnextRenderFunc) (fp_view*);
+	/** optional. called when the view is freed, e.g. to free data */
+	bool (*freeFunc) (fp_view*);
+	/** custom data */
+	void* data;
+} fp_procedural_view_data;
+
+fp_viewid fp_procedural_view_create(
+	unsigned int width,
+	unsigned int height,
+	fp_span_fn spanFunc,
+	bool (*onnextRenderFunc) (fp_view*),
+	void* data
+);
+
+/** set a function to call when the view is freed */
+bool fp_procedural_view_set_free(fp_viewid id, bool (*freeFunc) (fp_view*));
+
+fp_frameid fp_procedural_view_get_frame(fp_view* view);
+bool fp_procedural_view_render(fp_view* view);
+bool fp_procedural_view_onnext_render(fp_view* view);
+bool fp_procedural_view_free(fp_view* view);
+bool fp_procedural_view_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out);
+bool fp_procedural_view_get_size(fp_view* view, unsigned int* width, unsigned int* height);
+
+static const fp_view_register_data fp_procedural_view_register_data = {
+	&fp_procedural_view_get_frame,
+	&fp_procedural_view_render,
+	&fp_procedural_view_onnext_render,
+	&fp_procedural_view_free,
+	&fp_procedural_view_render_span,
+	&fp_procedural_view_get_size
+};
+
+#endif /* PROCEDURAL_VIEW_H */
@@ -20,30 +20,37 @@ fp_viewid fp_create_transition_view(
 		return 0;
 	}
 
-	fp_viewid* pages = malloc(pageCount * sizeof(fp_viewid));
-	if(!pages) {
-		printf("error: fp_create_transition_view: failed to allocate memory for pages\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_TRANSITION, false, sizeof(fp_transition_view_data));
+	if(id == 0) {
+		printf("error: fp_create_transition_view: failed to create view\n");
 		return 0;
 	}
 
-	fp_transition_view_data* transitionData = malloc(sizeof(fp_transition_view_data));
-	if(!transitionData) {
-		printf("error: fp_create_transition_view: failed to allocate memory for transitionData\n");
-		free(pages);
+	fp_view* view = fp_view_get(id);
+	fp_viewid* pages = fp_view_alloc_children(view, pageCount * sizeof(fp_viewid));
+	if(!pages) {
+		printf("error: fp_create_transition_view: failed to allocate memory for pages\n");
+		fp_view_free(id);
 		return 0;
 	}
 
+	fp_transition_view_data* transitionData = view->data;
 	transitionData->pageCount = pageCount;
 	transitionData->pages = pages;
 	transitionData->pageIndex = 0;
 	transitionData->previousPageIndex = 0;
-	transitionData->frame = fp_frame_create(width, height, rgb(0,0,0));
+	transitionData->width = width;
+	transitionData->height = height;
+	transitionData->frame = 0;
+	if(fp_view_get_compositor_mode() == FP_COMPOSITOR_BUFFERED) {
+		transitionData->frame = fp_frame_create(width, height, rgb(0,0,0));
+	}
 	transitionData->transition = transition;
+	fp_view_retain(transition.viewA);
+	fp_view_retain(transition.viewB);
 	transitionData->blendFn = &rgb_alpha;
 	transitionData->transitionPeriodMs = transitionPeriodMs;
 
-	fp_viewid id = fp_view_create(FP_VIEW_TRANSITION, false, transitionData);
-
 	/* init pages */
 	for(int i = 0; i < pageCount; i++) {
 		pages[i] = fp_frame_view_create(width, height, rgb(0,0,0));
@@ -71,34 +78,41 @@ fp_viewid fp_create_transition_view_composite(
 	}
 
 
-	fp_viewid* newPages = malloc(pageCount * sizeof(fp_viewid));
-	if(!newPages) {
-		printf("error: fp_create_transition_view_composite: failed to allocate memory for pages\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_TRANSITION, true, sizeof(fp_transition_view_data));
+	if(id == 0) {
+		printf("error: fp_create_transition_view_composite: failed to create view\n");
 		return 0;
 	}
 
-	fp_transition_view_data* transitionData = malloc(sizeof(fp_transition_view_data));
-	if(!transitionData) {
-		printf("error: fp_create_transition_view_composite: failed to allocate memory for transitionData\n");
-		free(newPages);
+	fp_view* view = fp_view_get(id);
+	fp_viewid* newPages = fp_view_alloc_children(view, pageCount * sizeof(fp_viewid));
+	if(!newPages) {
+		printf("error: fp_create_transition_view_composite: failed to allocate memory for pages\n");
+		fp_view_free(id);
 		return 0;
 	}
 
+	fp_transition_view_data* transitionData = view->data;
 	transitionData->pageCount = pageCount;
 	transitionData->pages = newPages;
 	transitionData->pageIndex = 0;
 	transitionData->previousPageIndex = 0;
-	transitionData->frame = fp_frame_create(width, height, rgb(0,0,0));
+	transitionData->width = width;
+	transitionData->height = height;
+	transitionData->frame = 0;
+	if(fp_view_get_compositor_mode() == FP_COMPOSITOR_BUFFERED) {
+		transitionData->frame = fp_frame_create(width, height, rgb(0,0,0));
+	}
 	
 	transitionData->transition = transition;
+	fp_view_retain(transition.viewA);
+	fp_view_retain(transition.viewB);
 	transitionData->blendFn = &rgb_alpha;
 	transitionData->transitionPeriodMs = transitionPeriodMs;
 
-	fp_viewid id = fp_view_create(FP_VIEW_TRANSITION, true, transitionData);
-
 	/* copy pages */
 	for(int i = 0; i < pageCount; i++) {
-		newPages[i] = pages[i];
+		newPages[i] = fp_view_retain(pages[i]);
 		fp_view_get(newPages[i])->parent = id;
 	}
 
@@ -153,50 +167,100 @@ fp_frameid fp_transition_view_get_frame(fp_view* view) {
 	return ((fp_transition_view_data*)view->data)->frame;
 }
 
+/** reads the pixel at "index" of a page. frame-backed pages are read directly from "frame",
+ * frameless pages generate a single pixel span */
+static bool fp_transition_page_pixel(fp_viewid page, fp_frame* frame, unsigned int width, unsigned int height, uint16_t index, rgb_color* color) {
+	if(frame) {
+		if(index >= frame->length) {
+			return false;
+		}
+		*color = frame->pixels[index];
+		return true;
+	}
+
+	if(width == 0 || index >= width * height) {
+		return false;
+	}
+
+	const rgb_color* span = fp_view_get_span(page, index % width, index / width, 1, color);
+	if(!span) {
+		return false;
+	}
+
+	*color = *span;
+	return true;
+}
+
 bool fp_transition_view_render(fp_view* view) {
 	fp_transition_view_data* transitionData = view->data;
-	// TODO: add anim_view start/stop/pause functions
-	// add nextPage, previousPage, setPage, cycle functions that trigger transition animation playback
+	if(transitionData->frame == 0) {
+		/* scanline mode, the transition is evaluated in render_span when the parent reads it */
+		return true;
+	}
+
 	fp_frame* frame = fp_frame_get(transitionData->frame);
-	fp_frame* frameA = fp_frame_get(fp_view_get_frame(transitionData->pages[transitionData->previousPageIndex]));
-	fp_frame* frameB = fp_frame_get(fp_view_get_frame(transitionData->pages[transitionData->pageIndex]));
+	for(unsigned int row = 0; row < transitionData->height; row++) {
+		fp_transition_view_render_span(
+			view,
+			0, row,
+			transitionData->width,
+			&frame->pixels[fp_fcalc_index(0, row, frame->width)]
+		);
+	}
 
-	fp_frame* transitionA = fp_frame_get(fp_view_get_frame(transitionData->transition.viewA));
-	fp_frame* transitionB = fp_frame_get(fp_view_get_frame(transitionData->transition.viewB));
+	return true;
+}
 
+bool fp_transition_view_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out) {
+	fp_transition_view_data* transitionData = view->data;
+	// TODO: add anim_view start/stop/pause functions
+	// add nextPage, previousPage, setPage, cycle functions that trigger transition animation playback
+	fp_viewid pageA = transitionData->pages[transitionData->previousPageIndex];
+	fp_viewid pageB = transitionData->pages[transitionData->pageIndex];
 
-	for(int row = 0; row < fp_frame_height(frame); row++) {
-		for(int col = 0; col < frame->width; col++) {
-			rgb_color colorA = rgb(0, 0, 0);
-			rgb_color colorB = rgb(0, 0, 0);
-			uint8_t alphaA = 0;
-			uint8_t alphaB = 0;
+	unsigned int widthA, heightA, widthB, heightB;
+	fp_view_get_size(pageA, &widthA, &heightA);
+	fp_view_get_size(pageB, &widthB, &heightB);
 
-			if(row < fp_frame_height(transitionA) && col < transitionA->width) {
-				uint16_t indexA = transitionA->pixels[fp_fcalc_index(col, row, transitionA->width)].mapFields.index;
-				if(indexA < frameA->length) {
-					colorA = frameA->pixels[indexA];
-				}
-				alphaA = transitionA->pixels[fp_fcalc_index(col, row, transitionA->width)].mapFields.alpha;
-			}
+	fp_frame* frameA = fp_view_is_frameless(pageA) ? NULL : fp_frame_get(fp_view_get_frame(pageA));
+	fp_frame* frameB = fp_view_is_frameless(pageB) ? NULL : fp_frame_get(fp_view_get_frame(pageB));
 
-			if(row < fp_frame_height(transitionB) && col < transitionB->width) {
-				uint16_t indexB = transitionB->pixels[fp_fcalc_index(col, row, transitionB->width)].mapFields.index;
-				if(indexB < frameB->length) {
-					colorB = frameB->pixels[indexB];
-				}
-				alphaB = transitionB->pixels[fp_fcalc_index(col, row, transitionB->width)].mapFields.alpha;
-			}
+	fp_frame* transitionA = fp_frame_get(fp_view_get_frame(transitionData->transition.viewA));
+	fp_frame* transitionB = fp_frame_get(fp_view_get_frame(transitionData->transition.viewB));
 
+	unsigned int row = y;
+	for(unsigned int i = 0; i < width; i++) {
+		unsigned int col = x + i;
+		rgb_color colorA = rgb(0, 0, 0);
+		rgb_color colorB = rgb(0, 0, 0);
+		uint8_t alphaA = 0;
+		uint8_t alphaB = 0;
+
+		if(row < fp_frame_height(transitionA) && col < transitionA->width) {
+			uint16_t indexA = transitionA->pixels[fp_fcalc_index(col, row, transitionA->width)].mapFields.index;
+			fp_transition_page_pixel(pageA, frameA, widthA, heightA, indexA, &colorA);
+			alphaA = transitionA->pixels[fp_fcalc_index(col, row, transitionA->width)].mapFields.alpha;
+		}
 
-			frame->pixels[fp_fcalc_index(col, row, frame->width)] =
-				(*transitionData->blendFn)(colorA, alphaA, colorB, alphaB);
+		if(row < fp_frame_height(transitionB) && col < transitionB->width) {
+			uint16_t indexB = transitionB->pixels[fp_fcalc_index(col, row, transitionB->width)].mapFields.index;
+			fp_transition_page_pixel(pageB, frameB, widthB, heightB, indexB, &colorB);
+			alphaB = transitionB->pixels[fp_fcalc_index(col, row, transitionB->width)].mapFields.alpha;
 		}
+
+		out[i] = (*transitionData->blendFn)(colorA, alphaA, colorB, alphaB);
 	}
 
 	return true;
 }
 
+bool fp_transition_view_get_size(fp_view* view, unsigned int* width, unsigned int* height) {
+	fp_transition_view_data* transitionData = view->data;
+	*width = transitionData->width;
+	*height = transitionData->height;
+	return true;
+}
+
 bool fp_transition_view_onnext_render(fp_view* view) {
 	TickType_t currentTick = xTaskGetTickCount();
 	fp_transition_view_data* transitionData = view->data;
@@ -281,15 +345,16 @@ fp_transition fp_create_sliding_transition(unsigned int width, unsigned int heig
 
 bool fp_transition_view_free(fp_view* view) {
 	fp_transition_view_data* transitionData = view->data;
-	if(!view->composite) {
-		for(int i = 0; i < transitionData->pageCount; i++) {
-			fp_view_free(transitionData->pages[i]);
-		}
+	for(int i = 0; i < transitionData->pageCount; i++) {
+		fp_view_release(transitionData->pages[i]);
 	}
+	fp_view_release(transitionData->transition.viewA);
+	fp_view_release(transitionData->transition.viewB);
 
-	fp_frame_free(transitionData->frame);
-	free(transitionData->pages);
-	free(transitionData);
+	if(transitionData->frame != 0) {
+		fp_frame_free(transitionData->frame);
+	}
+	fp_view_free_children(view, transitionData->pages);
 
 	return true;
 }
@@ -21,11 +21,14 @@ typedef struct {
 	rgb_color (*blendFn)(rgb_color a, uint8_t aWeight, rgb_color b, uint8_t bWeight);
 	unsigned int transitionPeriodMs;
 	int loop; /* 1 = loop, 0 = stop, -1 = loop reverse */
-	/** stores the result of render */
+	unsigned int width;
+	unsigned int height;
+	/** stores the result of render. 0 when created in FP_COMPOSITOR_SCANLINE mode */
 	fp_frameid frame;
 
 } fp_transition_view_data;
 
+/** the transition views are retained. the caller may release its own references afterwards */
 fp_viewid fp_create_transition_view(
 	unsigned int width,
 	unsigned int height,
@@ -34,6 +37,7 @@ fp_viewid fp_create_transition_view(
 	unsigned int transitionPeriodMs
 );
 
+/** retains each page view and the transition views */
 fp_viewid fp_create_transition_view_composite(
 	unsigned int width,
 	unsigned int height,
@@ -47,6 +51,8 @@ fp_frameid fp_transition_view_get_frame(fp_view* view);
 bool fp_transition_view_render(fp_view* view);
 bool fp_transition_view_onnext_render(fp_view* view);
 bool fp_transition_view_free(fp_view* view);
+bool fp_transition_view_render_span(fp_view* view, unsigned int x, unsigned int y, unsigned int width, rgb_color* out);
+bool fp_transition_view_get_size(fp_view* view, unsigned int* width, unsigned int* height);
 
 bool fp_transition_loop(fp_viewid transitionView, bool reverse);
 bool fp_transition_set(fp_viewid transitionView, unsigned int pageIndex);
@@ -60,7 +66,9 @@ static const fp_view_register_data fp_transition_view_register_data = {
 	&fp_transition_view_get_frame,
 	&fp_transition_view_render,
 	&fp_transition_view_onnext_render,
-	&fp_transition_view_free
+	&fp_transition_view_free,
+	&fp_transition_view_render_span,
+	&fp_transition_view_get_size
 };
 
 #endif /* TRANSITION_VIEW_H */
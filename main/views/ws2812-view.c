@@ -1,10 +1,14 @@
 #include "ws2812-view.h"
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
 #include <math.h>
 #include <string.h>
 
 #include "../ws2812_control.h"
+#include "../render.h"
+#include "../mem.h"
 
 struct led_state ledState;
 
@@ -12,59 +16,159 @@ fp_frameid fp_ws2812_view_get_frame(fp_view* view) {
 	return ((fp_ws2812_view_data*)view->data)->frame;
 }
 
+/** LED index of the pixel at row, col */
+static unsigned int fp_ws2812_led_index(fp_index_mode indexMode, unsigned int width, unsigned int row, unsigned int col) {
+	switch(indexMode) {
+	case FP_INDEX_ZIGZAG:
+		/*
+		00 01 02 03 04 05 06 07
+		15 14 13 12 11 10 09 08
+		16 17 18 19 20 21 22 23
+		31 30 29 28 27 26 25 24
+		32 33 34 35 36 37 38 39
+		47 46 45 44 43 42 41 40
+		48 49 50 51 52 53 54 55
+		63 62 61 60 59 58 57 56
+		*/
+		if(row % 2 == 0) {
+			return row*width + col;
+		}
+		return row*width + (width - 1 - col);
+	case FP_INDEX_GRID:
+	default:
+		return row*width + col;
+	}
+}
+
+typedef struct {
+	fp_ws2812_view_data* screenData;
+	fp_frame* frame;
+	unsigned int width;
+} fp_ws2812_compose_context;
+
+/** composes rows [rowStart, rowEnd) of the child view.
+ * pixels are written to "leds" if provided, otherwise to the view's frame, otherwise straight into the RMT buffer */
+static void fp_ws2812_view_compose_rows(void* context, uint32_t* leds, unsigned int rowStart, unsigned int rowEnd) {
+	fp_ws2812_compose_context* composeContext = context;
+	fp_ws2812_view_data* screenData = composeContext->screenData;
+	fp_frame* frame = composeContext->frame;
+	unsigned int width = composeContext->width;
+
+	/* frame-backed children are read in place, frameless children are generated into spanBuffer.
+	 * in scanline mode this is the only working buffer for the whole view tree */
+	rgb_color spanBuffer[width];
+
+	/* apply gamma and indexing */
+	for(unsigned int row = rowStart; row < rowEnd; row++) {
+		const rgb_color* span = fp_view_get_span(screenData->childView, 0, row, width, spanBuffer);
+		if(!span) {
+			break;
+		}
+
+		/* FNV-1a over the final LED values */
+		uint32_t rowHash = 2166136261u;
+
+		for(unsigned int col = 0; col < width; col++) {
+			rgb_color color = span[col];
+			unsigned int index = fp_ws2812_led_index(screenData->indexMode, screenData->width, row, col);
+
+			color.fields.r = (uint8_t)(color.fields.r * screenData->brightness);
+			color.fields.g = (uint8_t)(color.fields.g * screenData->brightness);
+			color.fields.b = (uint8_t)(color.fields.b * screenData->brightness);
+
+			/* color.fields.r = gamma8[(int)(color.fields.r * screenData->brightness)]; */
+			/* color.fields.g = gamma8[(int)(color.fields.g * screenData->brightness)]; */
+			/* color.fields.b = gamma8[(int)(color.fields.b * screenData->brightness)]; */
+
+			rowHash = (rowHash ^ (color.bits & 0xffffff)) * 16777619u;
+
+			if(leds) {
+				leds[index] = color.bits;
+			}
+			else if(frame) {
+				frame->pixels[index] = color;
+			}
+			else {
+				ws2812_set_led(index, color.bits);
+			}
+		}
+
+		screenData->rowHashes[row] = rowHash;
+	}
+}
+
+/** true if the output matches the last transmitted frame, and the keep alive period hasn't elapsed */
+static bool fp_ws2812_view_is_redundant(fp_ws2812_view_data* screenData, unsigned int height, TickType_t currentTick) {
+	uint32_t hash = 2166136261u;
+	for(unsigned int row = 0; row < height; row++) {
+		hash = (hash ^ screenData->rowHashes[row]) * 16777619u;
+	}
+
+	bool redundant = screenData->keepAliveMs > 0
+		&& screenData->hasLastHash
+		&& hash == screenData->lastHash
+		&& currentTick - screenData->lastSentTick < pdMS_TO_TICKS(screenData->keepAliveMs);
+
+	screenData->lastHash = hash;
+	screenData->hasLastHash = true;
+	return redundant;
+}
+
 bool fp_ws2812_view_render(fp_view* view) {
 	fp_ws2812_view_data* screenData = view->data;
-	fp_frame* frame = fp_frame_get(screenData->frame);
-	fp_frame* childFrame = fp_frame_get(fp_view_get_frame(screenData->childView));
-
-	if(screenData->childView != 0) {
-		/* apply gamma and indexing */
-		for(int i = 0; i < frame->length && i < childFrame->length; i++) {
-			rgb_color color = childFrame->pixels[i];
-			unsigned int index;
-			switch(screenData->indexMode) {
-			case FP_INDEX_ZIGZAG:
-				/*
-				00 01 02 03 04 05 06 07
-				15 14 13 12 11 10 09 08
-				16 17 18 19 20 21 22 23
-				31 30 29 28 27 26 25 24
-				32 33 34 35 36 37 38 39
-				47 46 45 44 43 42 41 40
-				48 49 50 51 52 53 54 55
-				63 62 61 60 59 58 57 56
-				*/
-				if((i/frame->width) % 2 == 0) {
-					index = i;
-				}
-				else {
-					index = (i/frame->width)*frame->width + (frame->width - 1 - (i % frame->width));
-				}
-				break;
-			case FP_INDEX_GRID:
-			default:
-				index = i;
-			}
+	fp_frame* frame = screenData->frame != 0 ? fp_frame_get(screenData->frame) : NULL;
+	uint32_t* leds = NULL;
+	if(screenData->pipeline) {
+		int64_t waitStart = esp_timer_get_time();
+		leds = fp_pipeline_acquire(screenData->pipeline);
+		fp_render_add_output_wait(esp_timer_get_time() - waitStart);
+	}
+	else if(screenData->output) {
+		leds = screenData->outputBuffer;
+	}
 
-			frame->pixels[index].fields.r = (uint8_t)(color.fields.r * screenData->brightness);
-			frame->pixels[index].fields.g = (uint8_t)(color.fields.g * screenData->brightness);
-			frame->pixels[index].fields.b = (uint8_t)(color.fields.b * screenData->brightness);
+	unsigned int height = 0;
+	unsigned int childWidth;
+	unsigned int childHeight;
+	if(screenData->childView != 0 && fp_view_get_size(screenData->childView, &childWidth, &childHeight)) {
+		fp_ws2812_compose_context context = {
+			screenData,
+			frame,
+			childWidth < screenData->width ? childWidth : screenData->width
+		};
+		height = childHeight < screenData->height ? childHeight : screenData->height;
 
-			/* frame->pixels[i].fields.r = gamma8[(int)(color.fields.r * screenData->brightness)]; */
-			/* frame->pixels[i].fields.g = gamma8[(int)(color.fields.g * screenData->brightness)]; */
-			/* frame->pixels[i].fields.b = gamma8[(int)(color.fields.b * screenData->brightness)]; */
-		}
+		fp_ws2812_view_compose_rows(&context, leds, 0, height);
+	}
 
-		/*
-		fp_fset_rect(
-			screenData->frame,
-			0, 0,
-			fp_frame_get(fp_view_get_frame(screenData->childView))
-		);
-		*/
+	TickType_t currentTick = xTaskGetTickCount();
+	if(fp_ws2812_view_is_redundant(screenData, height, currentTick)) {
+		/* an unpublished pipeline buffer is handed out again by the next fp_pipeline_acquire */
+		screenData->stats.framesSkipped++;
+		return true;
 	}
 
-	fp_render_leds_ws2812(screenData->frame);
+	screenData->lastSentTick = currentTick;
+	screenData->stats.framesSent++;
+
+	int64_t inputTimestamp = fp_render_get_frame_input_timestamp();
+	if(screenData->pipeline) {
+		fp_pipeline_publish(screenData->pipeline, inputTimestamp);
+		return true;
+	}
+
+	int64_t outputStart = esp_timer_get_time();
+	if(screenData->output) {
+		fp_output_write(screenData->output, leds, screenData->width * screenData->height);
+	}
+	else if(frame) {
+		fp_render_leds_ws2812(screenData->frame);
+	}
+	else {
+		ws2812_transmit();
+	}
+	fp_render_add_output_wait(esp_timer_get_time() - outputStart);
+	fp_render_record_latency(inputTimestamp);
 
 	return true;
 }
@@ -75,18 +179,42 @@ bool fp_ws2812_view_onnext_render(fp_view* view) {
 
 
 fp_viewid fp_create_ws2812_view(unsigned int width, unsigned int height, fp_index_mode indexMode) {
-	fp_ws2812_view_data * screenData = malloc(sizeof(fp_ws2812_view_data));
-	if(!screenData) {
-		printf("error: fp_create_ws2812_view: failed to allocate memory for ws2812Data\n");
+	fp_viewid id = fp_view_create_inline(FP_VIEW_WS2812, false, sizeof(fp_ws2812_view_data));
+	if(id == 0) {
+		printf("error: fp_create_ws2812_view: failed to create view\n");
+		return 0;
+	}
+
+	fp_view* view = fp_view_get(id);
+	fp_ws2812_view_data* screenData = view->data;
+	screenData->rowHashes = fp_view_alloc_children(view, height * sizeof(uint32_t));
+	if(!screenData->rowHashes) {
+		printf("error: fp_create_ws2812_view: failed to allocate memory for rowHashes\n");
+		fp_view_free(id);
 		return 0;
 	}
+	memset(screenData->rowHashes, 0, height * sizeof(uint32_t));
 
-	screenData->frame = fp_frame_create(width, height, rgb(0,0,0));
+	screenData->width = width;
+	screenData->height = height;
+	screenData->frame = 0;
+	if(fp_view_get_compositor_mode() == FP_COMPOSITOR_BUFFERED) {
+		screenData->frame = fp_frame_create(width, height, rgb(0,0,0));
+	}
 	screenData->childView = 0;
 	screenData->brightness = 1.0f;
 	screenData->indexMode = indexMode;
+	screenData->pipeline = NULL;
+	screenData->output = NULL;
+	screenData->outputBuffer = NULL;
+	screenData->lastHash = 0;
+	screenData->hasLastHash = false;
+	screenData->lastSentTick = 0;
+	screenData->keepAliveMs = FP_WS2812_DEFAULT_KEEP_ALIVE_MS;
+	screenData->stats.framesSent = 0;
+	screenData->stats.framesSkipped = 0;
 
-	return fp_view_create(FP_VIEW_WS2812, false, screenData);
+	return id;
 }
 
 /* TODO: this makes some unnecessary copies and hardcodes one fixed-size LED array */
@@ -110,12 +238,22 @@ bool fp_render_leds_ws2812(fp_frameid id) {
 bool fp_ws2812_view_free(fp_view* view) {
 	fp_ws2812_view_data* screenData = view->data;
 
-	fp_frame_free(screenData->frame);
-	free(screenData);
+	if(screenData->frame != 0) {
+		fp_frame_free(screenData->frame);
+	}
+	fp_view_free_children(view, screenData->rowHashes);
+	fp_mem_free(screenData->outputBuffer);
 
 	return true;
 }
 
+bool fp_ws2812_view_get_size(fp_view* view, unsigned int* width, unsigned int* height) {
+	fp_ws2812_view_data* screenData = view->data;
+	*width = screenData->width;
+	*height = screenData->height;
+	return true;
+}
+
 void fp_ws2812_view_set_child(fp_viewid parent, fp_viewid child) {
 	fp_view* parentView = fp_view_get(parent);
 	fp_view* childView = fp_view_get(child);
@@ -125,3 +263,40 @@ void fp_ws2812_view_set_child(fp_viewid parent, fp_viewid child) {
 	parentViewData->childView = child;
 	childView->parent = parent;
 }
+
+void fp_ws2812_view_set_pipeline(fp_viewid id, fp_pipeline* pipeline) {
+	fp_view* view = fp_view_get(id);
+	fp_ws2812_view_data* screenData = view->data;
+
+	screenData->pipeline = pipeline;
+}
+
+bool fp_ws2812_view_set_output(fp_viewid id, fp_output* output) {
+	fp_view* view = fp_view_get(id);
+	fp_ws2812_view_data* screenData = view->data;
+
+	if(output && !screenData->outputBuffer) {
+		screenData->outputBuffer = fp_mem_calloc(FP_MEM_OUTPUT, screenData->width * screenData->height, sizeof(uint32_t));
+		if(!screenData->outputBuffer) {
+			printf("error: fp_ws2812_view_set_output: failed to allocate output buffer\n");
+			return false;
+		}
+	}
+
+	screenData->output = output;
+	return true;
+}
+
+void fp_ws2812_view_set_keep_alive(fp_viewid id, unsigned int keepAliveMs) {
+	fp_view* view = fp_view_get(id);
+	fp_ws2812_view_data* screenData = view->data;
+
+	screenData->keepAliveMs = keepAliveMs;
+}
+
+fp_ws2812_stats fp_ws2812_view_get_stats(fp_viewid id) {
+	fp_view* view = fp_view_get(id);
+	fp_ws2812_view_data* screenData = view->data;
+
+	return screenData->stats;
+}
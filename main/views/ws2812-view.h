@@ -3,7 +3,11 @@
 
 #include <stdbool.h>
 
+#include "freertos/FreeRTOS.h"
+
 #include "../view.h"
+#include "../pipeline.h"
+#include "../output.h"
 
 /* index mode changes the order of the pixels to match different types of displays */
 typedef enum {
@@ -12,12 +16,39 @@ typedef enum {
 } fp_index_mode;
 
 /* fp: fresh pixel */
+
+/* identical frames are still retransmitted after this long, so the LEDs recover from glitches */
+#define FP_WS2812_DEFAULT_KEEP_ALIVE_MS 1000
+
+typedef struct {
+	unsigned int framesSent;
+	/* renders that produced the same output as the last transmitted frame */
+	unsigned int framesSkipped;
+} fp_ws2812_stats;
+
 typedef struct {
 	fp_viewid childView;
+	unsigned int width;
+	unsigned int height;
+	/** 0 when created in FP_COMPOSITOR_SCANLINE mode. pixels are then encoded straight into the RMT buffer */
 	fp_frameid frame;
 	float brightness;
 	fp_index_mode indexMode;
+	/** optional. when set, render only composes the frame, and encoding/transmission runs on the pipeline's output stage */
+	fp_pipeline* pipeline;
+	/** optional. without a pipeline, frames are composed into outputBuffer and written to this output instead of the RMT buffer */
+	fp_output* output;
+	uint32_t* outputBuffer;
 	/* struct led_state leds; */
+
+	/** checksum of each row of the final (post brightness and indexing) output, computed while composing */
+	uint32_t* rowHashes;
+	uint32_t lastHash;
+	bool hasLastHash;
+	TickType_t lastSentTick;
+	/** 0 disables skipping identical frames */
+	unsigned int keepAliveMs;
+	fp_ws2812_stats stats;
 } fp_ws2812_view_data;
 
 /** screen view is just a buffered frame view. on render it explicitly makes a copy of its child view's primary frame*/
@@ -27,15 +58,23 @@ fp_frameid fp_ws2812_view_get_frame(fp_view* view);
 bool fp_ws2812_view_render(fp_view* view);
 bool fp_ws2812_view_onnext_render(fp_view* view);
 bool fp_ws2812_view_free(fp_view* view);
+bool fp_ws2812_view_get_size(fp_view* view, unsigned int* width, unsigned int* height);
 
 void fp_ws2812_view_set_child(fp_viewid parent, fp_viewid child);
+void fp_ws2812_view_set_pipeline(fp_viewid id, fp_pipeline* pipeline);
+/** write frames to output (e.g. a capture, or fp_output_ws2812 chained with one) when there is no pipeline. NULL to encode straight into the RMT buffer */
+bool fp_ws2812_view_set_output(fp_viewid id, fp_output* output);
+void fp_ws2812_view_set_keep_alive(fp_viewid id, unsigned int keepAliveMs);
+fp_ws2812_stats fp_ws2812_view_get_stats(fp_viewid id);
 bool fp_render_leds_ws2812(fp_frameid id);
 
 static const fp_view_register_data fp_ws2812_view_register_data = {
 	&fp_ws2812_view_get_frame,
 	&fp_ws2812_view_render,
 	&fp_ws2812_view_onnext_render,
-	&fp_ws2812_view_free
+	&fp_ws2812_view_free,
+	NULL,
+	&fp_ws2812_view_get_size
 };
 
 #endif /* WS2812_VIEW_H */
@@ -1,5 +1,7 @@
 #include "ws2812_control.h"
 #include "driver/rmt.h"
+#include "trace.h"
+#include "mem.h"
 
 // Configure these based on your project needs ********
 #define LED_RMT_TX_CHANNEL RMT_CHANNEL_0
@@ -41,25 +43,46 @@ void ws2812_control_init(void)
 
   ESP_ERROR_CHECK(rmt_config(&config));
   ESP_ERROR_CHECK(rmt_driver_install(config.channel, 0, 0));
+  fp_mem_add_static(FP_MEM_OUTPUT, sizeof(led_data_buffer));
 }
 
 void ws2812_write_leds(struct led_state new_state) {
   setup_rmt_data_buffer(new_state);
+  ws2812_transmit();
+}
+
+void ws2812_transmit(void) {
+  fp_trace_begin("rmt tx");
   ESP_ERROR_CHECK(rmt_write_items(LED_RMT_TX_CHANNEL, led_data_buffer, LED_BUFFER_ITEMS, false));
   ESP_ERROR_CHECK(rmt_wait_tx_done(LED_RMT_TX_CHANNEL, portMAX_DELAY));
+  fp_trace_end("rmt tx");
+}
+
+void ws2812_set_led(uint32_t led, uint32_t bits_to_send) {
+  if (led >= NUM_LEDS) {
+    return;
+  }
+
+  uint32_t mask = 1 << (BITS_PER_LED_CMD - 1);
+  for (uint32_t bit = 0; bit < BITS_PER_LED_CMD; bit++) {
+    uint32_t bit_is_set = bits_to_send & mask;
+    led_data_buffer[led * BITS_PER_LED_CMD + bit] = bit_is_set ?
+                                                    (rmt_item32_t){{{T1H, 1, T1L, 0}}} : 
+                                                    (rmt_item32_t){{{T0H, 1, T0L, 0}}};
+    mask >>= 1;
+  }
+}
+
+void ws2812_write_pixels(const uint32_t* leds, unsigned int length) {
+  for (uint32_t led = 0; led < length && led < NUM_LEDS; led++) {
+    ws2812_set_led(led, leds[led]);
+  }
+  ws2812_transmit();
 }
 
 void setup_rmt_data_buffer(struct led_state new_state) 
 {
   for (uint32_t led = 0; led < NUM_LEDS; led++) {
-    uint32_t bits_to_send = new_state.leds[led];
-    uint32_t mask = 1 << (BITS_PER_LED_CMD - 1);
-    for (uint32_t bit = 0; bit < BITS_PER_LED_CMD; bit++) {
-      uint32_t bit_is_set = bits_to_send & mask;
-      led_data_buffer[led * BITS_PER_LED_CMD + bit] = bit_is_set ?
-                                                      (rmt_item32_t){{{T1H, 1, T1L, 0}}} : 
-                                                      (rmt_item32_t){{{T0H, 1, T0L, 0}}};
-      mask >>= 1;
-    }
+    ws2812_set_led(led, new_state.leds[led]);
   }
 }
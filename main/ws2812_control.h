@@ -21,4 +21,14 @@ void ws2812_control_init(void);
 // the entire sequence.
 void ws2812_write_leds(struct led_state new_state);
 
+// Encode a single LED directly into the RMT buffer, without staging it in a led_state.
+// Used to stream pixels into the peripheral buffer as they are composited.
+void ws2812_set_led(uint32_t led, uint32_t bits);
+
+// Send the current contents of the RMT buffer. Blocks like ws2812_write_leds.
+void ws2812_transmit(void);
+
+// Encode and send "length" LED values (same layout as led_state). Blocks like ws2812_write_leds.
+void ws2812_write_pixels(const uint32_t* leds, unsigned int length);
+
 #endif
@@ -0,0 +1,215 @@
+#!/usr/bin/env python
+#
+# replays and diffs capture files recorded by main/capture.c
+#
+# usage:
+#   python tools/capture_tool.py info run.fpc
+#   python tools/capture_tool.py replay run.fpc [--zigzag] [--realtime] [--ppm <dir>]
+#   python tools/capture_tool.py diff run.fpc golden.fpc [--tolerance <n>] [--max-drift-us <n>]
+#
+# diff compares the frames in order, with repeats expanded, and reports the first mismatch and the timing drift
+# between the two captures. it exits with 1 if the frames differ by more than the tolerance, the frame counts differ,
+# or the drift exceeds --max-drift-us, so it can gate a regression test against a golden capture.
+
+from __future__ import print_function
+import argparse
+import os
+import struct
+import sys
+import time
+
+MAGIC = b'FPCP'
+VERSION = 1
+HEADER_SIZE = 12
+
+RECORD_FRAME = 1
+RECORD_REPEAT = 2
+
+
+class CaptureError(Exception):
+    pass
+
+
+class Capture(object):
+    def __init__(self, width, height):
+        self.width = width
+        self.height = height
+        # (microseconds since the first frame, rgb bytes, repeat)
+        self.frames = []
+
+
+def read_capture(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    if len(data) < HEADER_SIZE or data[:4] != MAGIC:
+        raise CaptureError('%s: not a capture file' % path)
+    version, _, width, height, _ = struct.unpack_from('<BBHHH', data, 4)
+    if version != VERSION:
+        raise CaptureError('%s: unsupported version %d' % (path, version))
+
+    capture = Capture(width, height)
+    frameSize = width * height * 3
+    offset = HEADER_SIZE
+    timestamp = 0
+    pixels = None
+    while offset < len(data):
+        if offset + 5 > len(data):
+            raise CaptureError('%s: truncated record at byte %d' % (path, offset))
+        delta, recordType = struct.unpack_from('<IB', data, offset)
+        offset += 5
+        timestamp += delta
+
+        if recordType == RECORD_FRAME:
+            if offset + frameSize > len(data):
+                # the device may have been stopped mid-write
+                print('warning: %s: truncated frame at byte %d' % (path, offset), file=sys.stderr)
+                break
+            pixels = data[offset:offset + frameSize]
+            offset += frameSize
+            capture.frames.append((timestamp, pixels, False))
+        elif recordType == RECORD_REPEAT:
+            if pixels is None:
+                raise CaptureError('%s: repeat before the first frame' % path)
+            capture.frames.append((timestamp, pixels, True))
+        else:
+            raise CaptureError('%s: unknown record type %d at byte %d' % (path, recordType, offset - 1))
+
+    return capture
+
+
+def grid_pixels(capture, pixels, zigzag):
+    """rows of (r, g, b) in screen order. leds are recorded in LED order, which is reversed on odd rows of a zigzag display"""
+    rows = []
+    for row in range(capture.height):
+        start = row * capture.width * 3
+        rowBytes = bytearray(pixels[start:start + capture.width * 3])
+        colors = [tuple(rowBytes[i:i + 3]) for i in range(0, len(rowBytes), 3)]
+        if zigzag and row % 2 == 1:
+            colors.reverse()
+        rows.append(colors)
+    return rows
+
+
+def info(args):
+    capture = read_capture(args.capture)
+    repeats = sum(1 for frame in capture.frames if frame[2])
+    duration = capture.frames[-1][0] if capture.frames else 0
+    print('%s: %dx%d, %d frames (%d repeats), %.3f s' % (args.capture, capture.width, capture.height, len(capture.frames), repeats, duration / 1e6))
+    if len(capture.frames) > 1:
+        print('%.1f fps' % ((len(capture.frames) - 1) * 1e6 / duration if duration > 0 else 0))
+    return 0
+
+
+def replay(args):
+    capture = read_capture(args.capture)
+    if args.ppm and not os.path.isdir(args.ppm):
+        os.makedirs(args.ppm)
+
+    lastTimestamp = 0
+    for index, (timestamp, pixels, repeat) in enumerate(capture.frames):
+        rows = grid_pixels(capture, pixels, args.zigzag)
+        if args.ppm:
+            with open(os.path.join(args.ppm, 'frame%05d.ppm' % index), 'wb') as f:
+                f.write(b'P6\n%d %d\n255\n' % (capture.width, capture.height))
+                f.write(bytes(bytearray(channel for row in rows for color in row for channel in color)))
+            continue
+
+        if args.realtime:
+            time.sleep((timestamp - lastTimestamp) / 1e6)
+        lastTimestamp = timestamp
+
+        out = ['\x1b[H' if args.realtime else '', 'frame %d at %.3f s%s\n' % (index, timestamp / 1e6, ' (repeat)' if repeat else '')]
+        for row in rows:
+            out.extend('\x1b[48;2;%d;%d;%dm  ' % color for color in row)
+            out.append('\x1b[0m\n')
+        sys.stdout.write(''.join(out))
+
+    return 0
+
+
+def diff(args):
+    capture = read_capture(args.capture)
+    golden = read_capture(args.golden)
+    if (capture.width, capture.height) != (golden.width, golden.height):
+        print('size differs: %dx%d, golden %dx%d' % (capture.width, capture.height, golden.width, golden.height))
+        return 1
+
+    failed = False
+    count = min(len(capture.frames), len(golden.frames))
+    if len(capture.frames) != len(golden.frames):
+        print('frame count differs: %d, golden %d. comparing the first %d' % (len(capture.frames), len(golden.frames), count))
+        failed = True
+
+    mismatched = 0
+    firstMismatch = None
+    maxDelta = 0
+    maxDrift = 0
+    intervalError = 0
+    for index in range(count):
+        timestamp, pixels, _ = capture.frames[index]
+        goldenTimestamp, goldenPixels, _ = golden.frames[index]
+
+        if pixels != goldenPixels:
+            delta = max(abs(a - b) for a, b in zip(bytearray(pixels), bytearray(goldenPixels)))
+            maxDelta = max(maxDelta, delta)
+            if delta > args.tolerance:
+                mismatched += 1
+                if firstMismatch is None:
+                    firstMismatch = index
+
+        maxDrift = max(maxDrift, abs(timestamp - goldenTimestamp))
+        if index > 0:
+            interval = timestamp - capture.frames[index - 1][0]
+            goldenInterval = goldenTimestamp - golden.frames[index - 1][0]
+            intervalError += abs(interval - goldenInterval)
+
+    print('frames: %d compared, %d differ by more than %d (max channel delta %d)' % (count, mismatched, args.tolerance, maxDelta))
+    if firstMismatch is not None:
+        print('first mismatch: frame %d at %.3f s' % (firstMismatch, capture.frames[firstMismatch][0] / 1e6))
+        failed = True
+
+    if count > 1:
+        finalDrift = capture.frames[count - 1][0] - golden.frames[count - 1][0]
+        print('timing: %+d us final drift, %d us max drift, %.1f us mean interval error' % (finalDrift, maxDrift, intervalError / float(count - 1)))
+        if args.max_drift_us is not None and maxDrift > args.max_drift_us:
+            print('drift exceeds %d us' % args.max_drift_us)
+            failed = True
+
+    print('FAIL' if failed else 'OK')
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='replay and diff LED capture files')
+    commands = parser.add_subparsers(dest='command')
+    commands.required = True
+
+    infoParser = commands.add_parser('info', help='summarize a capture')
+    infoParser.add_argument('capture')
+    infoParser.set_defaults(fn=info)
+
+    replayParser = commands.add_parser('replay', help='print frames to the terminal, or write them as ppm images')
+    replayParser.add_argument('capture')
+    replayParser.add_argument('--zigzag', action='store_true', help='the display is wired in FP_INDEX_ZIGZAG order')
+    replayParser.add_argument('--realtime', action='store_true', help='redraw in place at the recorded timing')
+    replayParser.add_argument('--ppm', metavar='DIR', help='write each frame to DIR/frameNNNNN.ppm instead')
+    replayParser.set_defaults(fn=replay)
+
+    diffParser = commands.add_parser('diff', help='compare a capture with a golden capture')
+    diffParser.add_argument('capture')
+    diffParser.add_argument('golden')
+    diffParser.add_argument('--tolerance', type=int, default=0, help='largest allowed difference of a color channel')
+    diffParser.add_argument('--max-drift-us', type=int, default=None, help='fail if a frame is further than this from its golden timestamp')
+    diffParser.set_defaults(fn=diff)
+
+    args = parser.parse_args()
+    try:
+        return args.fn(args)
+    except CaptureError as e:
+        print('error: %s' % e, file=sys.stderr)
+        return 2
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,262 @@
+#!/usr/bin/env python
+#
+# compiles a text scene description into the binary format loaded by main/scene-file.c
+#
+# usage: python tools/scene_compiler.py scenes/layers.scene spiffs_image/layers.fps
+#
+# one statement per line, '#' starts a comment. every frame, anim and layer defines a node,
+# and nodes must be defined before they are used.
+#
+#   frame <name> <width>x<height> fill <r> <g> <b>
+#   frame <name> ppm <path>                         binary ppm (P6), relative to the description
+#   anim <name> <periodMs> <play|once|stop> <node> [<node> ...]
+#   layer <name> <width>x<height>
+#       <node> [blend=replace|overwrite|add|multiply|alpha] [x=<n>] [y=<n>] [alpha=<0-255>]
+#   root <name>
+#
+# layer lines are indented under their layer statement. identical frames are stored once.
+
+from __future__ import print_function
+import argparse
+import os
+import struct
+import sys
+
+MAGIC = b'FPSC'
+VERSION = 1
+# FP_SCENE_FILE_MAX_FRAME_PIXELS in main/scene-file.h
+MAX_FRAME_PIXELS = 256 * 256
+
+NODE_FRAME = 1
+NODE_ANIM = 2
+NODE_LAYER = 3
+
+PLAYBACK = {'stop': 0, 'play': 1, 'once': 2}
+BLEND_MODES = {'replace': 0, 'overwrite': 1, 'add': 2, 'multiply': 3, 'alpha': 4}
+
+
+class SceneError(Exception):
+    pass
+
+
+def parse_size(text):
+    try:
+        width, height = (int(v) for v in text.split('x'))
+    except ValueError:
+        raise SceneError('invalid size "%s", expected <width>x<height>' % text)
+    if width <= 0 or height <= 0 or width > 0xffff or height > 0xffff:
+        raise SceneError('invalid size "%s"' % text)
+    return width, height
+
+
+def read_ppm(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    # header: magic, width, height, maxval, separated by whitespace, with optional comments
+    fields = []
+    offset = 0
+    while len(fields) < 4:
+        while data[offset:offset + 1].isspace():
+            offset += 1
+        if data[offset:offset + 1] == b'#':
+            offset = data.index(b'\n', offset)
+            continue
+        end = offset
+        while not data[end:end + 1].isspace():
+            end += 1
+        fields.append(data[offset:end])
+        offset = end
+    offset += 1
+
+    if fields[0] != b'P6':
+        raise SceneError('%s: only binary ppm (P6) is supported' % path)
+    width, height, maxval = (int(v) for v in fields[1:])
+    if maxval != 255:
+        raise SceneError('%s: only maxval 255 is supported' % path)
+    if width == 0 or height == 0 or width * height > MAX_FRAME_PIXELS:
+        raise SceneError('%s: frame must have between 1 and %d pixels' % (path, MAX_FRAME_PIXELS))
+
+    pixels = data[offset:offset + width * height * 3]
+    if len(pixels) != width * height * 3:
+        raise SceneError('%s: truncated pixel data' % path)
+    return width, height, bytes(pixels)
+
+
+class Scene(object):
+    def __init__(self):
+        # (width, height, rgb bytes)
+        self.frames = []
+        self.frameIndex = {}
+        self.nodes = []
+        self.nodeIndex = {}
+        self.root = None
+        self.framesShared = 0
+
+    def add_frame(self, width, height, pixels):
+        key = (width, height, pixels)
+        if key in self.frameIndex:
+            self.framesShared += 1
+            return self.frameIndex[key]
+        self.frameIndex[key] = len(self.frames)
+        self.frames.append(key)
+        return len(self.frames) - 1
+
+    def add_node(self, name, node):
+        if name in self.nodeIndex:
+            raise SceneError('node "%s" is already defined' % name)
+        self.nodeIndex[name] = len(self.nodes)
+        self.nodes.append(node)
+
+    def node(self, name):
+        if name not in self.nodeIndex:
+            raise SceneError('unknown node "%s"' % name)
+        return self.nodeIndex[name]
+
+
+def parse(path):
+    scene = Scene()
+    layer = None
+    baseDir = os.path.dirname(path)
+
+    with open(path) as f:
+        lines = f.readlines()
+
+    for lineNumber, line in enumerate(lines, 1):
+        indented = line[:1].isspace()
+        tokens = line.split('#', 1)[0].split()
+        if not tokens:
+            continue
+
+        try:
+            if indented:
+                if layer is None:
+                    raise SceneError('indented line outside of a layer')
+                entry = {'node': scene.node(tokens[0]), 'blend': 0, 'x': 0, 'y': 0, 'alpha': 255}
+                for option in tokens[1:]:
+                    key, _, value = option.partition('=')
+                    if key == 'blend':
+                        if value not in BLEND_MODES:
+                            raise SceneError('unknown blend mode "%s"' % value)
+                        entry['blend'] = BLEND_MODES[value]
+                    elif key in ('x', 'y', 'alpha'):
+                        entry[key] = int(value)
+                    else:
+                        raise SceneError('unknown layer option "%s"' % key)
+                if entry['alpha'] < 0 or entry['alpha'] > 255:
+                    raise SceneError('alpha must be between 0 and 255')
+                if not (0 <= entry['x'] <= 0xffff and 0 <= entry['y'] <= 0xffff):
+                    raise SceneError('offsets must be between 0 and 65535')
+                layer['layers'].append(entry)
+                continue
+
+            layer = None
+            statement = tokens[0]
+            if statement == 'frame' and len(tokens) >= 4 and tokens[2] == 'ppm':
+                width, height, pixels = read_ppm(os.path.join(baseDir, tokens[3]))
+                scene.add_node(tokens[1], {'type': NODE_FRAME, 'frame': scene.add_frame(width, height, pixels)})
+            elif statement == 'frame' and len(tokens) == 7 and tokens[3] == 'fill':
+                width, height = parse_size(tokens[2])
+                color = bytes(bytearray(int(v) for v in tokens[4:7]))
+                scene.add_node(tokens[1], {'type': NODE_FRAME, 'frame': scene.add_frame(width, height, color * (width * height))})
+            elif statement == 'anim' and len(tokens) >= 5:
+                if tokens[3] not in PLAYBACK:
+                    raise SceneError('unknown playback "%s"' % tokens[3])
+                scene.add_node(tokens[1], {
+                    'type': NODE_ANIM,
+                    'period': int(tokens[2]),
+                    'playback': PLAYBACK[tokens[3]],
+                    'children': [scene.node(name) for name in tokens[4:]],
+                })
+            elif statement == 'layer' and len(tokens) == 3:
+                width, height = parse_size(tokens[2])
+                layer = {'type': NODE_LAYER, 'width': width, 'height': height, 'layers': []}
+                scene.add_node(tokens[1], layer)
+            elif statement == 'root' and len(tokens) == 2:
+                scene.root = scene.node(tokens[1])
+            else:
+                raise SceneError('invalid statement')
+        except (SceneError, ValueError) as e:
+            raise SceneError('%s:%d: %s' % (path, lineNumber, e))
+
+    for node in scene.nodes:
+        if node['type'] == NODE_LAYER and not node['layers']:
+            raise SceneError('%s: layer has no layers' % path)
+    if scene.root is None:
+        if not scene.nodes:
+            raise SceneError('%s: scene is empty' % path)
+        scene.root = len(scene.nodes) - 1
+    return scene
+
+
+def reachable(scene):
+    """node indices used by the root, in definition order. nodes only reference earlier nodes, so the root comes last"""
+    used = set()
+    stack = [scene.root]
+    while stack:
+        index = stack.pop()
+        if index in used:
+            continue
+        used.add(index)
+        node = scene.nodes[index]
+        if node['type'] == NODE_ANIM:
+            stack.extend(node['children'])
+        elif node['type'] == NODE_LAYER:
+            stack.extend(layer['node'] for layer in node['layers'])
+    return sorted(used)
+
+
+def compile_scene(scene):
+    order = reachable(scene)
+    remap = dict((old, new) for new, old in enumerate(order))
+
+    usedFrames = sorted(set(scene.nodes[i]['frame'] for i in order if scene.nodes[i]['type'] == NODE_FRAME))
+    frameRemap = dict((old, new) for new, old in enumerate(usedFrames))
+
+    out = bytearray()
+    out += MAGIC
+    out += struct.pack('<BBHHH', VERSION, 0, len(usedFrames), len(order), 0)
+
+    for index in usedFrames:
+        width, height, pixels = scene.frames[index]
+        out += struct.pack('<HH', width, height)
+        out += pixels
+
+    for index in order:
+        node = scene.nodes[index]
+        if node['type'] == NODE_FRAME:
+            out += struct.pack('<BH', NODE_FRAME, frameRemap[node['frame']])
+        elif node['type'] == NODE_ANIM:
+            out += struct.pack('<BHBH', NODE_ANIM, node['period'], node['playback'], len(node['children']))
+            for child in node['children']:
+                out += struct.pack('<H', remap[child])
+        elif node['type'] == NODE_LAYER:
+            out += struct.pack('<BHHH', NODE_LAYER, node['width'], node['height'], len(node['layers']))
+            for layer in node['layers']:
+                out += struct.pack('<HBHHB', remap[layer['node']], layer['blend'], layer['x'], layer['y'], layer['alpha'])
+
+    return bytes(out), len(usedFrames), len(order)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='compile a text scene description into a binary scene file')
+    parser.add_argument('input', help='scene description')
+    parser.add_argument('output', help='binary scene file, e.g. in spiffs_image')
+    args = parser.parse_args()
+
+    try:
+        scene = parse(args.input)
+        data, frameCount, nodeCount = compile_scene(scene)
+    except SceneError as e:
+        print('error: %s' % e, file=sys.stderr)
+        return 1
+
+    with open(args.output, 'wb') as f:
+        f.write(data)
+
+    print('%s: %d nodes, %d frames (%d shared), %d bytes' % (args.output, nodeCount, frameCount, scene.framesShared, len(data)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())